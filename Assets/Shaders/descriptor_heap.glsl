@@ -0,0 +1,19 @@
+// Descriptor heap shared by all pipeline layouts reading it, matches Renderer::Resource::DescriptorHeap
+// Included with GL_GOOGLE_include_directive, slots come from per draw data
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define DESCRIPTOR_HEAP_SET 1
+#define MAX_HEAP_IMAGE_COUNT 4096
+#define MAX_HEAP_BUFFER_COUNT 4096
+
+layout (set = DESCRIPTOR_HEAP_SET, binding = 0) uniform sampler2D heapImages[MAX_HEAP_IMAGE_COUNT];
+
+// Slots may differ within a draw, so every access is non uniform
+#define HEAP_IMAGE(slot) heapImages[nonuniformEXT(slot)]
+
+// Declares a view of the buffer slots, e.g. DESCRIPTOR_HEAP_BUFFER(MaterialBuffer, Material, heapMaterials)
+#define DESCRIPTOR_HEAP_BUFFER(Block, Type, name) \
+	layout (std430, set = DESCRIPTOR_HEAP_SET, binding = 1) readonly buffer Block { Type data[]; } name[MAX_HEAP_BUFFER_COUNT]
+
+#define HEAP_BUFFER(name, slot) name[nonuniformEXT(slot)].data
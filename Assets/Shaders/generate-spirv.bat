@@ -1,3 +1,5 @@
 glslangvalidator -V triangle.vert -o triangle.vert.spv 
-glslangvalidator -V triangle.frag -o triangle.frag.spv
+glslangvalidator -V hiz_downsample.comp -o hiz_downsample.comp.spv
+glslangvalidator -V vt_feedback.vert -o vt_feedback.vert.spv
+glslangvalidator -V vt_feedback.frag -o vt_feedback.frag.spv
 
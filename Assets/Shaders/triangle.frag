@@ -1,9 +1,20 @@
 #version 450
 
+// Variants of RenderPassMesh, ALBEDO_TEXTURE samples the streamed texture bound by the draw
+
 layout (location = 0) in vec3 inColor;
 layout (location = 0) out vec4 outFragColor;
 
+#ifdef ALBEDO_TEXTURE
+layout (location = 1) in vec2 inTex;
+layout (binding = 3) uniform sampler2D albedo;
+#endif
+
 void main() 
 {
+#ifdef ALBEDO_TEXTURE
+  outFragColor = vec4(inColor, 1.0) * texture(albedo, inTex);
+#else
   outFragColor = vec4(inColor, 1.0);
+#endif
 }
\ No newline at end of file
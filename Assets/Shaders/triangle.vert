@@ -7,11 +7,46 @@ layout (location = 2) in vec2 inTex;
 layout (binding = 0) uniform UBO 
 {
 	mat4 projectionMatrix;
-	mat4 modelMatrix;
 	mat4 viewMatrix;
 } ubo;
 
+// Renderer::Resource::DrawPushConstants
+layout (push_constant) uniform DrawConstants
+{
+	mat4 modelMatrix;
+	uint objectIndex;
+	uint materialIndex;
+	uint drawIndex;
+} draw;
+
+// Renderer::Resource::NO_DRAW_INDEX
+#define NO_DRAW_INDEX 0xFFFFFFFFu
+
+struct InstanceData
+{
+	mat4 modelMatrix;
+	vec4 boundingSphere;
+	uint firstLod;
+	uint lodCount;
+	int  vertexOffset;
+	uint clusterCount;
+	vec4 positionOffset;
+	vec4 positionScale;
+};
+
+layout (std430, binding = 1) readonly buffer Instances
+{
+	InstanceData instances[];
+};
+
+// Instance of each culled command, commands start at instance 0 without drawIndirectFirstInstance
+layout (std430, binding = 2) readonly buffer DrawInstances
+{
+	uint drawInstances[];
+};
+
 layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outTex;
 
 out gl_PerVertex 
 {
@@ -21,6 +56,13 @@ out gl_PerVertex
 
 void main() 
 {
+	uint instanceIndex = draw.drawIndex == NO_DRAW_INDEX ? uint(gl_InstanceIndex) : drawInstances[draw.drawIndex];
+	InstanceData instance = instances[instanceIndex];
+
+	// Positions are snorm inside the bounds box of the submesh
+	vec3 position = instance.positionOffset.xyz + inPos.xyz * instance.positionScale.xyz;
+
 	outColor = inColor;
-	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * vec4(inPos.xyz, 1.0);
+	outTex = inTex;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * draw.modelMatrix * instance.modelMatrix * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+// Virtual texture sampling and feedback, matches Renderer::Resource::VirtualTextureSystem
+// Included with GL_GOOGLE_include_directive, descriptor_heap.glsl has to be included first to sample
+
+#define VIRTUAL_TEXTURE_TILE_SIZE 128
+#define VIRTUAL_TEXTURE_TILE_BORDER 4
+#define VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE 24
+#define VIRTUAL_TEXTURE_ATLAS_TILE_EXTENT (VIRTUAL_TEXTURE_TILE_SIZE + 2 * VIRTUAL_TEXTURE_TILE_BORDER)
+#define VIRTUAL_TEXTURE_ATLAS_EXTENT (VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE * VIRTUAL_TEXTURE_ATLAS_TILE_EXTENT)
+
+// Mip the hardware would pick, mipBias compensates a feedback target smaller than the screen
+float VirtualTextureMip(vec2 uv, uint pageCount, uint mipCount, float mipBias)
+{
+	vec2 texel = uv * float(pageCount * VIRTUAL_TEXTURE_TILE_SIZE);
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float mip = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + mipBias;
+
+	return clamp(mip, 0.0, float(mipCount - 1));
+}
+
+// textureId:4 | mip:4 | pageY:12 | pageX:12, see EncodeVirtualTextureTile()
+uint VirtualTextureFeedback(vec2 uv, uint textureId, uint pageCount, uint mipCount, float mipBias)
+{
+	uint mip = uint(VirtualTextureMip(uv, pageCount, mipCount, mipBias));
+	uvec2 page = min(uvec2(fract(uv) * float(pageCount >> mip)), uvec2((pageCount >> mip) - 1));
+
+	return (textureId << 28) | (mip << 24) | (page.y << 12) | page.x;
+}
+
+#ifdef DESCRIPTOR_HEAP_SET
+// Samples the finest resident tile, pages without one fall back to a coarser mip
+vec4 VirtualTextureSample(uint pageTableSlot, uint atlasSlot, vec2 uv, uint pageCount, uint mipCount)
+{
+	uint mip = uint(VirtualTextureMip(uv, pageCount, mipCount, 0.0));
+	ivec2 page = ivec2(fract(uv) * float(pageCount)) >> mip;
+	uvec4 entry = uvec4(round(texelFetch(HEAP_IMAGE(pageTableSlot), page, int(mip)) * 255.0));
+
+	// Position inside the page of the mapped mip, the border keeps the bilinear footprint inside the tile
+	vec2 pageCoord = fract(fract(uv) * float(pageCount >> entry.b));
+	vec2 atlasTexel = vec2(entry.rg * VIRTUAL_TEXTURE_ATLAS_TILE_EXTENT + VIRTUAL_TEXTURE_TILE_BORDER) + pageCoord * float(VIRTUAL_TEXTURE_TILE_SIZE);
+
+	return textureLod(HEAP_IMAGE(atlasSlot), atlasTexel / float(VIRTUAL_TEXTURE_ATLAS_EXTENT), 0.0);
+}
+#endif
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "virtual_texture.glsl"
+
+// Placed after the DrawConstants of vt_feedback.vert
+layout (push_constant) uniform FeedbackParams
+{
+	layout (offset = 80) uint textureId;
+	uint pageCount;
+	uint mipCount;
+	// log2 of how much smaller the feedback target is than the screen, negated
+	float mipBias;
+} params;
+
+layout (location = 0) in vec2 inTex;
+layout (location = 0) out uint outFeedback;
+
+void main() 
+{
+	outFeedback = VirtualTextureFeedback(inTex, params.textureId, params.pageCount, params.mipCount, params.mipBias);
+}
@@ -0,0 +1,65 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 2) in vec2 inTex;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+// Renderer::Resource::DrawPushConstants
+layout (push_constant) uniform DrawConstants
+{
+	mat4 modelMatrix;
+	uint objectIndex;
+	uint materialIndex;
+	uint drawIndex;
+} draw;
+
+// Renderer::Resource::NO_DRAW_INDEX
+#define NO_DRAW_INDEX 0xFFFFFFFFu
+
+struct InstanceData
+{
+	mat4 modelMatrix;
+	vec4 boundingSphere;
+	uint firstLod;
+	uint lodCount;
+	int  vertexOffset;
+	uint clusterCount;
+	vec4 positionOffset;
+	vec4 positionScale;
+};
+
+layout (std430, binding = 1) readonly buffer Instances
+{
+	InstanceData instances[];
+};
+
+// Instance of each culled command, commands start at instance 0 without drawIndirectFirstInstance
+layout (std430, binding = 2) readonly buffer DrawInstances
+{
+	uint drawInstances[];
+};
+
+layout (location = 0) out vec2 outTex;
+
+out gl_PerVertex 
+{
+    vec4 gl_Position;   
+};
+
+// Same transform as triangle.vert, the depth test then matches the mesh pass
+void main() 
+{
+	uint instanceIndex = draw.drawIndex == NO_DRAW_INDEX ? uint(gl_InstanceIndex) : drawInstances[draw.drawIndex];
+	InstanceData instance = instances[instanceIndex];
+
+	// Positions are snorm inside the bounds box of the submesh
+	vec3 position = instance.positionOffset.xyz + inPos.xyz * instance.positionScale.xyz;
+
+	outTex = inTex;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * draw.modelMatrix * instance.modelMatrix * vec4(position, 1.0);
+}
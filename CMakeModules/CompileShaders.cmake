@@ -0,0 +1,66 @@
+#-------------------------------------------------------------------
+# Compiles the shaders listed in generate-spirv.bat at build time
+#
+# The script stays the only list of shaders, ShaderHotReload reads the
+# same lines at runtime. The generated .spv files are written next to
+# their sources, where the render passes load them from.
+#
+# OCTO_COMPILE_SHADERS(<target> <shader directory>)
+#-------------------------------------------------------------------
+
+find_program(GLSLANG_VALIDATOR
+	NAMES glslangValidator glslangvalidator
+	HINTS "$ENV{VULKAN_SDK}/Bin" "$ENV{VULKAN_SDK}/bin"
+)
+
+function(OCTO_COMPILE_SHADERS TARGET_NAME SHADER_DIR)
+	#No SPIR-V is committed, without the compiler the application has no shaders to load
+	if(NOT GLSLANG_VALIDATOR)
+		message(FATAL_ERROR "glslangValidator not found, install the Vulkan SDK or set GLSLANG_VALIDATOR to compile the shaders in ${SHADER_DIR}")
+	endif()
+
+	#Any include may be used by any shader
+	file(GLOB SHADER_INCLUDES "${SHADER_DIR}/*.glsl")
+
+	set(SHADER_OUTPUTS)
+	file(STRINGS "${SHADER_DIR}/generate-spirv.bat" SCRIPT_LINES)
+	foreach(SCRIPT_LINE ${SCRIPT_LINES})
+		separate_arguments(WORDS UNIX_COMMAND "${SCRIPT_LINE}")
+
+		#Same rules as ShaderHotReload::ParseCompileJobs
+		set(SHADER_SOURCE)
+		set(SHADER_OUTPUT)
+		set(SHADER_ARGUMENTS)
+		set(NEXT_IS_OUTPUT FALSE)
+		set(WORD_INDEX 0)
+		foreach(WORD ${WORDS})
+			if(WORD_INDEX EQUAL 0)
+			elseif(NEXT_IS_OUTPUT)
+				set(SHADER_OUTPUT "${WORD}")
+				set(NEXT_IS_OUTPUT FALSE)
+			elseif(WORD STREQUAL "-o")
+				set(NEXT_IS_OUTPUT TRUE)
+			elseif(WORD STREQUAL "-V")
+			elseif(WORD MATCHES "^-")
+				list(APPEND SHADER_ARGUMENTS "${WORD}")
+			else()
+				set(SHADER_SOURCE "${WORD}")
+			endif()
+			math(EXPR WORD_INDEX "${WORD_INDEX} + 1")
+		endforeach()
+
+		if(SHADER_SOURCE AND SHADER_OUTPUT)
+			add_custom_command(
+				OUTPUT "${SHADER_DIR}/${SHADER_OUTPUT}"
+				COMMAND ${GLSLANG_VALIDATOR} -V ${SHADER_ARGUMENTS} "${SHADER_SOURCE}" -o "${SHADER_OUTPUT}"
+				DEPENDS "${SHADER_DIR}/${SHADER_SOURCE}" ${SHADER_INCLUDES} "${SHADER_DIR}/generate-spirv.bat"
+				WORKING_DIRECTORY "${SHADER_DIR}"
+				COMMENT "Compiling ${SHADER_OUTPUT}"
+				VERBATIM
+			)
+			list(APPEND SHADER_OUTPUTS "${SHADER_DIR}/${SHADER_OUTPUT}")
+		endif()
+	endforeach()
+
+	add_custom_target(${TARGET_NAME} ALL DEPENDS ${SHADER_OUTPUTS})
+endfunction()
@@ -24,6 +24,8 @@
 
 //Core
 #include <OctoCore/Public/DOD.h>
+#include <OctoCore/Public/AssimpLoader.h>
+#include <OctoCore/Public/TextureTranscoder.h>
 
 //ThirdParty
 #include <ThirdParty/glm/glm/glm.hpp>
@@ -41,6 +43,7 @@
 //Other
 #include <filesystem>
 #include <chrono>
+#include <cstdio>
 
 //func
 LRESULT CALLBACK HandleWindowMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
@@ -48,6 +51,8 @@ bool GenerateEvents(MSG& msg);
 
 int g_iDesktopWidth = 800;
 int g_iDesktopHeight = 600;
+bool g_bInSizeMove = false;
+bool g_bRendererInitialized = false;
 
 bool GenerateEvents(MSG& msg)
 {
@@ -68,11 +73,30 @@ bool GenerateEvents(MSG& msg)
 
 int main(int argc, char *argv[])
 {
+	//Offline mesh cooking: -cook <source mesh> <cooked mesh>
+	if (argc == 4 && std::string(argv[1]) == "-cook")
+	{
+		return Core::Mesh::AssimpLoader::CookMesh(argv[2], argv[3]) ? 0 : 1;
+	}
+
+	//Offline texture transcoding: -transcode <source texture> <cooked ktx> <bc1|bc3|bc5|bc7>
+	if (argc == 5 && std::string(argv[1]) == "-transcode")
+	{
+		Core::Texture::TranscodeFormat::Enum format;
+		if (!Core::Texture::TextureTranscoder::ParseFormat(argv[4], format))
+		{
+			printf("ERROR: main: unknown texture format %s \n", argv[4]);
+			return 1;
+		}
+		return Core::Texture::TextureTranscoder::Transcode(argv[2], argv[3], format) ? 0 : 1;
+	}
+
 	std::unique_ptr<VulkanRendererInitializer> renderer_initializer = std::make_unique<VulkanRendererInitializer>();
 	renderer_initializer->CreateWindows(g_iDesktopWidth, g_iDesktopHeight, HandleWindowMessages);
 
 	Renderer::Vulkan::RenderSystem::Init(true, true, "Triangle", renderer_initializer->m_hinstance, renderer_initializer->m_HwndWindows);
 	Renderer::RenderProcess::Init();
+	g_bRendererInitialized = true;
 
 #if defined(_WIN32)
 	MSG msg;
@@ -108,8 +132,6 @@ void WIN_Sizing(WORD side, RECT *rect)
 
 	g_iDesktopWidth -= decoWidth;
 	g_iDesktopHeight -= decoHeight;
-
-	Renderer::Vulkan::RenderSystem::backBufferDimensions = glm::uvec2(g_iDesktopWidth, g_iDesktopHeight);
 }
 
 LRESULT CALLBACK HandleWindowMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
@@ -127,11 +149,22 @@ LRESULT CALLBACK HandleWindowMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
 		{
 			WIN_Sizing(wParam, &rect);
 		}
+
+		//Dragging resizes once the size move loop ends, anything else (maximize, snap, SetWindowPos) right away
+		if (g_bRendererInitialized && !g_bInSizeMove && wParam != SIZE_MINIMIZED)
+		{
+			Renderer::RenderProcess::Resize();
+		}
+		break;
+	case WM_ENTERSIZEMOVE:
+		g_bInSizeMove = true;
 		break;
 	case WM_EXITSIZEMOVE:
-		Renderer::Vulkan::RenderSystem::ResizeSwapchain();
-		//RecreateAfterSwapchainResize();
-		//g_Renderer.VWindowResize(g_iDesktopHeight, g_iDesktopWidth);
+		g_bInSizeMove = false;
+		if (g_bRendererInitialized)
+		{
+			Renderer::RenderProcess::Resize();
+		}
 		break;
 	}
 	return DefWindowProc(hWnd, uMsg, wParam, lParam);
@@ -0,0 +1,471 @@
+#include "AssimpLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "TangentGenerator.h"
+
+//ThirdParty
+#include <ThirdParty/assimp/include/assimp/Importer.hpp>
+#include <ThirdParty/assimp/include/assimp/scene.h>
+#include <ThirdParty/assimp/include/assimp/postprocess.h>
+
+//Other
+#include <cassert>
+#include <cstdio>
+#include <cfloat>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		namespace
+		{
+			//Each level aims for half the triangles of the previous one
+			const float LOD_TRIANGLE_RATIO = 0.5f;
+
+			//Levels saving less than this share of the previous level's triangles are not worth a switch
+			const float LOD_MIN_REDUCTION = 0.2f;
+
+			uint64_t AlignSectionOffset(uint64_t offset)
+			{
+				return (offset + MESH_FILE_SECTION_ALIGNMENT - 1u) & ~static_cast<uint64_t>(MESH_FILE_SECTION_ALIGNMENT - 1u);
+			}
+
+			MeshFileBounds CalculateBounds(const CookedVertex* vertices, uint32_t vertexCount)
+			{
+				MeshFileBounds bounds;
+				bounds.min = glm::vec3(FLT_MAX);
+				bounds.max = glm::vec3(-FLT_MAX);
+
+				for (uint32_t i = 0u; i < vertexCount; i++)
+				{
+					bounds.min = glm::min(bounds.min, vertices[i].position);
+					bounds.max = glm::max(bounds.max, vertices[i].position);
+				}
+
+				//Sphere around the box center, tighter than the box diagonal for most meshes
+				const glm::vec3 center = vertexCount > 0u ? (bounds.min + bounds.max) * 0.5f : glm::vec3(0.0f);
+				float radiusSquared = 0.0f;
+				for (uint32_t i = 0u; i < vertexCount; i++)
+				{
+					const glm::vec3 offset = vertices[i].position - center;
+					radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+				}
+
+				if (vertexCount == 0u)
+				{
+					bounds.min = bounds.max = glm::vec3(0.0f);
+				}
+
+				bounds.sphere = glm::vec4(center, glm::sqrt(radiusSquared));
+				return bounds;
+			}
+
+			bool WriteSection(FILE* fp, uint64_t offset, const void* data, uint64_t size)
+			{
+				if (size == 0u)
+				{
+					return true;
+				}
+
+				//Padding between the sections is zeroed
+				static const uint8_t zeros[MESH_FILE_SECTION_ALIGNMENT] = {};
+				const uint64_t position = static_cast<uint64_t>(ftell(fp));
+				assert(offset >= position && offset - position < MESH_FILE_SECTION_ALIGNMENT);
+
+				if (offset > position && fwrite(zeros, static_cast<size_t>(offset - position), 1, fp) != 1u)
+				{
+					return false;
+				}
+
+				return fwrite(data, static_cast<size_t>(size), 1, fp) == 1u;
+			}
+
+			aiMatrix4x4 GetModelTransform(const aiNode* node)
+			{
+				aiMatrix4x4 transform = node->mTransformation;
+				for (const aiNode* parent = node->mParent; parent != nullptr; parent = parent->mParent)
+				{
+					transform = parent->mTransformation * transform;
+				}
+
+				return transform;
+			}
+
+			//Depth first, so parents are written before their children. Nodes between two joints are folded into the child
+			void CollectJoints(const aiNode* node, int32_t parentJoint, const std::unordered_map<std::string, const aiBone*>& bones,
+				std::vector<const aiNode*>& jointNodes, std::vector<MeshFileJoint>& joints)
+			{
+				const auto boneIt = bones.find(node->mName.C_Str());
+				if (boneIt != bones.end())
+				{
+					aiMatrix4x4 local = GetModelTransform(node);
+					if (parentJoint >= 0)
+					{
+						aiMatrix4x4 parentInverse = GetModelTransform(jointNodes[parentJoint]);
+						parentInverse.Inverse();
+						local = parentInverse * local;
+					}
+
+					//SkeletonPose has no joint scale, it is dropped
+					aiVector3D scaling;
+					aiVector3D translation;
+					aiQuaternion rotation;
+					local.Decompose(scaling, rotation, translation);
+
+					const aiMatrix4x4& offset = boneIt->second->mOffsetMatrix;
+					MeshFileJoint joint = {};
+					joint.parent = parentJoint;
+					joint.bindRotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+					joint.bindTranslation = glm::vec4(translation.x, translation.y, translation.z, 0.0f);
+					for (uint32_t column = 0u; column < 4u; column++)
+					{
+						joint.inverseBindPose[0][column] = offset[0][column];
+						joint.inverseBindPose[1][column] = offset[1][column];
+						joint.inverseBindPose[2][column] = offset[2][column];
+					}
+
+					parentJoint = static_cast<int32_t>(joints.size());
+					jointNodes.push_back(node);
+					joints.push_back(joint);
+				}
+
+				for (uint32_t childIdx = 0u; childIdx < node->mNumChildren; childIdx++)
+				{
+					CollectJoints(node->mChildren[childIdx], parentJoint, bones, jointNodes, joints);
+				}
+			}
+		}
+
+		bool AssimpLoader::CookMesh(const std::string& sourcePath, const std::string& cookedPath)
+		{
+			//Limited to the four influences PackedSkin holds
+			const uint32_t importFlags =
+				aiProcess_Triangulate |
+				aiProcess_JoinIdenticalVertices |
+				aiProcess_GenSmoothNormals |
+				aiProcess_LimitBoneWeights |
+				aiProcess_SortByPType |
+				aiProcess_FlipUVs;
+
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(sourcePath, importFlags);
+			if (scene == nullptr || scene->mRootNode == nullptr)
+			{
+				printf("ERROR: AssimpLoader::CookMesh: %s \n", importer.GetErrorString());
+				return false;
+			}
+
+			//Skinned meshes stay in mesh space and are placed by their joints, static ones get the hierarchy flattened into them
+			std::unordered_map<std::string, const aiBone*> bones;
+			for (uint32_t meshIdx = 0u; meshIdx < scene->mNumMeshes; meshIdx++)
+			{
+				const aiMesh* mesh = scene->mMeshes[meshIdx];
+				for (uint32_t boneIdx = 0u; boneIdx < mesh->mNumBones; boneIdx++)
+				{
+					bones.emplace(mesh->mBones[boneIdx]->mName.C_Str(), mesh->mBones[boneIdx]);
+				}
+			}
+
+			if (bones.empty())
+			{
+				scene = importer.ApplyPostProcessing(aiProcess_PreTransformVertices);
+				if (scene == nullptr)
+				{
+					printf("ERROR: AssimpLoader::CookMesh: %s \n", importer.GetErrorString());
+					return false;
+				}
+			}
+
+			std::vector<const aiNode*> jointNodes;
+			std::vector<MeshFileJoint> joints;
+			CollectJoints(scene->mRootNode, -1, bones, jointNodes, joints);
+			if (joints.size() > MAX_MESH_JOINTS)
+			{
+				printf("ERROR: AssimpLoader::CookMesh: %s has %u joints, at most %u are supported \n", sourcePath.c_str(), static_cast<uint32_t>(joints.size()), MAX_MESH_JOINTS);
+				return false;
+			}
+
+			std::unordered_map<std::string, uint32_t> jointIndices;
+			for (uint32_t jointIdx = 0u; jointIdx < jointNodes.size(); jointIdx++)
+			{
+				jointIndices.emplace(jointNodes[jointIdx]->mName.C_Str(), jointIdx);
+			}
+
+			std::vector<MeshFileSubmesh> submeshes;
+			std::vector<MeshFileLod> lods;
+			std::vector<MeshFileCluster> clusters;
+			std::vector<CookedVertex> vertices;
+			std::vector<uint32_t> indices;
+			submeshes.reserve(scene->mNumMeshes);
+
+			for (uint32_t meshIdx = 0u; meshIdx < scene->mNumMeshes; meshIdx++)
+			{
+				const aiMesh* mesh = scene->mMeshes[meshIdx];
+
+				//Points and lines are split off by SortByPType
+				if ((mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) == 0u || mesh->mNumVertices == 0u)
+				{
+					continue;
+				}
+
+				std::vector<CookedVertex> meshVertices;
+				std::vector<uint32_t> meshIndices;
+				meshVertices.reserve(mesh->mNumVertices);
+				meshIndices.reserve(mesh->mNumFaces * 3u);
+
+				for (uint32_t i = 0u; i < mesh->mNumVertices; i++)
+				{
+					CookedVertex vertex;
+					vertex.position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+					vertex.normal = mesh->HasNormals() ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f, 0.0f, 1.0f);
+					vertex.tangent = glm::vec3(0.0f);
+					vertex.bitangent = glm::vec3(0.0f);
+					vertex.color = mesh->HasVertexColors(0) ? glm::vec3(mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b) : glm::vec3(1.0f);
+					vertex.uv = mesh->HasTextureCoords(0) ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+					vertex.joints = glm::uvec4(0u);
+					vertex.weights = glm::vec4(0.0f);
+					meshVertices.push_back(vertex);
+				}
+
+				//Vertices without influences follow the first joint
+				for (uint32_t boneIdx = 0u; boneIdx < mesh->mNumBones; boneIdx++)
+				{
+					const aiBone* bone = mesh->mBones[boneIdx];
+					const auto jointIt = jointIndices.find(bone->mName.C_Str());
+					if (jointIt == jointIndices.end())
+					{
+						printf("ERROR: AssimpLoader::CookMesh: bone %s has no node \n", bone->mName.C_Str());
+						continue;
+					}
+
+					const uint32_t jointIdx = jointIt->second;
+					for (uint32_t weightIdx = 0u; weightIdx < bone->mNumWeights; weightIdx++)
+					{
+						const aiVertexWeight& weight = bone->mWeights[weightIdx];
+						CookedVertex& vertex = meshVertices[weight.mVertexId];
+
+						//Smallest influence is replaced once all four are taken
+						uint32_t slot = 0u;
+						for (uint32_t i = 1u; i < 4u; i++)
+						{
+							slot = vertex.weights[i] < vertex.weights[slot] ? i : slot;
+						}
+
+						if (weight.mWeight > vertex.weights[slot])
+						{
+							vertex.joints[slot] = jointIdx;
+							vertex.weights[slot] = weight.mWeight;
+						}
+					}
+				}
+
+				for (uint32_t faceIdx = 0u; faceIdx < mesh->mNumFaces; faceIdx++)
+				{
+					const aiFace& face = mesh->mFaces[faceIdx];
+					if (face.mNumIndices != 3u)
+					{
+						continue;
+					}
+
+					meshIndices.push_back(face.mIndices[0]);
+					meshIndices.push_back(face.mIndices[1]);
+					meshIndices.push_back(face.mIndices[2]);
+				}
+
+				//Tangents take part in the vertex deduplication, so they have to be final before the optimizer runs
+				TangentGenerator::Generate(meshVertices, meshIndices);
+
+				const float inputACMR = MeshOptimizer::CalculateACMR(meshIndices, static_cast<uint32_t>(meshVertices.size()));
+				MeshOptimizer::Optimize(meshVertices, meshIndices);
+				printf("AssimpLoader::CookMesh: %s ACMR %.3f -> %.3f \n", mesh->mName.C_Str(), inputACMR,
+					MeshOptimizer::CalculateACMR(meshIndices, static_cast<uint32_t>(meshVertices.size())));
+
+				MeshFileSubmesh submesh = {};
+				submesh.firstIndex = static_cast<uint32_t>(indices.size());
+				submesh.vertexOffset = static_cast<int32_t>(vertices.size());
+				submesh.vertexCount = static_cast<uint32_t>(meshVertices.size());
+				submesh.materialIndex = mesh->mMaterialIndex;
+
+				vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+				indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+
+				submesh.indexCount = static_cast<uint32_t>(indices.size()) - submesh.firstIndex;
+				submesh.firstCluster = static_cast<uint32_t>(clusters.size());
+				MeshletBuilder::Build(meshVertices, meshIndices.data(), static_cast<uint32_t>(meshIndices.size()), submesh.firstIndex, clusters);
+				submesh.clusterCount = static_cast<uint32_t>(clusters.size()) - submesh.firstCluster;
+
+				submesh.firstLod = static_cast<uint32_t>(lods.size());
+				lods.push_back({ submesh.firstIndex, submesh.indexCount, 0.0f, 0u });
+
+				//Levels are simplified from full detail so their errors do not stack, indices follow LOD 0
+				float lodError = 0.0f;
+				uint32_t targetIndexCount = submesh.indexCount;
+				for (uint32_t lodIdx = 1u; lodIdx < MAX_MESH_LODS; lodIdx++)
+				{
+					targetIndexCount = static_cast<uint32_t>(targetIndexCount * LOD_TRIANGLE_RATIO) / 3u * 3u;
+
+					float simplifyError = 0.0f;
+					std::vector<uint32_t> lodIndices = MeshSimplifier::Simplify(meshVertices, meshIndices, targetIndexCount, simplifyError);
+					const uint32_t previousIndexCount = lods.back().indexCount;
+					if (lodIndices.empty() || lodIndices.size() > previousIndexCount * (1.0f - LOD_MIN_REDUCTION))
+					{
+						break;
+					}
+
+					std::vector<uint32_t> clusterStarts;
+					MeshOptimizer::OptimizeVertexCache(lodIndices, static_cast<uint32_t>(meshVertices.size()), clusterStarts);
+
+					lodError = std::max(lodError, simplifyError);
+					lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), lodError, 0u });
+					indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+				}
+
+				submesh.lodCount = static_cast<uint32_t>(lods.size()) - submesh.firstLod;
+				printf("AssimpLoader::CookMesh: %s %u LODs, lowest %u triangles \n", mesh->mName.C_Str(), submesh.lodCount, lods.back().indexCount / 3u);
+				submesh.bounds = CalculateBounds(vertices.data() + submesh.vertexOffset, submesh.vertexCount);
+
+				//Culling works on the decoded positions, which may lie up to the quantization error outside the exact spheres
+				const float quantizationError = GetPositionQuantizationError(GetPositionQuantization(submesh.bounds.min, submesh.bounds.max));
+				submesh.bounds.sphere.w += quantizationError;
+				for (uint32_t clusterIdx = submesh.firstCluster; clusterIdx < submesh.firstCluster + submesh.clusterCount; clusterIdx++)
+				{
+					clusters[clusterIdx].boundingSphere.w += quantizationError;
+				}
+
+				submeshes.push_back(submesh);
+			}
+
+			if (submeshes.empty())
+			{
+				printf("ERROR: AssimpLoader::CookMesh: %s has no triangle meshes \n", sourcePath.c_str());
+				return false;
+			}
+
+			//Indices are submesh local, 16 bits are enough unless a single submesh exceeds them
+			uint32_t maxSubmeshVertexCount = 0u;
+			for (const MeshFileSubmesh& submesh : submeshes)
+			{
+				maxSubmeshVertexCount = std::max(maxSubmeshVertexCount, submesh.vertexCount);
+			}
+
+			MeshFileHeader header = {};
+			header.magic = MESH_FILE_MAGIC;
+			header.version = MESH_FILE_VERSION;
+			header.vertexFormat = VertexFormat::kPacked;
+			header.positionStride = sizeof(PackedPosition);
+			header.attributeStride = sizeof(PackedAttributes);
+			header.vertexCount = static_cast<uint32_t>(vertices.size());
+			header.indexCount = static_cast<uint32_t>(indices.size());
+			header.indexSize = maxSubmeshVertexCount <= 0x10000u ? sizeof(uint16_t) : sizeof(uint32_t);
+			header.submeshCount = static_cast<uint32_t>(submeshes.size());
+			header.lodCount = static_cast<uint32_t>(lods.size());
+			header.clusterCount = static_cast<uint32_t>(clusters.size());
+			header.jointCount = static_cast<uint32_t>(joints.size());
+			header.bounds = CalculateBounds(vertices.data(), header.vertexCount);
+			for (const MeshFileSubmesh& submesh : submeshes)
+			{
+				header.bounds.sphere.w = std::max(header.bounds.sphere.w,
+					glm::distance(glm::vec3(header.bounds.sphere), glm::vec3(submesh.bounds.sphere)) + submesh.bounds.sphere.w);
+			}
+
+			header.submeshOffset = AlignSectionOffset(sizeof(MeshFileHeader));
+			header.lodOffset = AlignSectionOffset(header.submeshOffset + submeshes.size() * sizeof(MeshFileSubmesh));
+			header.clusterOffset = AlignSectionOffset(header.lodOffset + lods.size() * sizeof(MeshFileLod));
+			header.positionOffset = AlignSectionOffset(header.clusterOffset + clusters.size() * sizeof(MeshFileCluster));
+			header.attributeOffset = AlignSectionOffset(header.positionOffset + vertices.size() * sizeof(PackedPosition));
+			header.indexOffset = AlignSectionOffset(header.attributeOffset + vertices.size() * sizeof(PackedAttributes));
+			header.jointOffset = AlignSectionOffset(header.indexOffset + static_cast<uint64_t>(indices.size()) * header.indexSize);
+			header.skinOffset = AlignSectionOffset(header.jointOffset + joints.size() * sizeof(MeshFileJoint));
+
+			std::vector<PackedPosition> positions;
+			std::vector<PackedAttributes> attributes;
+			std::vector<PackedSkin> skin;
+			positions.reserve(vertices.size());
+			attributes.reserve(vertices.size());
+			skin.reserve(joints.empty() ? 0u : vertices.size());
+			for (const MeshFileSubmesh& submesh : submeshes)
+			{
+				const PositionQuantization quantization = GetPositionQuantization(submesh.bounds.min, submesh.bounds.max);
+				for (uint32_t i = 0u; i < submesh.vertexCount; i++)
+				{
+					const CookedVertex& vertex = vertices[submesh.vertexOffset + i];
+					positions.push_back(PackPosition(vertex.position, quantization));
+					attributes.push_back(PackAttributes(vertex.normal, vertex.tangent, vertex.bitangent, vertex.uv, vertex.color));
+
+					if (!joints.empty())
+					{
+						skin.push_back(PackSkin(vertex.joints, vertex.weights));
+					}
+				}
+			}
+
+			std::vector<uint16_t> shortIndices;
+			if (header.indexSize == sizeof(uint16_t))
+			{
+				shortIndices.assign(indices.begin(), indices.end());
+			}
+
+			FILE* fp = fopen(cookedPath.c_str(), "wb");
+			if (fp == nullptr)
+			{
+				printf("ERROR: AssimpLoader::CookMesh: could not open %s for writing \n", cookedPath.c_str());
+				return false;
+			}
+
+			bool written = WriteSection(fp, 0u, &header, sizeof(MeshFileHeader));
+			written = written && WriteSection(fp, header.submeshOffset, submeshes.data(), submeshes.size() * sizeof(MeshFileSubmesh));
+			written = written && WriteSection(fp, header.lodOffset, lods.data(), lods.size() * sizeof(MeshFileLod));
+			written = written && WriteSection(fp, header.clusterOffset, clusters.data(), clusters.size() * sizeof(MeshFileCluster));
+			written = written && WriteSection(fp, header.positionOffset, positions.data(), positions.size() * sizeof(PackedPosition));
+			written = written && WriteSection(fp, header.attributeOffset, attributes.data(), attributes.size() * sizeof(PackedAttributes));
+			written = written && (header.indexSize == sizeof(uint16_t) ?
+				WriteSection(fp, header.indexOffset, shortIndices.data(), shortIndices.size() * sizeof(uint16_t)) :
+				WriteSection(fp, header.indexOffset, indices.data(), indices.size() * sizeof(uint32_t)));
+			written = written && WriteSection(fp, header.jointOffset, joints.data(), joints.size() * sizeof(MeshFileJoint));
+			written = written && WriteSection(fp, header.skinOffset, skin.data(), skin.size() * sizeof(PackedSkin));
+			fclose(fp);
+
+			if (!written)
+			{
+				printf("ERROR: AssimpLoader::CookMesh: could not write %s \n", cookedPath.c_str());
+				std::remove(cookedPath.c_str());
+				return false;
+			}
+
+			return true;
+		}
+
+		bool AssimpLoader::IsCookedMeshStale(const std::string& sourcePath, const std::string& cookedPath)
+		{
+			std::error_code error;
+			if (!std::filesystem::exists(cookedPath, error))
+			{
+				return true;
+			}
+
+			if (std::filesystem::exists(sourcePath, error) &&
+				std::filesystem::last_write_time(sourcePath, error) > std::filesystem::last_write_time(cookedPath, error))
+			{
+				return true;
+			}
+
+			//Files of another version are cooked again
+			MeshFileHeader header = {};
+			FILE* fp = fopen(cookedPath.c_str(), "rb");
+			if (fp == nullptr)
+			{
+				return true;
+			}
+
+			const size_t readCount = fread(&header, sizeof(MeshFileHeader), 1, fp);
+			fclose(fp);
+
+			return readCount != 1u || header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION;
+		}
+	}
+}
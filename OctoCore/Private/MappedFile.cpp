@@ -0,0 +1,126 @@
+#include "MappedFile.h"
+#include <utility>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace Core
+{
+	namespace Memory
+	{
+		MappedFile::~MappedFile()
+		{
+			Unmap();
+		}
+
+		MappedFile::MappedFile(MappedFile&& other)
+		{
+			*this = std::move(other);
+		}
+
+		MappedFile& MappedFile::operator=(MappedFile&& other)
+		{
+			if (this != &other)
+			{
+				Unmap();
+
+				m_Data = other.m_Data;
+				m_Size = other.m_Size;
+
+				other.m_Data = nullptr;
+				other.m_Size = 0u;
+			}
+
+			return *this;
+		}
+
+		bool MappedFile::Map(const std::string& path)
+		{
+			Unmap();
+
+#if defined(_WIN32)
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			{
+				CloseHandle(file);
+				return false;
+			}
+
+			//The view keeps the mapping and the file alive, their handles are not needed anymore
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+			if (mapping == nullptr)
+			{
+				return false;
+			}
+
+			void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (data == nullptr)
+			{
+				return false;
+			}
+
+			m_Data = static_cast<const uint8_t*>(data);
+			m_Size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+			const int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				return false;
+			}
+
+			struct stat fileStat;
+			if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+			{
+				close(fd);
+				return false;
+			}
+
+			void* data = mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (data == MAP_FAILED)
+			{
+				return false;
+			}
+
+			//Assets are consumed front to back
+			madvise(data, static_cast<std::size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+			m_Data = static_cast<const uint8_t*>(data);
+			m_Size = static_cast<std::size_t>(fileStat.st_size);
+#endif
+
+			return true;
+		}
+
+		void MappedFile::Unmap()
+		{
+			if (m_Data == nullptr)
+			{
+				return;
+			}
+
+#if defined(_WIN32)
+			UnmapViewOfFile(m_Data);
+#else
+			munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+
+			m_Data = nullptr;
+			m_Size = 0u;
+		}
+	}
+}
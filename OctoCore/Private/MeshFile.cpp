@@ -0,0 +1,138 @@
+#include "MeshFile.h"
+#include <cstdio>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		bool MeshFile::Load(const std::string& path)
+		{
+			Release();
+
+			if (!m_File.Map(path))
+			{
+				return false;
+			}
+
+			const size_t size = m_File.GetSize();
+			if (size < sizeof(MeshFileHeader))
+			{
+				Release();
+				return false;
+			}
+
+			const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(m_File.GetData());
+			if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION)
+			{
+				printf("ERROR: MeshFile::Load: %s is not a cooked mesh of version %u \n", path.c_str(), MESH_FILE_VERSION);
+				Release();
+				return false;
+			}
+
+			if (header->vertexFormat != VertexFormat::kPacked || header->positionStride != sizeof(PackedPosition) || header->attributeStride != sizeof(PackedAttributes) ||
+				(header->indexSize != sizeof(uint16_t) && header->indexSize != sizeof(uint32_t)))
+			{
+				printf("ERROR: MeshFile::Load: %s has an unknown vertex or index format \n", path.c_str());
+				Release();
+				return false;
+			}
+
+			//Sections have to lie inside the file. Empty ones are never read, the cooker aligns their offsets past the end of static meshes
+			auto isInside = [size](uint64_t offset, uint64_t sectionSize)
+			{
+				return sectionSize == 0u || (offset <= size && sectionSize <= size - offset);
+			};
+
+			const uint64_t positionSize = static_cast<uint64_t>(header->vertexCount) * header->positionStride;
+			const bool bSectionsInside =
+				isInside(header->submeshOffset, static_cast<uint64_t>(header->submeshCount) * sizeof(MeshFileSubmesh)) &&
+				isInside(header->lodOffset, static_cast<uint64_t>(header->lodCount) * sizeof(MeshFileLod)) &&
+				isInside(header->clusterOffset, static_cast<uint64_t>(header->clusterCount) * sizeof(MeshFileCluster)) &&
+				isInside(header->positionOffset, positionSize) && header->positionOffset + positionSize <= header->attributeOffset &&
+				isInside(header->attributeOffset, static_cast<uint64_t>(header->vertexCount) * header->attributeStride) &&
+				isInside(header->indexOffset, static_cast<uint64_t>(header->indexCount) * header->indexSize) &&
+				isInside(header->jointOffset, static_cast<uint64_t>(header->jointCount) * sizeof(MeshFileJoint)) &&
+				isInside(header->skinOffset, header->jointCount > 0u ? static_cast<uint64_t>(header->vertexCount) * sizeof(PackedSkin) : 0u);
+			if (!bSectionsInside)
+			{
+				printf("ERROR: MeshFile::Load: %s is truncated \n", path.c_str());
+				Release();
+				return false;
+			}
+
+			//Skinning evaluates the hierarchy in one pass from the roots
+			const MeshFileJoint* joints = reinterpret_cast<const MeshFileJoint*>(m_File.GetData() + header->jointOffset);
+			bool bJointsValid = header->jointCount <= MAX_MESH_JOINTS;
+			for (uint32_t jointIdx = 0u; bJointsValid && jointIdx < header->jointCount; jointIdx++)
+			{
+				bJointsValid = joints[jointIdx].parent >= -1 && joints[jointIdx].parent < static_cast<int32_t>(jointIdx);
+			}
+
+			if (!bJointsValid)
+			{
+				printf("ERROR: MeshFile::Load: %s has an invalid skeleton \n", path.c_str());
+				Release();
+				return false;
+			}
+
+			//Ranges are used to index the sections and the GPU buffers without further checks
+			const MeshFileSubmesh* submeshes = reinterpret_cast<const MeshFileSubmesh*>(m_File.GetData() + header->submeshOffset);
+			const MeshFileLod* lods = reinterpret_cast<const MeshFileLod*>(m_File.GetData() + header->lodOffset);
+			const MeshFileCluster* clusters = reinterpret_cast<const MeshFileCluster*>(m_File.GetData() + header->clusterOffset);
+			bool bRangesValid = true;
+			for (uint32_t submeshIdx = 0u; bRangesValid && submeshIdx < header->submeshCount; submeshIdx++)
+			{
+				const MeshFileSubmesh& submesh = submeshes[submeshIdx];
+				const uint64_t indexEnd = static_cast<uint64_t>(submesh.firstIndex) + submesh.indexCount;
+				bRangesValid = submesh.vertexOffset >= 0 && static_cast<uint64_t>(submesh.vertexOffset) + submesh.vertexCount <= header->vertexCount &&
+					indexEnd <= header->indexCount &&
+					submesh.lodCount > 0u && submesh.lodCount <= MAX_MESH_LODS && static_cast<uint64_t>(submesh.firstLod) + submesh.lodCount <= header->lodCount &&
+					static_cast<uint64_t>(submesh.firstCluster) + submesh.clusterCount <= header->clusterCount;
+
+				for (uint32_t lodIdx = submesh.firstLod; bRangesValid && lodIdx < submesh.firstLod + submesh.lodCount; lodIdx++)
+				{
+					bRangesValid = static_cast<uint64_t>(lods[lodIdx].firstIndex) + lods[lodIdx].indexCount <= header->indexCount;
+				}
+
+				//Clusters split LOD 0
+				for (uint32_t clusterIdx = submesh.firstCluster; bRangesValid && clusterIdx < submesh.firstCluster + submesh.clusterCount; clusterIdx++)
+				{
+					bRangesValid = clusters[clusterIdx].firstIndex >= submesh.firstIndex &&
+						static_cast<uint64_t>(clusters[clusterIdx].firstIndex) + clusters[clusterIdx].indexCount <= indexEnd;
+				}
+			}
+
+			if (!bRangesValid)
+			{
+				printf("ERROR: MeshFile::Load: %s has submesh ranges outside of its sections \n", path.c_str());
+				Release();
+				return false;
+			}
+
+			m_Header = header;
+			m_Submeshes = submeshes;
+			m_Lods = lods;
+			m_Clusters = clusters;
+			m_Vertices = m_File.GetData() + header->positionOffset;
+			m_Indices = m_File.GetData() + header->indexOffset;
+			m_Joints = header->jointCount > 0u ? joints : nullptr;
+			m_Skin = header->jointCount > 0u ? reinterpret_cast<const PackedSkin*>(m_File.GetData() + header->skinOffset) : nullptr;
+
+			return true;
+		}
+
+		void MeshFile::Release()
+		{
+			m_Header = nullptr;
+			m_Submeshes = nullptr;
+			m_Lods = nullptr;
+			m_Clusters = nullptr;
+			m_Vertices = nullptr;
+			m_Indices = nullptr;
+			m_Joints = nullptr;
+			m_Skin = nullptr;
+
+			m_File.Unmap();
+		}
+	}
+}
@@ -0,0 +1,341 @@
+#include "MeshOptimizer.h"
+
+//Other
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		namespace
+		{
+			//Tiny clusters would cost more cache misses than they save overdraw
+			const uint32_t MIN_CLUSTER_TRIANGLES = 64u;
+
+			struct VertexHasher
+			{
+				const CookedVertex* vertices;
+
+				size_t operator()(uint32_t vertexIdx) const
+				{
+					//FNV-1a over the raw bytes, CookedVertex has no padding
+					const uint8_t* bytes = reinterpret_cast<const uint8_t*>(vertices + vertexIdx);
+					uint64_t hash = 14695981039346656037ull;
+					for (size_t i = 0u; i < sizeof(CookedVertex); i++)
+					{
+						hash = (hash ^ bytes[i]) * 1099511628211ull;
+					}
+					return static_cast<size_t>(hash);
+				}
+			};
+
+			struct VertexEqual
+			{
+				const CookedVertex* vertices;
+
+				bool operator()(uint32_t a, uint32_t b) const
+				{
+					return memcmp(vertices + a, vertices + b, sizeof(CookedVertex)) == 0;
+				}
+			};
+		}
+
+		void MeshOptimizer::Optimize(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			assert(indices.size() % 3u == 0u);
+
+			std::vector<uint32_t> clusterStarts;
+			DeduplicateVertices(vertices, indices);
+			OptimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()), clusterStarts);
+			OptimizeOverdraw(indices, vertices, clusterStarts);
+			OptimizeVertexFetch(vertices, indices);
+		}
+
+		void MeshOptimizer::DeduplicateVertices(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			static_assert(sizeof(CookedVertex) == 25u * sizeof(float), "CookedVertex must not contain padding for hashing");
+
+			std::unordered_map<uint32_t, uint32_t, VertexHasher, VertexEqual> uniqueVertices(vertices.size(),
+				VertexHasher{ vertices.data() }, VertexEqual{ vertices.data() });
+
+			std::vector<uint32_t> remap(vertices.size());
+			std::vector<CookedVertex> uniqueData;
+			uniqueData.reserve(vertices.size());
+
+			for (uint32_t i = 0u; i < vertices.size(); i++)
+			{
+				auto it = uniqueVertices.find(i);
+				if (it == uniqueVertices.end())
+				{
+					it = uniqueVertices.emplace(i, static_cast<uint32_t>(uniqueData.size())).first;
+					uniqueData.push_back(vertices[i]);
+				}
+				remap[i] = it->second;
+			}
+
+			for (uint32_t& index : indices)
+			{
+				index = remap[index];
+			}
+
+			vertices = std::move(uniqueData);
+		}
+
+		void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusterStarts)
+		{
+			const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3u);
+			clusterStarts.clear();
+			if (triangleCount == 0u)
+			{
+				return;
+			}
+
+			//Vertex to triangle adjacency, liveTriangles counts the ones not emitted yet
+			std::vector<uint32_t> liveTriangles(vertexCount, 0u);
+			for (uint32_t index : indices)
+			{
+				liveTriangles[index]++;
+			}
+
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1u, 0u);
+			for (uint32_t v = 0u; v < vertexCount; v++)
+			{
+				adjacencyOffsets[v + 1u] = adjacencyOffsets[v] + liveTriangles[v];
+			}
+
+			std::vector<uint32_t> adjacency(indices.size());
+			std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t t = 0u; t < triangleCount; t++)
+			{
+				for (uint32_t corner = 0u; corner < 3u; corner++)
+				{
+					adjacency[adjacencyFill[indices[t * 3u + corner]]++] = t;
+				}
+			}
+
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0u);
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> deadEnds;
+			std::vector<uint32_t> candidates;
+			std::vector<uint32_t> output;
+			output.reserve(indices.size());
+
+			uint32_t timestamp = VERTEX_CACHE_SIZE + 1u;
+			uint32_t cursor = 0u;
+			uint32_t clusterSize = 0u;
+			int64_t fanningVertex = indices[0];
+			clusterStarts.push_back(0u);
+
+			while (fanningVertex >= 0)
+			{
+				const uint32_t fan = static_cast<uint32_t>(fanningVertex);
+				candidates.clear();
+
+				//Emit all remaining triangles around the fanning vertex
+				for (uint32_t i = adjacencyOffsets[fan]; i < adjacencyOffsets[fan + 1u]; i++)
+				{
+					const uint32_t t = adjacency[i];
+					if (emitted[t])
+					{
+						continue;
+					}
+
+					for (uint32_t corner = 0u; corner < 3u; corner++)
+					{
+						const uint32_t v = indices[t * 3u + corner];
+						output.push_back(v);
+						deadEnds.push_back(v);
+						candidates.push_back(v);
+						liveTriangles[v]--;
+
+						if (timestamp - cacheTimestamps[v] > VERTEX_CACHE_SIZE)
+						{
+							cacheTimestamps[v] = timestamp++;
+						}
+					}
+
+					emitted[t] = true;
+					clusterSize++;
+				}
+
+				//Next fan is the candidate that stays in the cache longest once its triangles are emitted
+				fanningVertex = -1;
+				uint32_t bestPriority = 0u;
+				for (uint32_t v : candidates)
+				{
+					if (liveTriangles[v] == 0u)
+					{
+						continue;
+					}
+
+					uint32_t priority = 0u;
+					if (timestamp - cacheTimestamps[v] + 2u * liveTriangles[v] <= VERTEX_CACHE_SIZE)
+					{
+						priority = timestamp - cacheTimestamps[v];
+					}
+
+					if (fanningVertex < 0 || priority > bestPriority)
+					{
+						bestPriority = priority;
+						fanningVertex = v;
+					}
+				}
+
+				if (fanningVertex >= 0)
+				{
+					continue;
+				}
+
+				//Dead end, fall back to recently used vertices, then to the next unprocessed one
+				while (!deadEnds.empty() && fanningVertex < 0)
+				{
+					const uint32_t v = deadEnds.back();
+					deadEnds.pop_back();
+					if (liveTriangles[v] > 0u)
+					{
+						fanningVertex = v;
+					}
+				}
+
+				while (cursor < vertexCount && fanningVertex < 0)
+				{
+					if (liveTriangles[cursor] > 0u)
+					{
+						fanningVertex = cursor;
+					}
+					cursor++;
+				}
+
+				//Cache restarts cold here, a good place for the overdraw pass to cut
+				if (fanningVertex >= 0 && timestamp - cacheTimestamps[static_cast<uint32_t>(fanningVertex)] > VERTEX_CACHE_SIZE &&
+					clusterSize >= MIN_CLUSTER_TRIANGLES)
+				{
+					clusterStarts.push_back(static_cast<uint32_t>(output.size() / 3u));
+					clusterSize = 0u;
+				}
+			}
+
+			assert(output.size() == indices.size());
+			indices = std::move(output);
+		}
+
+		void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& clusterStarts)
+		{
+			const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3u);
+			if (clusterStarts.size() < 2u)
+			{
+				return;
+			}
+
+			struct Cluster
+			{
+				uint32_t firstTriangle;
+				uint32_t triangleCount;
+				float sortKey;
+			};
+
+			//Area weighted centroid of the whole submesh
+			glm::vec3 meshCentroid = glm::vec3(0.0f);
+			float meshArea = 0.0f;
+			for (uint32_t t = 0u; t < triangleCount; t++)
+			{
+				const glm::vec3& p0 = vertices[indices[t * 3u + 0u]].position;
+				const glm::vec3& p1 = vertices[indices[t * 3u + 1u]].position;
+				const glm::vec3& p2 = vertices[indices[t * 3u + 2u]].position;
+				const float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+				meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+				meshArea += area;
+			}
+			meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : meshCentroid;
+
+			std::vector<Cluster> clusters;
+			clusters.reserve(clusterStarts.size());
+			for (size_t i = 0u; i < clusterStarts.size(); i++)
+			{
+				Cluster cluster;
+				cluster.firstTriangle = clusterStarts[i];
+				cluster.triangleCount = (i + 1u < clusterStarts.size() ? clusterStarts[i + 1u] : triangleCount) - cluster.firstTriangle;
+
+				//Unnormalized cross products weight the normals by area
+				glm::vec3 centroid = glm::vec3(0.0f);
+				glm::vec3 normal = glm::vec3(0.0f);
+				float area = 0.0f;
+				for (uint32_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+				{
+					const glm::vec3& p0 = vertices[indices[t * 3u + 0u]].position;
+					const glm::vec3& p1 = vertices[indices[t * 3u + 1u]].position;
+					const glm::vec3& p2 = vertices[indices[t * 3u + 2u]].position;
+					const glm::vec3 weightedNormal = glm::cross(p1 - p0, p2 - p0);
+					const float triangleArea = glm::length(weightedNormal);
+					centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+					normal += weightedNormal;
+					area += triangleArea;
+				}
+
+				centroid = area > 0.0f ? centroid / area : centroid;
+				const float normalLength = glm::length(normal);
+				cluster.sortKey = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+				clusters.push_back(cluster);
+			}
+
+			std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b)
+			{
+				return a.sortKey > b.sortKey;
+			});
+
+			std::vector<uint32_t> output;
+			output.reserve(indices.size());
+			for (const Cluster& cluster : clusters)
+			{
+				output.insert(output.end(), indices.begin() + cluster.firstTriangle * 3u, indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3u);
+			}
+
+			indices = std::move(output);
+		}
+
+		void MeshOptimizer::OptimizeVertexFetch(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			const uint32_t unassigned = ~0u;
+			std::vector<uint32_t> remap(vertices.size(), unassigned);
+			std::vector<CookedVertex> orderedVertices;
+			orderedVertices.reserve(vertices.size());
+
+			for (uint32_t& index : indices)
+			{
+				if (remap[index] == unassigned)
+				{
+					remap[index] = static_cast<uint32_t>(orderedVertices.size());
+					orderedVertices.push_back(vertices[index]);
+				}
+				index = remap[index];
+			}
+
+			vertices = std::move(orderedVertices);
+		}
+
+		float MeshOptimizer::CalculateACMR(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+		{
+			if (indices.empty())
+			{
+				return 0.0f;
+			}
+
+			//FIFO, a vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened after its own
+			std::vector<uint32_t> cachedAt(vertexCount, 0u);
+			uint32_t misses = 0u;
+			for (uint32_t index : indices)
+			{
+				if (cachedAt[index] == 0u || misses - cachedAt[index] >= VERTEX_CACHE_SIZE)
+				{
+					misses++;
+					cachedAt[index] = misses;
+				}
+			}
+
+			return static_cast<float>(misses) / static_cast<float>(indices.size() / 3u);
+		}
+	}
+}
@@ -0,0 +1,372 @@
+#include "MeshSimplifier.h"
+
+//Other
+#include <algorithm>
+#include <numeric>
+#include <unordered_set>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		namespace
+		{
+			//Border edges are held on their original line stronger than faces on their plane
+			const double BORDER_WEIGHT = 10.0;
+
+			namespace VertexKind
+			{
+				enum Enum : uint8_t
+				{
+					kManifold = 0u,
+
+					//On an open edge, only collapses along the border
+					kBorder = 1u,
+
+					//On an attribute seam, never collapses but others collapse into it
+					kLocked = 2u
+				};
+			};
+
+			//Symmetric 4x4 matrix of the summed plane equations, weight is the summed area
+			struct Quadric
+			{
+				double a2, ab, ac, ad;
+				double b2, bc, bd;
+				double c2, cd;
+				double d2;
+				double weight;
+
+				void AddPlane(const glm::dvec3& normal, double distance, double planeWeight)
+				{
+					a2 += normal.x * normal.x * planeWeight;
+					ab += normal.x * normal.y * planeWeight;
+					ac += normal.x * normal.z * planeWeight;
+					ad += normal.x * distance * planeWeight;
+					b2 += normal.y * normal.y * planeWeight;
+					bc += normal.y * normal.z * planeWeight;
+					bd += normal.y * distance * planeWeight;
+					c2 += normal.z * normal.z * planeWeight;
+					cd += normal.z * distance * planeWeight;
+					d2 += distance * distance * planeWeight;
+					weight += planeWeight;
+				}
+
+				void Add(const Quadric& other)
+				{
+					a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+					b2 += other.b2; bc += other.bc; bd += other.bd;
+					c2 += other.c2; cd += other.cd;
+					d2 += other.d2;
+					weight += other.weight;
+				}
+
+				//Weighted sum of squared distances to the planes
+				double Evaluate(const glm::vec3& position) const
+				{
+					const double x = position.x;
+					const double y = position.y;
+					const double z = position.z;
+
+					return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+						b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+						c2 * z * z + 2.0 * cd * z +
+						d2;
+				}
+			};
+
+			struct Collapse
+			{
+				uint32_t from;
+				uint32_t to;
+
+				//Mean squared distance of the merged quadric at the target
+				double cost;
+			};
+
+			uint64_t EdgeKey(uint32_t a, uint32_t b)
+			{
+				return (static_cast<uint64_t>(a) << 32u) | b;
+			}
+
+			glm::vec3 TriangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+			{
+				return glm::cross(p1 - p0, p2 - p0);
+			}
+		}
+
+		std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& indices,
+			uint32_t targetIndexCount, float& error)
+		{
+			const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+			std::vector<uint32_t> result = indices;
+			error = 0.0f;
+
+			if (result.size() <= targetIndexCount)
+			{
+				return result;
+			}
+
+			//Vertices sharing their position with another one lie on an attribute seam
+			std::vector<uint8_t> kinds(vertexCount, VertexKind::kManifold);
+			{
+				std::vector<uint32_t> order(vertexCount);
+				std::iota(order.begin(), order.end(), 0u);
+				std::sort(order.begin(), order.end(), [&vertices](uint32_t a, uint32_t b)
+				{
+					const glm::vec3& pa = vertices[a].position;
+					const glm::vec3& pb = vertices[b].position;
+					return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+				});
+
+				for (uint32_t i = 1u; i < vertexCount; i++)
+				{
+					if (vertices[order[i]].position == vertices[order[i - 1u]].position)
+					{
+						kinds[order[i]] = VertexKind::kLocked;
+						kinds[order[i - 1u]] = VertexKind::kLocked;
+					}
+				}
+			}
+
+			std::unordered_set<uint64_t> halfEdges;
+			const auto IsBorderEdge = [&halfEdges](uint32_t a, uint32_t b)
+			{
+				return halfEdges.count(EdgeKey(a, b)) + halfEdges.count(EdgeKey(b, a)) == 1u;
+			};
+
+			const auto CollectHalfEdges = [&halfEdges](const std::vector<uint32_t>& triangles)
+			{
+				halfEdges.clear();
+				halfEdges.reserve(triangles.size());
+				for (size_t t = 0u; t < triangles.size(); t += 3u)
+				{
+					halfEdges.insert(EdgeKey(triangles[t + 0u], triangles[t + 1u]));
+					halfEdges.insert(EdgeKey(triangles[t + 1u], triangles[t + 2u]));
+					halfEdges.insert(EdgeKey(triangles[t + 2u], triangles[t + 0u]));
+				}
+			};
+
+			//Quadrics of the full detail mesh, area weighted face planes plus border planes
+			std::vector<Quadric> quadrics(vertexCount, Quadric{});
+			CollectHalfEdges(result);
+			for (size_t t = 0u; t < result.size(); t += 3u)
+			{
+				const uint32_t corners[3] = { result[t + 0u], result[t + 1u], result[t + 2u] };
+				const glm::dvec3 p0 = vertices[corners[0]].position;
+				const glm::dvec3 p1 = vertices[corners[1]].position;
+				const glm::dvec3 p2 = vertices[corners[2]].position;
+
+				const glm::dvec3 weightedNormal = glm::cross(p1 - p0, p2 - p0);
+				const double area = glm::length(weightedNormal);
+				if (area <= 0.0)
+				{
+					continue;
+				}
+
+				const glm::dvec3 normal = weightedNormal / area;
+				for (uint32_t corner = 0u; corner < 3u; corner++)
+				{
+					quadrics[corners[corner]].AddPlane(normal, -glm::dot(normal, p0), area);
+				}
+
+				//Plane through the border edge, perpendicular to the face
+				for (uint32_t corner = 0u; corner < 3u; corner++)
+				{
+					const uint32_t a = corners[corner];
+					const uint32_t b = corners[(corner + 1u) % 3u];
+					if (!IsBorderEdge(a, b))
+					{
+						continue;
+					}
+
+					const glm::dvec3 pa = vertices[a].position;
+					const glm::dvec3 edge = glm::dvec3(vertices[b].position) - pa;
+					const double edgeLength = glm::length(edge);
+					if (edgeLength <= 0.0)
+					{
+						continue;
+					}
+
+					const glm::dvec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+					const double borderWeight = edgeLength * edgeLength * BORDER_WEIGHT;
+					quadrics[a].AddPlane(borderNormal, -glm::dot(borderNormal, pa), borderWeight);
+					quadrics[b].AddPlane(borderNormal, -glm::dot(borderNormal, pa), borderWeight);
+				}
+			}
+
+			std::vector<Collapse> collapses;
+			std::vector<uint32_t> remap(vertexCount);
+			std::vector<uint8_t> touched(vertexCount);
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1u);
+			std::vector<uint32_t> adjacency;
+			std::vector<uint32_t> simplified;
+
+			//Each pass collapses the cheapest edges with disjoint neighborhoods, so the costs of a pass stay valid
+			while (result.size() > targetIndexCount)
+			{
+				const uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3u);
+
+				CollectHalfEdges(result);
+				for (uint32_t v = 0u; v < vertexCount; v++)
+				{
+					kinds[v] = kinds[v] == VertexKind::kLocked ? VertexKind::kLocked : VertexKind::kManifold;
+				}
+
+				for (size_t t = 0u; t < result.size(); t += 3u)
+				{
+					for (uint32_t corner = 0u; corner < 3u; corner++)
+					{
+						const uint32_t a = result[t + corner];
+						const uint32_t b = result[t + (corner + 1u) % 3u];
+						if (!IsBorderEdge(a, b))
+						{
+							continue;
+						}
+
+						kinds[a] = kinds[a] == VertexKind::kLocked ? VertexKind::kLocked : VertexKind::kBorder;
+						kinds[b] = kinds[b] == VertexKind::kLocked ? VertexKind::kLocked : VertexKind::kBorder;
+					}
+				}
+
+				//Vertex to triangle adjacency of the current triangles
+				std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0u);
+				for (uint32_t index : result)
+				{
+					adjacencyOffsets[index + 1u]++;
+				}
+
+				for (uint32_t v = 0u; v < vertexCount; v++)
+				{
+					adjacencyOffsets[v + 1u] += adjacencyOffsets[v];
+				}
+
+				adjacency.resize(result.size());
+				std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (uint32_t t = 0u; t < triangleCount; t++)
+				{
+					for (uint32_t corner = 0u; corner < 3u; corner++)
+					{
+						adjacency[adjacencyFill[result[t * 3u + corner]]++] = t;
+					}
+				}
+
+				const auto AddCollapse = [&](uint32_t from, uint32_t to)
+				{
+					if (kinds[from] == VertexKind::kLocked || (kinds[from] == VertexKind::kBorder && !IsBorderEdge(from, to)))
+					{
+						return;
+					}
+
+					Quadric merged = quadrics[from];
+					merged.Add(quadrics[to]);
+					const double cost = merged.weight > 0.0 ? std::max(merged.Evaluate(vertices[to].position), 0.0) / merged.weight : 0.0;
+					collapses.push_back({ from, to, cost });
+				};
+
+				collapses.clear();
+				for (size_t t = 0u; t < result.size(); t += 3u)
+				{
+					for (uint32_t corner = 0u; corner < 3u; corner++)
+					{
+						const uint32_t a = result[t + corner];
+						const uint32_t b = result[t + (corner + 1u) % 3u];
+						AddCollapse(a, b);
+						AddCollapse(b, a);
+					}
+				}
+
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+				{
+					return a.cost < b.cost;
+				});
+
+				std::iota(remap.begin(), remap.end(), 0u);
+				std::fill(touched.begin(), touched.end(), 0u);
+
+				const uint32_t trianglesToRemove = static_cast<uint32_t>(result.size() - targetIndexCount + 2u) / 3u;
+				uint32_t removedTriangles = 0u;
+				uint32_t collapseCount = 0u;
+
+				for (const Collapse& collapse : collapses)
+				{
+					if (removedTriangles >= trianglesToRemove)
+					{
+						break;
+					}
+
+					if (touched[collapse.from] || touched[collapse.to])
+					{
+						continue;
+					}
+
+					//Triangles that keep existing must not turn over or flatten, a zero normal would let later collapses flip them unchecked
+					bool flips = false;
+					for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1u] && !flips; i++)
+					{
+						const uint32_t* triangle = &result[adjacency[i] * 3u];
+						if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+						{
+							continue;
+						}
+
+						glm::vec3 positions[3] = { vertices[triangle[0]].position, vertices[triangle[1]].position, vertices[triangle[2]].position };
+						const glm::vec3 normalBefore = TriangleNormal(positions[0], positions[1], positions[2]);
+						for (uint32_t corner = 0u; corner < 3u; corner++)
+						{
+							positions[corner] = triangle[corner] == collapse.from ? vertices[collapse.to].position : positions[corner];
+						}
+
+						const glm::vec3 normalAfter = TriangleNormal(positions[0], positions[1], positions[2]);
+						flips = glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter);
+					}
+
+					if (flips)
+					{
+						continue;
+					}
+
+					remap[collapse.from] = collapse.to;
+					quadrics[collapse.to].Add(quadrics[collapse.from]);
+					error = std::max(error, static_cast<float>(glm::sqrt(collapse.cost)));
+					collapseCount++;
+
+					//Whole neighborhood is frozen for the rest of the pass
+					touched[collapse.to] = 1u;
+					for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1u]; i++)
+					{
+						const uint32_t* triangle = &result[adjacency[i] * 3u];
+						touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1u;
+						removedTriangles += (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) ? 1u : 0u;
+					}
+				}
+
+				if (collapseCount == 0u)
+				{
+					break;
+				}
+
+				//Collapsed triangles degenerate and are dropped
+				simplified.clear();
+				for (size_t t = 0u; t < result.size(); t += 3u)
+				{
+					const uint32_t a = remap[result[t + 0u]];
+					const uint32_t b = remap[result[t + 1u]];
+					const uint32_t c = remap[result[t + 2u]];
+					if (a == b || b == c || c == a)
+					{
+						continue;
+					}
+
+					simplified.push_back(a);
+					simplified.push_back(b);
+					simplified.push_back(c);
+				}
+
+				result.swap(simplified);
+			}
+
+			return result;
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#include "MeshletBuilder.h"
+
+//Other
+#include <algorithm>
+#include <cfloat>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		namespace
+		{
+			//Normals spread wider than this leave no cone worth testing
+			const float MIN_CONE_DOT = 0.1f;
+
+			MeshFileCluster CalculateCluster(const std::vector<CookedVertex>& vertices, const uint32_t* indices, uint32_t indexCount, uint32_t firstIndex)
+			{
+				MeshFileCluster cluster = {};
+				cluster.firstIndex = firstIndex;
+				cluster.indexCount = indexCount;
+
+				glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+				glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+				for (uint32_t i = 0u; i < indexCount; i++)
+				{
+					boundsMin = glm::min(boundsMin, vertices[indices[i]].position);
+					boundsMax = glm::max(boundsMax, vertices[indices[i]].position);
+				}
+
+				const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+				float radiusSquared = 0.0f;
+				for (uint32_t i = 0u; i < indexCount; i++)
+				{
+					const glm::vec3 offset = vertices[indices[i]].position - center;
+					radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+				}
+
+				cluster.boundingSphere = glm::vec4(center, glm::sqrt(radiusSquared));
+
+				//Cone around the average face normal, degenerate triangles do not vote
+				glm::vec3 axis = glm::vec3(0.0f);
+				for (uint32_t i = 0u; i < indexCount; i += 3u)
+				{
+					const glm::vec3& p0 = vertices[indices[i + 0u]].position;
+					const glm::vec3& p1 = vertices[indices[i + 1u]].position;
+					const glm::vec3& p2 = vertices[indices[i + 2u]].position;
+					const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					const float length = glm::length(normal);
+					axis += length > 0.0f ? normal / length : glm::vec3(0.0f);
+				}
+
+				const float axisLength = glm::length(axis);
+				float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+				axis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+
+				for (uint32_t i = 0u; i < indexCount && minDot > MIN_CONE_DOT; i += 3u)
+				{
+					const glm::vec3& p0 = vertices[indices[i + 0u]].position;
+					const glm::vec3& p1 = vertices[indices[i + 1u]].position;
+					const glm::vec3& p2 = vertices[indices[i + 2u]].position;
+					const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					const float length = glm::length(normal);
+					minDot = length > 0.0f ? std::min(minDot, glm::dot(normal / length, axis)) : minDot;
+				}
+
+				//Cutoff is the sine of the cone angle, 1 can never be culled
+				const float cutoff = minDot > MIN_CONE_DOT ? glm::sqrt(1.0f - minDot * minDot) : 1.0f;
+				cluster.cone = glm::vec4(axis, cutoff);
+
+				return cluster;
+			}
+		}
+
+		void MeshletBuilder::Build(const std::vector<CookedVertex>& vertices, const uint32_t* indices, uint32_t indexCount,
+			uint32_t firstIndex, std::vector<MeshFileCluster>& clusters)
+		{
+			//Marks the vertices of the current cluster with its number, so no clearing is needed between clusters
+			std::vector<uint32_t> clusterStamps(vertices.size(), 0u);
+			uint32_t stamp = 1u;
+			uint32_t clusterStart = 0u;
+			uint32_t clusterVertexCount = 0u;
+
+			for (uint32_t i = 0u; i < indexCount; i += 3u)
+			{
+				uint32_t newVertices = 0u;
+				for (uint32_t corner = 0u; corner < 3u; corner++)
+				{
+					newVertices += clusterStamps[indices[i + corner]] != stamp ? 1u : 0u;
+				}
+
+				const uint32_t clusterTriangleCount = (i - clusterStart) / 3u;
+				if (clusterVertexCount + newVertices > MAX_CLUSTER_VERTICES || clusterTriangleCount + 1u > MAX_CLUSTER_TRIANGLES)
+				{
+					clusters.push_back(CalculateCluster(vertices, indices + clusterStart, i - clusterStart, firstIndex + clusterStart));
+					clusterStart = i;
+					clusterVertexCount = 0u;
+					stamp++;
+				}
+
+				for (uint32_t corner = 0u; corner < 3u; corner++)
+				{
+					uint32_t& vertexStamp = clusterStamps[indices[i + corner]];
+					clusterVertexCount += vertexStamp != stamp ? 1u : 0u;
+					vertexStamp = stamp;
+				}
+			}
+
+			if (indexCount > clusterStart)
+			{
+				clusters.push_back(CalculateCluster(vertices, indices + clusterStart, indexCount - clusterStart, firstIndex + clusterStart));
+			}
+		}
+	}
+}
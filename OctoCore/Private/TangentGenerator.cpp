@@ -0,0 +1,326 @@
+#include "TangentGenerator.h"
+
+//Other
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCTO_TANGENTS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Core
+{
+	namespace Mesh
+	{
+		namespace
+		{
+			//Tangents shorter than this after the projection have no usable direction
+			const float MIN_TANGENT_LENGTH = 1e-6f;
+
+			//Vertex attributes and accumulators as separate float arrays, so four lanes load at once
+			struct TangentStreams
+			{
+				void Resize(size_t count)
+				{
+					for (std::vector<float>* stream : { &px, &py, &pz, &nx, &ny, &nz, &u, &v, &tx, &ty, &tz, &bx, &by, &bz })
+					{
+						stream->assign(count, 0.0f);
+					}
+				}
+
+				std::vector<float> px, py, pz;
+				std::vector<float> nx, ny, nz;
+				std::vector<float> u, v;
+
+				//Angle weighted sums of the projected face tangents and bitangents
+				std::vector<float> tx, ty, tz;
+				std::vector<float> bx, by, bz;
+			};
+
+			//Abramowitz and Stegun 4.4.45, max error 7e-5 radians, shared by both paths so they agree
+			float AcosApprox(float x)
+			{
+				const float a = std::fabs(x);
+				const float result = std::sqrt(std::max(1.0f - a, 0.0f)) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f + a * -0.0187293f)));
+				return x < 0.0f ? 3.14159265f - result : result;
+			}
+
+			void AccumulateTriangle(TangentStreams& streams, const uint32_t* corners)
+			{
+				const glm::vec3 p[3] =
+				{
+					glm::vec3(streams.px[corners[0]], streams.py[corners[0]], streams.pz[corners[0]]),
+					glm::vec3(streams.px[corners[1]], streams.py[corners[1]], streams.pz[corners[1]]),
+					glm::vec3(streams.px[corners[2]], streams.py[corners[2]], streams.pz[corners[2]])
+				};
+
+				const glm::vec3 edge1 = p[1] - p[0];
+				const glm::vec3 edge2 = p[2] - p[0];
+				const float du1 = streams.u[corners[1]] - streams.u[corners[0]];
+				const float dv1 = streams.v[corners[1]] - streams.v[corners[0]];
+				const float du2 = streams.u[corners[2]] - streams.u[corners[0]];
+				const float dv2 = streams.v[corners[2]] - streams.v[corners[0]];
+
+				//Only the orientation of the uv mapping matters, the length is lost in the normalization
+				const float uvArea = du1 * dv2 - dv1 * du2;
+				if (std::fabs(uvArea) <= FLT_MIN)
+				{
+					return;
+				}
+
+				const float orientation = uvArea > 0.0f ? 1.0f : -1.0f;
+				const glm::vec3 faceTangent = (edge1 * dv2 - edge2 * dv1) * orientation;
+				const glm::vec3 faceBitangent = (edge2 * du1 - edge1 * du2) * orientation;
+
+				for (uint32_t corner = 0u; corner < 3u; corner++)
+				{
+					const uint32_t vertexIdx = corners[corner];
+					const glm::vec3 edgeA = p[(corner + 1u) % 3u] - p[corner];
+					const glm::vec3 edgeB = p[(corner + 2u) % 3u] - p[corner];
+					const float lengths = glm::length(edgeA) * glm::length(edgeB);
+					const float angle = lengths > 0.0f ? AcosApprox(glm::clamp(glm::dot(edgeA, edgeB) / lengths, -1.0f, 1.0f)) : 0.0f;
+
+					const glm::vec3 n = glm::vec3(streams.nx[vertexIdx], streams.ny[vertexIdx], streams.nz[vertexIdx]);
+					glm::vec3 t = faceTangent - n * glm::dot(n, faceTangent);
+					glm::vec3 b = faceBitangent - n * glm::dot(n, faceBitangent);
+					const float tLength = glm::length(t);
+					const float bLength = glm::length(b);
+					t = tLength > 0.0f ? t * (angle / tLength) : glm::vec3(0.0f);
+					b = bLength > 0.0f ? b * (angle / bLength) : glm::vec3(0.0f);
+
+					streams.tx[vertexIdx] += t.x; streams.ty[vertexIdx] += t.y; streams.tz[vertexIdx] += t.z;
+					streams.bx[vertexIdx] += b.x; streams.by[vertexIdx] += b.y; streams.bz[vertexIdx] += b.z;
+				}
+			}
+
+			void FinalizeVertex(const TangentStreams& streams, uint32_t vertexIdx, CookedVertex& vertex)
+			{
+				const glm::vec3 n = glm::vec3(streams.nx[vertexIdx], streams.ny[vertexIdx], streams.nz[vertexIdx]);
+				const glm::vec3 summedTangent = glm::vec3(streams.tx[vertexIdx], streams.ty[vertexIdx], streams.tz[vertexIdx]);
+				const glm::vec3 summedBitangent = glm::vec3(streams.bx[vertexIdx], streams.by[vertexIdx], streams.bz[vertexIdx]);
+
+				//Gram-Schmidt, vertices without uv derivatives get any tangent perpendicular to the normal
+				glm::vec3 t = summedTangent - n * glm::dot(n, summedTangent);
+				float length = glm::length(t);
+				if (length <= MIN_TANGENT_LENGTH)
+				{
+					t = glm::cross(n, std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+					length = glm::length(t);
+				}
+
+				t = length > 0.0f ? t / length : glm::vec3(1.0f, 0.0f, 0.0f);
+				const float handedness = glm::dot(glm::cross(n, t), summedBitangent) < 0.0f ? -1.0f : 1.0f;
+
+				vertex.tangent = t;
+				vertex.bitangent = glm::cross(n, t) * handedness;
+			}
+
+#if defined(OCTO_TANGENTS_SSE2)
+			struct Vec3x4
+			{
+				__m128 x, y, z;
+			};
+
+			inline __m128 Gather(const std::vector<float>& stream, const uint32_t* idx)
+			{
+				return _mm_set_ps(stream[idx[3]], stream[idx[2]], stream[idx[1]], stream[idx[0]]);
+			}
+
+			inline Vec3x4 Gather3(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z, const uint32_t* idx)
+			{
+				return { Gather(x, idx), Gather(y, idx), Gather(z, idx) };
+			}
+
+			inline Vec3x4 Sub(const Vec3x4& a, const Vec3x4& b) { return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) }; }
+			inline Vec3x4 Scale(const Vec3x4& a, __m128 s) { return { _mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s) }; }
+			inline Vec3x4 MulSub(const Vec3x4& a, __m128 sa, const Vec3x4& b, __m128 sb) { return Sub(Scale(a, sa), Scale(b, sb)); }
+
+			inline __m128 Dot(const Vec3x4& a, const Vec3x4& b)
+			{
+				return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+			}
+
+			inline Vec3x4 Cross(const Vec3x4& a, const Vec3x4& b)
+			{
+				return {
+					_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+					_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+					_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)) };
+			}
+
+			inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+			{
+				return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+			}
+
+			inline Vec3x4 Select(__m128 mask, const Vec3x4& a, const Vec3x4& b)
+			{
+				return { Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z) };
+			}
+
+			//Projects v onto the plane of n and scales it to the given length, zero where there is no direction
+			inline Vec3x4 ProjectAndScale(const Vec3x4& v, const Vec3x4& n, __m128 length)
+			{
+				const Vec3x4 projected = Sub(v, Scale(n, Dot(n, v)));
+				const __m128 projectedLength = _mm_sqrt_ps(Dot(projected, projected));
+				const __m128 valid = _mm_cmpgt_ps(projectedLength, _mm_setzero_ps());
+				const __m128 scale = _mm_and_ps(valid, _mm_div_ps(length, Select(valid, projectedLength, _mm_set1_ps(1.0f))));
+				return Scale(projected, scale);
+			}
+
+			inline __m128 AcosApprox4(__m128 x)
+			{
+				const __m128 signMask = _mm_set1_ps(-0.0f);
+				const __m128 a = _mm_andnot_ps(signMask, x);
+				__m128 poly = _mm_add_ps(_mm_set1_ps(0.0742610f), _mm_mul_ps(a, _mm_set1_ps(-0.0187293f)));
+				poly = _mm_add_ps(_mm_set1_ps(-0.2121144f), _mm_mul_ps(a, poly));
+				poly = _mm_add_ps(_mm_set1_ps(1.5707288f), _mm_mul_ps(a, poly));
+				const __m128 result = _mm_mul_ps(_mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a), _mm_setzero_ps())), poly);
+				return Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(3.14159265f), result), result);
+			}
+
+			void AccumulateTriangles4(TangentStreams& streams, const uint32_t* indices)
+			{
+				//corners[corner][lane]
+				uint32_t corners[3][4];
+				for (uint32_t lane = 0u; lane < 4u; lane++)
+				{
+					corners[0][lane] = indices[lane * 3u + 0u];
+					corners[1][lane] = indices[lane * 3u + 1u];
+					corners[2][lane] = indices[lane * 3u + 2u];
+				}
+
+				const Vec3x4 p[3] =
+				{
+					Gather3(streams.px, streams.py, streams.pz, corners[0]),
+					Gather3(streams.px, streams.py, streams.pz, corners[1]),
+					Gather3(streams.px, streams.py, streams.pz, corners[2])
+				};
+
+				const __m128 u0 = Gather(streams.u, corners[0]);
+				const __m128 v0 = Gather(streams.v, corners[0]);
+				const __m128 du1 = _mm_sub_ps(Gather(streams.u, corners[1]), u0);
+				const __m128 dv1 = _mm_sub_ps(Gather(streams.v, corners[1]), v0);
+				const __m128 du2 = _mm_sub_ps(Gather(streams.u, corners[2]), u0);
+				const __m128 dv2 = _mm_sub_ps(Gather(streams.v, corners[2]), v0);
+
+				const __m128 uvArea = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(dv1, du2));
+				const __m128 signMask = _mm_set1_ps(-0.0f);
+				const __m128 valid = _mm_cmpgt_ps(_mm_andnot_ps(signMask, uvArea), _mm_set1_ps(FLT_MIN));
+
+				//Orientation of the uv mapping, degenerate lanes get a zero weight
+				const __m128 orientation = _mm_and_ps(valid, _mm_or_ps(_mm_and_ps(signMask, uvArea), _mm_set1_ps(1.0f)));
+
+				const Vec3x4 edge1 = Sub(p[1], p[0]);
+				const Vec3x4 edge2 = Sub(p[2], p[0]);
+				const Vec3x4 faceTangent = Scale(MulSub(edge1, dv2, edge2, dv1), orientation);
+				const Vec3x4 faceBitangent = Scale(MulSub(edge2, du1, edge1, du2), orientation);
+
+				for (uint32_t corner = 0u; corner < 3u; corner++)
+				{
+					const Vec3x4 edgeA = Sub(p[(corner + 1u) % 3u], p[corner]);
+					const Vec3x4 edgeB = Sub(p[(corner + 2u) % 3u], p[corner]);
+					const __m128 lengths = _mm_sqrt_ps(_mm_mul_ps(Dot(edgeA, edgeA), Dot(edgeB, edgeB)));
+					const __m128 hasLength = _mm_cmpgt_ps(lengths, _mm_setzero_ps());
+					__m128 cosine = _mm_div_ps(Dot(edgeA, edgeB), Select(hasLength, lengths, _mm_set1_ps(1.0f)));
+					cosine = _mm_min_ps(_mm_max_ps(cosine, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+					const __m128 angle = _mm_and_ps(_mm_and_ps(hasLength, valid), AcosApprox4(cosine));
+
+					const Vec3x4 n = Gather3(streams.nx, streams.ny, streams.nz, corners[corner]);
+					const Vec3x4 t = ProjectAndScale(faceTangent, n, angle);
+					const Vec3x4 b = ProjectAndScale(faceBitangent, n, angle);
+
+					//Lanes may share vertices, so the scatter stays scalar
+					alignas(16) float weighted[6][4];
+					_mm_store_ps(weighted[0], t.x); _mm_store_ps(weighted[1], t.y); _mm_store_ps(weighted[2], t.z);
+					_mm_store_ps(weighted[3], b.x); _mm_store_ps(weighted[4], b.y); _mm_store_ps(weighted[5], b.z);
+
+					for (uint32_t lane = 0u; lane < 4u; lane++)
+					{
+						const uint32_t vertexIdx = corners[corner][lane];
+						streams.tx[vertexIdx] += weighted[0][lane]; streams.ty[vertexIdx] += weighted[1][lane]; streams.tz[vertexIdx] += weighted[2][lane];
+						streams.bx[vertexIdx] += weighted[3][lane]; streams.by[vertexIdx] += weighted[4][lane]; streams.bz[vertexIdx] += weighted[5][lane];
+					}
+				}
+			}
+
+			void FinalizeVertices4(const TangentStreams& streams, uint32_t firstVertex, CookedVertex* vertices)
+			{
+				const Vec3x4 n = { _mm_loadu_ps(&streams.nx[firstVertex]), _mm_loadu_ps(&streams.ny[firstVertex]), _mm_loadu_ps(&streams.nz[firstVertex]) };
+				const Vec3x4 summedTangent = { _mm_loadu_ps(&streams.tx[firstVertex]), _mm_loadu_ps(&streams.ty[firstVertex]), _mm_loadu_ps(&streams.tz[firstVertex]) };
+				const Vec3x4 summedBitangent = { _mm_loadu_ps(&streams.bx[firstVertex]), _mm_loadu_ps(&streams.by[firstVertex]), _mm_loadu_ps(&streams.bz[firstVertex]) };
+
+				//Gram-Schmidt, vertices without uv derivatives get any tangent perpendicular to the normal
+				Vec3x4 t = Sub(summedTangent, Scale(n, Dot(n, summedTangent)));
+				const __m128 hasTangent = _mm_cmpgt_ps(_mm_sqrt_ps(Dot(t, t)), _mm_set1_ps(MIN_TANGENT_LENGTH));
+
+				const __m128 useX = _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), n.x), _mm_set1_ps(0.9f));
+				const Vec3x4 axis = { _mm_and_ps(useX, _mm_set1_ps(1.0f)), _mm_andnot_ps(useX, _mm_set1_ps(1.0f)), _mm_setzero_ps() };
+				t = Select(hasTangent, t, Cross(n, axis));
+				t = ProjectAndScale(t, n, _mm_set1_ps(1.0f));
+
+				const Vec3x4 cross = Cross(n, t);
+				const __m128 flipped = _mm_cmplt_ps(Dot(cross, summedBitangent), _mm_setzero_ps());
+				const __m128 handedness = Select(flipped, _mm_set1_ps(-1.0f), _mm_set1_ps(1.0f));
+				const Vec3x4 b = Scale(cross, handedness);
+
+				alignas(16) float result[6][4];
+				_mm_store_ps(result[0], t.x); _mm_store_ps(result[1], t.y); _mm_store_ps(result[2], t.z);
+				_mm_store_ps(result[3], b.x); _mm_store_ps(result[4], b.y); _mm_store_ps(result[5], b.z);
+
+				for (uint32_t lane = 0u; lane < 4u; lane++)
+				{
+					vertices[lane].tangent = glm::vec3(result[0][lane], result[1][lane], result[2][lane]);
+					vertices[lane].bitangent = glm::vec3(result[3][lane], result[4][lane], result[5][lane]);
+				}
+			}
+#endif
+		}
+
+		void TangentGenerator::Generate(std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+			const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3u);
+
+			TangentStreams streams;
+			streams.Resize(vertexCount);
+			for (uint32_t i = 0u; i < vertexCount; i++)
+			{
+				const CookedVertex& vertex = vertices[i];
+				const float normalLength = glm::length(vertex.normal);
+				const glm::vec3 normal = normalLength > 0.0f ? vertex.normal / normalLength : glm::vec3(0.0f, 0.0f, 1.0f);
+
+				streams.px[i] = vertex.position.x; streams.py[i] = vertex.position.y; streams.pz[i] = vertex.position.z;
+				streams.nx[i] = normal.x; streams.ny[i] = normal.y; streams.nz[i] = normal.z;
+				streams.u[i] = vertex.uv.x; streams.v[i] = vertex.uv.y;
+			}
+
+			uint32_t triangleIdx = 0u;
+			uint32_t vertexIdx = 0u;
+
+#if defined(OCTO_TANGENTS_SSE2)
+			for (; triangleIdx + 4u <= triangleCount; triangleIdx += 4u)
+			{
+				AccumulateTriangles4(streams, &indices[triangleIdx * 3u]);
+			}
+#endif
+			for (; triangleIdx < triangleCount; triangleIdx++)
+			{
+				AccumulateTriangle(streams, &indices[triangleIdx * 3u]);
+			}
+
+#if defined(OCTO_TANGENTS_SSE2)
+			for (; vertexIdx + 4u <= vertexCount; vertexIdx += 4u)
+			{
+				FinalizeVertices4(streams, vertexIdx, &vertices[vertexIdx]);
+			}
+#endif
+			for (; vertexIdx < vertexCount; vertexIdx++)
+			{
+				FinalizeVertex(streams, vertexIdx, vertices[vertexIdx]);
+			}
+		}
+	}
+}
@@ -0,0 +1,505 @@
+#include "TextureTranscoder.h"
+
+//ThirdParty
+#include <ThirdParty/gli/gli/gli.hpp>
+#include <ThirdParty/gli/gli/convert.hpp>
+#include <ThirdParty/glm/glm/glm.hpp>
+
+//Other
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+namespace Core
+{
+	namespace Texture
+	{
+		namespace
+		{
+			const uint32_t BLOCK_DIM = 4u;
+			const uint32_t BLOCK_TEXELS = BLOCK_DIM * BLOCK_DIM;
+
+			//Power iterations for the principal axis, converges long before this for 16 points
+			const uint32_t AXIS_ITERATIONS = 8u;
+
+			//BC7 4 bit index weights, in 64ths
+			const uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+			struct RgbaImage
+			{
+				uint32_t width;
+				uint32_t height;
+				std::vector<uint8_t> texels;
+			};
+
+			float SrgbToLinear(float value)
+			{
+				return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+			}
+
+			float LinearToSrgb(float value)
+			{
+				return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			}
+
+			uint8_t ToByte(float value)
+			{
+				return static_cast<uint8_t>(glm::clamp(value, 0.0f, 255.0f) + 0.5f);
+			}
+
+			//2x2 box filter, odd sizes clamp the last row and column
+			RgbaImage Downsample(const RgbaImage& source, bool bSrgb)
+			{
+				RgbaImage result;
+				result.width = std::max(source.width / 2u, 1u);
+				result.height = std::max(source.height / 2u, 1u);
+				result.texels.resize(result.width * result.height * 4u);
+
+				for (uint32_t y = 0; y < result.height; ++y)
+				{
+					for (uint32_t x = 0; x < result.width; ++x)
+					{
+						const uint32_t x0 = std::min(x * 2u, source.width - 1u);
+						const uint32_t x1 = std::min(x * 2u + 1u, source.width - 1u);
+						const uint32_t y0 = std::min(y * 2u, source.height - 1u);
+						const uint32_t y1 = std::min(y * 2u + 1u, source.height - 1u);
+						const uint32_t offsets[4] = {
+							(y0 * source.width + x0) * 4u, (y0 * source.width + x1) * 4u,
+							(y1 * source.width + x0) * 4u, (y1 * source.width + x1) * 4u };
+
+						for (uint32_t channel = 0; channel < 4u; ++channel)
+						{
+							//Alpha is always linear
+							const bool bDecode = bSrgb && channel < 3u;
+
+							float sum = 0.0f;
+							for (uint32_t i = 0; i < 4u; ++i)
+							{
+								const float value = source.texels[offsets[i] + channel] / 255.0f;
+								sum += bDecode ? SrgbToLinear(value) : value;
+							}
+
+							const float average = sum * 0.25f;
+							result.texels[(y * result.width + x) * 4u + channel] = ToByte((bDecode ? LinearToSrgb(average) : average) * 255.0f);
+						}
+					}
+				}
+
+				return result;
+			}
+
+			//Blocks hanging over the edge repeat the last row and column
+			void GatherBlock(const RgbaImage& image, uint32_t blockX, uint32_t blockY, uint8_t texels[64])
+			{
+				for (uint32_t y = 0; y < BLOCK_DIM; ++y)
+				{
+					for (uint32_t x = 0; x < BLOCK_DIM; ++x)
+					{
+						const uint32_t sourceX = std::min(blockX * BLOCK_DIM + x, image.width - 1u);
+						const uint32_t sourceY = std::min(blockY * BLOCK_DIM + y, image.height - 1u);
+						memcpy(&texels[(y * BLOCK_DIM + x) * 4u], &image.texels[(sourceY * image.width + sourceX) * 4u], 4u);
+					}
+				}
+			}
+
+			//Endpoints on the principal axis of the points, only the first channelCount channels are used
+			void FitEndpoints(const uint8_t texels[64], uint32_t channelCount, glm::vec4& start, glm::vec4& end)
+			{
+				glm::vec4 points[BLOCK_TEXELS];
+				glm::vec4 mean(0.0f);
+				for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+				{
+					points[i] = glm::vec4(0.0f);
+					for (uint32_t channel = 0; channel < channelCount; ++channel)
+					{
+						points[i][channel] = texels[i * 4u + channel];
+					}
+					mean += points[i];
+				}
+				mean /= static_cast<float>(BLOCK_TEXELS);
+
+				glm::mat4 covariance(0.0f);
+				glm::vec4 minPoint(255.0f);
+				glm::vec4 maxPoint(0.0f);
+				for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+				{
+					const glm::vec4 delta = points[i] - mean;
+					covariance += glm::outerProduct(delta, delta);
+					minPoint = glm::min(minPoint, points[i]);
+					maxPoint = glm::max(maxPoint, points[i]);
+				}
+
+				glm::vec4 axis = maxPoint - minPoint;
+				for (uint32_t i = 0; i < AXIS_ITERATIONS; ++i)
+				{
+					const glm::vec4 next = covariance * axis;
+					const float length = glm::length(next);
+					if (length <= 1e-6f)
+					{
+						break;
+					}
+					axis = next / length;
+				}
+
+				const float axisLength = glm::length(axis);
+				if (axisLength <= 1e-6f)
+				{
+					start = mean;
+					end = mean;
+					return;
+				}
+				axis /= axisLength;
+
+				float minT = 0.0f;
+				float maxT = 0.0f;
+				for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+				{
+					const float t = glm::dot(points[i] - mean, axis);
+					minT = std::min(minT, t);
+					maxT = std::max(maxT, t);
+				}
+
+				start = glm::clamp(mean + axis * minT, glm::vec4(0.0f), glm::vec4(255.0f));
+				end = glm::clamp(mean + axis * maxT, glm::vec4(0.0f), glm::vec4(255.0f));
+			}
+
+			uint16_t PackRgb565(const glm::vec4& color)
+			{
+				const uint32_t r = static_cast<uint32_t>(color.r * 31.0f / 255.0f + 0.5f);
+				const uint32_t g = static_cast<uint32_t>(color.g * 63.0f / 255.0f + 0.5f);
+				const uint32_t b = static_cast<uint32_t>(color.b * 31.0f / 255.0f + 0.5f);
+				return static_cast<uint16_t>((r << 11u) | (g << 5u) | b);
+			}
+
+			glm::ivec3 UnpackRgb565(uint16_t color)
+			{
+				const int32_t r = (color >> 11u) & 31u;
+				const int32_t g = (color >> 5u) & 63u;
+				const int32_t b = color & 31u;
+				return glm::ivec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+			}
+
+			//Always the four color mode, also valid as the color half of BC3
+			void EncodeColorBlock(const uint8_t texels[64], uint8_t* block)
+			{
+				glm::vec4 start;
+				glm::vec4 end;
+				FitEndpoints(texels, 3u, start, end);
+
+				uint16_t color0 = PackRgb565(end);
+				uint16_t color1 = PackRgb565(start);
+				if (color0 < color1)
+				{
+					std::swap(color0, color1);
+				}
+
+				uint32_t indices = 0;
+				if (color0 != color1)
+				{
+					glm::ivec3 palette[4];
+					palette[0] = UnpackRgb565(color0);
+					palette[1] = UnpackRgb565(color1);
+					palette[2] = (palette[0] * 2 + palette[1]) / 3;
+					palette[3] = (palette[0] + palette[1] * 2) / 3;
+
+					for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+					{
+						const glm::ivec3 texel(texels[i * 4u], texels[i * 4u + 1u], texels[i * 4u + 2u]);
+						uint32_t bestIndex = 0;
+						int32_t bestError = INT32_MAX;
+						for (uint32_t p = 0; p < 4u; ++p)
+						{
+							const glm::ivec3 delta = texel - palette[p];
+							const int32_t error = delta.x * delta.x + delta.y * delta.y + delta.z * delta.z;
+							if (error < bestError)
+							{
+								bestError = error;
+								bestIndex = p;
+							}
+						}
+						indices |= bestIndex << (i * 2u);
+					}
+				}
+
+				memcpy(block, &color0, sizeof(uint16_t));
+				memcpy(block + 2, &color1, sizeof(uint16_t));
+				memcpy(block + 4, &indices, sizeof(uint32_t));
+			}
+
+			//BC4 style block of one channel, eight value mode
+			void EncodeChannelBlock(const uint8_t texels[64], uint32_t channel, uint8_t* block)
+			{
+				uint32_t maxValue = 0;
+				uint32_t minValue = 255;
+				for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+				{
+					maxValue = std::max<uint32_t>(maxValue, texels[i * 4u + channel]);
+					minValue = std::min<uint32_t>(minValue, texels[i * 4u + channel]);
+				}
+
+				uint64_t indices = 0;
+				if (maxValue != minValue)
+				{
+					int32_t palette[8];
+					palette[0] = static_cast<int32_t>(maxValue);
+					palette[1] = static_cast<int32_t>(minValue);
+					for (int32_t p = 2; p < 8; ++p)
+					{
+						palette[p] = ((8 - p) * palette[0] + (p - 1) * palette[1]) / 7;
+					}
+
+					for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+					{
+						const int32_t value = texels[i * 4u + channel];
+						uint64_t bestIndex = 0;
+						int32_t bestError = INT32_MAX;
+						for (uint32_t p = 0; p < 8u; ++p)
+						{
+							const int32_t error = std::abs(value - palette[p]);
+							if (error < bestError)
+							{
+								bestError = error;
+								bestIndex = p;
+							}
+						}
+						indices |= bestIndex << (i * 3u);
+					}
+				}
+
+				block[0] = static_cast<uint8_t>(maxValue);
+				block[1] = static_cast<uint8_t>(minValue);
+				for (uint32_t i = 0; i < 6u; ++i)
+				{
+					block[2 + i] = static_cast<uint8_t>(indices >> (i * 8u));
+				}
+			}
+
+			void WriteBits(uint8_t* block, uint32_t& bitOffset, uint32_t value, uint32_t bitCount)
+			{
+				for (uint32_t i = 0; i < bitCount; ++i, ++bitOffset)
+				{
+					if ((value >> i) & 1u)
+					{
+						block[bitOffset / 8u] |= static_cast<uint8_t>(1u << (bitOffset % 8u));
+					}
+				}
+			}
+
+			//7 bit endpoint with the p-bit of lowest error, the p-bit is shared by all channels
+			void QuantizeBC7Endpoint(const glm::vec4& endpoint, glm::uvec4& quantized, uint32_t& pBit)
+			{
+				float bestError = FLT_MAX;
+				for (uint32_t p = 0; p < 2u; ++p)
+				{
+					glm::uvec4 candidate;
+					float error = 0.0f;
+					for (uint32_t channel = 0; channel < 4u; ++channel)
+					{
+						const float value = std::round((endpoint[channel] - p) * 0.5f);
+						candidate[channel] = static_cast<uint32_t>(glm::clamp(value, 0.0f, 127.0f));
+						const float delta = static_cast<float>((candidate[channel] << 1u) | p) - endpoint[channel];
+						error += delta * delta;
+					}
+
+					if (error < bestError)
+					{
+						bestError = error;
+						quantized = candidate;
+						pBit = p;
+					}
+				}
+			}
+
+			//Mode 6, one subset with RGBA endpoints and 4 bit indices
+			void EncodeBC7Block(const uint8_t texels[64], uint8_t* block)
+			{
+				glm::vec4 start;
+				glm::vec4 end;
+				FitEndpoints(texels, 4u, start, end);
+
+				glm::uvec4 endpoints[2];
+				uint32_t pBits[2];
+				QuantizeBC7Endpoint(start, endpoints[0], pBits[0]);
+				QuantizeBC7Endpoint(end, endpoints[1], pBits[1]);
+
+				const glm::ivec4 color0((endpoints[0] << 1u) | glm::uvec4(pBits[0]));
+				const glm::ivec4 color1((endpoints[1] << 1u) | glm::uvec4(pBits[1]));
+
+				uint32_t indices[BLOCK_TEXELS];
+				for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+				{
+					const glm::ivec4 texel(texels[i * 4u], texels[i * 4u + 1u], texels[i * 4u + 2u], texels[i * 4u + 3u]);
+					int32_t bestError = INT32_MAX;
+					indices[i] = 0;
+					for (uint32_t p = 0; p < 16u; ++p)
+					{
+						const int32_t weight = static_cast<int32_t>(BC7_WEIGHTS[p]);
+						const glm::ivec4 delta = texel - (color0 * (64 - weight) + color1 * weight + 32) / 64;
+						const int32_t error = delta.x * delta.x + delta.y * delta.y + delta.z * delta.z + delta.w * delta.w;
+						if (error < bestError)
+						{
+							bestError = error;
+							indices[i] = p;
+						}
+					}
+				}
+
+				//The anchor index drops its top bit, swap the endpoints if it is set
+				if (indices[0] & 8u)
+				{
+					std::swap(endpoints[0], endpoints[1]);
+					std::swap(pBits[0], pBits[1]);
+					for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+					{
+						indices[i] = 15u - indices[i];
+					}
+				}
+
+				memset(block, 0, 16u);
+				uint32_t bitOffset = 0;
+				WriteBits(block, bitOffset, 1u << 6u, 7u);
+				for (uint32_t channel = 0; channel < 4u; ++channel)
+				{
+					WriteBits(block, bitOffset, endpoints[0][channel], 7u);
+					WriteBits(block, bitOffset, endpoints[1][channel], 7u);
+				}
+				WriteBits(block, bitOffset, pBits[0], 1u);
+				WriteBits(block, bitOffset, pBits[1], 1u);
+				WriteBits(block, bitOffset, indices[0], 3u);
+				for (uint32_t i = 1; i < BLOCK_TEXELS; ++i)
+				{
+					WriteBits(block, bitOffset, indices[i], 4u);
+				}
+				assert(bitOffset == 128u);
+			}
+
+			uint32_t GetBlockSize(TranscodeFormat::Enum format)
+			{
+				return format == TranscodeFormat::kBC1 ? 8u : 16u;
+			}
+
+			gli::format GetCookedFormat(TranscodeFormat::Enum format, bool bSrgb)
+			{
+				switch (format)
+				{
+				case TranscodeFormat::kBC1:
+					return bSrgb ? gli::FORMAT_RGB_DXT1_SRGB_BLOCK8 : gli::FORMAT_RGB_DXT1_UNORM_BLOCK8;
+				case TranscodeFormat::kBC3:
+					return bSrgb ? gli::FORMAT_RGBA_DXT5_SRGB_BLOCK16 : gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16;
+				case TranscodeFormat::kBC5:
+					return gli::FORMAT_RG_ATI2N_UNORM_BLOCK16;
+				case TranscodeFormat::kBC7:
+					return bSrgb ? gli::FORMAT_RGBA_BP_SRGB_BLOCK16 : gli::FORMAT_RGBA_BP_UNORM_BLOCK16;
+				}
+
+				assert(false);
+				return gli::FORMAT_UNDEFINED;
+			}
+		}
+
+		bool TextureTranscoder::ParseFormat(const std::string& name, TranscodeFormat::Enum& format)
+		{
+			if (name == "bc1") format = TranscodeFormat::kBC1;
+			else if (name == "bc3") format = TranscodeFormat::kBC3;
+			else if (name == "bc5") format = TranscodeFormat::kBC5;
+			else if (name == "bc7") format = TranscodeFormat::kBC7;
+			else return false;
+
+			return true;
+		}
+
+		void TextureTranscoder::EncodeBlock(const uint8_t texels[64], TranscodeFormat::Enum format, uint8_t* block)
+		{
+			switch (format)
+			{
+			case TranscodeFormat::kBC1:
+				EncodeColorBlock(texels, block);
+				break;
+			case TranscodeFormat::kBC3:
+				EncodeChannelBlock(texels, 3u, block);
+				EncodeColorBlock(texels, block + 8);
+				break;
+			case TranscodeFormat::kBC5:
+				EncodeChannelBlock(texels, 0u, block);
+				EncodeChannelBlock(texels, 1u, block + 8);
+				break;
+			case TranscodeFormat::kBC7:
+				EncodeBC7Block(texels, block);
+				break;
+			}
+		}
+
+		bool TextureTranscoder::Transcode(const std::string& sourcePath, const std::string& cookedPath, TranscodeFormat::Enum format)
+		{
+			const gli::texture source = gli::load(sourcePath);
+			if (source.empty())
+			{
+				printf("ERROR: TextureTranscoder::Transcode: could not load %s \n", sourcePath.c_str());
+				return false;
+			}
+
+			if (source.target() != gli::TARGET_2D || gli::is_compressed(source.format()))
+			{
+				printf("ERROR: TextureTranscoder::Transcode: %s has to be an uncompressed 2D texture \n", sourcePath.c_str());
+				return false;
+			}
+
+			//Two channel normal maps have no sRGB variant
+			const bool bSrgb = gli::is_srgb(source.format()) && format != TranscodeFormat::kBC5;
+			const gli::format rgbaFormat = bSrgb ? gli::FORMAT_RGBA8_SRGB_PACK8 : gli::FORMAT_RGBA8_UNORM_PACK8;
+
+			const gli::texture2d rgba = source.format() == rgbaFormat ? gli::texture2d(source) : gli::convert(gli::texture2d(source), rgbaFormat);
+			if (rgba.empty())
+			{
+				printf("ERROR: TextureTranscoder::Transcode: can not convert %s to RGBA8 \n", sourcePath.c_str());
+				return false;
+			}
+
+			//The source mips are ignored, the whole chain is filtered again from the top level
+			std::vector<RgbaImage> levels(1);
+			levels[0].width = static_cast<uint32_t>(rgba.extent(0).x);
+			levels[0].height = static_cast<uint32_t>(rgba.extent(0).y);
+			levels[0].texels.resize(rgba.size(0));
+			memcpy(levels[0].texels.data(), rgba.data(0, 0, 0), rgba.size(0));
+
+			while (levels.back().width > 1u || levels.back().height > 1u)
+			{
+				levels.push_back(Downsample(levels.back(), bSrgb));
+			}
+
+			gli::texture2d cooked(GetCookedFormat(format, bSrgb), gli::extent2d(levels[0].width, levels[0].height), levels.size());
+			const uint32_t blockSize = GetBlockSize(format);
+			uint8_t texels[64];
+			for (size_t level = 0; level < levels.size(); ++level)
+			{
+				const RgbaImage& image = levels[level];
+				const uint32_t blocksX = (image.width + BLOCK_DIM - 1u) / BLOCK_DIM;
+				const uint32_t blocksY = (image.height + BLOCK_DIM - 1u) / BLOCK_DIM;
+				assert(cooked.size(level) == static_cast<size_t>(blocksX) * blocksY * blockSize);
+
+				uint8_t* blocks = static_cast<uint8_t*>(cooked.data(0, 0, level));
+				for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+				{
+					for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+					{
+						GatherBlock(image, blockX, blockY, texels);
+						EncodeBlock(texels, format, blocks + (blockY * blocksX + blockX) * blockSize);
+					}
+				}
+			}
+
+			if (!gli::save_ktx(cooked, cookedPath))
+			{
+				printf("ERROR: TextureTranscoder::Transcode: could not write %s \n", cookedPath.c_str());
+				return false;
+			}
+
+			return true;
+		}
+	}
+}
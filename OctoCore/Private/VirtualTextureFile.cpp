@@ -0,0 +1,237 @@
+#include "VirtualTextureFile.h"
+
+//Other
+#include <cassert>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+
+namespace Core
+{
+	namespace Texture
+	{
+		namespace
+		{
+			//VK_FORMAT_R8G8B8A8_UNORM, OctoCore does not see the Vulkan headers
+			const uint32_t TEXEL_FORMAT = 37u;
+			const uint32_t TEXEL_SIZE = 4u;
+
+			uint64_t AlignSectionOffset(uint64_t offset)
+			{
+				return (offset + VIRTUAL_TEXTURE_FILE_SECTION_ALIGNMENT - 1u) & ~static_cast<uint64_t>(VIRTUAL_TEXTURE_FILE_SECTION_ALIGNMENT - 1u);
+			}
+
+			bool IsPowerOfTwo(uint32_t value)
+			{
+				return value > 0u && (value & (value - 1u)) == 0u;
+			}
+
+			//Half the size, every texel averages its 2x2 footprint
+			std::vector<uint8_t> DownsampleMip(const uint8_t* texels, uint32_t size)
+			{
+				const uint32_t mipSize = size / 2u;
+				std::vector<uint8_t> mip(static_cast<size_t>(mipSize) * mipSize * TEXEL_SIZE);
+
+				for (uint32_t y = 0u; y < mipSize; y++)
+				{
+					for (uint32_t x = 0u; x < mipSize; x++)
+					{
+						const uint8_t* row0 = texels + (static_cast<size_t>(2u * y) * size + 2u * x) * TEXEL_SIZE;
+						const uint8_t* row1 = row0 + static_cast<size_t>(size) * TEXEL_SIZE;
+						uint8_t* texel = &mip[(static_cast<size_t>(y) * mipSize + x) * TEXEL_SIZE];
+
+						for (uint32_t channel = 0u; channel < TEXEL_SIZE; channel++)
+						{
+							const uint32_t sum = row0[channel] + row0[TEXEL_SIZE + channel] + row1[channel] + row1[TEXEL_SIZE + channel];
+							texel[channel] = static_cast<uint8_t>((sum + 2u) / 4u);
+						}
+					}
+				}
+
+				return mip;
+			}
+
+			//Border texels outside the mip repeat its edge
+			void CopyTile(const uint8_t* texels, uint32_t size, uint32_t pageX, uint32_t pageY, uint8_t* tile)
+			{
+				const int32_t tileExtent = static_cast<int32_t>(VIRTUAL_TEXTURE_TILE_SIZE + 2u * VIRTUAL_TEXTURE_TILE_BORDER);
+				const int32_t originX = static_cast<int32_t>(pageX * VIRTUAL_TEXTURE_TILE_SIZE) - static_cast<int32_t>(VIRTUAL_TEXTURE_TILE_BORDER);
+				const int32_t originY = static_cast<int32_t>(pageY * VIRTUAL_TEXTURE_TILE_SIZE) - static_cast<int32_t>(VIRTUAL_TEXTURE_TILE_BORDER);
+				const int32_t last = static_cast<int32_t>(size) - 1;
+
+				for (int32_t y = 0; y < tileExtent; y++)
+				{
+					const int32_t sourceY = std::min(std::max(originY + y, 0), last);
+					for (int32_t x = 0; x < tileExtent; x++)
+					{
+						const int32_t sourceX = std::min(std::max(originX + x, 0), last);
+						const uint8_t* source = texels + (static_cast<size_t>(sourceY) * size + sourceX) * TEXEL_SIZE;
+						std::copy(source, source + TEXEL_SIZE, tile + (static_cast<size_t>(y) * tileExtent + x) * TEXEL_SIZE);
+					}
+				}
+			}
+
+			bool WriteSection(FILE* fp, uint64_t offset, const void* data, uint64_t size)
+			{
+				if (size == 0u)
+				{
+					return true;
+				}
+
+				//Padding between the sections is zeroed
+				static const uint8_t zeros[VIRTUAL_TEXTURE_FILE_SECTION_ALIGNMENT] = {};
+				const uint64_t position = static_cast<uint64_t>(ftell(fp));
+				assert(offset >= position && offset - position < VIRTUAL_TEXTURE_FILE_SECTION_ALIGNMENT);
+
+				if (offset > position && fwrite(zeros, static_cast<size_t>(offset - position), 1, fp) != 1u)
+				{
+					return false;
+				}
+
+				return fwrite(data, static_cast<size_t>(size), 1, fp) == 1u;
+			}
+		}
+
+		bool VirtualTextureFile::Load(const std::string& path)
+		{
+			Release();
+
+			if (!m_File.Map(path))
+			{
+				return false;
+			}
+
+			const size_t size = m_File.GetSize();
+			if (size < sizeof(VirtualTextureFileHeader))
+			{
+				Release();
+				return false;
+			}
+
+			const VirtualTextureFileHeader* header = reinterpret_cast<const VirtualTextureFileHeader*>(m_File.GetData());
+			if (header->magic != VIRTUAL_TEXTURE_FILE_MAGIC || header->version != VIRTUAL_TEXTURE_FILE_VERSION)
+			{
+				printf("ERROR: VirtualTextureFile::Load: %s is not a cooked virtual texture of version %u \n", path.c_str(), VIRTUAL_TEXTURE_FILE_VERSION);
+				Release();
+				return false;
+			}
+
+			assert(header->format == TEXEL_FORMAT && header->texelSize == TEXEL_SIZE);
+			assert(header->tileSize == VIRTUAL_TEXTURE_TILE_SIZE && header->tileBorder == VIRTUAL_TEXTURE_TILE_BORDER);
+
+			//Sections have to lie inside the file
+			const uint64_t tileSize = static_cast<uint64_t>(header->tileSize + 2u * header->tileBorder) * (header->tileSize + 2u * header->tileBorder) * header->texelSize;
+			const uint64_t mipEnd = header->mipOffset + static_cast<uint64_t>(header->mipCount) * sizeof(VirtualTextureFileMip);
+			const uint64_t tileEnd = header->tileOffset + header->tileCount * tileSize;
+			if (mipEnd > size || tileEnd > size)
+			{
+				printf("ERROR: VirtualTextureFile::Load: %s is truncated \n", path.c_str());
+				Release();
+				return false;
+			}
+
+			m_Header = header;
+			m_Mips = reinterpret_cast<const VirtualTextureFileMip*>(m_File.GetData() + header->mipOffset);
+			m_Tiles = m_File.GetData() + header->tileOffset;
+
+			return true;
+		}
+
+		void VirtualTextureFile::Release()
+		{
+			m_Header = nullptr;
+			m_Mips = nullptr;
+			m_Tiles = nullptr;
+
+			m_File.Unmap();
+		}
+
+		const uint8_t* VirtualTextureFile::GetTileData(uint32_t mip, uint32_t pageX, uint32_t pageY) const
+		{
+			assert(mip < m_Header->mipCount && pageX < m_Mips[mip].pageCount && pageY < m_Mips[mip].pageCount);
+
+			const uint64_t tileIdx = m_Mips[mip].firstTile + static_cast<uint64_t>(pageY) * m_Mips[mip].pageCount + pageX;
+			return m_Tiles + tileIdx * GetTileDataSize();
+		}
+
+		bool VirtualTextureFile::Cook(const std::string& cookedPath, const uint8_t* texels, uint32_t size)
+		{
+			const uint32_t pageCount = size / VIRTUAL_TEXTURE_TILE_SIZE;
+			if (!IsPowerOfTwo(size) || pageCount < 2u || pageCount > VIRTUAL_TEXTURE_MAX_PAGES_PER_SIDE)
+			{
+				printf("ERROR: VirtualTextureFile::Cook: size %u of %s is no power of two between %u and %u \n", size, cookedPath.c_str(),
+					2u * VIRTUAL_TEXTURE_TILE_SIZE, VIRTUAL_TEXTURE_MAX_PAGES_PER_SIDE * VIRTUAL_TEXTURE_TILE_SIZE);
+				return false;
+			}
+
+			VirtualTextureFileHeader header = {};
+			header.magic = VIRTUAL_TEXTURE_FILE_MAGIC;
+			header.version = VIRTUAL_TEXTURE_FILE_VERSION;
+			header.format = TEXEL_FORMAT;
+			header.texelSize = TEXEL_SIZE;
+			header.size = size;
+			header.tileSize = VIRTUAL_TEXTURE_TILE_SIZE;
+			header.tileBorder = VIRTUAL_TEXTURE_TILE_BORDER;
+
+			std::vector<VirtualTextureFileMip> mips;
+			for (uint32_t mipPageCount = pageCount; mipPageCount > 0u; mipPageCount /= 2u)
+			{
+				mips.push_back({ mipPageCount, header.tileCount, { 0u, 0u } });
+				header.tileCount += mipPageCount * mipPageCount;
+			}
+
+			header.mipCount = static_cast<uint32_t>(mips.size());
+			header.mipOffset = AlignSectionOffset(sizeof(VirtualTextureFileHeader));
+			header.tileOffset = AlignSectionOffset(header.mipOffset + mips.size() * sizeof(VirtualTextureFileMip));
+
+			FILE* fp = fopen(cookedPath.c_str(), "wb");
+			if (fp == nullptr)
+			{
+				printf("ERROR: VirtualTextureFile::Cook: could not open %s \n", cookedPath.c_str());
+				return false;
+			}
+
+			bool written = WriteSection(fp, 0u, &header, sizeof(VirtualTextureFileHeader));
+			written = written && WriteSection(fp, header.mipOffset, mips.data(), mips.size() * sizeof(VirtualTextureFileMip));
+
+			//One mip is kept in memory at a time, tiles are written as they are cut
+			const uint32_t tileExtent = VIRTUAL_TEXTURE_TILE_SIZE + 2u * VIRTUAL_TEXTURE_TILE_BORDER;
+			std::vector<uint8_t> tile(static_cast<size_t>(tileExtent) * tileExtent * TEXEL_SIZE);
+			std::vector<uint8_t> mipTexels;
+			const uint8_t* mipData = texels;
+			uint32_t mipSize = size;
+
+			for (size_t mipIdx = 0u; mipIdx < mips.size() && written; mipIdx++)
+			{
+				if (mipIdx > 0u)
+				{
+					mipTexels = DownsampleMip(mipData, mipSize);
+					mipData = mipTexels.data();
+					mipSize /= 2u;
+				}
+
+				for (uint32_t pageY = 0u; pageY < mips[mipIdx].pageCount && written; pageY++)
+				{
+					for (uint32_t pageX = 0u; pageX < mips[mipIdx].pageCount && written; pageX++)
+					{
+						CopyTile(mipData, mipSize, pageX, pageY, tile.data());
+
+						//Tiles follow each other without padding, files of large textures outgrow what ftell() reports
+						const bool firstTile = mipIdx == 0u && pageX == 0u && pageY == 0u;
+						written = firstTile ? WriteSection(fp, header.tileOffset, tile.data(), tile.size()) : fwrite(tile.data(), tile.size(), 1, fp) == 1u;
+					}
+				}
+			}
+			fclose(fp);
+
+			if (!written)
+			{
+				printf("ERROR: VirtualTextureFile::Cook: could not write %s \n", cookedPath.c_str());
+				std::remove(cookedPath.c_str());
+				return false;
+			}
+
+			return true;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "MeshFile.h"
+
+namespace Core
+{
+	namespace Mesh
+	{
+		/*
+			Offline importer, runs Assimp once on the source asset and writes the cooked mesh file.
+			The runtime never touches Assimp, it loads the cooked file through MeshFile.
+		*/
+		struct AssimpLoader
+		{
+			/*
+				@param sourcePath any format Assimp can import (FBX, OBJ, ...)
+				@param cookedPath output path of the cooked mesh file
+				@return false if the import or the write failed
+			*/
+			static bool CookMesh(const std::string& sourcePath, const std::string& cookedPath);
+
+			//True if the cooked file is missing or older than its source
+			static bool IsCookedMeshStale(const std::string& sourcePath, const std::string& cookedPath);
+		};
+	}
+}
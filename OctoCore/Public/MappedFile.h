@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace Core
+{
+	namespace Memory
+	{
+		/*
+			Read only memory mapping of a whole file.
+			Pages are brought in by the OS on first access and never copied to the heap,
+			callers point uploads directly at the mapped range.
+		*/
+		class MappedFile
+		{
+			public:
+				MappedFile() = default;
+				~MappedFile();
+
+				MappedFile(const MappedFile&) = delete;
+				MappedFile& operator=(const MappedFile&) = delete;
+				MappedFile(MappedFile&& other);
+				MappedFile& operator=(MappedFile&& other);
+
+				/*
+					@param path
+					@return false if the file is missing or empty
+				*/
+				bool Map(const std::string& path);
+				void Unmap();
+
+				bool IsMapped() const { return m_Data != nullptr; }
+
+				//Mapping is page aligned
+				const uint8_t* GetData() const { return m_Data; }
+				std::size_t GetSize() const { return m_Size; }
+
+			private:
+				const uint8_t* m_Data = nullptr;
+				std::size_t m_Size = 0u;
+		};
+	}
+}
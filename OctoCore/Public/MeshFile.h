@@ -0,0 +1,225 @@
+#pragma once
+#include "MappedFile.h"
+#include "VertexPacking.h"
+#include <ThirdParty/glm/glm/glm.hpp>
+
+//Other
+#include <cstdint>
+#include <string>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		//"OMSH"
+		const uint32_t MESH_FILE_MAGIC = 0x48534D4Fu;
+
+		//Bump on every layout change, files of other versions are rejected and have to be cooked again
+		const uint32_t MESH_FILE_VERSION = 6u;
+
+		//Sections start at this alignment inside the file
+		const uint32_t MESH_FILE_SECTION_ALIGNMENT = 16u;
+
+		//Full detail plus up to four simplified levels per submesh
+		const uint32_t MAX_MESH_LODS = 5u;
+
+		//PackedSkin indexes the palette with bytes
+		const uint32_t MAX_MESH_JOINTS = 256u;
+
+		namespace VertexFormat
+		{
+			enum Enum : uint32_t
+			{
+				//Interleaved drawVert, not written anymore
+				kDrawVert = 0u,
+
+				//PackedPosition stream followed by a PackedAttributes stream,
+				//positions are quantized to the bounds box of their submesh
+				kPacked = 1u
+			};
+		};
+
+		//Unpacked vertex the cooker works on, written as PackedPosition and PackedAttributes
+		struct CookedVertex
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+			glm::vec3 tangent;
+			glm::vec3 bitangent;
+			glm::vec3 color;
+			glm::vec2 uv;
+
+			//Four strongest joints, weights sum up to 1, all zero for static meshes
+			glm::uvec4 joints;
+			glm::vec4 weights;
+		};
+
+		struct MeshFileBounds
+		{
+			//Exact, submesh boxes define the position quantization
+			glm::vec3 min;
+			glm::vec3 max;
+
+			//Center and radius, padded by the position quantization error
+			glm::vec4 sphere;
+		};
+
+		/*
+			Index range of one detail level, all levels of a submesh share its vertices.
+			Error is the largest deviation from the full detail surface in object space units.
+		*/
+		struct MeshFileLod
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float    error;
+			uint32_t padding;
+		};
+
+		//Contiguous part of the LOD 0 index range, culled on its own by the cluster culling pass
+		struct MeshFileCluster
+		{
+			//Center and radius, padded by the position quantization error
+			glm::vec4 boundingSphere;
+
+			//Axis and sine of the cone angle around the face normals, a cutoff of 1 is never back facing
+			glm::vec4 cone;
+
+			uint32_t  firstIndex;
+			uint32_t  indexCount;
+			uint32_t  padding[2];
+		};
+
+		/*
+			Joint of the skeleton of a skinned mesh, parents always come before their children.
+			The bind pose is relative to the parent joint, root joints are in model space.
+		*/
+		struct MeshFileJoint
+		{
+			//-1 for root joints
+			int32_t   parent;
+			uint32_t  padding[3];
+
+			//Quaternion as x, y, z, w
+			glm::vec4 bindRotation;
+
+			//w unused
+			glm::vec4 bindTranslation;
+
+			//Mesh space to joint space, 3x4 row major with the translation in the last column
+			float     inverseBindPose[3][4];
+		};
+
+		//Indices are relative to the submesh vertex offset, the index range is the one of LOD 0
+		struct MeshFileSubmesh
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			int32_t  vertexOffset;
+			uint32_t vertexCount;
+			uint32_t materialIndex;
+
+			//Range in the LOD section, ordered from full to lowest detail
+			uint32_t firstLod;
+			uint32_t lodCount;
+
+			//Range in the cluster section, the clusters cover LOD 0
+			uint32_t firstCluster;
+			uint32_t clusterCount;
+			uint32_t padding;
+			MeshFileBounds bounds;
+		};
+
+		/*
+			Cooked mesh file:
+			header | submeshes | lods | clusters | positions | attributes | indices | joints | skin
+			Offsets are relative to the start of the file and aligned to MESH_FILE_SECTION_ALIGNMENT.
+			Static meshes have no joints, their skin section is empty.
+		*/
+		struct MeshFileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vertexFormat;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+
+			//2 or 4 bytes
+			uint32_t indexSize;
+			uint32_t submeshCount;
+
+			uint32_t positionStride;
+			uint32_t attributeStride;
+			uint32_t lodCount;
+			uint32_t clusterCount;
+			uint32_t jointCount;
+
+			uint64_t submeshOffset;
+			uint64_t lodOffset;
+			uint64_t clusterOffset;
+			uint64_t positionOffset;
+			uint64_t attributeOffset;
+			uint64_t indexOffset;
+			uint64_t jointOffset;
+
+			//One PackedSkin per vertex
+			uint64_t skinOffset;
+
+			MeshFileBounds bounds;
+		};
+
+		static_assert(sizeof(MeshFileLod) == 16u, "MeshFileLod layout changed, bump MESH_FILE_VERSION");
+		static_assert(sizeof(MeshFileCluster) == 48u, "MeshFileCluster layout changed, bump MESH_FILE_VERSION");
+		static_assert(sizeof(MeshFileJoint) == 96u, "MeshFileJoint layout changed, bump MESH_FILE_VERSION");
+		static_assert(sizeof(MeshFileSubmesh) == 80u, "MeshFileSubmesh layout changed, bump MESH_FILE_VERSION");
+		static_assert(sizeof(MeshFileHeader) == 152u, "MeshFileHeader layout changed, bump MESH_FILE_VERSION");
+
+		/*
+			Runtime side of the cooked format.
+			The file is memory mapped, sections are referenced in place without any parsing or heap copy.
+			Buffers can point their upload data directly at GetVertexData() and GetIndexData(),
+			the vertex data holds both streams so they share one buffer.
+		*/
+		class MeshFile
+		{
+			public:
+				/*
+					@param path of the cooked file
+					@return false if the file is missing, truncated, corrupt or of another version
+				*/
+				bool Load(const std::string& path);
+				void Release();
+
+				bool IsLoaded() const { return m_Header != nullptr; }
+
+				const MeshFileHeader& GetHeader() const { return *m_Header; }
+				const MeshFileSubmesh* GetSubmeshes() const { return m_Submeshes; }
+				const MeshFileLod* GetLods() const { return m_Lods; }
+				const MeshFileCluster* GetClusters() const { return m_Clusters; }
+				const void* GetVertexData() const { return m_Vertices; }
+				const void* GetIndexData() const { return m_Indices; }
+
+				//Skinned meshes only, both are null for static meshes
+				bool IsSkinned() const { return m_Header->jointCount > 0u; }
+				const MeshFileJoint* GetJoints() const { return m_Joints; }
+				const PackedSkin* GetSkinData() const { return m_Skin; }
+				uint64_t GetSkinDataSize() const { return static_cast<uint64_t>(m_Header->vertexCount) * sizeof(PackedSkin); }
+
+				uint64_t GetVertexDataSize() const { return m_Header->attributeOffset + static_cast<uint64_t>(m_Header->vertexCount) * m_Header->attributeStride - m_Header->positionOffset; }
+				uint64_t GetAttributeStreamOffset() const { return m_Header->attributeOffset - m_Header->positionOffset; }
+				uint64_t GetIndexDataSize() const { return static_cast<uint64_t>(m_Header->indexCount) * m_Header->indexSize; }
+
+			private:
+				Core::Memory::MappedFile m_File;
+
+				const MeshFileHeader*  m_Header = nullptr;
+				const MeshFileSubmesh* m_Submeshes = nullptr;
+				const MeshFileLod* m_Lods = nullptr;
+				const MeshFileCluster* m_Clusters = nullptr;
+				const void* m_Vertices = nullptr;
+				const void* m_Indices = nullptr;
+				const MeshFileJoint* m_Joints = nullptr;
+				const PackedSkin* m_Skin = nullptr;
+		};
+	}
+}
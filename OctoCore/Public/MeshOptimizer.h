@@ -0,0 +1,42 @@
+#pragma once
+#include "MeshFile.h"
+
+//Other
+#include <vector>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		//Post transform cache size the orderings are tuned for
+		const uint32_t VERTEX_CACHE_SIZE = 16u;
+
+		/*
+			Cook time reordering of a single submesh, indices are local to its vertices.
+			Optimize() runs all stages in order: deduplication, vertex cache (Tipsify),
+			overdraw (cluster sorting) and vertex fetch. Stages only reorder, the triangles stay the same.
+		*/
+		struct MeshOptimizer
+		{
+			static void Optimize(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices);
+
+			//Bitwise identical vertices are merged
+			static void DeduplicateVertices(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices);
+
+			/*
+				Tipsify (Sander et al. 2007), linear in the triangle count.
+				@param clusterStarts first triangle of every cluster, clusters start where the cache restarts cold
+			*/
+			static void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusterStarts);
+
+			//Clusters facing away from the mesh center are drawn first so they occlude the inner ones
+			static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& clusterStarts);
+
+			//Vertices are stored in the order the indices first reference them, unreferenced ones are dropped
+			static void OptimizeVertexFetch(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices);
+
+			//Average cache misses per triangle of a FIFO cache, 0.5 is the optimum for regular grids, 3 the worst case
+			static float CalculateACMR(const std::vector<uint32_t>& indices, uint32_t vertexCount);
+		};
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "MeshFile.h"
+
+//Other
+#include <vector>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		/*
+			Cook time simplification of a single submesh with quadric error metrics (Garland and Heckbert 1997).
+			Vertices are never moved or added, edges collapse into one of their end points,
+			so every LOD indexes the vertices of the full detail mesh and only needs its own index range.
+			Vertices on attribute seams are kept, collapsing only one side of a seam would tear it open.
+		*/
+		struct MeshSimplifier
+		{
+			/*
+				@param indices full detail triangle list, indices are local to vertices
+				@param targetIndexCount the result stops shrinking once it is at or below this count
+				@param error receives the largest deviation of a collapse in object space units
+				@return simplified triangle list, larger than the target if no further collapse was possible
+			*/
+			static std::vector<uint32_t> Simplify(const std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& indices,
+				uint32_t targetIndexCount, float& error);
+		};
+	}
+}
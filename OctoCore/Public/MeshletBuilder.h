@@ -0,0 +1,30 @@
+#pragma once
+#include "MeshFile.h"
+
+//Other
+#include <vector>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		//Limits of a single cluster, 124 triangles keep the index data of a cluster below 1.5KB
+		const uint32_t MAX_CLUSTER_VERTICES = 64u;
+		const uint32_t MAX_CLUSTER_TRIANGLES = 124u;
+
+		/*
+			Splits a triangle list into clusters for cluster culling.
+			Triangles are taken in order, so the list should already be optimized for the vertex cache,
+			and every cluster is a contiguous index range of it. No index data is duplicated.
+		*/
+		struct MeshletBuilder
+		{
+			/*
+				@param indices triangle list, indices are local to vertices
+				@param firstIndex offset of indices[0] in the index section, written to the cluster ranges
+			*/
+			static void Build(const std::vector<CookedVertex>& vertices, const uint32_t* indices, uint32_t indexCount,
+				uint32_t firstIndex, std::vector<MeshFileCluster>& clusters);
+		};
+	}
+}
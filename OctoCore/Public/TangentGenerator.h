@@ -0,0 +1,24 @@
+#pragma once
+#include "MeshFile.h"
+
+//Other
+#include <vector>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		/*
+			Tangent space generation for a whole triangle list, weighted the way MikkTSpace does it:
+			face tangents are projected onto the vertex normals, weighted by the corner angle,
+			summed per vertex and orthonormalized against the normal.
+			Vertices are not split, so the result matches MikkTSpace wherever the tangent space is continuous.
+			Four triangles or vertices are processed at once with SSE2, tails and other targets take the scalar path.
+		*/
+		struct TangentGenerator
+		{
+			//Overwrites tangent and bitangent of every vertex, positions, normals and uvs have to be set
+			static void Generate(std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& indices);
+		};
+	}
+}
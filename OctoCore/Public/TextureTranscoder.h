@@ -0,0 +1,53 @@
+#pragma once
+
+//Other
+#include <cstdint>
+#include <string>
+
+namespace Core
+{
+	namespace Texture
+	{
+		namespace TranscodeFormat
+		{
+			enum Enum
+			{
+				//RGB, 4 bits per texel
+				kBC1,
+
+				//RGBA, BC1 color with interpolated alpha
+				kBC3,
+
+				//Two channels, normal maps
+				kBC5,
+
+				//RGBA at BC3 size with better quality, single subset mode 6 blocks
+				kBC7
+			};
+		}
+
+		/*
+			Offline transcoder, converts an uncompressed source texture into a block compressed KTX file
+			with its full mip chain. Mips are box filtered before compression, in linear space for sRGB sources.
+			The runtime loads the result through gli like every other texture, nothing is compressed on load.
+		*/
+		struct TextureTranscoder
+		{
+			/*
+				@param sourcePath uncompressed 8 bit per channel KTX or DDS
+				@param cookedPath output path of the KTX file
+				@return false if the source can not be read or the write failed
+			*/
+			static bool Transcode(const std::string& sourcePath, const std::string& cookedPath, TranscodeFormat::Enum format);
+
+			//"bc1", "bc3", "bc5" or "bc7"
+			static bool ParseFormat(const std::string& name, TranscodeFormat::Enum& format);
+
+			/*
+				Compress one 4x4 block of RGBA8 texels, rows are tightly packed.
+				@param block receives 8 bytes for BC1, 16 bytes for the others
+			*/
+			static void EncodeBlock(const uint8_t texels[64], TranscodeFormat::Enum format, uint8_t* block);
+		};
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <ThirdParty/glm/glm/glm.hpp>
+#include <ThirdParty/glm/glm/gtc/packing.hpp>
+
+//Other
+#include <cstdint>
+
+namespace Core
+{
+	namespace Mesh
+	{
+		/*
+			Packed vertex streams, positions are split from the other attributes
+			so depth only passes fetch 8 bytes per vertex instead of the whole vertex.
+			Layouts have to match the BufferLayoutDescription formats used to draw them.
+		*/
+
+		//VK_FORMAT_R16G16B16A16_SNORM, relative to a PositionQuantization box, w is 1
+		struct PackedPosition
+		{
+			uint64_t position;
+		};
+
+		/*
+			Box the positions of one submesh are quantized to, decoded as offset + packed * scale.
+			Snorm steps are relative to the box, so precision does not fall off with the distance from the origin.
+		*/
+		struct PositionQuantization
+		{
+			glm::vec3 offset;
+			glm::vec3 scale;
+		};
+
+		struct PackedAttributes
+		{
+			//VK_FORMAT_R16G16_SNORM, octahedral encoded
+			uint32_t normal;
+
+			//VK_FORMAT_A2B10G10R10_UNORM_PACK32, xyz * 0.5 + 0.5, w is 1 if the bitangent is cross(normal, tangent)
+			//Snorm 10:10:10:2 is not a mandatory vertex format, unorm is
+			uint32_t tangent;
+
+			//VK_FORMAT_R16G16_SFLOAT
+			uint32_t uv;
+
+			//VK_FORMAT_R8G8B8A8_UNORM
+			uint32_t color;
+		};
+
+		//Skin stream of skinned meshes, read by skinning.comp
+		struct PackedSkin
+		{
+			//VK_FORMAT_R8G8B8A8_UINT, palette indices
+			uint32_t joints;
+
+			//VK_FORMAT_R8G8B8A8_UNORM, sums up to 255
+			uint32_t weights;
+		};
+
+		static_assert(sizeof(PackedPosition) == 8u, "Position stream stride changed");
+		static_assert(sizeof(PackedAttributes) == 16u, "Attribute stream stride changed");
+		static_assert(sizeof(PackedSkin) == 8u, "Skin stream stride changed");
+
+		inline PositionQuantization GetPositionQuantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+		{
+			//Flat boxes keep a scale above zero, their positions all pack to 0 on that axis
+			return PositionQuantization{ (boundsMin + boundsMax) * 0.5f, glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(1e-6f)) };
+		}
+
+		//Bound on the distance between a position inside the box and its decoded value, bounds are padded by it
+		inline float GetPositionQuantizationError(const PositionQuantization& quantization)
+		{
+			//Rounding is half a step, the other half covers float error of far away boxes
+			return glm::length(quantization.scale) / 32767.0f;
+		}
+
+		//Positions outside the box are clamped to it
+		inline PackedPosition PackPosition(const glm::vec3& position, const PositionQuantization& quantization)
+		{
+			return PackedPosition{ glm::packSnorm4x16(glm::vec4((position - quantization.offset) / quantization.scale, 1.0f)) };
+		}
+
+		//Unit vector onto the octahedron, lower hemisphere folded over the diagonals
+		inline glm::vec2 OctahedralEncode(const glm::vec3& normal)
+		{
+			const glm::vec3 n = normal / (glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z));
+			if (n.z >= 0.0f)
+			{
+				return glm::vec2(n.x, n.y);
+			}
+
+			return glm::vec2(
+				(1.0f - glm::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - glm::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+		}
+
+		inline glm::vec3 OctahedralDecode(const glm::vec2& encoded)
+		{
+			glm::vec3 n = glm::vec3(encoded.x, encoded.y, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y));
+			if (n.z < 0.0f)
+			{
+				n.x = (1.0f - glm::abs(encoded.y)) * (encoded.x >= 0.0f ? 1.0f : -1.0f);
+				n.y = (1.0f - glm::abs(encoded.x)) * (encoded.y >= 0.0f ? 1.0f : -1.0f);
+			}
+
+			return glm::normalize(n);
+		}
+
+		/*
+			@param normal unit length
+			@param tangent does not have to be orthogonal to the normal, zero picks any orthogonal direction
+			@param bitangent only its handedness is kept
+		*/
+		inline PackedAttributes PackAttributes(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent, const glm::vec2& uv, const glm::vec3& color)
+		{
+			//Gram-Schmidt, the bitangent is rebuilt from the frame in the shader
+			glm::vec3 t = tangent - normal * glm::dot(normal, tangent);
+			if (glm::dot(t, t) < 1e-12f)
+			{
+				t = glm::abs(normal.x) < 0.9f ? glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f));
+			}
+			t = glm::normalize(t);
+
+			const float handedness = glm::dot(glm::cross(normal, t), bitangent) < 0.0f ? 0.0f : 1.0f;
+
+			PackedAttributes attributes;
+			attributes.normal = glm::packSnorm2x16(OctahedralEncode(normal));
+			attributes.tangent = glm::packUnorm3x10_1x2(glm::vec4(t * 0.5f + 0.5f, handedness));
+			attributes.uv = glm::packHalf2x16(uv);
+			attributes.color = glm::packUnorm4x8(glm::vec4(glm::clamp(color, 0.0f, 1.0f), 1.0f));
+			return attributes;
+		}
+	
+		/*
+			@param joints palette indices, below 256
+			@param weights do not have to be normalized, unused influences have a weight of 0
+		*/
+		inline PackedSkin PackSkin(const glm::uvec4& joints, const glm::vec4& weights)
+		{
+			const float weightSum = weights.x + weights.y + weights.z + weights.w;
+			const glm::vec4 normalized = weightSum > 0.0f ? weights / weightSum : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+
+			//Rounding error goes to the largest weight, so the quantized weights still sum up to one
+			glm::uvec4 quantized = glm::uvec4(glm::round(normalized * 255.0f));
+			const int32_t error = 255 - static_cast<int32_t>(quantized.x + quantized.y + quantized.z + quantized.w);
+			uint32_t largest = 0u;
+			for (uint32_t i = 1u; i < 4u; i++)
+			{
+				largest = normalized[i] > normalized[largest] ? i : largest;
+			}
+			quantized[largest] = static_cast<uint32_t>(static_cast<int32_t>(quantized[largest]) + error);
+
+			PackedSkin skin;
+			skin.joints = (joints.x & 0xFFu) | ((joints.y & 0xFFu) << 8u) | ((joints.z & 0xFFu) << 16u) | ((joints.w & 0xFFu) << 24u);
+			skin.weights = quantized.x | (quantized.y << 8u) | (quantized.z << 16u) | (quantized.w << 24u);
+			return skin;
+		}
+	}
+}
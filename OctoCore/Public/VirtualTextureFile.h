@@ -0,0 +1,110 @@
+#pragma once
+#include "MappedFile.h"
+
+//Other
+#include <cstdint>
+#include <string>
+
+namespace Core
+{
+	namespace Texture
+	{
+		//"OVTX"
+		const uint32_t VIRTUAL_TEXTURE_FILE_MAGIC = 0x5854564Fu;
+
+		//Bump on every layout change, files of other versions are rejected and have to be cooked again
+		const uint32_t VIRTUAL_TEXTURE_FILE_VERSION = 1u;
+
+		//Sections start at this alignment inside the file
+		const uint32_t VIRTUAL_TEXTURE_FILE_SECTION_ALIGNMENT = 16u;
+
+		//Texels of a page, the tile stored for it adds the border on every side
+		const uint32_t VIRTUAL_TEXTURE_TILE_SIZE = 128u;
+
+		//Texels of the neighbouring pages, lets the atlas be filtered bilinearly without bleeding
+		const uint32_t VIRTUAL_TEXTURE_TILE_BORDER = 4u;
+
+		//Page coordinates take 12 bits in the feedback, see VirtualTextureSystem
+		const uint32_t VIRTUAL_TEXTURE_MAX_PAGES_PER_SIDE = 512u;
+
+		//Pages of one mip, tiles are stored row by row
+		struct VirtualTextureFileMip
+		{
+			uint32_t pageCount;
+			uint32_t firstTile;
+			uint32_t padding[2];
+		};
+
+		/*
+			Cooked virtual texture file:
+			header | mips | tiles
+			Square, power of two sized texture with 8 bits per channel, cut into pages of VIRTUAL_TEXTURE_TILE_SIZE texels.
+			The mip chain ends at the mip covered by a single page.
+			Every tile holds (tileSize + 2 * tileBorder)^2 texels, so any tile can be read without touching the others.
+			Offsets are relative to the start of the file and aligned to VIRTUAL_TEXTURE_FILE_SECTION_ALIGNMENT.
+		*/
+		struct VirtualTextureFileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+
+			//VkFormat of the texels, VK_FORMAT_R8G8B8A8_UNORM
+			uint32_t format;
+			uint32_t texelSize;
+			uint32_t size;
+			uint32_t tileSize;
+			uint32_t tileBorder;
+			uint32_t mipCount;
+			uint32_t tileCount;
+			uint32_t padding[3];
+
+			uint64_t mipOffset;
+			uint64_t tileOffset;
+		};
+
+		static_assert(sizeof(VirtualTextureFileMip) == 16u, "VirtualTextureFileMip layout changed, bump VIRTUAL_TEXTURE_FILE_VERSION");
+		static_assert(sizeof(VirtualTextureFileHeader) == 64u, "VirtualTextureFileHeader layout changed, bump VIRTUAL_TEXTURE_FILE_VERSION");
+
+		/*
+			Runtime side of the cooked format.
+			The file is memory mapped, tiles are copied out of the mapping by whoever streams them,
+			so reading a tile only touches the pages of the file it lies in.
+		*/
+		class VirtualTextureFile
+		{
+			public:
+				/*
+					@param path of the cooked file
+					@return false if the file is missing, truncated or of another version
+				*/
+				bool Load(const std::string& path);
+				void Release();
+
+				bool IsLoaded() const { return m_Header != nullptr; }
+
+				const VirtualTextureFileHeader& GetHeader() const { return *m_Header; }
+				const VirtualTextureFileMip* GetMips() const { return m_Mips; }
+
+				uint32_t GetPageCount(uint32_t mip) const { return m_Mips[mip].pageCount; }
+				uint32_t GetTileExtent() const { return m_Header->tileSize + 2u * m_Header->tileBorder; }
+				uint64_t GetTileDataSize() const { return static_cast<uint64_t>(GetTileExtent()) * GetTileExtent() * m_Header->texelSize; }
+
+				//Tile rows are tightly packed
+				const uint8_t* GetTileData(uint32_t mip, uint32_t pageX, uint32_t pageY) const;
+
+				/*
+					Cuts RGBA8 texels into tiles, mips are box filtered.
+					@param size of the square texture, a power of two of at least two pages per side
+					@return false if the size is not supported or the file could not be written
+				*/
+				static bool Cook(const std::string& cookedPath, const uint8_t* texels, uint32_t size);
+
+			private:
+				Core::Memory::MappedFile m_File;
+
+				const VirtualTextureFileHeader* m_Header = nullptr;
+				const VirtualTextureFileMip* m_Mips = nullptr;
+				const uint8_t* m_Tiles = nullptr;
+		};
+	}
+}
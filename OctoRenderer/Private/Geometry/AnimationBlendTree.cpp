@@ -0,0 +1,92 @@
+//Geometry Includes
+#include "AnimationBlendTree.h"
+
+//Other
+#include <cassert>
+#include <cmath>
+
+uint32_t AnimationBlendTree::AddClip(const AnimationClip& clip, float speed)
+{
+	AnimationBlendNode node;
+	node.type = AnimationBlendNodeType::kClip;
+	node.weight = 1.0f;
+	node.speed = speed;
+	node.cursor.Reset(clip);
+
+	m_Nodes.push_back(std::move(node));
+	return static_cast<uint32_t>(m_Nodes.size() - 1u);
+}
+
+uint32_t AnimationBlendTree::AddLerp(uint32_t first, uint32_t second, float weight)
+{
+	assert(first < m_Nodes.size() && second < m_Nodes.size());
+
+	AnimationBlendNode node;
+	node.type = AnimationBlendNodeType::kLerp;
+	node.weight = weight;
+	node.children[0] = first;
+	node.children[1] = second;
+
+	m_Nodes.push_back(std::move(node));
+	return static_cast<uint32_t>(m_Nodes.size() - 1u);
+}
+
+uint32_t AnimationBlendTree::AddLayer(uint32_t base, uint32_t layer, float weight, const std::vector<float>& jointMask)
+{
+	assert(base < m_Nodes.size() && layer < m_Nodes.size());
+
+	AnimationBlendNode node;
+	node.type = AnimationBlendNodeType::kLayer;
+	node.weight = weight;
+	node.children[0] = base;
+	node.children[1] = layer;
+	node.jointMask = jointMask;
+	node.jointMask.resize((jointMask.size() + 3u) & ~size_t(3u), 0.0f);
+
+	m_Nodes.push_back(std::move(node));
+	return static_cast<uint32_t>(m_Nodes.size() - 1u);
+}
+
+void AnimationBlendTree::Evaluate(float time, SkeletonPose& pose)
+{
+	assert(!m_Nodes.empty());
+
+	m_NodePoses.resize(m_Nodes.size());
+	EvaluateNode(static_cast<uint32_t>(m_Nodes.size() - 1u), time, pose);
+}
+
+void AnimationBlendTree::EvaluateNode(uint32_t nodeIdx, float time, SkeletonPose& pose)
+{
+	AnimationBlendNode& node = m_Nodes[nodeIdx];
+
+	if (node.type == AnimationBlendNodeType::kClip)
+	{
+		const float duration = node.cursor.clip->GetDuration();
+		const float clipTime = duration > 0.0f ? std::fmod(time * node.speed, duration) : 0.0f;
+		AnimationSampler::Sample(node.cursor, clipTime < 0.0f ? clipTime + duration : clipTime, pose);
+		return;
+	}
+
+	//Layers with a partial mask always blend, the base is still needed for the masked out joints
+	const bool fullWeight = node.weight >= 1.0f && node.type == AnimationBlendNodeType::kLerp;
+	if (node.weight <= 0.0f || fullWeight)
+	{
+		EvaluateNode(node.children[fullWeight ? 1u : 0u], time, pose);
+		return;
+	}
+
+	SkeletonPose& blended = m_NodePoses[nodeIdx];
+	EvaluateNode(node.children[0], time, pose);
+	EvaluateNode(node.children[1], time, blended);
+
+	if (node.type == AnimationBlendNodeType::kLayer)
+	{
+		//Joints past the mask keep the base pose
+		node.jointMask.resize(pose.rotationX.size(), 0.0f);
+		AnimationSampler::Blend(pose, blended, node.weight, node.jointMask.data(), pose);
+	}
+	else
+	{
+		AnimationSampler::Blend(pose, blended, node.weight, nullptr, pose);
+	}
+}
@@ -0,0 +1,191 @@
+//Geometry Includes
+#include "AnimationClip.h"
+
+//Other
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float QUAT_COMPONENT_RANGE = 0.70710678f;
+	const float QUAT_COMPONENT_SCALE = 32767.0f;
+
+	//Same interpolation as the sampler, so the error is measured on what gets played back
+	glm::quat Nlerp(const glm::quat& a, const glm::quat& b, float alpha)
+	{
+		const float sign = glm::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+		return glm::normalize(glm::quat(
+			a.w + (b.w * sign - a.w) * alpha,
+			a.x + (b.x * sign - a.x) * alpha,
+			a.y + (b.y * sign - a.y) * alpha,
+			a.z + (b.z * sign - a.z) * alpha));
+	}
+
+	//Chord of the shorter arc, acos of the dot product loses all precision for small angles
+	float AngleBetween(const glm::quat& a, const glm::quat& b)
+	{
+		const glm::quat closest = glm::dot(a, b) < 0.0f ? -b : b;
+		const glm::vec4 chord = glm::vec4(a.x - closest.x, a.y - closest.y, a.z - closest.z, a.w - closest.w);
+		return 4.0f * std::asin(std::min(glm::length(chord) * 0.5f, 1.0f));
+	}
+
+	/*
+		Greedy key reduction, every key is extended as far as the frames in between stay within the error.
+		IsWithinError(firstKey, lastKey, frame) decides if a frame is covered by the keys around it.
+	*/
+	template<typename IsWithinError>
+	void ReduceKeys(uint32_t frameCount, IsWithinError isWithinError, std::vector<uint16_t>& keptFrames)
+	{
+		keptFrames.clear();
+		keptFrames.push_back(0u);
+
+		//Constant tracks keep a single key
+		bool constant = true;
+		for (uint32_t frame = 1u; frame < frameCount && constant; frame++)
+		{
+			constant = isWithinError(0u, 0u, frame);
+		}
+
+		if (constant)
+		{
+			return;
+		}
+
+		uint32_t key = 0u;
+		while (key < frameCount - 1u)
+		{
+			uint32_t nextKey = key + 1u;
+			while (nextKey + 1u < frameCount)
+			{
+				bool covered = true;
+				for (uint32_t frame = key + 1u; frame < nextKey + 1u && covered; frame++)
+				{
+					covered = isWithinError(key, nextKey + 1u, frame);
+				}
+
+				if (!covered)
+				{
+					break;
+				}
+				nextKey++;
+			}
+
+			keptFrames.push_back(static_cast<uint16_t>(nextKey));
+			key = nextKey;
+		}
+	}
+}
+
+PackedQuat AnimationClip::PackQuat(const glm::quat& q)
+{
+	const float components[4] = { q.x, q.y, q.z, q.w };
+
+	uint32_t largest = 0u;
+	for (uint32_t i = 1u; i < 4u; i++)
+	{
+		largest = std::fabs(components[i]) > std::fabs(components[largest]) ? i : largest;
+	}
+
+	//q and -q are the same rotation, the dropped component is always positive
+	const float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+	PackedQuat packed;
+	for (uint32_t i = 0u, value = 0u; i < 4u; i++)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		const float normalized = glm::clamp(components[i] * sign / QUAT_COMPONENT_RANGE * 0.5f + 0.5f, 0.0f, 1.0f);
+		packed.data[value++] = static_cast<uint16_t>(std::lround(normalized * QUAT_COMPONENT_SCALE));
+	}
+
+	packed.data[0] |= static_cast<uint16_t>((largest & 1u) << 15u);
+	packed.data[1] |= static_cast<uint16_t>((largest >> 1u) << 15u);
+	return packed;
+}
+
+glm::quat AnimationClip::UnpackQuat(const PackedQuat& packed)
+{
+	const uint32_t largest = (packed.data[0] >> 15u) | ((packed.data[1] >> 15u) << 1u);
+
+	float components[4];
+	float sumSquared = 0.0f;
+	for (uint32_t i = 0u, value = 0u; i < 4u; i++)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		const float normalized = (packed.data[value++] & 0x7FFFu) / QUAT_COMPONENT_SCALE;
+		components[i] = (normalized * 2.0f - 1.0f) * QUAT_COMPONENT_RANGE;
+		sumSquared += components[i] * components[i];
+	}
+
+	components[largest] = std::sqrt(std::max(1.0f - sumSquared, 0.0f));
+	return glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+}
+
+bool AnimationClipBuilder::Build(const std::vector<JointQuat>& frames, uint32_t jointCount, float frameRate,
+	const AnimationCompressionSettings& settings, AnimationClip& clip)
+{
+	const uint32_t frameCount = jointCount > 0u ? static_cast<uint32_t>(frames.size() / jointCount) : 0u;
+	if (frameCount == 0u || frameCount > 65536u)
+	{
+		return false;
+	}
+
+	clip = AnimationClip();
+	clip.frameRate = frameRate;
+	clip.frameCount = frameCount;
+	clip.tracks.resize(jointCount);
+
+	std::vector<PackedQuat> packedRotations(frameCount);
+	std::vector<glm::quat> quantizedRotations(frameCount);
+	std::vector<uint16_t> keptFrames;
+
+	for (uint32_t jointIdx = 0u; jointIdx < jointCount; jointIdx++)
+	{
+		AnimationTrack& track = clip.tracks[jointIdx];
+		auto frameOf = [&](uint32_t frame) -> const JointQuat& { return frames[frame * jointCount + jointIdx]; };
+
+		//Rotations are compared after quantization, so the kept keys include its error
+		for (uint32_t frame = 0u; frame < frameCount; frame++)
+		{
+			packedRotations[frame] = AnimationClip::PackQuat(glm::normalize(frameOf(frame).q));
+			quantizedRotations[frame] = AnimationClip::UnpackQuat(packedRotations[frame]);
+		}
+
+		ReduceKeys(frameCount, [&](uint32_t firstKey, uint32_t lastKey, uint32_t frame)
+		{
+			const float alpha = lastKey > firstKey ? static_cast<float>(frame - firstKey) / (lastKey - firstKey) : 0.0f;
+			return AngleBetween(Nlerp(quantizedRotations[firstKey], quantizedRotations[lastKey], alpha), frameOf(frame).q) <= settings.rotationError;
+		}, keptFrames);
+
+		track.firstRotationKey = static_cast<uint32_t>(clip.rotations.size());
+		track.rotationKeyCount = static_cast<uint32_t>(keptFrames.size());
+		for (uint16_t frame : keptFrames)
+		{
+			clip.rotationFrames.push_back(frame);
+			clip.rotations.push_back(packedRotations[frame]);
+		}
+
+		ReduceKeys(frameCount, [&](uint32_t firstKey, uint32_t lastKey, uint32_t frame)
+		{
+			const float alpha = lastKey > firstKey ? static_cast<float>(frame - firstKey) / (lastKey - firstKey) : 0.0f;
+			return glm::length(glm::mix(frameOf(firstKey).t, frameOf(lastKey).t, alpha) - frameOf(frame).t) <= settings.translationError;
+		}, keptFrames);
+
+		track.firstTranslationKey = static_cast<uint32_t>(clip.translations.size());
+		track.translationKeyCount = static_cast<uint32_t>(keptFrames.size());
+		for (uint16_t frame : keptFrames)
+		{
+			clip.translationFrames.push_back(frame);
+			clip.translations.push_back(frameOf(frame).t);
+		}
+	}
+
+	return true;
+}
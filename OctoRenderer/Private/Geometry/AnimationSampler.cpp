@@ -0,0 +1,257 @@
+//Geometry Includes
+#include "AnimationSampler.h"
+
+//Other
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCTO_ANIMATION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//Rotation x, y, z, w followed by translation x, y, z
+	const uint32_t POSE_COMPONENT_COUNT = 7u;
+
+	void GetComponents(const SkeletonPose& pose, uint32_t firstJoint, const float* components[POSE_COMPONENT_COUNT])
+	{
+		components[0] = &pose.rotationX[firstJoint];
+		components[1] = &pose.rotationY[firstJoint];
+		components[2] = &pose.rotationZ[firstJoint];
+		components[3] = &pose.rotationW[firstJoint];
+		components[4] = &pose.translationX[firstJoint];
+		components[5] = &pose.translationY[firstJoint];
+		components[6] = &pose.translationZ[firstJoint];
+	}
+
+	void GetComponents(SkeletonPose& pose, uint32_t firstJoint, float* components[POSE_COMPONENT_COUNT])
+	{
+		components[0] = &pose.rotationX[firstJoint];
+		components[1] = &pose.rotationY[firstJoint];
+		components[2] = &pose.rotationZ[firstJoint];
+		components[3] = &pose.rotationW[firstJoint];
+		components[4] = &pose.translationX[firstJoint];
+		components[5] = &pose.translationY[firstJoint];
+		components[6] = &pose.translationZ[firstJoint];
+	}
+
+	//Nlerp of the rotations in the shorter arc and lerp of the translations for four joints
+	void Interpolate4(const float* const a[POSE_COMPONENT_COUNT], const float* const b[POSE_COMPONENT_COUNT],
+		const float* rotationAlpha, const float* translationAlpha, float* const result[POSE_COMPONENT_COUNT])
+	{
+#if defined(OCTO_ANIMATION_SSE2)
+		__m128 ra[4], rb[4];
+		for (uint32_t i = 0u; i < 4u; i++)
+		{
+			ra[i] = _mm_loadu_ps(a[i]);
+			rb[i] = _mm_loadu_ps(b[i]);
+		}
+
+		const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ra[0], rb[0]), _mm_mul_ps(ra[1], rb[1])), _mm_add_ps(_mm_mul_ps(ra[2], rb[2]), _mm_mul_ps(ra[3], rb[3])));
+		const __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+		const __m128 alpha = _mm_loadu_ps(rotationAlpha);
+
+		__m128 r[4];
+		__m128 lengthSquared = _mm_setzero_ps();
+		for (uint32_t i = 0u; i < 4u; i++)
+		{
+			r[i] = _mm_add_ps(ra[i], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(rb[i], flip), ra[i]), alpha));
+			lengthSquared = _mm_add_ps(lengthSquared, _mm_mul_ps(r[i], r[i]));
+		}
+
+		//Both ends are unit length and in the same hemisphere, the length can not get close to zero
+		const __m128 length = _mm_sqrt_ps(lengthSquared);
+		for (uint32_t i = 0u; i < 4u; i++)
+		{
+			_mm_storeu_ps(result[i], _mm_div_ps(r[i], length));
+		}
+
+		const __m128 tAlpha = _mm_loadu_ps(translationAlpha);
+		for (uint32_t i = 4u; i < POSE_COMPONENT_COUNT; i++)
+		{
+			const __m128 ta = _mm_loadu_ps(a[i]);
+			_mm_storeu_ps(result[i], _mm_add_ps(ta, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[i]), ta), tAlpha)));
+		}
+#else
+		for (uint32_t lane = 0u; lane < 4u; lane++)
+		{
+			const float dot = a[0][lane] * b[0][lane] + a[1][lane] * b[1][lane] + a[2][lane] * b[2][lane] + a[3][lane] * b[3][lane];
+			const float sign = dot < 0.0f ? -1.0f : 1.0f;
+
+			float r[4];
+			float lengthSquared = 0.0f;
+			for (uint32_t i = 0u; i < 4u; i++)
+			{
+				r[i] = a[i][lane] + (b[i][lane] * sign - a[i][lane]) * rotationAlpha[lane];
+				lengthSquared += r[i] * r[i];
+			}
+
+			const float length = std::sqrt(lengthSquared);
+			for (uint32_t i = 0u; i < 4u; i++)
+			{
+				result[i][lane] = r[i] / length;
+			}
+
+			for (uint32_t i = 4u; i < POSE_COMPONENT_COUNT; i++)
+			{
+				result[i][lane] = a[i][lane] + (b[i][lane] - a[i][lane]) * translationAlpha[lane];
+			}
+		}
+#endif
+	}
+
+	//Moves the cursor key forward to the last key at or before the frame, returns the interpolation factor to the next key
+	float AdvanceKey(const std::vector<uint16_t>& keyFrames, uint32_t firstKey, uint32_t keyCount, float frame, uint32_t& key, uint32_t& nextKey)
+	{
+		const uint32_t lastKey = firstKey + keyCount - 1u;
+		while (key < lastKey && keyFrames[key + 1u] <= frame)
+		{
+			key++;
+		}
+
+		nextKey = std::min(key + 1u, lastKey);
+		const float keyFrame = keyFrames[key];
+		const float nextKeyFrame = keyFrames[nextKey];
+		return nextKeyFrame > keyFrame ? glm::clamp((frame - keyFrame) / (nextKeyFrame - keyFrame), 0.0f, 1.0f) : 0.0f;
+	}
+}
+
+void AnimationCursor::Reset(const AnimationClip& animationClip)
+{
+	clip = &animationClip;
+	time = 0.0f;
+
+	rotationKeys.resize(animationClip.tracks.size());
+	translationKeys.resize(animationClip.tracks.size());
+	for (size_t trackIdx = 0u; trackIdx < animationClip.tracks.size(); trackIdx++)
+	{
+		rotationKeys[trackIdx] = animationClip.tracks[trackIdx].firstRotationKey;
+		translationKeys[trackIdx] = animationClip.tracks[trackIdx].firstTranslationKey;
+	}
+}
+
+void AnimationSampler::Sample(AnimationCursor& cursor, float time, SkeletonPose& pose)
+{
+	assert(cursor.clip != nullptr);
+	const AnimationClip& clip = *cursor.clip;
+	const uint32_t jointCount = clip.GetJointCount();
+
+	if (pose.GetJointCount() != jointCount)
+	{
+		pose.Resize(jointCount);
+	}
+
+	//Keys only move forward, looping or seeking back starts over
+	if (time < cursor.time)
+	{
+		cursor.Reset(clip);
+	}
+	cursor.time = time;
+
+	const float frame = glm::clamp(time * clip.frameRate, 0.0f, static_cast<float>(clip.frameCount - 1u));
+
+	//Decoded keys of four joints, padding lanes interpolate between identities
+	alignas(16) float keys[2][POSE_COMPONENT_COUNT][4];
+	alignas(16) float rotationAlpha[4];
+	alignas(16) float translationAlpha[4];
+
+	for (uint32_t firstJoint = 0u; firstJoint < jointCount; firstJoint += 4u)
+	{
+		for (uint32_t lane = 0u; lane < 4u; lane++)
+		{
+			const uint32_t jointIdx = firstJoint + lane;
+			if (jointIdx >= jointCount)
+			{
+				for (uint32_t side = 0u; side < 2u; side++)
+				{
+					for (uint32_t i = 0u; i < POSE_COMPONENT_COUNT; i++)
+					{
+						keys[side][i][lane] = i == 3u ? 1.0f : 0.0f;
+					}
+				}
+				rotationAlpha[lane] = translationAlpha[lane] = 0.0f;
+				continue;
+			}
+
+			const AnimationTrack& track = clip.tracks[jointIdx];
+
+			uint32_t nextKey;
+			rotationAlpha[lane] = AdvanceKey(clip.rotationFrames, track.firstRotationKey, track.rotationKeyCount, frame, cursor.rotationKeys[jointIdx], nextKey);
+			const glm::quat rotation = AnimationClip::UnpackQuat(clip.rotations[cursor.rotationKeys[jointIdx]]);
+			const glm::quat nextRotation = AnimationClip::UnpackQuat(clip.rotations[nextKey]);
+
+			translationAlpha[lane] = AdvanceKey(clip.translationFrames, track.firstTranslationKey, track.translationKeyCount, frame, cursor.translationKeys[jointIdx], nextKey);
+			const glm::vec3& translation = clip.translations[cursor.translationKeys[jointIdx]];
+			const glm::vec3& nextTranslation = clip.translations[nextKey];
+
+			const float components[2][POSE_COMPONENT_COUNT] =
+			{
+				{ rotation.x, rotation.y, rotation.z, rotation.w, translation.x, translation.y, translation.z },
+				{ nextRotation.x, nextRotation.y, nextRotation.z, nextRotation.w, nextTranslation.x, nextTranslation.y, nextTranslation.z }
+			};
+
+			for (uint32_t side = 0u; side < 2u; side++)
+			{
+				for (uint32_t i = 0u; i < POSE_COMPONENT_COUNT; i++)
+				{
+					keys[side][i][lane] = components[side][i];
+				}
+			}
+		}
+
+		const float* a[POSE_COMPONENT_COUNT];
+		const float* b[POSE_COMPONENT_COUNT];
+		for (uint32_t i = 0u; i < POSE_COMPONENT_COUNT; i++)
+		{
+			a[i] = keys[0][i];
+			b[i] = keys[1][i];
+		}
+
+		float* result[POSE_COMPONENT_COUNT];
+		GetComponents(pose, firstJoint, result);
+		Interpolate4(a, b, rotationAlpha, translationAlpha, result);
+	}
+}
+
+void AnimationSampler::SampleBatch(const AnimationSampleJob* jobs, uint32_t jobCount)
+{
+	for (uint32_t jobIdx = 0u; jobIdx < jobCount; jobIdx++)
+	{
+		Sample(*jobs[jobIdx].cursor, jobs[jobIdx].time, *jobs[jobIdx].pose);
+	}
+}
+
+void AnimationSampler::Blend(const SkeletonPose& a, const SkeletonPose& b, float weight, const float* jointWeights, SkeletonPose& result)
+{
+	assert(a.GetJointCount() == b.GetJointCount());
+
+	if (result.GetJointCount() != a.GetJointCount())
+	{
+		result.Resize(a.GetJointCount());
+	}
+
+	alignas(16) float alpha[4] = { weight, weight, weight, weight };
+
+	//Poses are padded to four joints, so whole groups can be read
+	for (uint32_t firstJoint = 0u; firstJoint < a.GetJointCount(); firstJoint += 4u)
+	{
+		if (jointWeights != nullptr)
+		{
+			for (uint32_t lane = 0u; lane < 4u; lane++)
+			{
+				alpha[lane] = weight * jointWeights[firstJoint + lane];
+			}
+		}
+
+		const float* aComponents[POSE_COMPONENT_COUNT];
+		const float* bComponents[POSE_COMPONENT_COUNT];
+		float* resultComponents[POSE_COMPONENT_COUNT];
+		GetComponents(a, firstJoint, aComponents);
+		GetComponents(b, firstJoint, bComponents);
+		GetComponents(result, firstJoint, resultComponents);
+		Interpolate4(aComponents, bComponents, alpha, alpha, resultComponents);
+	}
+}
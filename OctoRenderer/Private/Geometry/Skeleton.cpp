@@ -0,0 +1,221 @@
+//Geometry Includes
+#include "Skeleton.h"
+
+//Other
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCTO_SKELETON_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//Affine 3x4 product, the fourth row of both is (0, 0, 0, 1)
+	void ConcatenateJoints(const JointMat& a, const JointMat& b, JointMat& result)
+	{
+#if defined(OCTO_SKELETON_SSE2)
+		const __m128 bRow0 = _mm_loadu_ps(b.mat[0]);
+		const __m128 bRow1 = _mm_loadu_ps(b.mat[1]);
+		const __m128 bRow2 = _mm_loadu_ps(b.mat[2]);
+
+		for (uint32_t row = 0u; row < 3u; row++)
+		{
+			__m128 resultRow = _mm_set_ps(a.mat[row][3], 0.0f, 0.0f, 0.0f);
+			resultRow = _mm_add_ps(resultRow, _mm_mul_ps(_mm_set1_ps(a.mat[row][0]), bRow0));
+			resultRow = _mm_add_ps(resultRow, _mm_mul_ps(_mm_set1_ps(a.mat[row][1]), bRow1));
+			resultRow = _mm_add_ps(resultRow, _mm_mul_ps(_mm_set1_ps(a.mat[row][2]), bRow2));
+			_mm_storeu_ps(result.mat[row], resultRow);
+		}
+#else
+		for (uint32_t row = 0u; row < 3u; row++)
+		{
+			for (uint32_t column = 0u; column < 4u; column++)
+			{
+				result.mat[row][column] = a.mat[row][0] * b.mat[0][column] + a.mat[row][1] * b.mat[1][column] + a.mat[row][2] * b.mat[2][column];
+			}
+			result.mat[row][3] += a.mat[row][3];
+		}
+#endif
+	}
+
+	//Rotation part has to be orthonormal
+	glm::vec4 RotationToQuat(const JointMat& m)
+	{
+		const float trace = m.mat[0][0] + m.mat[1][1] + m.mat[2][2];
+		if (trace > 0.0f)
+		{
+			const float s = std::sqrt(trace + 1.0f) * 2.0f;
+			return glm::vec4(m.mat[2][1] - m.mat[1][2], m.mat[0][2] - m.mat[2][0], m.mat[1][0] - m.mat[0][1], s * s * 0.25f) / s;
+		}
+
+		if (m.mat[0][0] > m.mat[1][1] && m.mat[0][0] > m.mat[2][2])
+		{
+			const float s = std::sqrt(1.0f + m.mat[0][0] - m.mat[1][1] - m.mat[2][2]) * 2.0f;
+			return glm::vec4(s * s * 0.25f, m.mat[0][1] + m.mat[1][0], m.mat[0][2] + m.mat[2][0], m.mat[2][1] - m.mat[1][2]) / s;
+		}
+
+		if (m.mat[1][1] > m.mat[2][2])
+		{
+			const float s = std::sqrt(1.0f + m.mat[1][1] - m.mat[0][0] - m.mat[2][2]) * 2.0f;
+			return glm::vec4(m.mat[0][1] + m.mat[1][0], s * s * 0.25f, m.mat[1][2] + m.mat[2][1], m.mat[0][2] - m.mat[2][0]) / s;
+		}
+
+		const float s = std::sqrt(1.0f + m.mat[2][2] - m.mat[0][0] - m.mat[1][1]) * 2.0f;
+		return glm::vec4(m.mat[0][2] + m.mat[2][0], m.mat[1][2] + m.mat[2][1], s * s * 0.25f, m.mat[1][0] - m.mat[0][1]) / s;
+	}
+
+	void QuatToJoint(float x, float y, float z, float w, float tx, float ty, float tz, JointMat& joint)
+	{
+		joint.mat[0][0] = 1.0f - 2.0f * (y * y + z * z);
+		joint.mat[0][1] = 2.0f * (x * y - w * z);
+		joint.mat[0][2] = 2.0f * (x * z + w * y);
+		joint.mat[0][3] = tx;
+		joint.mat[1][0] = 2.0f * (x * y + w * z);
+		joint.mat[1][1] = 1.0f - 2.0f * (x * x + z * z);
+		joint.mat[1][2] = 2.0f * (y * z - w * x);
+		joint.mat[1][3] = ty;
+		joint.mat[2][0] = 2.0f * (x * z - w * y);
+		joint.mat[2][1] = 2.0f * (y * z + w * x);
+		joint.mat[2][2] = 1.0f - 2.0f * (x * x + y * y);
+		joint.mat[2][3] = tz;
+	}
+
+#if defined(OCTO_SKELETON_SSE2)
+	//Same as QuatToJoint for four joints, the matrix elements are transposed into rows at the end
+	void QuatToJoint4(const SkeletonPose& pose, uint32_t firstJoint, JointMat* joints)
+	{
+		const __m128 x = _mm_loadu_ps(&pose.rotationX[firstJoint]);
+		const __m128 y = _mm_loadu_ps(&pose.rotationY[firstJoint]);
+		const __m128 z = _mm_loadu_ps(&pose.rotationZ[firstJoint]);
+		const __m128 w = _mm_loadu_ps(&pose.rotationW[firstJoint]);
+
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 rows[3][4] =
+		{
+			{ _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), _mm_mul_ps(two, _mm_sub_ps(xy, wz)), _mm_mul_ps(two, _mm_add_ps(xz, wy)), _mm_loadu_ps(&pose.translationX[firstJoint]) },
+			{ _mm_mul_ps(two, _mm_add_ps(xy, wz)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), _mm_mul_ps(two, _mm_sub_ps(yz, wx)), _mm_loadu_ps(&pose.translationY[firstJoint]) },
+			{ _mm_mul_ps(two, _mm_sub_ps(xz, wy)), _mm_mul_ps(two, _mm_add_ps(yz, wx)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), _mm_loadu_ps(&pose.translationZ[firstJoint]) }
+		};
+
+		for (uint32_t row = 0u; row < 3u; row++)
+		{
+			_MM_TRANSPOSE4_PS(rows[row][0], rows[row][1], rows[row][2], rows[row][3]);
+			_mm_storeu_ps(joints[0].mat[row], rows[row][0]);
+			_mm_storeu_ps(joints[1].mat[row], rows[row][1]);
+			_mm_storeu_ps(joints[2].mat[row], rows[row][2]);
+			_mm_storeu_ps(joints[3].mat[row], rows[row][3]);
+		}
+	}
+#endif
+}
+
+void SkeletonPose::Resize(uint32_t count)
+{
+	//Padding joints stay at identity
+	const uint32_t paddedCount = (count + 3u) & ~3u;
+	jointCount = count;
+
+	for (std::vector<float>* component : { &rotationX, &rotationY, &rotationZ, &translationX, &translationY, &translationZ })
+	{
+		component->assign(paddedCount, 0.0f);
+	}
+	rotationW.assign(paddedCount, 1.0f);
+}
+
+void SkeletonPose::SetJoint(uint32_t jointIdx, const JointQuat& joint)
+{
+	assert(jointIdx < jointCount);
+
+	rotationX[jointIdx] = joint.q.x;
+	rotationY[jointIdx] = joint.q.y;
+	rotationZ[jointIdx] = joint.q.z;
+	rotationW[jointIdx] = joint.q.w;
+	translationX[jointIdx] = joint.t.x;
+	translationY[jointIdx] = joint.t.y;
+	translationZ[jointIdx] = joint.t.z;
+}
+
+JointQuat SkeletonPose::GetJoint(uint32_t jointIdx) const
+{
+	assert(jointIdx < jointCount);
+
+	JointQuat joint;
+	joint.q = glm::quat(rotationW[jointIdx], rotationX[jointIdx], rotationY[jointIdx], rotationZ[jointIdx]);
+	joint.t = glm::vec3(translationX[jointIdx], translationY[jointIdx], translationZ[jointIdx]);
+	return joint;
+}
+
+void SkeletonEvaluator::LocalToModel(const Skeleton& skeleton, const SkeletonPose& pose, std::vector<JointMat>& modelPose)
+{
+	const uint32_t jointCount = skeleton.GetJointCount();
+	assert(pose.GetJointCount() == jointCount);
+
+	//Local transforms first, the padding of the pose is converted along and dropped at the end
+	modelPose.resize(pose.rotationX.size());
+
+	uint32_t jointIdx = 0u;
+#if defined(OCTO_SKELETON_SSE2)
+	for (; jointIdx + 4u <= modelPose.size(); jointIdx += 4u)
+	{
+		QuatToJoint4(pose, jointIdx, &modelPose[jointIdx]);
+	}
+#endif
+	for (; jointIdx < modelPose.size(); jointIdx++)
+	{
+		QuatToJoint(pose.rotationX[jointIdx], pose.rotationY[jointIdx], pose.rotationZ[jointIdx], pose.rotationW[jointIdx],
+			pose.translationX[jointIdx], pose.translationY[jointIdx], pose.translationZ[jointIdx], modelPose[jointIdx]);
+	}
+
+	modelPose.resize(jointCount);
+
+	//Parents are final before their children are reached
+	for (jointIdx = 0u; jointIdx < jointCount; jointIdx++)
+	{
+		const int32_t parentIdx = skeleton.parents[jointIdx];
+		assert(parentIdx < static_cast<int32_t>(jointIdx));
+
+		if (parentIdx >= 0)
+		{
+			const JointMat local = modelPose[jointIdx];
+			ConcatenateJoints(modelPose[parentIdx], local, modelPose[jointIdx]);
+		}
+	}
+}
+
+void SkeletonEvaluator::BuildLinearBlendPalette(const Skeleton& skeleton, const std::vector<JointMat>& modelPose, std::vector<JointMat>& palette)
+{
+	const uint32_t jointCount = skeleton.GetJointCount();
+	palette.resize(jointCount);
+
+	for (uint32_t jointIdx = 0u; jointIdx < jointCount; jointIdx++)
+	{
+		ConcatenateJoints(modelPose[jointIdx], skeleton.inverseBindPose[jointIdx], palette[jointIdx]);
+	}
+}
+
+void SkeletonEvaluator::BuildDualQuatPalette(const Skeleton& skeleton, const std::vector<JointMat>& modelPose, std::vector<JointDualQuat>& palette)
+{
+	const uint32_t jointCount = skeleton.GetJointCount();
+	palette.resize(jointCount);
+
+	for (uint32_t jointIdx = 0u; jointIdx < jointCount; jointIdx++)
+	{
+		JointMat skinning;
+		ConcatenateJoints(modelPose[jointIdx], skeleton.inverseBindPose[jointIdx], skinning);
+
+		//Dual part is half the translation times the rotation
+		const glm::vec4 real = glm::normalize(RotationToQuat(skinning));
+		const glm::vec3 t = glm::vec3(skinning.mat[0][3], skinning.mat[1][3], skinning.mat[2][3]);
+		const glm::vec3 rv = glm::vec3(real);
+
+		palette[jointIdx].real = real;
+		palette[jointIdx].dual = glm::vec4(t * real.w + glm::cross(t, rv), -glm::dot(t, rv)) * 0.5f;
+	}
+}
@@ -0,0 +1,540 @@
+#include "OctoRenderGraph.h"
+#include "Vulkan\VkRenderPassManager.h"
+#include "Vulkan\VkImageManager.h"
+#include "Vulkan\VkRenderSystem.h"
+#include "Vulkan\VulkanTools.h"
+
+//Other
+#include <algorithm>
+#include <unordered_set>
+
+namespace
+{
+	VkPipelineStageFlags GetStageFlags(uint32_t access, VkPipelineStageFlags shaderStages)
+	{
+		VkPipelineStageFlags stages = 0u;
+
+		if (access & Renderer::RenderGraphAccess::kColorAttachment)
+			stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		if (access & Renderer::RenderGraphAccess::kDepthAttachment)
+			stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		if (access & (Renderer::RenderGraphAccess::kSampled | Renderer::RenderGraphAccess::kStorageRead |
+			Renderer::RenderGraphAccess::kStorageWrite | Renderer::RenderGraphAccess::kUniformRead))
+			stages |= shaderStages;
+		if (access & Renderer::RenderGraphAccess::kIndirectRead)
+			stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+		if (access & Renderer::RenderGraphAccess::kVertexRead)
+			stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		if (access & (Renderer::RenderGraphAccess::kTransferRead | Renderer::RenderGraphAccess::kTransferWrite))
+			stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		return stages;
+	}
+
+	VkAccessFlags GetAccessFlags(uint32_t access)
+	{
+		VkAccessFlags accessFlags = 0u;
+
+		if (access & Renderer::RenderGraphAccess::kColorAttachment)
+			accessFlags |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		if (access & Renderer::RenderGraphAccess::kDepthAttachment)
+			accessFlags |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		if (access & (Renderer::RenderGraphAccess::kSampled | Renderer::RenderGraphAccess::kStorageRead))
+			accessFlags |= VK_ACCESS_SHADER_READ_BIT;
+		if (access & Renderer::RenderGraphAccess::kStorageWrite)
+			accessFlags |= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		if (access & Renderer::RenderGraphAccess::kUniformRead)
+			accessFlags |= VK_ACCESS_UNIFORM_READ_BIT;
+		if (access & Renderer::RenderGraphAccess::kIndirectRead)
+			accessFlags |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		if (access & Renderer::RenderGraphAccess::kVertexRead)
+			accessFlags |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		if (access & Renderer::RenderGraphAccess::kTransferRead)
+			accessFlags |= VK_ACCESS_TRANSFER_READ_BIT;
+		if (access & Renderer::RenderGraphAccess::kTransferWrite)
+			accessFlags |= VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		return accessFlags;
+	}
+
+	VkImageLayout GetImageLayout(uint32_t access)
+	{
+		//Storage and mixed accesses have to share the general layout
+		if (access & (Renderer::RenderGraphAccess::kStorageRead | Renderer::RenderGraphAccess::kStorageWrite))
+			return VK_IMAGE_LAYOUT_GENERAL;
+
+		switch (access)
+		{
+			case Renderer::RenderGraphAccess::kColorAttachment:
+				return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			case Renderer::RenderGraphAccess::kDepthAttachment:
+				return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			case Renderer::RenderGraphAccess::kSampled:
+				return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			case Renderer::RenderGraphAccess::kTransferRead:
+				return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			case Renderer::RenderGraphAccess::kTransferWrite:
+				return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			default:
+				return VK_IMAGE_LAYOUT_GENERAL;
+		}
+	}
+
+	bool IsWrite(uint32_t access)
+	{
+		return (access & Renderer::RenderGraphAccess::kWriteMask) > 0u;
+	}
+
+	//Cleared attachments are the only accesses that do not depend on previous contents
+	bool NeedsContents(const Renderer::RenderGraphResourceUsage& usage)
+	{
+		return !(usage.clear && (usage.access & Renderer::RenderGraphAccess::kAttachmentMask) > 0u);
+	}
+}
+
+namespace Renderer
+{
+	std::vector<RenderGraphPass> RenderGraph::m_Passes;
+	std::vector<uint64_t> RenderGraph::m_Outputs;
+	std::unordered_map<uint64_t, RenderGraph::ResourceState> RenderGraph::m_ResourceStates;
+	std::unordered_map<uint64_t, RenderGraph::ResourceLifetime> RenderGraph::m_ImageLifetimes;
+	std::unordered_map<uint64_t, std::vector<uint64_t>> RenderGraph::m_ImageAliases;
+
+	uint32_t RenderGraph::AddPass(const std::string& name, std::function<void(float)> execute, const DOD::Ref& renderPassRef)
+	{
+		RenderGraphPass pass;
+		pass.name = name;
+		pass.execute = std::move(execute);
+		pass.renderPassRef = renderPassRef;
+
+		m_Passes.push_back(std::move(pass));
+		return static_cast<uint32_t>(m_Passes.size() - 1u);
+	}
+
+	void RenderGraph::AddImageUsage(uint32_t passIdx, const std::vector<DOD::Ref>& imageRefs, uint32_t access,
+		VkPipelineStageFlags shaderStages, VkImageLayout layout, bool clear)
+	{
+		assert(!imageRefs.empty());
+
+		RenderGraphResourceUsage usage;
+		usage.type = RenderGraphResourceType::kImage;
+		usage.access = access;
+		usage.refs = imageRefs;
+		usage.shaderStages = shaderStages;
+		usage.layout = layout != VK_IMAGE_LAYOUT_UNDEFINED ? layout : GetImageLayout(access);
+		usage.clear = clear;
+
+		m_Passes[passIdx].usages.push_back(std::move(usage));
+	}
+
+	void RenderGraph::AddBufferUsage(uint32_t passIdx, const std::vector<DOD::Ref>& bufferRefs, uint32_t access, VkPipelineStageFlags shaderStages)
+	{
+		assert(!bufferRefs.empty());
+
+		RenderGraphResourceUsage usage;
+		usage.type = RenderGraphResourceType::kBuffer;
+		usage.access = access;
+		usage.refs = bufferRefs;
+		usage.shaderStages = shaderStages;
+		usage.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		usage.clear = false;
+
+		m_Passes[passIdx].usages.push_back(std::move(usage));
+	}
+
+	void RenderGraph::MarkOutput(const std::vector<DOD::Ref>& imageRefs)
+	{
+		for (const auto& ref : imageRefs)
+		{
+			m_Outputs.push_back(GetResourceKey(RenderGraphResourceType::kImage, ref));
+		}
+	}
+
+	void RenderGraph::MarkPassSideEffects(uint32_t passIdx)
+	{
+		m_Passes[passIdx].hasSideEffects = true;
+	}
+
+	void RenderGraph::Compile()
+	{
+		const std::unordered_set<uint64_t> outputs(m_Outputs.begin(), m_Outputs.end());
+
+		//Walk backwards and keep passes whose writes are consumed later on
+		std::unordered_set<uint64_t> neededResources = outputs;
+
+		for (int32_t passIdx = static_cast<int32_t>(m_Passes.size()) - 1; passIdx >= 0; passIdx--)
+		{
+			RenderGraphPass& pass = m_Passes[passIdx];
+			pass.culled = !pass.hasSideEffects;
+
+			for (const auto& usage : pass.usages)
+			{
+				if (!IsWrite(usage.access))
+					continue;
+
+				for (const auto& ref : usage.refs)
+				{
+					if (neededResources.count(GetResourceKey(usage.type, ref)) > 0u)
+						pass.culled = false;
+				}
+			}
+
+			if (pass.culled)
+				continue;
+
+			for (const auto& usage : pass.usages)
+			{
+				for (const auto& ref : usage.refs)
+				{
+					const uint64_t key = GetResourceKey(usage.type, ref);
+
+					if (NeedsContents(usage))
+						neededResources.insert(key);
+					else if (outputs.count(key) == 0u)
+						neededResources.erase(key);
+				}
+			}
+		}
+
+		//Lifetimes of the images touched by the remaining passes
+		m_ImageLifetimes.clear();
+		for (uint32_t passIdx = 0u; passIdx < m_Passes.size(); passIdx++)
+		{
+			const RenderGraphPass& pass = m_Passes[passIdx];
+			if (pass.culled)
+				continue;
+
+			for (const auto& usage : pass.usages)
+			{
+				if (usage.type != RenderGraphResourceType::kImage)
+					continue;
+
+				for (const auto& ref : usage.refs)
+				{
+					const uint64_t key = GetResourceKey(usage.type, ref);
+					auto lifetimeIt = m_ImageLifetimes.find(key);
+
+					if (lifetimeIt == m_ImageLifetimes.end())
+					{
+						ResourceLifetime lifetime = { passIdx, passIdx, outputs.count(key) == 0u && !NeedsContents(usage), usage.access };
+						m_ImageLifetimes[key] = lifetime;
+					}
+					else
+					{
+						lifetimeIt->second.lastPass = passIdx;
+						lifetimeIt->second.access |= usage.access;
+					}
+				}
+			}
+		}
+
+		std::vector<DOD::Ref> patchedRenderPasses;
+		for (uint32_t passIdx = 0u; passIdx < m_Passes.size(); passIdx++)
+		{
+			const RenderGraphPass& pass = m_Passes[passIdx];
+			if (pass.culled || !pass.renderPassRef.isValid())
+				continue;
+
+			PatchRenderPass(pass, passIdx);
+			patchedRenderPasses.push_back(pass.renderPassRef);
+		}
+
+		//Only load/store ops and layouts change, pipelines and frame buffers stay compatible
+		if (!patchedRenderPasses.empty())
+		{
+			Renderer::Resource::RenderPassManager::DestroyResources(patchedRenderPasses);
+			Renderer::Resource::RenderPassManager::CreateResource(patchedRenderPasses);
+		}
+
+		AliasResolutionDependentImages();
+	}
+
+	void RenderGraph::PatchRenderPass(const RenderGraphPass& pass, uint32_t passIdx)
+	{
+		auto& attachments = Renderer::Resource::RenderPassManager::GetAttachementDescription(pass.renderPassRef);
+
+		uint32_t attachmentIdx = 0u;
+		for (const auto& usage : pass.usages)
+		{
+			if ((usage.access & RenderGraphAccess::kAttachmentMask) == 0u)
+				continue;
+
+			assert(attachmentIdx < attachments.size() && "Attachment usages have to match the render pass");
+			AttachementDescription& attachment = attachments[attachmentIdx++];
+
+			const uint64_t key = GetResourceKey(usage.type, usage.refs[0]);
+			const ResourceLifetime& lifetime = m_ImageLifetimes[key];
+			const bool isOutput = std::find(m_Outputs.begin(), m_Outputs.end(), key) != m_Outputs.end();
+
+			//Contents are needed from earlier passes or from the previous frame
+			const bool load = NeedsContents(usage) && (lifetime.firstPass < passIdx || isOutput);
+
+			//Contents are needed by later passes or next frame
+			bool store = isOutput || lifetime.lastPass > passIdx;
+
+			attachment.flags &= AttachementFlags::kClearStencilOnLoad;
+			if (usage.clear)
+				attachment.flags |= AttachementFlags::kClearOnLoad;
+			else if (load)
+				attachment.flags |= AttachementFlags::kLoadOnLoad;
+
+			if (!store)
+				attachment.flags |= AttachementFlags::kDiscardOnStore;
+
+			//The graph transitions images itself, render passes keep them in attachment layout
+			attachment.initialLayout = usage.layout;
+			attachment.finalLayout = usage.layout;
+		}
+	}
+
+	void RenderGraph::Execute(float dt)
+	{
+		for (uint32_t passIdx = 0u; passIdx < m_Passes.size(); passIdx++)
+		{
+			const RenderGraphPass& pass = m_Passes[passIdx];
+			if (pass.culled)
+				continue;
+
+			InsertBarriers(pass, passIdx);
+			pass.execute(dt);
+		}
+	}
+
+	void RenderGraph::AliasResolutionDependentImages()
+	{
+		for (const auto& ref : Renderer::Resource::ImageManager::activeRefs)
+		{
+			if (!Renderer::Resource::ImageManager::IsResolutionDependent(ref))
+				continue;
+
+			auto lifetimeIt = m_ImageLifetimes.find(GetResourceKey(RenderGraphResourceType::kImage, ref));
+			const bool transient = lifetimeIt != m_ImageLifetimes.end() && lifetimeIt->second.transient;
+
+			Renderer::Resource::ImageManager::GetAliasingLifetime(ref) = transient
+				? glm::uvec2(lifetimeIt->second.firstPass, lifetimeIt->second.lastPass)
+				: Renderer::ALIASING_LIFETIME_FRAME;
+
+			//Attachments nobody reads outside of the render pass can stay in tile memory
+			if (transient && (lifetimeIt->second.access & ~RenderGraphAccess::kAttachmentMask) == 0u)
+			{
+				uint8_t& imageFlags = Renderer::Resource::ImageManager::GetImageFlags(ref);
+				imageFlags = (imageFlags & ~(ImageFlags::kUsageSampled | ImageFlags::kUsageStorage)) | ImageFlags::kUsageTransient;
+			}
+		}
+
+		//Passes leave their resolution dependent images to the first compile, so they are created once with their lifetimes.
+		//Compiling again replaces images the frames in flight may still use
+		bool imagesCreated = false;
+		for (const auto& ref : Renderer::Resource::ImageManager::activeRefs)
+		{
+			if (Renderer::Resource::ImageManager::IsResolutionDependent(ref) && Renderer::Resource::ImageManager::GetVkImage(ref) != VK_NULL_HANDLE)
+				imagesCreated = true;
+		}
+
+		if (imagesCreated)
+			VK_CHECK_RESULT(vkDeviceWaitIdle(Renderer::Vulkan::RenderSystem::vkDevice));
+
+		Renderer::Vulkan::RenderSystem::RecreateResolutionDependentResources();
+
+		CollectImageAliases();
+	}
+
+	void RenderGraph::CollectImageAliases()
+	{
+		m_ImageAliases.clear();
+
+		std::vector<DOD::Ref> imageRefs;
+		for (const auto& ref : Renderer::Resource::ImageManager::activeRefs)
+		{
+			if (Renderer::Resource::ImageManager::IsResolutionDependent(ref))
+				imageRefs.push_back(ref);
+		}
+
+		//Transient images ending up in the same memory have to be synchronized against each other
+		for (uint32_t i = 0u; i < imageRefs.size(); i++)
+		{
+			const MemoryPoolTypes::GpuMemoryAllocationInfo& lhs = Renderer::Resource::ImageManager::GetMemoryAllocationInfo(imageRefs[i]);
+
+			for (uint32_t j = i + 1u; j < imageRefs.size(); j++)
+			{
+				const MemoryPoolTypes::GpuMemoryAllocationInfo& rhs = Renderer::Resource::ImageManager::GetMemoryAllocationInfo(imageRefs[j]);
+
+				if (lhs._vkDeviceMemory != rhs._vkDeviceMemory || lhs._offset >= rhs._offset + rhs._sizeInBytes || rhs._offset >= lhs._offset + lhs._sizeInBytes)
+					continue;
+
+				const uint64_t lhsKey = GetResourceKey(RenderGraphResourceType::kImage, imageRefs[i]);
+				const uint64_t rhsKey = GetResourceKey(RenderGraphResourceType::kImage, imageRefs[j]);
+
+				m_ImageAliases[lhsKey].push_back(rhsKey);
+				m_ImageAliases[rhsKey].push_back(lhsKey);
+			}
+		}
+	}
+
+	void RenderGraph::Resize()
+	{
+		//Recreated images start out undefined, the device is idle so nothing else has to be waited on
+		for (const auto& ref : Renderer::Resource::ImageManager::activeRefs)
+		{
+			if (Renderer::Resource::ImageManager::IsResolutionDependent(ref))
+				m_ResourceStates.erase(GetResourceKey(RenderGraphResourceType::kImage, ref));
+		}
+
+		CollectImageAliases();
+	}
+
+	void RenderGraph::InsertBarriers(const RenderGraphPass& pass, uint32_t passIdx)
+	{
+		const uint32_t backBufferIndex = Renderer::Vulkan::RenderSystem::backBufferIndex;
+
+		VkPipelineStageFlags srcStages = 0u;
+		VkPipelineStageFlags dstStages = 0u;
+		VkAccessFlags memorySrcAccess = 0u;
+		VkAccessFlags memoryDstAccess = 0u;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+
+		for (const auto& usage : pass.usages)
+		{
+			const DOD::Ref& ref = usage.GetRef(backBufferIndex);
+			const uint64_t key = GetResourceKey(usage.type, ref);
+			ResourceState& state = m_ResourceStates[key];
+
+			//Another image might have used the memory since, contents and layout are gone
+			VkPipelineStageFlags aliasStages = 0u;
+			VkAccessFlags aliasAccess = 0u;
+
+			auto aliasesIt = m_ImageAliases.find(key);
+			if (aliasesIt != m_ImageAliases.end() && m_ImageLifetimes[key].firstPass == passIdx)
+			{
+				for (const uint64_t aliasKey : aliasesIt->second)
+				{
+					const ResourceState& aliasState = m_ResourceStates[aliasKey];
+					aliasStages |= aliasState.readStages | aliasState.writeStages;
+					aliasAccess |= aliasState.writeAccess;
+				}
+
+				state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			}
+
+			const VkPipelineStageFlags stages = GetStageFlags(usage.access, usage.shaderStages);
+			const VkAccessFlags access = GetAccessFlags(usage.access);
+			const bool isWrite = IsWrite(usage.access);
+			const bool layoutChange = usage.type == RenderGraphResourceType::kImage && state.layout != usage.layout;
+
+			VkPipelineStageFlags waitStages = 0u;
+			VkAccessFlags waitAccess = 0u;
+
+			if (isWrite || layoutChange)
+			{
+				//Writes and transitions wait on every access since the last write
+				waitStages = state.readStages | state.writeStages | aliasStages;
+				waitAccess = state.writeAccess | aliasAccess;
+			}
+			else if (state.writeStages != 0u && ((stages & ~state.visibleStages) != 0u || (access & ~state.visibleAccess) != 0u))
+			{
+				//Reads only wait if the last write is not visible to them yet
+				waitStages = state.writeStages;
+				waitAccess = state.writeAccess;
+			}
+
+			if (layoutChange)
+			{
+				VkImageMemoryBarrier imageBarrier = VkTools::Initializer::ImageMemoryBarrier();
+				imageBarrier.srcAccessMask = waitAccess;
+				imageBarrier.dstAccessMask = access;
+				imageBarrier.oldLayout = NeedsContents(usage) ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+				imageBarrier.newLayout = usage.layout;
+				imageBarrier.image = Renderer::Resource::ImageManager::GetVkImage(ref);
+				imageBarrier.subresourceRange.aspectMask = Renderer::Resource::ImageManager::GetImageAspectFlags(ref);
+				imageBarrier.subresourceRange.baseMipLevel = 0u;
+				imageBarrier.subresourceRange.levelCount = Renderer::Resource::ImageManager::GetMipLevelCount(ref);
+				imageBarrier.subresourceRange.baseArrayLayer = 0u;
+				imageBarrier.subresourceRange.layerCount = Renderer::Resource::ImageManager::GetArrayLayerCount(ref);
+
+				imageBarriers.push_back(imageBarrier);
+
+				srcStages |= waitStages != 0u ? static_cast<VkPipelineStageFlags>(waitStages) : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+				dstStages |= stages;
+			}
+			else if (waitStages != 0u)
+			{
+				memorySrcAccess |= waitAccess;
+				memoryDstAccess |= access;
+				srcStages |= waitStages;
+				dstStages |= stages;
+			}
+
+			if (isWrite)
+			{
+				state.writeStages = stages;
+				state.writeAccess = access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+				state.readStages = 0u;
+				state.visibleStages = 0u;
+				state.visibleAccess = 0u;
+			}
+			else if (layoutChange)
+			{
+				//Later readers have to wait on the transition
+				state.writeStages = stages;
+				state.writeAccess = 0u;
+				state.readStages = stages;
+				state.visibleStages = stages;
+				state.visibleAccess = access;
+			}
+			else
+			{
+				state.readStages |= stages;
+				if (waitStages != 0u)
+				{
+					state.visibleStages |= stages;
+					state.visibleAccess |= access;
+				}
+			}
+
+			state.layout = usage.type == RenderGraphResourceType::kImage ? usage.layout : state.layout;
+		}
+
+		if (srcStages == 0u)
+			return;
+
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = memorySrcAccess;
+		memoryBarrier.dstAccessMask = memoryDstAccess;
+
+		const bool hasMemoryBarrier = memorySrcAccess != 0u || memoryDstAccess != 0u;
+
+		vkCmdPipelineBarrier(Renderer::Vulkan::RenderSystem::GetPrimaryCommandBuffer(),
+			srcStages, dstStages, 0,
+			hasMemoryBarrier ? 1u : 0u, hasMemoryBarrier ? &memoryBarrier : nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.empty() ? nullptr : imageBarriers.data());
+	}
+
+	bool RenderGraph::GetImageLifetime(const DOD::Ref& imageRef, uint32_t& firstPass, uint32_t& lastPass)
+	{
+		auto lifetimeIt = m_ImageLifetimes.find(GetResourceKey(RenderGraphResourceType::kImage, imageRef));
+		if (lifetimeIt == m_ImageLifetimes.end())
+			return false;
+
+		firstPass = lifetimeIt->second.firstPass;
+		lastPass = lifetimeIt->second.lastPass;
+		return true;
+	}
+
+	bool RenderGraph::IsTransientImage(const DOD::Ref& imageRef)
+	{
+		auto lifetimeIt = m_ImageLifetimes.find(GetResourceKey(RenderGraphResourceType::kImage, imageRef));
+		return lifetimeIt != m_ImageLifetimes.end() && lifetimeIt->second.transient;
+	}
+
+	void RenderGraph::Reset()
+	{
+		m_Passes.clear();
+		m_Outputs.clear();
+		m_ResourceStates.clear();
+		m_ImageLifetimes.clear();
+		m_ImageAliases.clear();
+	}
+}
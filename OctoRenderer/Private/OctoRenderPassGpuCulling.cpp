@@ -0,0 +1,487 @@
+#include "OctoRenderPassGpuCulling.h"
+#include "OctoRenderPassMesh.h"
+#include "OctoRenderGraph.h"
+#include "Vulkan\VkPipelineLayoutManager.h"
+#include "Vulkan\VkImageManager.h"
+#include "Vulkan\VkRenderSystem.h"
+#include "Vulkan\VkGpuProgram.h"
+#include "Vulkan\VulkanTools.h"
+#include "Vulkan\VkPipelineManager.h"
+#include "Vulkan\DrawCallManager.h"
+#include "Vulkan\VkDrawCallDispatcher.h"
+#include "Vulkan\VkBufferObjectManager.h"
+#include "Vulkan\VkUniformBufferManager.h"
+
+//ThirdParty
+#include <ThirdParty/glm/glm/gtc/matrix_access.hpp>
+
+//Other
+#include <algorithm>
+#include <cstring>
+
+#define CULL_GROUP_SIZE 64u
+#define HIZ_GROUP_SIZE 8u
+
+//Feature bit of the gpu_cull.comp permutation, compiled as a define
+#define CLUSTER_CULL_FEATURE (1u << 0u)
+
+namespace Renderer
+{
+	void RenderPassGpuCulling::Init(RenderPassMesh& meshPass)
+	{
+		LoadShaders("hiz_downsample.comp.spv", "gpu_cull.comp");
+		CreateHiZImage("RenderPassGpuCulling_HiZ");
+		CreateSampler();
+		CreatePipelineLayouts("RenderPassGpuCulling_PipelineLayout");
+		CreatePipelines("RenderPassGpuCulling_Pipeline");
+		//Every instance draws either one LOD or all of its clusters
+		const uint32_t maxDrawCount = meshPass.GetInstanceCount() + meshPass.GetClusterInstanceCount();
+		CreateBuffers("RenderPassGpuCulling", meshPass.GetInstanceCount(), maxDrawCount);
+
+		//Mesh pass draws whatever the culling pass wrote
+		const DOD::Ref& drawCallRef = meshPass.GetDrawCallRef();
+		Renderer::Resource::DrawCallManager::GetIndirectBufferRef(drawCallRef) = m_IndirectBufferRef;
+		Renderer::Resource::DrawCallManager::GetDrawCountBufferRef(drawCallRef) = m_DrawCountBufferRef;
+		Renderer::Resource::DrawCallManager::GetMaxDrawCount(drawCallRef) = maxDrawCount;
+	}
+
+	void RenderPassGpuCulling::InitAfterCompile(const RenderPassMesh& meshPass)
+	{
+		CreateDispatches("RenderPassGpuCulling_Dispatch", meshPass);
+	}
+
+	void RenderPassGpuCulling::Destroy()
+	{
+		std::vector<DOD::Ref> dispatchRefs = m_HiZFirstLevelDispatchRefs;
+		dispatchRefs.insert(dispatchRefs.end(), m_HiZLevelDispatchRefs.begin(), m_HiZLevelDispatchRefs.end());
+		dispatchRefs.push_back(m_CullDispatchRef);
+		dispatchRefs.push_back(m_ClusterCullDispatchRef);
+		Renderer::Resource::DrawCallManager::DestroyDrawCallsAndResources(dispatchRefs);
+
+		Renderer::Resource::PipelineManager::DestroyPipelineAndResources({ m_HiZPipelineRef, m_CullPipelineRef, m_ClusterCullPipelineRef });
+		Renderer::Resource::PipelineLayoutManager::DestroyPipelineLayoutAndResources({ m_HiZPipelineLayoutRef, m_CullPipelineLayoutRef, m_ClusterCullPipelineLayoutRef });
+
+		Renderer::Resource::ImageManager::DestroyResource({ m_HiZImageRef });
+		Renderer::Resource::ImageManager::DestroyImage(m_HiZImageRef);
+
+		if (m_HiZSampler != VK_NULL_HANDLE)
+		{
+			vkDestroySampler(Renderer::Vulkan::RenderSystem::vkDevice, m_HiZSampler, nullptr);
+			m_HiZSampler = VK_NULL_HANDLE;
+		}
+
+		m_HiZValid = false;
+	}
+
+	void RenderPassGpuCulling::Resize()
+	{
+		//Recreated pyramid holds no depth until the next build
+		m_HiZValid = false;
+
+		//Level count follows the new resolution, the other dispatches got their descriptor sets rewritten
+		Renderer::Resource::DrawCallManager::DestroyDrawCallsAndResources(m_HiZLevelDispatchRefs);
+		CreateHiZLevelDispatches("RenderPassGpuCulling_Dispatch");
+	}
+
+	void RenderPassGpuCulling::Cull(const RenderPassMesh& meshPass)
+	{
+		VkCommandBuffer commandBuffer = Renderer::Vulkan::RenderSystem::GetPrimaryCommandBuffer();
+
+		//Update culling parameters, planes are extracted from the combined view projection matrix
+		const glm::mat4 viewProjection = meshPass.GetViewProjectionMatrix();
+		m_CullParams.viewProjection = viewProjection;
+		m_CullParams.frustumPlanes[0] = glm::row(viewProjection, 3) + glm::row(viewProjection, 0);
+		m_CullParams.frustumPlanes[1] = glm::row(viewProjection, 3) - glm::row(viewProjection, 0);
+		m_CullParams.frustumPlanes[2] = glm::row(viewProjection, 3) + glm::row(viewProjection, 1);
+		m_CullParams.frustumPlanes[3] = glm::row(viewProjection, 3) - glm::row(viewProjection, 1);
+		m_CullParams.frustumPlanes[4] = glm::row(viewProjection, 3) + glm::row(viewProjection, 2);
+		m_CullParams.frustumPlanes[5] = glm::row(viewProjection, 3) - glm::row(viewProjection, 2);
+
+		for (auto& plane : m_CullParams.frustumPlanes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		const glm::uvec3& hizDimensions = Renderer::Resource::ImageManager::GetImageDimensions(m_HiZImageRef);
+		m_CullParams.hizSize = glm::vec4(hizDimensions.x, hizDimensions.y, Renderer::Resource::ImageManager::GetMipLevelCount(m_HiZImageRef), 0.0f);
+		m_CullParams.lodParams = glm::vec4(meshPass.GetViewPosition(), meshPass.GetLodScale());
+		m_CullParams.instanceCount = meshPass.GetInstanceCount();
+		m_CullParams.hizEnabled = m_HiZValid ? 1u : 0u;
+		m_CullParams.clusterInstanceCount = meshPass.GetClusterInstanceCount();
+		m_CullParams.firstInstanceEnabled = Renderer::Vulkan::RenderSystem::supportsDrawIndirectFirstInstance ? 1u : 0u;
+
+		const VkBuffer& cullParamsBuffer = Renderer::Resource::UniformBufferManager::GetUniformBufferObject(m_CullParamsBufferRef).buffer;
+		const VkBuffer& indirectBuffer = Renderer::Resource::BufferObjectManager::GetBufferObject(m_IndirectBufferRef).buffer;
+		const VkBuffer& drawCountBuffer = Renderer::Resource::BufferObjectManager::GetBufferObject(m_DrawCountBufferRef).buffer;
+
+		//Hazards against the previous frame are resolved by the render graph before the pass
+		vkCmdUpdateBuffer(commandBuffer, cullParamsBuffer, 0u, sizeof(CullParams), reinterpret_cast<const uint32_t*>(&m_CullParams));
+
+		//Commands past the draw count stay zeroed, so they can be issued without the count extension
+		vkCmdFillBuffer(commandBuffer, indirectBuffer, 0u, VK_WHOLE_SIZE, 0u);
+		vkCmdFillBuffer(commandBuffer, drawCountBuffer, 0u, VK_WHOLE_SIZE, 0u);
+
+		//Cleared buffers have to be visible to the culling shader
+		VkTools::InsertMemoryBarrier(commandBuffer,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_UNIFORM_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		const uint32_t groupCount = (m_CullParams.instanceCount + CULL_GROUP_SIZE - 1u) / CULL_GROUP_SIZE;
+		Renderer::Vulkan::DrawCall::QueueDispatch(m_CullDispatchRef, groupCount);
+
+		if (m_CullParams.clusterInstanceCount == 0u)
+		{
+			return;
+		}
+
+		//Clusters read the instance visibility and append to the same commands
+		VkTools::InsertMemoryBarrier(commandBuffer,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		const uint32_t clusterGroupCount = (m_CullParams.clusterInstanceCount + CULL_GROUP_SIZE - 1u) / CULL_GROUP_SIZE;
+		Renderer::Vulkan::DrawCall::QueueDispatch(m_ClusterCullDispatchRef, clusterGroupCount);
+	}
+
+	void RenderPassGpuCulling::BuildHiZ(const RenderPassMesh& meshPass)
+	{
+		VkCommandBuffer commandBuffer = Renderer::Vulkan::RenderSystem::GetPrimaryCommandBuffer();
+		const uint32_t backBufferIndex = Renderer::Vulkan::RenderSystem::backBufferIndex;
+
+		//Depth and pyramid layouts are set up by the render graph, the pyramid stays in general layout
+		const glm::uvec3& hizDimensions = Renderer::Resource::ImageManager::GetImageDimensions(m_HiZImageRef);
+		const uint32_t mipLevelCount = Renderer::Resource::ImageManager::GetMipLevelCount(m_HiZImageRef);
+
+		for (uint32_t mipLevel = 0u; mipLevel < mipLevelCount; mipLevel++)
+		{
+			const uint32_t width = std::max(hizDimensions.x >> mipLevel, 1u);
+			const uint32_t height = std::max(hizDimensions.y >> mipLevel, 1u);
+
+			const DOD::Ref& dispatchRef = mipLevel == 0u
+				? m_HiZFirstLevelDispatchRefs[backBufferIndex]
+				: m_HiZLevelDispatchRefs[mipLevel - 1u];
+
+			Renderer::Vulkan::DrawCall::QueueDispatch(dispatchRef, (width + HIZ_GROUP_SIZE - 1u) / HIZ_GROUP_SIZE, (height + HIZ_GROUP_SIZE - 1u) / HIZ_GROUP_SIZE);
+
+			VkTools::InsertMemoryBarrier(commandBuffer,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		}
+
+		m_HiZValid = true;
+	}
+
+	uint32_t RenderPassGpuCulling::AddCullToRenderGraph(const RenderPassMesh& meshPass)
+	{
+		const uint32_t passIdx = Renderer::RenderGraph::AddPass("GpuCulling", [this, &meshPass](float dt) { Cull(meshPass); });
+
+		const DOD::Ref& clusterBufferRef = Renderer::Resource::DrawCallManager::GetClusterBufferRef(meshPass.GetDrawCallRef());
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { meshPass.GetInstanceBufferRef(), meshPass.GetLodBufferRef(), clusterBufferRef, meshPass.GetClusterInstanceBufferRef() },
+			Renderer::RenderGraphAccess::kStorageRead, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { m_InstanceVisibilityBufferRef, meshPass.GetDrawInstanceBufferRef() }, Renderer::RenderGraphAccess::kStorageWrite, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { m_IndirectBufferRef, m_DrawCountBufferRef },
+			Renderer::RenderGraphAccess::kTransferWrite | Renderer::RenderGraphAccess::kStorageWrite, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		//Pyramid of the previous frame, kept in general layout since the Hi-Z build writes it in place
+		Renderer::RenderGraph::AddImageUsage(passIdx, { m_HiZImageRef }, Renderer::RenderGraphAccess::kSampled,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_GENERAL);
+
+		return passIdx;
+	}
+
+	uint32_t RenderPassGpuCulling::AddHiZToRenderGraph(const RenderPassMesh& meshPass)
+	{
+		const uint32_t passIdx = Renderer::RenderGraph::AddPass("HiZ", [this, &meshPass](float dt) { BuildHiZ(meshPass); });
+
+		Renderer::RenderGraph::AddImageUsage(passIdx, meshPass.GetDepthImageRefs(), Renderer::RenderGraphAccess::kSampled, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		Renderer::RenderGraph::AddImageUsage(passIdx, { m_HiZImageRef },
+			Renderer::RenderGraphAccess::kSampled | Renderer::RenderGraphAccess::kStorageWrite, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		//Consumed by the next frame, which the graph can not see
+		Renderer::RenderGraph::MarkOutput({ m_HiZImageRef });
+
+		return passIdx;
+	}
+
+	bool RenderPassGpuCulling::LoadShaders(const std::string& hizShader, const std::string& cullSource)
+	{
+		//Create GPU Resource
+		DOD::Ref hiz_ref = Renderer::Resource::GpuProgramManager::CreateGPUProgram(hizShader);
+
+		//Compile and set to created gpu resource reference
+		bool bSaderLoaded = Renderer::Resource::GpuProgramManager::LoadAndCompileShader(hiz_ref, "../../Assets/Shaders/", VK_SHADER_STAGE_COMPUTE_BIT);
+
+		//Instance and cluster culling are variants of one source, they stay cached by the GpuProgramManager
+		Renderer::Resource::ShaderPermutation cullPermutation;
+		cullPermutation.source = cullSource;
+		cullPermutation.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		cullPermutation.features = { "CLUSTER_CULL" };
+
+		DOD::Ref cull_ref = Renderer::Resource::GpuProgramManager::GetVariant(cullPermutation, 0u, "../../Assets/Shaders/");
+		DOD::Ref cluster_cull_ref = Renderer::Resource::GpuProgramManager::GetVariant(cullPermutation, CLUSTER_CULL_FEATURE, "../../Assets/Shaders/");
+
+		if (bSaderLoaded == false || !cull_ref.isValid() || !cluster_cull_ref.isValid())
+		{
+			Renderer::Resource::GpuProgramManager::destroyResource(hiz_ref);
+			return false;
+		}
+
+		m_HiZShaderRef = hiz_ref;
+		m_CullShaderRef = cull_ref;
+		m_ClusterCullShaderRef = cluster_cull_ref;
+
+		return true;
+	}
+
+	void RenderPassGpuCulling::CreateHiZImage(const std::string& imageName)
+	{
+		//Half of the mesh pass depth buffer, which follows the back buffer
+		m_HiZImageRef = Renderer::Resource::ImageManager::CreateImage(imageName);
+		Renderer::Resource::ImageManager::ResetToDefault(m_HiZImageRef);
+		Renderer::Resource::ImageManager::GetResolutionScale(m_HiZImageRef) = 0.5f;
+		Renderer::Resource::ImageManager::GetMemoryPoolType(m_HiZImageRef) = MemoryPoolTypes::kResolutionDependentImages;
+		Renderer::Resource::ImageManager::GetImageFormat(m_HiZImageRef) = VK_FORMAT_R32_SFLOAT;
+		Renderer::Resource::ImageManager::GetImageFlags(m_HiZImageRef) = ImageFlags::kUsageSampled | ImageFlags::kUsageStorage | ImageFlags::kFullMipChain;
+	}
+
+	void RenderPassGpuCulling::CreateSampler()
+	{
+		//Hi-Z texels are max reduced, filtering would mix in closer depth
+		VkSamplerCreateInfo samplerCreateInfo = VkTools::Initializer::SamplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.minLod = 0.0f;
+		//Level count changes with the resolution, levels are always picked explicitly
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+		VK_CHECK_RESULT(vkCreateSampler(Renderer::Vulkan::RenderSystem::vkDevice, &samplerCreateInfo, nullptr, &m_HiZSampler));
+	}
+
+	void RenderPassGpuCulling::CreatePipelineLayouts(const std::string& pipelineLayoutName)
+	{
+		std::vector<DOD::Ref> PipeleinLayoutRefs;
+
+		//Hi-Z downsample, source depth or previous level and destination level
+		m_HiZPipelineLayoutRef = Renderer::Resource::PipelineLayoutManager::CreatePipelineLayout(pipelineLayoutName + "_HiZ");
+		{
+			auto& descriptorSetLayout = Renderer::Resource::PipelineLayoutManager::GetDescriptorSetLayoutBinding(m_HiZPipelineLayoutRef);
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1));
+		}
+		PipeleinLayoutRefs.push_back(m_HiZPipelineLayoutRef);
+
+		//Culling, parameters, instances, output commands, output count, Hi-Z, LODs, instance visibility and command instances
+		m_CullPipelineLayoutRef = Renderer::Resource::PipelineLayoutManager::CreatePipelineLayout(pipelineLayoutName + "_Cull");
+		{
+			auto& descriptorSetLayout = Renderer::Resource::PipelineLayoutManager::GetDescriptorSetLayoutBinding(m_CullPipelineLayoutRef);
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 4));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 9));
+		}
+		PipeleinLayoutRefs.push_back(m_CullPipelineLayoutRef);
+
+		//Cluster culling, same as culling with clusters and cluster instances in place of the LODs
+		m_ClusterCullPipelineLayoutRef = Renderer::Resource::PipelineLayoutManager::CreatePipelineLayout(pipelineLayoutName + "_ClusterCull");
+		{
+			auto& descriptorSetLayout = Renderer::Resource::PipelineLayoutManager::GetDescriptorSetLayoutBinding(m_ClusterCullPipelineLayoutRef);
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 4));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 7));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 8));
+			descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 9));
+		}
+		PipeleinLayoutRefs.push_back(m_ClusterCullPipelineLayoutRef);
+
+		Renderer::Resource::PipelineLayoutManager::CreateResource(PipeleinLayoutRefs);
+	}
+
+	void RenderPassGpuCulling::CreatePipelines(const std::string& pipelineName)
+	{
+		std::vector<DOD::Ref> PipelineRefs;
+
+		m_HiZPipelineRef = Renderer::Resource::PipelineManager::CreatePipeline(pipelineName + "_HiZ");
+		Renderer::Resource::PipelineManager::GetComputeShader(m_HiZPipelineRef) = m_HiZShaderRef;
+		Renderer::Resource::PipelineManager::GetPipelineLayoutRef(m_HiZPipelineRef) = m_HiZPipelineLayoutRef;
+		PipelineRefs.push_back(m_HiZPipelineRef);
+
+		m_CullPipelineRef = Renderer::Resource::PipelineManager::CreatePipeline(pipelineName + "_Cull");
+		Renderer::Resource::PipelineManager::GetComputeShader(m_CullPipelineRef) = m_CullShaderRef;
+		Renderer::Resource::PipelineManager::GetPipelineLayoutRef(m_CullPipelineRef) = m_CullPipelineLayoutRef;
+		PipelineRefs.push_back(m_CullPipelineRef);
+
+		m_ClusterCullPipelineRef = Renderer::Resource::PipelineManager::CreatePipeline(pipelineName + "_ClusterCull");
+		Renderer::Resource::PipelineManager::GetComputeShader(m_ClusterCullPipelineRef) = m_ClusterCullShaderRef;
+		Renderer::Resource::PipelineManager::GetPipelineLayoutRef(m_ClusterCullPipelineRef) = m_ClusterCullPipelineLayoutRef;
+		PipelineRefs.push_back(m_ClusterCullPipelineRef);
+
+		Renderer::Resource::PipelineManager::CreateResource(PipelineRefs);
+	}
+
+	void RenderPassGpuCulling::CreateBuffers(const std::string& bufferName, uint32_t instanceCount, uint32_t maxDrawCount)
+	{
+		memset(&m_CullParams, 0, sizeof(m_CullParams));
+
+		m_CullParamsBufferRef = Renderer::Resource::UniformBufferManager::CreateUniformBufferOjbect(bufferName + "_CullParams");
+		Renderer::Resource::UniformBufferManager::GetUniformBufferSize(m_CullParamsBufferRef) = sizeof(CullParams);
+		Renderer::Resource::UniformBufferManager::GetUniformBufferUsageFlag(m_CullParamsBufferRef) = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		Renderer::Resource::UniformBufferManager::GetUniformBufferData(m_CullParamsBufferRef) = &m_CullParams;
+		Renderer::Resource::UniformBufferManager::CreateResource(m_CullParamsBufferRef, Renderer::Vulkan::RenderSystem::vkPhysicalDeviceMemoryProperties);
+
+		//Contents are cleared every frame before culling
+		m_IndirectBufferRef = Renderer::Resource::BufferObjectManager::CreateBufferOjbect(bufferName + "_IndirectCommands");
+		Renderer::Resource::BufferObjectManager::GetBufferSize(m_IndirectBufferRef) = maxDrawCount * sizeof(VkDrawIndexedIndirectCommand);
+		Renderer::Resource::BufferObjectManager::GetBufferUsageFlag(m_IndirectBufferRef) = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		Renderer::Resource::BufferObjectManager::GetBufferData(m_IndirectBufferRef) = nullptr;
+		Renderer::Resource::BufferObjectManager::CreateResource(m_IndirectBufferRef, Renderer::Vulkan::RenderSystem::vkPhysicalDeviceMemoryProperties);
+
+		m_DrawCountBufferRef = Renderer::Resource::BufferObjectManager::CreateBufferOjbect(bufferName + "_DrawCount");
+		Renderer::Resource::BufferObjectManager::GetBufferSize(m_DrawCountBufferRef) = sizeof(uint32_t);
+		Renderer::Resource::BufferObjectManager::GetBufferUsageFlag(m_DrawCountBufferRef) = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		Renderer::Resource::BufferObjectManager::GetBufferData(m_DrawCountBufferRef) = nullptr;
+		Renderer::Resource::BufferObjectManager::CreateResource(m_DrawCountBufferRef, Renderer::Vulkan::RenderSystem::vkPhysicalDeviceMemoryProperties);
+
+		//Every entry is written by the instance culling before the cluster culling reads it
+		m_InstanceVisibilityBufferRef = Renderer::Resource::BufferObjectManager::CreateBufferOjbect(bufferName + "_InstanceVisibility");
+		Renderer::Resource::BufferObjectManager::GetBufferSize(m_InstanceVisibilityBufferRef) = instanceCount * sizeof(uint32_t);
+		Renderer::Resource::BufferObjectManager::GetBufferUsageFlag(m_InstanceVisibilityBufferRef) = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		Renderer::Resource::BufferObjectManager::GetBufferData(m_InstanceVisibilityBufferRef) = nullptr;
+		Renderer::Resource::BufferObjectManager::CreateResource(m_InstanceVisibilityBufferRef, Renderer::Vulkan::RenderSystem::vkPhysicalDeviceMemoryProperties);
+	}
+
+	void RenderPassGpuCulling::CreateDispatches(const std::string& dispatchName, const RenderPassMesh& meshPass)
+	{
+		std::vector<DOD::Ref> dispatchesToCreate;
+
+		//First level reads the depth buffer rendered into this frame
+		m_HiZFirstLevelDispatchRefs.clear();
+		for (uint32_t backBufferIndex = 0u; backBufferIndex < Renderer::Vulkan::RenderSystem::vkSwapchainImages.size(); backBufferIndex++)
+		{
+			const DOD::Ref dispatchRef = Renderer::Resource::DrawCallManager::CreateDrawCall(dispatchName + "_HiZ_Depth" + std::to_string(backBufferIndex));
+
+			Renderer::Resource::BindingInfo sourceInfo = { 0, DOD::Ref() };
+			sourceInfo.image_ref = meshPass.GetDepthImageRef(backBufferIndex);
+			sourceInfo.sampler = m_HiZSampler;
+
+			Renderer::Resource::BindingInfo destinationInfo = { 1, DOD::Ref() };
+			destinationInfo.image_ref = m_HiZImageRef;
+			destinationInfo.mip_level = 0u;
+
+			auto& binding_infos = Renderer::Resource::DrawCallManager::GetBindingInfo(dispatchRef);
+			binding_infos.push_back(sourceInfo);
+			binding_infos.push_back(destinationInfo);
+
+			Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(dispatchRef) = m_HiZPipelineLayoutRef;
+			Renderer::Resource::DrawCallManager::GetPipelineRef(dispatchRef) = m_HiZPipelineRef;
+
+			m_HiZFirstLevelDispatchRefs.push_back(dispatchRef);
+			dispatchesToCreate.push_back(dispatchRef);
+		}
+
+		//Culling
+		{
+			m_CullDispatchRef = Renderer::Resource::DrawCallManager::CreateDrawCall(dispatchName + "_Cull");
+
+			Renderer::Resource::BindingInfo hizInfo = { 4, DOD::Ref() };
+			hizInfo.image_ref = m_HiZImageRef;
+			hizInfo.image_layout = VK_IMAGE_LAYOUT_GENERAL;
+			hizInfo.sampler = m_HiZSampler;
+
+			auto& binding_infos = Renderer::Resource::DrawCallManager::GetBindingInfo(m_CullDispatchRef);
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 0, m_CullParamsBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 1, meshPass.GetInstanceBufferRef() });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 2, m_IndirectBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 3, m_DrawCountBufferRef });
+			binding_infos.push_back(hizInfo);
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 5, meshPass.GetLodBufferRef() });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 6, m_InstanceVisibilityBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 9, meshPass.GetDrawInstanceBufferRef() });
+
+			Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(m_CullDispatchRef) = m_CullPipelineLayoutRef;
+			Renderer::Resource::DrawCallManager::GetPipelineRef(m_CullDispatchRef) = m_CullPipelineRef;
+
+			dispatchesToCreate.push_back(m_CullDispatchRef);
+		}
+
+		//Cluster culling
+		{
+			m_ClusterCullDispatchRef = Renderer::Resource::DrawCallManager::CreateDrawCall(dispatchName + "_ClusterCull");
+
+			Renderer::Resource::BindingInfo hizInfo = { 4, DOD::Ref() };
+			hizInfo.image_ref = m_HiZImageRef;
+			hizInfo.image_layout = VK_IMAGE_LAYOUT_GENERAL;
+			hizInfo.sampler = m_HiZSampler;
+
+			const DOD::Ref& clusterBufferRef = Renderer::Resource::DrawCallManager::GetClusterBufferRef(meshPass.GetDrawCallRef());
+
+			auto& binding_infos = Renderer::Resource::DrawCallManager::GetBindingInfo(m_ClusterCullDispatchRef);
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 0, m_CullParamsBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 1, meshPass.GetInstanceBufferRef() });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 2, m_IndirectBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 3, m_DrawCountBufferRef });
+			binding_infos.push_back(hizInfo);
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 6, m_InstanceVisibilityBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 7, clusterBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 8, meshPass.GetClusterInstanceBufferRef() });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 9, meshPass.GetDrawInstanceBufferRef() });
+
+			Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(m_ClusterCullDispatchRef) = m_ClusterCullPipelineLayoutRef;
+			Renderer::Resource::DrawCallManager::GetPipelineRef(m_ClusterCullDispatchRef) = m_ClusterCullPipelineRef;
+
+			dispatchesToCreate.push_back(m_ClusterCullDispatchRef);
+		}
+
+		Renderer::Resource::DrawCallManager::CreateResource(dispatchesToCreate);
+
+		CreateHiZLevelDispatches(dispatchName);
+	}
+
+	void RenderPassGpuCulling::CreateHiZLevelDispatches(const std::string& dispatchName)
+	{
+		std::vector<DOD::Ref> dispatchesToCreate;
+		const uint32_t mipLevelCount = Renderer::Resource::ImageManager::GetMipLevelCount(m_HiZImageRef);
+
+		m_HiZLevelDispatchRefs.clear();
+		for (uint32_t mipLevel = 1u; mipLevel < mipLevelCount; mipLevel++)
+		{
+			const DOD::Ref dispatchRef = Renderer::Resource::DrawCallManager::CreateDrawCall(dispatchName + "_HiZ_Level" + std::to_string(mipLevel));
+
+			Renderer::Resource::BindingInfo sourceInfo = { 0, DOD::Ref() };
+			sourceInfo.image_ref = m_HiZImageRef;
+			sourceInfo.mip_level = mipLevel - 1u;
+			sourceInfo.image_layout = VK_IMAGE_LAYOUT_GENERAL;
+			sourceInfo.sampler = m_HiZSampler;
+
+			Renderer::Resource::BindingInfo destinationInfo = { 1, DOD::Ref() };
+			destinationInfo.image_ref = m_HiZImageRef;
+			destinationInfo.mip_level = mipLevel;
+
+			//Recreated on every resize, the reused slots must not keep the previous chain's levels
+			Renderer::Resource::DrawCallManager::GetBindingInfo(dispatchRef) = { sourceInfo, destinationInfo };
+
+			Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(dispatchRef) = m_HiZPipelineLayoutRef;
+			Renderer::Resource::DrawCallManager::GetPipelineRef(dispatchRef) = m_HiZPipelineRef;
+
+			m_HiZLevelDispatchRefs.push_back(dispatchRef);
+			dispatchesToCreate.push_back(dispatchRef);
+		}
+
+		Renderer::Resource::DrawCallManager::CreateResource(dispatchesToCreate);
+	}
+}
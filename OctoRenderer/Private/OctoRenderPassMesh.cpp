@@ -1,4 +1,5 @@
 #include "OctoRenderPassMesh.h"
+#include "OctoRenderGraph.h"
 #include "Vulkan\VkRenderPassManager.h"
 #include "Vulkan\VkGPUMemoryManager.h"
 #include "Vulkan\VkPipelineLayoutManager.h"
@@ -14,6 +15,7 @@
 #include "Vulkan\VkBufferObjectManager.h"
 #include "Vulkan\VkUniformBufferManager.h"
 #include "Geometry\VertData.h"
+#include "OctoCore/Public/MeshFile.h"
 
 //ThirdParty
 #include <ThirdParty/glm/glm/glm.hpp>
@@ -28,6 +30,11 @@
 #include <ThirdParty/glm/glm/gtx/matrix_operation.hpp>
 #include <ThirdParty\glm\glm\gtx\orthonormalize.hpp>
 
+//Other
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
 glm::vec3	g_Rotation = glm::vec3();
 float       g_zoom = 1.0f;
 
@@ -43,58 +50,254 @@ std::vector<drawVert> vertData =
 // Setup indices
 std::vector<uint32_t> indexBuffer = { 0, 1, 2, 2,3,0 };
 
+//Instances are laid out on a grid, the culling pass decides which of them get drawn
+#define INSTANCE_GRID_DIM 16
+
+//LODs switch once their error would cover more than this many pixels
+#define LOD_PIXEL_ERROR 1.0f
+#define FIELD_OF_VIEW 60.0f
+
+//Feature bit of the triangle.frag permutation, compiled as a define
+#define ALBEDO_TEXTURE_FEATURE (1u << 0u)
+
 namespace Renderer
 {
 	void RenderPassMesh::UpdateUniformBufferData()
 	{
 		// Update matrices
-		int g_iDesktopWidth = 800;
-		int g_iDesktopHeight = 600;
-		m_UboData.projectionMatrix = glm::perspective(glm::radians(60.0f), (float)g_iDesktopWidth / (float)g_iDesktopHeight, 0.1f, 256.0f);
+		const glm::uvec2& backBufferDimensions = Renderer::Vulkan::RenderSystem::backBufferDimensions;
+		m_UboData.projectionMatrix = glm::perspective(glm::radians(FIELD_OF_VIEW), (float)backBufferDimensions.x / (float)backBufferDimensions.y, 0.1f, 256.0f);
+
+		//Pixels covered by one unit at distance one
+		m_ProjectionScale = backBufferDimensions.y / (2.0f * glm::tan(glm::radians(FIELD_OF_VIEW) * 0.5f));
+		m_LodScale = m_ProjectionScale / LOD_PIXEL_ERROR;
 
 		m_UboData.viewMatrix = glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, g_zoom));
 
-		m_UboData.modelMatrix = m_UboData.viewMatrix * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, -5.0f));
-		m_UboData.modelMatrix = glm::rotate(m_UboData.modelMatrix, glm::radians(g_Rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-		m_UboData.modelMatrix = glm::rotate(m_UboData.modelMatrix, glm::radians(g_Rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-		m_UboData.modelMatrix = glm::rotate(m_UboData.modelMatrix, glm::radians(g_Rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		//Pushed with the draw, the instances are placed relative to it
+		m_DrawConstants.modelMatrix = glm::rotate(glm::mat4(), glm::radians(g_Rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		m_DrawConstants.modelMatrix = glm::rotate(m_DrawConstants.modelMatrix, glm::radians(g_Rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		m_DrawConstants.modelMatrix = glm::rotate(m_DrawConstants.modelMatrix, glm::radians(g_Rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		m_DrawConstants.objectIndex = 0u;
+		m_DrawConstants.materialIndex = 0u;
+		m_DrawConstants.drawIndex = Renderer::Resource::NO_DRAW_INDEX;
 
 		m_UboData.viewPos = glm::vec4(0.0f, 0.0f, -5.0f, 0.0f);
 	}
 
+	void RenderPassMesh::CreateInstanceData()
+	{
+		m_InstanceData.resize(INSTANCE_GRID_DIM * INSTANCE_GRID_DIM);
+		m_ClusterInstances.clear();
+
+		float maxRadius = 0.0f;
+		for (const Submesh& submesh : m_Submeshes)
+		{
+			maxRadius = std::max(maxRadius, submesh.boundingSphere.w);
+		}
+
+		for (uint32_t y = 0u; y < INSTANCE_GRID_DIM; y++)
+		{
+			for (uint32_t x = 0u; x < INSTANCE_GRID_DIM; x++)
+			{
+				const uint32_t instanceIdx = y * INSTANCE_GRID_DIM + x;
+				InstanceData& instance = m_InstanceData[instanceIdx];
+				const Submesh& submesh = m_Submeshes[instanceIdx % m_Submeshes.size()];
+
+				//Spacing of 1.77 bounding radii keeps the quad grid at 2.5 quad extents
+				const glm::vec3 position = glm::vec3(
+					(x - INSTANCE_GRID_DIM * 0.5f) * 1.77f * maxRadius,
+					(y - INSTANCE_GRID_DIM * 0.5f) * 1.77f * maxRadius,
+					-5.0f - (x + y) % 4);
+
+				instance.modelMatrix = glm::translate(glm::mat4(), position);
+				instance.boundingSphere = submesh.boundingSphere;
+				instance.firstLod = submesh.firstLod;
+				instance.lodCount = submesh.lodCount;
+				instance.vertexOffset = submesh.vertexOffset;
+				instance.clusterCount = submesh.clusterCount;
+				instance.positionOffset = glm::vec4(submesh.quantization.offset, 0.0f);
+				instance.positionScale = glm::vec4(submesh.quantization.scale, 0.0f);
+
+				for (uint32_t clusterIdx = submesh.firstCluster; clusterIdx < submesh.firstCluster + submesh.clusterCount; clusterIdx++)
+				{
+					m_ClusterInstances.push_back(glm::uvec2(instanceIdx, clusterIdx));
+				}
+			}
+		}
+	}
+
 	void RenderPassMesh::Init()
 	{		
-		LoadShaders("triangle.vert.spv", "triangle.frag.spv");
+		CreateAlbedoTexture("RenderPassMesh_Albedo", "../../Assets/Textures/Scene.ktx");
+		LoadShaders("triangle.vert.spv", "triangle.frag");
 		CreatePipelineLayout("RenderPassMesh_PipelineLayout");
 		CreateRenderPass("RenderPassMesh_RenderPass");
-		CreateFramBuffer("RenderPassMesh_FrameBuffer");
+		CreateImages("RenderPassMesh_FrameBuffer");
 		CrreateBufferLayout("RenderPassMesh_BufferLayout");
 		CreatePipeline("RenderPassMesh_Pipeline");
 
-		//SENDING DATA TO GPU
-		struct Vertex
+		//Update UBO
+		UpdateUniformBufferData();
+
+		if (!LoadMesh("RenderPassMesh", "../../Assets/Meshes/Scene.omesh"))
 		{
-			float pos[3];
-			float uv[2];
-			float normal[3];
-		};
+			CreateFallbackMesh("RenderPassMesh");
+		}
 
+		m_UniformBufferRef = CreateUniformBuffer("RenderPassMeshUniformBuffer", VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &m_UboData, sizeof(m_UboData));
 
-		uint32_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
+		CreateInstanceData();
+		m_InstanceBufferRef = CreateBuffer("RenderPassMeshInstanceBuffer", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_InstanceData.data(), static_cast<uint32_t>(m_InstanceData.size() * sizeof(InstanceData)));
+		m_LodBufferRef = CreateBuffer("RenderPassMeshLodBuffer", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_Lods.data(), static_cast<uint32_t>(m_Lods.size() * sizeof(Renderer::Resource::DrawCallLod)));
+		m_ClusterBufferRef = CreateBuffer("RenderPassMeshClusterBuffer", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_Clusters.data(), static_cast<uint32_t>(m_Clusters.size() * sizeof(Renderer::Resource::DrawCallCluster)));
+		m_ClusterInstanceBufferRef = CreateBuffer("RenderPassMeshClusterInstanceBuffer", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_ClusterInstances.data(), static_cast<uint32_t>(m_ClusterInstances.size() * sizeof(glm::uvec2)));
 
-		//Update UBO
-		UpdateUniformBufferData();
+		//One entry per command the culling pass can write
+		m_DrawInstanceBufferRef = CreateBuffer("RenderPassMeshDrawInstanceBuffer", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, nullptr, static_cast<uint32_t>((m_InstanceData.size() + m_ClusterInstances.size()) * sizeof(uint32_t)));
 
-		m_StagingBufferVerticesRef = CreateBuffer("RenderPassMeshVertBuffer", VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertData.data(), static_cast<uint32_t>(vertData.size() + sizeof(drawVert)));
-		m_StagingBufferIndicesRef = CreateBuffer("RenderPassMeshIndexBuffer", VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer.data(), indexBufferSize);
-		m_UniformBufferRef = CreateUniformBuffer("RenderPassMeshUniformBuffer", VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &m_UboData, sizeof(m_UboData));
+		m_DrawCallRef = CreateDrawCall("RenderPassMeshDrawCall", m_IndexCount);
+	}
 
-		m_DrawCallRef = CreateDrawCall("RenderPassMeshDrawCall", indexBuffer.size());
+	void RenderPassMesh::InitAfterCompile()
+	{
+		CreateFramBuffer("RenderPassMesh_FrameBuffer");
+	}
+
+	bool RenderPassMesh::LoadMesh(const std::string& meshName, const std::string& meshPath)
+	{
+		Core::Mesh::MeshFile meshFile;
+		if (!meshFile.Load(meshPath))
+		{
+			return false;
+		}
+
+		const Core::Mesh::MeshFileHeader& header = meshFile.GetHeader();
+
+		//Skinned vertices are read by the skinning pass as well
+		const VkBufferUsageFlags vertexUsage = meshFile.IsSkinned() ? VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+		//Uploads read straight from the mapped file, it is unmapped once the buffers exist
+		m_StagingBufferVerticesRef = CreateBuffer(meshName + "VertBuffer", static_cast<VkBufferUsageFlagBits>(vertexUsage),
+			const_cast<void*>(meshFile.GetVertexData()), static_cast<int32_t>(meshFile.GetVertexDataSize()));
+		m_StagingBufferIndicesRef = CreateBuffer(meshName + "IndexBuffer", VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			const_cast<void*>(meshFile.GetIndexData()), static_cast<int32_t>(meshFile.GetIndexDataSize()));
+
+		m_VertexStreamOffsets = { 0u, meshFile.GetAttributeStreamOffset() };
+		m_VertexCount = header.vertexCount;
+		m_IndexCount = header.indexCount;
+		m_IndexType = header.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+		m_Submeshes.clear();
+		m_Submeshes.reserve(header.submeshCount);
+		for (uint32_t i = 0u; i < header.submeshCount; i++)
+		{
+			const Core::Mesh::MeshFileSubmesh& fileSubmesh = meshFile.GetSubmeshes()[i];
+			const Core::Mesh::PositionQuantization bindPoseQuantization = Core::Mesh::GetPositionQuantization(fileSubmesh.bounds.min, fileSubmesh.bounds.max);
+
+			//Poses are expected to stay inside the bind pose sphere, the culling sphere and the skinned box both cover it
+			const glm::vec3 sphereCenter = glm::vec3(fileSubmesh.bounds.sphere);
+			const glm::vec3 sphereExtent = glm::vec3(fileSubmesh.bounds.sphere.w);
+			const Core::Mesh::PositionQuantization quantization = meshFile.IsSkinned() ?
+				Core::Mesh::GetPositionQuantization(sphereCenter - sphereExtent, sphereCenter + sphereExtent) : bindPoseQuantization;
+
+			m_Submeshes.push_back({ fileSubmesh.bounds.sphere, fileSubmesh.firstLod, fileSubmesh.lodCount, fileSubmesh.vertexOffset, fileSubmesh.vertexCount,
+				fileSubmesh.firstCluster, fileSubmesh.clusterCount, quantization, bindPoseQuantization });
+		}
+
+		m_Skeleton = Skeleton();
+		m_BindPose = SkeletonPose();
+		if (meshFile.IsSkinned())
+		{
+			m_SkinBufferRef = CreateBuffer(meshName + "SkinBuffer", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				const_cast<Core::Mesh::PackedSkin*>(meshFile.GetSkinData()), static_cast<int32_t>(meshFile.GetSkinDataSize()));
+
+			m_Skeleton.parents.resize(header.jointCount);
+			m_Skeleton.inverseBindPose.resize(header.jointCount);
+			m_BindPose.Resize(header.jointCount);
+			for (uint32_t jointIdx = 0u; jointIdx < header.jointCount; jointIdx++)
+			{
+				const Core::Mesh::MeshFileJoint& fileJoint = meshFile.GetJoints()[jointIdx];
+				m_Skeleton.parents[jointIdx] = fileJoint.parent;
+				memcpy(m_Skeleton.inverseBindPose[jointIdx].mat, fileJoint.inverseBindPose, sizeof(fileJoint.inverseBindPose));
+
+				JointQuat bindJoint;
+				bindJoint.q = glm::quat(fileJoint.bindRotation.w, fileJoint.bindRotation.x, fileJoint.bindRotation.y, fileJoint.bindRotation.z);
+				bindJoint.t = glm::vec3(fileJoint.bindTranslation);
+				m_BindPose.SetJoint(jointIdx, bindJoint);
+			}
+		}
+
+		//Same layout as the draw call LODs
+		static_assert(sizeof(Core::Mesh::MeshFileLod) == sizeof(Renderer::Resource::DrawCallLod), "LOD layouts differ");
+		m_Lods.assign(reinterpret_cast<const Renderer::Resource::DrawCallLod*>(meshFile.GetLods()),
+			reinterpret_cast<const Renderer::Resource::DrawCallLod*>(meshFile.GetLods()) + header.lodCount);
+
+		static_assert(sizeof(Core::Mesh::MeshFileCluster) == sizeof(Renderer::Resource::DrawCallCluster), "Cluster layouts differ");
+		m_Clusters.assign(reinterpret_cast<const Renderer::Resource::DrawCallCluster*>(meshFile.GetClusters()),
+			reinterpret_cast<const Renderer::Resource::DrawCallCluster*>(meshFile.GetClusters()) + header.clusterCount);
+
+		return true;
+	}
+
+	void RenderPassMesh::CreateFallbackMesh(const std::string& meshName)
+	{
+		//Same streams as cooked meshes, positions followed by the other attributes
+		const size_t positionStreamSize = vertData.size() * sizeof(Core::Mesh::PackedPosition);
+		std::vector<uint8_t> vertexData(positionStreamSize + vertData.size() * sizeof(Core::Mesh::PackedAttributes));
+		Core::Mesh::PackedPosition* positions = reinterpret_cast<Core::Mesh::PackedPosition*>(vertexData.data());
+		Core::Mesh::PackedAttributes* attributes = reinterpret_cast<Core::Mesh::PackedAttributes*>(vertexData.data() + positionStreamSize);
+
+		glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+		glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+		for (const drawVert& vertex : vertData)
+		{
+			boundsMin = glm::min(boundsMin, vertex.vertex);
+			boundsMax = glm::max(boundsMax, vertex.vertex);
+		}
+		const Core::Mesh::PositionQuantization quantization = Core::Mesh::GetPositionQuantization(boundsMin, boundsMax);
+
+		for (size_t i = 0u; i < vertData.size(); i++)
+		{
+			const drawVert& vertex = vertData[i];
+			positions[i] = Core::Mesh::PackPosition(vertex.vertex, quantization);
+			attributes[i] = Core::Mesh::PackAttributes(vertex.normal, vertex.tangent, vertex.bitangent, vertex.tex, vertex.color);
+		}
+
+		m_StagingBufferVerticesRef = CreateBuffer(meshName + "VertBuffer", VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData.data(), static_cast<int32_t>(vertexData.size()));
+		m_VertexStreamOffsets = { 0u, positionStreamSize };
+		m_VertexCount = static_cast<uint32_t>(vertData.size());
+		m_StagingBufferIndicesRef = CreateBuffer(meshName + "IndexBuffer", VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer.data(), static_cast<int32_t>(indexBuffer.size() * sizeof(uint32_t)));
+
+		m_IndexCount = static_cast<uint32_t>(indexBuffer.size());
+		m_IndexType = VK_INDEX_TYPE_UINT32;
+
+		const glm::vec4 boundingSphere = glm::vec4(0.0f, 0.0f, 0.0f, glm::sqrt(2.0f) * DIM + Core::Mesh::GetPositionQuantizationError(quantization));
+		m_Submeshes.clear();
+		m_Submeshes.push_back({ boundingSphere, 0u, 1u, 0, m_VertexCount, 0u, 1u, quantization, quantization });
+		m_Lods = { { 0u, m_IndexCount, 0.0f, 0u } };
+
+		//Flat quad, a single cluster whose cone has no spread
+		Renderer::Resource::DrawCallCluster cluster = { boundingSphere, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f), 0u, m_IndexCount, { 0u, 0u } };
+		m_Clusters = { cluster };
 	}
 
 	void RenderPassMesh::Destroy()
 	{
+		Renderer::Resource::PipelineLayoutManager::ReleasePipelineLayout(m_PipeleinLayoutRef);
 
+		if (m_AlbedoImageRef.isValid())
+		{
+			Renderer::Resource::ImageManager::DestroyResource({ m_AlbedoImageRef });
+			Renderer::Resource::ImageManager::DestroyImage(m_AlbedoImageRef);
+			m_AlbedoImageRef = DOD::Ref();
+		}
+
+		if (m_AlbedoSampler != VK_NULL_HANDLE)
+		{
+			vkDestroySampler(Renderer::Vulkan::RenderSystem::vkDevice, m_AlbedoSampler, nullptr);
+			m_AlbedoSampler = VK_NULL_HANDLE;
+		}
 	}
 
 	void RenderPassMesh::Render(float dt, float width, float height)
@@ -103,25 +306,108 @@ namespace Renderer
 		clearValues[0].color = { { 0.5f, 0.5f, 0.5f, 1.0f } };
 		clearValues[1].depthStencil = { 1.0f, 0 };
 
+		//Matrices changed on resize, the device was idle so only the upload has to be made visible
+		if (m_UniformBufferDirty)
+		{
+			VkCommandBuffer commandBuffer = Renderer::Vulkan::RenderSystem::GetPrimaryCommandBuffer();
+			const VkBuffer& uniformBuffer = Renderer::Resource::UniformBufferManager::GetUniformBufferObject(m_UniformBufferRef).buffer;
+
+			vkCmdUpdateBuffer(commandBuffer, uniformBuffer, 0u, sizeof(m_UboData), reinterpret_cast<const uint32_t*>(&m_UboData));
+			VkTools::InsertMemoryBarrier(commandBuffer,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+
+			m_UniformBufferDirty = false;
+		}
+
+		//Culled draws get their LODs on the GPU, direct draws pick them here
+		if (!Renderer::Resource::DrawCallManager::GetIndirectBufferRef(m_DrawCallRef).isValid())
+		{
+			Renderer::Resource::DrawCallManager::SelectLods({ m_DrawCallRef }, GetViewPosition(), m_LodScale);
+		}
+
+		//Streamed textures bound by the draw call get their mips for the next swap
+		Renderer::Resource::DrawCallManager::RequestTextureMips({ m_DrawCallRef }, GetViewPosition(), m_ProjectionScale);
+
 		Renderer::Vulkan::RenderSystem::BeginRenderPass(m_RenderPassRef, m_FrameBufferRefs[Renderer::Vulkan::RenderSystem::backBufferIndex], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, 2, clearValues);
 		Renderer::Vulkan::DrawCall::QueuDrawCall(m_DrawCallRef, m_FrameBufferRefs[Renderer::Vulkan::RenderSystem::backBufferIndex], m_RenderPassRef, width, height);
 		Renderer::Vulkan::RenderSystem::EndRenderPass();
 	}
 
-	bool RenderPassMesh::LoadShaders(const std::string& vertShader, const std::string& fragShader)
+	void RenderPassMesh::Resize()
+	{
+		UpdateUniformBufferData();
+		m_UniformBufferDirty = true;
+		Renderer::Resource::DrawCallManager::SetPushConstants(m_DrawCallRef, m_DrawConstants);
+	}
+
+	uint32_t RenderPassMesh::AddToRenderGraph()
+	{
+		const uint32_t passIdx = Renderer::RenderGraph::AddPass("Mesh", [this](float dt)
+		{
+			const glm::uvec2& backBufferDimensions = Renderer::Vulkan::RenderSystem::backBufferDimensions;
+			Render(dt, static_cast<float>(backBufferDimensions.x), static_cast<float>(backBufferDimensions.y));
+		}, m_RenderPassRef);
+
+		//Same order as the render pass attachments
+		Renderer::RenderGraph::AddImageUsage(passIdx, m_ColorImageRefs, Renderer::RenderGraphAccess::kColorAttachment, 0u, VK_IMAGE_LAYOUT_UNDEFINED, true);
+		Renderer::RenderGraph::AddImageUsage(passIdx, m_DepthImageRefs, Renderer::RenderGraphAccess::kDepthAttachment, 0u, VK_IMAGE_LAYOUT_UNDEFINED, true);
+
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { Renderer::Resource::DrawCallManager::GetIndirectBufferRef(m_DrawCallRef), Renderer::Resource::DrawCallManager::GetDrawCountBufferRef(m_DrawCallRef) },
+			Renderer::RenderGraphAccess::kIndirectRead);
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { m_InstanceBufferRef, m_DrawInstanceBufferRef }, Renderer::RenderGraphAccess::kStorageRead, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+
+		//Keeps the skinning pass from being culled
+		if (m_SkinnedVertexBufferRef.isValid())
+		{
+			Renderer::RenderGraph::AddBufferUsage(passIdx, { m_SkinnedVertexBufferRef }, Renderer::RenderGraphAccess::kVertexRead);
+		}
+
+		Renderer::RenderGraph::MarkOutput(m_ColorImageRefs);
+
+		return passIdx;
+	}
+
+	std::vector<SkinningRange> RenderPassMesh::GetSkinningRanges() const
+	{
+		std::vector<SkinningRange> ranges;
+		ranges.reserve(m_Submeshes.size());
+
+		for (const Submesh& submesh : m_Submeshes)
+		{
+			ranges.push_back({ static_cast<uint32_t>(submesh.vertexOffset), submesh.vertexCount, submesh.bindPoseQuantization, submesh.quantization });
+		}
+
+		return ranges;
+	}
+
+	void RenderPassMesh::SetSkinnedVertexBuffer(const DOD::Ref& skinnedVertexBufferRef)
+	{
+		//Same stream layout as the bind pose, the stream offsets stay
+		m_SkinnedVertexBufferRef = skinnedVertexBufferRef;
+		Renderer::Resource::DrawCallManager::GetVertexBufferRef(m_DrawCallRef) = skinnedVertexBufferRef;
+	}
+
+	bool RenderPassMesh::LoadShaders(const std::string& vertShader, const std::string& fragSource)
 	{
 		//Create GPU Resource
 		DOD::Ref vert_ref = Renderer::Resource::GpuProgramManager::CreateGPUProgram(vertShader);
-		DOD::Ref frag_ref = Renderer::Resource::GpuProgramManager::CreateGPUProgram(fragShader);
 
 		//Compile and set to created gpu resource reference
 		bool bSaderLoaded = Renderer::Resource::GpuProgramManager::LoadAndCompileShader(vert_ref, "../../Assets/Shaders/", VK_SHADER_STAGE_VERTEX_BIT);
-		bSaderLoaded |= Renderer::Resource::GpuProgramManager::LoadAndCompileShader(frag_ref, "../../Assets/Shaders/", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-		if (bSaderLoaded == false)
+		//Textured and untextured draws are variants of one source, they stay cached by the GpuProgramManager
+		Renderer::Resource::ShaderPermutation fragPermutation;
+		fragPermutation.source = fragSource;
+		fragPermutation.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragPermutation.features = { "ALBEDO_TEXTURE" };
+
+		const uint32_t featureMask = m_AlbedoImageRef.isValid() ? ALBEDO_TEXTURE_FEATURE : 0u;
+		DOD::Ref frag_ref = Renderer::Resource::GpuProgramManager::GetVariant(fragPermutation, featureMask, "../../Assets/Shaders/");
+
+		if (bSaderLoaded == false || !frag_ref.isValid())
 		{
 			Renderer::Resource::GpuProgramManager::destroyResource(vert_ref);
-			Renderer::Resource::GpuProgramManager::destroyResource(frag_ref);
 			return false;
 		}
 
@@ -131,19 +417,44 @@ namespace Renderer
 		return true;
 	}
 
-	void RenderPassMesh::CreatePipelineLayout(const std::string& pipelineLayoutName)
+	bool RenderPassMesh::CreateAlbedoTexture(const std::string& imageName, const std::string& texturePath)
 	{
-		std::vector<DOD::Ref> PipeleinLayoutRefs;
+		//Only the mip tail is loaded here, the draw call requests the finer mips
+		DOD::Ref imageRef = Renderer::Resource::ImageManager::CreateImage(imageName);
+		Renderer::Resource::ImageManager::ResetToDefault(imageRef);
+		Renderer::Resource::ImageManager::GetImageType(imageRef) = ImageType::Enum::kTextureFromFile;
+		Renderer::Resource::ImageManager::GetFileName(imageRef) = texturePath;
 
-		//Set bindings positions
-		m_PipeleinLayoutRef = Renderer::Resource::PipelineLayoutManager::CreatePipelineLayout(pipelineLayoutName);
+		if (!Renderer::Resource::ImageManager::CreateResource(imageRef))
+		{
+			Renderer::Resource::ImageManager::DestroyResource({ imageRef });
+			Renderer::Resource::ImageManager::DestroyImage(imageRef);
+			return false;
+		}
 
-		//Describe at which position uniform and image buffer object goes
-		auto& descriptorSetLayout = Renderer::Resource::PipelineLayoutManager::GetDescriptorSetLayoutBinding(m_PipeleinLayoutRef);
-		descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0));
+		//Views of streamed images only cover the resident mips, so levels are not clamped
+		VkSamplerCreateInfo samplerCreateInfo = VkTools::Initializer::SamplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.minLod = 0.0f;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+		VK_CHECK_RESULT(vkCreateSampler(Renderer::Vulkan::RenderSystem::vkDevice, &samplerCreateInfo, nullptr, &m_AlbedoSampler));
+
+		m_AlbedoImageRef = imageRef;
+		return true;
+	}
 
-		PipeleinLayoutRefs.push_back(m_PipeleinLayoutRef);
-		Renderer::Resource::PipelineLayoutManager::CreateResource(PipeleinLayoutRefs);
+	void RenderPassMesh::CreatePipelineLayout(const std::string& pipelineLayoutName)
+	{
+		//Bindings come from the shaders, the draw call binding infos follow their binding order
+		m_PipeleinLayoutRef = Renderer::Resource::PipelineLayoutManager::CreatePipelineLayoutFromShaders(pipelineLayoutName, { m_VertShaderRef, m_FragShaderRef });
 	}
 
 	void RenderPassMesh::CreateRenderPass(const std::string& renderPassName)
@@ -160,16 +471,26 @@ namespace Renderer
 			false
 		};
 
+		AttachementDescription depthAttachment =
+		{
+			Renderer::Vulkan::RenderSystem::vkDepthFormatToUse,
+			AttachementFlags::kClearOnLoad,
+			true
+		};
+
 		Renderer::Resource::RenderPassManager::GetAttachementDescription(m_RenderPassRef).push_back(sceneAttachment);
+		Renderer::Resource::RenderPassManager::GetAttachementDescription(m_RenderPassRef).push_back(depthAttachment);
 
 		RenderPassRefs.push_back(m_RenderPassRef);
 		Renderer::Resource::RenderPassManager::CreateResource(RenderPassRefs);
 	}
 
-	void RenderPassMesh::CreateFramBuffer(const std::string& frameBufferName)
+	void RenderPassMesh::CreateImages(const std::string& frameBufferName)
 	{
-		m_FrameBufferRefs.clear();
-		m_FrameBufferRefs.reserve(Renderer::Vulkan::RenderSystem::vkSwapchainImages.size());
+		m_ColorImageRefs.clear();
+		m_ColorImageRefs.reserve(Renderer::Vulkan::RenderSystem::vkSwapchainImages.size());
+		m_DepthImageRefs.clear();
+		m_DepthImageRefs.reserve(Renderer::Vulkan::RenderSystem::vkSwapchainImages.size());
 
 		for (int backBufferIndex = 0; backBufferIndex < Renderer::Vulkan::RenderSystem::vkSwapchainImages.size(); backBufferIndex++)
 		{
@@ -177,15 +498,36 @@ namespace Renderer
 			std::string imageName = frameBufferName + std::to_string(backBufferIndex) + "_Image";
 			DOD::Ref imageRef = Renderer::Resource::ImageManager::CreateImage(imageName);
 			Renderer::Resource::ImageManager::ResetToDefault(imageRef);
-			Renderer::Resource::ImageManager::GetImageDimensions(imageRef) = glm::uvec3(800, 600, 1u);
+			Renderer::Resource::ImageManager::GetResolutionScale(imageRef) = 1.0f;
 			Renderer::Resource::ImageManager::GetImageFormat(imageRef) = Renderer::Vulkan::RenderSystem::vkColorFormatToUse;
-			Renderer::Resource::ImageManager::CreateResource(imageRef);
+			Renderer::Resource::ImageManager::GetMemoryPoolType(imageRef) = MemoryPoolTypes::kResolutionDependentImages;
+
+			//Depth is sampled by the Hi-Z build after the pass
+			std::string depthImageName = frameBufferName + std::to_string(backBufferIndex) + "_DepthImage";
+			DOD::Ref depthImageRef = Renderer::Resource::ImageManager::CreateImage(depthImageName);
+			Renderer::Resource::ImageManager::ResetToDefault(depthImageRef);
+			Renderer::Resource::ImageManager::GetResolutionScale(depthImageRef) = 1.0f;
+			Renderer::Resource::ImageManager::GetImageFormat(depthImageRef) = Renderer::Vulkan::RenderSystem::vkDepthFormatToUse;
+			Renderer::Resource::ImageManager::GetMemoryPoolType(depthImageRef) = MemoryPoolTypes::kResolutionDependentImages;
+
+			m_ColorImageRefs.push_back(imageRef);
+			m_DepthImageRefs.push_back(depthImageRef);
+		}
+	}
+
+	void RenderPassMesh::CreateFramBuffer(const std::string& frameBufferName)
+	{
+		m_FrameBufferRefs.clear();
+		m_FrameBufferRefs.reserve(m_ColorImageRefs.size());
 
+		for (uint32_t backBufferIndex = 0u; backBufferIndex < m_ColorImageRefs.size(); backBufferIndex++)
+		{
 			std::string frBufferName = frameBufferName + std::to_string(backBufferIndex);
 			DOD::Ref frame_buffer_Ref = Renderer::Resource::FrameBufferManager::CreateFrameBuffer(frBufferName);
 			Renderer::Resource::FrameBufferManager::ResetToDefault(frame_buffer_Ref);
 			Renderer::Resource::FrameBufferManager::GetDimensions(frame_buffer_Ref) = Renderer::Vulkan::RenderSystem::backBufferDimensions;
-			Renderer::Resource::FrameBufferManager::GetAttachedImiges(frame_buffer_Ref).push_back(imageRef);
+			Renderer::Resource::FrameBufferManager::GetAttachedImiges(frame_buffer_Ref).push_back(m_ColorImageRefs[backBufferIndex]);
+			Renderer::Resource::FrameBufferManager::GetAttachedImiges(frame_buffer_Ref).push_back(m_DepthImageRefs[backBufferIndex]);
 			Renderer::Resource::FrameBufferManager::GetRenderPassRef(frame_buffer_Ref) = m_RenderPassRef;
 			Renderer::Resource::FrameBufferManager::CreateResource(frame_buffer_Ref);
 
@@ -198,15 +540,18 @@ namespace Renderer
 		m_BufferLayoutRef = Renderer::Resource::BufferLayoutManager::CreateBufferLayout("BufferLayout1");
 		auto& buffer_layout_description = Renderer::Resource::BufferLayoutManager::GetBufferLayoutDescription(m_BufferLayoutRef);
 
-		//Describe layout of data that will be sent from cpu to gpu
+		//Core::Mesh packed streams, position only in binding 0 and the remaining attributes in binding 1
 		buffer_layout_description =
 		{
-			{0, Renderer::Resource::BufferObjectType::VERTEX, VK_FORMAT_R32G32B32_SFLOAT},
-			{1, Renderer::Resource::BufferObjectType::COLOR, VK_FORMAT_R32G32B32_SFLOAT},
-			{2, Renderer::Resource::BufferObjectType::TEX, VK_FORMAT_R32G32_SFLOAT}
+			{0, Renderer::Resource::BufferObjectType::VERTEX, VK_FORMAT_R16G16B16A16_SNORM, 0},
+			{3, Renderer::Resource::BufferObjectType::NORMAL, VK_FORMAT_R16G16_SNORM, 1},
+			{4, Renderer::Resource::BufferObjectType::TANGENT, VK_FORMAT_A2B10G10R10_UNORM_PACK32, 1},
+			{2, Renderer::Resource::BufferObjectType::TEX, VK_FORMAT_R16G16_SFLOAT, 1},
+			{1, Renderer::Resource::BufferObjectType::COLOR, VK_FORMAT_R8G8B8A8_UNORM, 1}
 		};
 
-		Renderer::Resource::BufferLayoutManager::CreateResource(m_BufferLayoutRef);
+		//Streams the vertex shader does not read stay in the stride only
+		Renderer::Resource::BufferLayoutManager::CreateResource(m_BufferLayoutRef, m_VertShaderRef);
 	}
 
 	void RenderPassMesh::CreatePipeline(const std::string& pipelineName)
@@ -221,7 +566,8 @@ namespace Renderer
 		Renderer::Resource::PipelineManager::GetbufferLayoutRef(m_PipelineRef)	= m_BufferLayoutRef;
 		PipelineRefs.push_back(m_PipelineRef);
 
-		Renderer::Resource::PipelineManager::CreateResource(PipelineRefs);
+		//Compiled while the mesh loads, draws are skipped until it is ready
+		Renderer::Resource::PipelineManager::CreateResourceAsync(PipelineRefs);
 	}
 
 	DOD::Ref RenderPassMesh::CreateBuffer(const std::string& name, VkBufferUsageFlagBits usage, void* bufferData, int32_t bufferSize)
@@ -233,6 +579,9 @@ namespace Renderer
 		Renderer::Resource::BufferObjectManager::GetBufferData(bufferRef) = bufferData;
 		Renderer::Resource::BufferObjectManager::CreateResource(bufferRef, Renderer::Vulkan::RenderSystem::vkPhysicalDeviceMemoryProperties);
 
+		//Data is uploaded, it points at locals or the mesh file which is unmapped after loading
+		Renderer::Resource::BufferObjectManager::GetBufferData(bufferRef) = nullptr;
+
 		return bufferRef;
 	}
 
@@ -255,12 +604,35 @@ namespace Renderer
 
 		auto& binding_infos = Renderer::Resource::DrawCallManager::GetBindingInfo(drawCallRef);
 		binding_infos.push_back(std::move(Renderer::Resource::BindingInfo{ 0, m_UniformBufferRef }));
+		binding_infos.push_back(std::move(Renderer::Resource::BindingInfo{ 1, m_InstanceBufferRef }));
+		binding_infos.push_back(std::move(Renderer::Resource::BindingInfo{ 2, m_DrawInstanceBufferRef }));
+
+		if (m_AlbedoImageRef.isValid())
+		{
+			Renderer::Resource::BindingInfo albedoInfo = { 3, DOD::Ref() };
+			albedoInfo.image_ref = m_AlbedoImageRef;
+			albedoInfo.sampler = m_AlbedoSampler;
+			binding_infos.push_back(albedoInfo);
+		}
 
 		Renderer::Resource::DrawCallManager::GetIndexCount(drawCallRef) = indexBufferSize;
+
+		//Direct draws have no per instance LODs, the first submesh provides them
+		const Submesh& submesh = m_Submeshes.front();
+		const InstanceData& instance = m_InstanceData.front();
+		Renderer::Resource::DrawCallManager::GetLods(drawCallRef).assign(m_Lods.begin() + submesh.firstLod, m_Lods.begin() + submesh.firstLod + submesh.lodCount);
+		Renderer::Resource::DrawCallManager::GetBoundingSphere(drawCallRef) = glm::vec4(glm::vec3(instance.modelMatrix * glm::vec4(glm::vec3(submesh.boundingSphere), 1.0f)), submesh.boundingSphere.w);
+
+		Renderer::Resource::DrawCallManager::GetClusterBufferRef(drawCallRef) = m_ClusterBufferRef;
+		Renderer::Resource::DrawCallManager::GetFirstCluster(drawCallRef) = 0u;
+		Renderer::Resource::DrawCallManager::GetClusterCount(drawCallRef) = static_cast<uint32_t>(m_Clusters.size());
 		Renderer::Resource::DrawCallManager::GetIndexBufferRef(drawCallRef) = m_StagingBufferIndicesRef;
+		Renderer::Resource::DrawCallManager::GetIndexType(drawCallRef) = m_IndexType;
 		Renderer::Resource::DrawCallManager::GetVertexBufferRef(drawCallRef) = m_StagingBufferVerticesRef;
+		Renderer::Resource::DrawCallManager::GetVertexStreamOffsets(drawCallRef) = m_VertexStreamOffsets;
 		Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(drawCallRef) = m_PipeleinLayoutRef;
 		Renderer::Resource::DrawCallManager::GetPipelineRef(drawCallRef) = m_PipelineRef;
+		Renderer::Resource::DrawCallManager::SetPushConstants(drawCallRef, m_DrawConstants);
 
 		drawCallsToCreate.push_back(drawCallRef);
 		Renderer::Resource::DrawCallManager::CreateResource(drawCallsToCreate);
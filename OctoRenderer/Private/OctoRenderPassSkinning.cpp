@@ -0,0 +1,225 @@
+#include "OctoRenderPassSkinning.h"
+#include "OctoRenderGraph.h"
+#include "Vulkan\VkPipelineLayoutManager.h"
+#include "Vulkan\VkRenderSystem.h"
+#include "Vulkan\VkGpuProgram.h"
+#include "Vulkan\VulkanTools.h"
+#include "Vulkan\VkPipelineManager.h"
+#include "Vulkan\DrawCallManager.h"
+#include "Vulkan\VkDrawCallDispatcher.h"
+#include "Vulkan\VkBufferObjectManager.h"
+#include "OctoCore/Public/VertexPacking.h"
+
+//Other
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#define SKINNING_GROUP_SIZE 64u
+
+//Feature bit of the skinning.comp permutation, a specialization constant
+#define DUAL_QUATERNION_FEATURE (1u << 0u)
+
+//Largest size vkCmdUpdateBuffer accepts at once
+#define MAX_UPDATE_BUFFER_SIZE 65536u
+
+namespace Renderer
+{
+	void RenderPassSkinning::Init(const Skeleton& skeleton, const DOD::Ref& vertexBufferRef, VkDeviceSize attributeStreamOffset,
+		const DOD::Ref& skinBufferRef, uint32_t vertexCount, SkinningMethod::Enum method, const std::vector<SkinningRange>& ranges)
+	{
+		assert(skeleton.GetJointCount() > 0u && skeleton.GetJointCount() <= 256u);
+
+		m_Skeleton = skeleton;
+		m_Method = method;
+		m_VertexBufferRef = vertexBufferRef;
+		m_SkinBufferRef = skinBufferRef;
+		m_VertexDataSize = attributeStreamOffset + static_cast<VkDeviceSize>(vertexCount) * sizeof(Core::Mesh::PackedAttributes);
+
+		m_SkinningParams.clear();
+		for (const SkinningRange& range : ranges)
+		{
+			assert(range.firstVertex + range.vertexCount <= vertexCount);
+
+			SkinningParams params;
+			memset(&params, 0, sizeof(params));
+			params.vertexCount = range.vertexCount;
+			params.attributeOffset = static_cast<uint32_t>(attributeStreamOffset / sizeof(uint32_t));
+			params.jointCount = skeleton.GetJointCount();
+			params.firstVertex = range.firstVertex;
+			params.bindPoseOffset = glm::vec4(range.bindPoseQuantization.offset, 0.0f);
+			params.bindPoseScale = glm::vec4(range.bindPoseQuantization.scale, 0.0f);
+			params.skinnedOffset = glm::vec4(range.skinnedQuantization.offset, 0.0f);
+			params.skinnedScale = glm::vec4(range.skinnedQuantization.scale, 0.0f);
+			m_SkinningParams.push_back(params);
+		}
+
+		//Bind pose until the first SetPose()
+		JointMat identity = {};
+		identity.mat[0][0] = identity.mat[1][1] = identity.mat[2][2] = 1.0f;
+		m_LinearBlendPalette.assign(skeleton.GetJointCount(), identity);
+		m_DualQuatPalette.assign(skeleton.GetJointCount(), JointDualQuat{ glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f) });
+
+		LoadShader("skinning.comp");
+		CreatePipelineLayout("RenderPassSkinning_PipelineLayout");
+		CreatePipeline("RenderPassSkinning_Pipeline");
+		CreateBuffers("RenderPassSkinning");
+		CreateDispatch("RenderPassSkinning_Dispatch");
+	}
+
+	void RenderPassSkinning::Destroy()
+	{
+		Renderer::Resource::DrawCallManager::DestroyDrawCallsAndResources(m_DispatchRefs);
+		Renderer::Resource::PipelineManager::DestroyPipelineAndResources({ m_PipelineRef });
+		Renderer::Resource::PipelineLayoutManager::DestroyPipelineLayoutAndResources({ m_PipelineLayoutRef });
+		Renderer::Resource::BufferObjectManager::DestroyResources({ m_PaletteBufferRef, m_SkinnedVertexBufferRef });
+	}
+
+	void RenderPassSkinning::SetPose(const SkeletonPose& pose)
+	{
+		SkeletonEvaluator::LocalToModel(m_Skeleton, pose, m_ModelPose);
+
+		if (m_Method == SkinningMethod::kDualQuaternion)
+		{
+			SkeletonEvaluator::BuildDualQuatPalette(m_Skeleton, m_ModelPose, m_DualQuatPalette);
+		}
+		else
+		{
+			SkeletonEvaluator::BuildLinearBlendPalette(m_Skeleton, m_ModelPose, m_LinearBlendPalette);
+		}
+	}
+
+	void RenderPassSkinning::Skin()
+	{
+		VkCommandBuffer commandBuffer = Renderer::Vulkan::RenderSystem::GetPrimaryCommandBuffer();
+		const VkBuffer& paletteBuffer = Renderer::Resource::BufferObjectManager::GetBufferObject(m_PaletteBufferRef).buffer;
+
+		const uint8_t* paletteData = m_Method == SkinningMethod::kDualQuaternion
+			? reinterpret_cast<const uint8_t*>(m_DualQuatPalette.data())
+			: reinterpret_cast<const uint8_t*>(m_LinearBlendPalette.data());
+		const VkDeviceSize paletteSize = Renderer::Resource::BufferObjectManager::GetBufferSize(m_PaletteBufferRef);
+
+		//Recorded into the frame, so the palette read by the previous frame is never overwritten under it
+		for (VkDeviceSize offset = 0u; offset < paletteSize; offset += MAX_UPDATE_BUFFER_SIZE)
+		{
+			const VkDeviceSize size = std::min<VkDeviceSize>(paletteSize - offset, MAX_UPDATE_BUFFER_SIZE);
+			vkCmdUpdateBuffer(commandBuffer, paletteBuffer, offset, size, reinterpret_cast<const uint32_t*>(paletteData + offset));
+		}
+
+		VkTools::InsertMemoryBarrier(commandBuffer,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		for (uint32_t i = 0u; i < m_DispatchRefs.size(); i++)
+		{
+			const uint32_t groupCount = (m_SkinningParams[i].vertexCount + SKINNING_GROUP_SIZE - 1u) / SKINNING_GROUP_SIZE;
+			Renderer::Vulkan::DrawCall::QueueDispatch(m_DispatchRefs[i], groupCount);
+		}
+	}
+
+	uint32_t RenderPassSkinning::AddToRenderGraph()
+	{
+		const uint32_t passIdx = Renderer::RenderGraph::AddPass("Skinning", [this](float dt) { Skin(); });
+
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { m_PaletteBufferRef },
+			Renderer::RenderGraphAccess::kTransferWrite | Renderer::RenderGraphAccess::kStorageRead, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { m_VertexBufferRef, m_SkinBufferRef }, Renderer::RenderGraphAccess::kStorageRead, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { m_SkinnedVertexBufferRef }, Renderer::RenderGraphAccess::kStorageWrite, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		return passIdx;
+	}
+
+	bool RenderPassSkinning::LoadShader(const std::string& skinningSource)
+	{
+		//Both methods share one SPIR-V, the method is a specialization constant
+		Renderer::Resource::ShaderPermutation permutation;
+		permutation.source = skinningSource;
+		permutation.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		permutation.features = { "DUAL_QUATERNION" };
+		permutation.specializedFeatures = DUAL_QUATERNION_FEATURE;
+
+		const uint32_t featureMask = m_Method == SkinningMethod::kDualQuaternion ? DUAL_QUATERNION_FEATURE : 0u;
+		DOD::Ref skinning_ref = Renderer::Resource::GpuProgramManager::GetVariant(permutation, featureMask, "../../Assets/Shaders/");
+
+		if (!skinning_ref.isValid())
+		{
+			return false;
+		}
+
+		m_SkinningShaderRef = skinning_ref;
+
+		return true;
+	}
+
+	void RenderPassSkinning::CreatePipelineLayout(const std::string& pipelineLayoutName)
+	{
+		std::vector<DOD::Ref> PipeleinLayoutRefs;
+
+		//Bind pose, skin, palette and skinned vertices, the parameters are push constants
+		m_PipelineLayoutRef = Renderer::Resource::PipelineLayoutManager::CreatePipelineLayout(pipelineLayoutName);
+		auto& descriptorSetLayout = Renderer::Resource::PipelineLayoutManager::GetDescriptorSetLayoutBinding(m_PipelineLayoutRef);
+		descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1));
+		descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2));
+		descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3));
+		descriptorSetLayout.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4));
+
+		auto& pushConstantRanges = Renderer::Resource::PipelineLayoutManager::GetPushConstantRanges(m_PipelineLayoutRef);
+		pushConstantRanges.push_back(VkTools::Initializer::PushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SkinningParams), 0));
+
+		PipeleinLayoutRefs.push_back(m_PipelineLayoutRef);
+		Renderer::Resource::PipelineLayoutManager::CreateResource(PipeleinLayoutRefs);
+	}
+
+	void RenderPassSkinning::CreatePipeline(const std::string& pipelineName)
+	{
+		std::vector<DOD::Ref> PipelineRefs;
+
+		m_PipelineRef = Renderer::Resource::PipelineManager::CreatePipeline(pipelineName);
+		Renderer::Resource::PipelineManager::GetComputeShader(m_PipelineRef) = m_SkinningShaderRef;
+		Renderer::Resource::PipelineManager::GetPipelineLayoutRef(m_PipelineRef) = m_PipelineLayoutRef;
+		PipelineRefs.push_back(m_PipelineRef);
+
+		Renderer::Resource::PipelineManager::CreateResource(PipelineRefs);
+	}
+
+	void RenderPassSkinning::CreateBuffers(const std::string& bufferName)
+	{
+		//Written every frame before the dispatch
+		const VkDeviceSize paletteEntrySize = m_Method == SkinningMethod::kDualQuaternion ? sizeof(JointDualQuat) : sizeof(JointMat);
+		m_PaletteBufferRef = Renderer::Resource::BufferObjectManager::CreateBufferOjbect(bufferName + "_Palette");
+		Renderer::Resource::BufferObjectManager::GetBufferSize(m_PaletteBufferRef) = m_Skeleton.GetJointCount() * paletteEntrySize;
+		Renderer::Resource::BufferObjectManager::GetBufferUsageFlag(m_PaletteBufferRef) = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		Renderer::Resource::BufferObjectManager::GetBufferData(m_PaletteBufferRef) = nullptr;
+		Renderer::Resource::BufferObjectManager::CreateResource(m_PaletteBufferRef, Renderer::Vulkan::RenderSystem::vkPhysicalDeviceMemoryProperties);
+
+		m_SkinnedVertexBufferRef = Renderer::Resource::BufferObjectManager::CreateBufferOjbect(bufferName + "_SkinnedVertices");
+		Renderer::Resource::BufferObjectManager::GetBufferSize(m_SkinnedVertexBufferRef) = m_VertexDataSize;
+		Renderer::Resource::BufferObjectManager::GetBufferUsageFlag(m_SkinnedVertexBufferRef) = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		Renderer::Resource::BufferObjectManager::GetBufferData(m_SkinnedVertexBufferRef) = nullptr;
+		Renderer::Resource::BufferObjectManager::CreateResource(m_SkinnedVertexBufferRef, Renderer::Vulkan::RenderSystem::vkPhysicalDeviceMemoryProperties);
+	}
+
+	void RenderPassSkinning::CreateDispatch(const std::string& dispatchName)
+	{
+		//Ranges share the buffers, only their push constants differ
+		m_DispatchRefs.clear();
+		for (uint32_t i = 0u; i < m_SkinningParams.size(); i++)
+		{
+			DOD::Ref dispatchRef = Renderer::Resource::DrawCallManager::CreateDrawCall(dispatchName + std::to_string(i));
+
+			auto& binding_infos = Renderer::Resource::DrawCallManager::GetBindingInfo(dispatchRef);
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 1, m_VertexBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 2, m_SkinBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 3, m_PaletteBufferRef });
+			binding_infos.push_back(Renderer::Resource::BindingInfo{ 4, m_SkinnedVertexBufferRef });
+
+			Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(dispatchRef) = m_PipelineLayoutRef;
+			Renderer::Resource::DrawCallManager::GetPipelineRef(dispatchRef) = m_PipelineRef;
+			Renderer::Resource::DrawCallManager::SetPushConstants(dispatchRef, m_SkinningParams[i]);
+
+			m_DispatchRefs.push_back(dispatchRef);
+		}
+
+		Renderer::Resource::DrawCallManager::CreateResource(m_DispatchRefs);
+	}
+}
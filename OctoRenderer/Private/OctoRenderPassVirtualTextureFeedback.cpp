@@ -0,0 +1,326 @@
+#include "OctoRenderPassVirtualTextureFeedback.h"
+#include "OctoRenderPassMesh.h"
+#include "OctoRenderGraph.h"
+#include "Vulkan\VkRenderPassManager.h"
+#include "Vulkan\VkGPUMemoryManager.h"
+#include "Vulkan\VkPipelineLayoutManager.h"
+#include "Vulkan\VkFrameBufferManager.h"
+#include "Vulkan\VkImageManager.h"
+#include "Vulkan\VkRenderSystem.h"
+#include "Vulkan\VkGpuProgram.h"
+#include "Vulkan\VulkanTools.h"
+#include "Vulkan\VkPipelineManager.h"
+#include "Vulkan\DrawCallManager.h"
+#include "Vulkan\VkDrawCallDispatcher.h"
+#include "Vulkan\VkVirtualTexture.h"
+
+//Other
+#include <algorithm>
+
+//Feedback is rendered at an eighth of the back buffer, the shader biases the mip by log2 of it
+#define FEEDBACK_RESOLUTION_SCALE 0.125f
+#define FEEDBACK_MIP_BIAS -3.0f
+
+//Largest feedback target read back, larger ones only have their top left corner read
+#define FEEDBACK_MAX_EXTENT 512u
+
+namespace Renderer
+{
+	void RenderPassVirtualTextureFeedback::Init(RenderPassMesh& meshPass, uint32_t textureId)
+	{
+		m_TextureId = textureId;
+
+		LoadShaders("vt_feedback.vert.spv", "vt_feedback.frag.spv");
+		m_PipelineLayoutRef = Renderer::Resource::PipelineLayoutManager::CreatePipelineLayoutFromShaders("RenderPassVirtualTextureFeedback_PipelineLayout", { m_VertShaderRef, m_FragShaderRef });
+		CreateRenderPass("RenderPassVirtualTextureFeedback_RenderPass");
+		CreateImages("RenderPassVirtualTextureFeedback_FrameBuffer");
+		CreatePipeline("RenderPassVirtualTextureFeedback_Pipeline", meshPass);
+		CreateReadbackBuffers();
+		CreateDrawCall("RenderPassVirtualTextureFeedbackDrawCall", meshPass);
+	}
+
+	void RenderPassVirtualTextureFeedback::InitAfterCompile()
+	{
+		CreateFrameBuffer("RenderPassVirtualTextureFeedback_FrameBuffer");
+	}
+
+	void RenderPassVirtualTextureFeedback::Destroy()
+	{
+		Renderer::Resource::DrawCallManager::DestroyDrawCallsAndResources({ m_DrawCallRef });
+		Renderer::Resource::PipelineManager::DestroyPipelineAndResources({ m_PipelineRef });
+		Renderer::Resource::PipelineLayoutManager::ReleasePipelineLayout(m_PipelineLayoutRef);
+		Renderer::Resource::FrameBufferManager::DestroyFrameBufferAndResources(m_FrameBufferRefs);
+		Renderer::Resource::RenderPassManager::DestroyRenderPassAndResources({ m_RenderPassRef });
+
+		std::vector<DOD::Ref> imageRefs = m_FeedbackImageRefs;
+		imageRefs.insert(imageRefs.end(), m_DepthImageRefs.begin(), m_DepthImageRefs.end());
+		Renderer::Resource::ImageManager::DestroyResource(imageRefs);
+		for (const auto& imageRef : imageRefs)
+		{
+			Renderer::Resource::ImageManager::DestroyImage(imageRef);
+		}
+
+		for (const auto& readbackBuffer : m_ReadbackBuffers)
+		{
+			vkDestroyBuffer(Renderer::Vulkan::RenderSystem::vkDevice, readbackBuffer.buffer, nullptr);
+		}
+		m_ReadbackBuffers.clear();
+	}
+
+	void RenderPassVirtualTextureFeedback::Resize()
+	{
+		for (auto& readbackBuffer : m_ReadbackBuffers)
+		{
+			readbackBuffer.extent = glm::uvec2(0u);
+		}
+	}
+
+	void RenderPassVirtualTextureFeedback::Render(float dt)
+	{
+		const uint32_t backBufferIndex = Renderer::Vulkan::RenderSystem::backBufferIndex;
+
+		//Fence of the back buffer was waited on, the copy of its last frame is done
+		ReadbackBuffer& readbackBuffer = m_ReadbackBuffers[backBufferIndex];
+		if (readbackBuffer.extent.x > 0u)
+		{
+			const uint32_t* texels = reinterpret_cast<const uint32_t*>(readbackBuffer.memoryAllocationInfo._mappedMemory);
+			Renderer::Resource::VirtualTextureSystem::AddFeedback(texels, static_cast<size_t>(readbackBuffer.extent.x) * readbackBuffer.extent.y);
+		}
+
+		VkClearValue clearValues[2];
+		clearValues[0].color.uint32[0] = Renderer::Resource::VIRTUAL_TEXTURE_NO_FEEDBACK;
+		clearValues[0].color.uint32[1] = 0u;
+		clearValues[0].color.uint32[2] = 0u;
+		clearValues[0].color.uint32[3] = 0u;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		const glm::uvec3& dimensions = Renderer::Resource::ImageManager::GetImageDimensions(m_FeedbackImageRefs[backBufferIndex]);
+		Renderer::Vulkan::RenderSystem::BeginRenderPass(m_RenderPassRef, m_FrameBufferRefs[backBufferIndex], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, 2, clearValues);
+		Renderer::Vulkan::DrawCall::QueuDrawCall(m_DrawCallRef, m_FrameBufferRefs[backBufferIndex], m_RenderPassRef, static_cast<float>(dimensions.x), static_cast<float>(dimensions.y));
+		Renderer::Vulkan::RenderSystem::EndRenderPass();
+	}
+
+	void RenderPassVirtualTextureFeedback::Readback()
+	{
+		const uint32_t backBufferIndex = Renderer::Vulkan::RenderSystem::backBufferIndex;
+		VkCommandBuffer commandBuffer = Renderer::Vulkan::RenderSystem::GetPrimaryCommandBuffer();
+
+		const DOD::Ref& feedbackImageRef = m_FeedbackImageRefs[backBufferIndex];
+		const glm::uvec3& dimensions = Renderer::Resource::ImageManager::GetImageDimensions(feedbackImageRef);
+		ReadbackBuffer& readbackBuffer = m_ReadbackBuffers[backBufferIndex];
+		readbackBuffer.extent = glm::min(glm::uvec2(dimensions), glm::uvec2(FEEDBACK_MAX_EXTENT));
+
+		VkBufferImageCopy region = {};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, 0u, 1u };
+		region.imageExtent = { readbackBuffer.extent.x, readbackBuffer.extent.y, 1u };
+
+		//Layout transition was inserted by the render graph
+		vkCmdCopyImageToBuffer(commandBuffer, Renderer::Resource::ImageManager::GetVkImage(feedbackImageRef), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, 1u, &region);
+		VkTools::InsertMemoryBarrier(commandBuffer,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+	}
+
+	uint32_t RenderPassVirtualTextureFeedback::AddToRenderGraph(const RenderPassMesh& meshPass)
+	{
+		const uint32_t passIdx = Renderer::RenderGraph::AddPass("VirtualTextureFeedback", [this](float dt) { Render(dt); }, m_RenderPassRef);
+
+		//Same order as the render pass attachments
+		Renderer::RenderGraph::AddImageUsage(passIdx, m_FeedbackImageRefs, Renderer::RenderGraphAccess::kColorAttachment, 0u, VK_IMAGE_LAYOUT_UNDEFINED, true);
+		Renderer::RenderGraph::AddImageUsage(passIdx, m_DepthImageRefs, Renderer::RenderGraphAccess::kDepthAttachment, 0u, VK_IMAGE_LAYOUT_UNDEFINED, true);
+
+		const DOD::Ref& meshDrawCallRef = meshPass.GetDrawCallRef();
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { Renderer::Resource::DrawCallManager::GetIndirectBufferRef(meshDrawCallRef), Renderer::Resource::DrawCallManager::GetDrawCountBufferRef(meshDrawCallRef) },
+			Renderer::RenderGraphAccess::kIndirectRead);
+		Renderer::RenderGraph::AddBufferUsage(passIdx, { meshPass.GetInstanceBufferRef(), meshPass.GetDrawInstanceBufferRef() }, Renderer::RenderGraphAccess::kStorageRead, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+
+		if (meshPass.GetSkinnedVertexBufferRef().isValid())
+		{
+			Renderer::RenderGraph::AddBufferUsage(passIdx, { meshPass.GetSkinnedVertexBufferRef() }, Renderer::RenderGraphAccess::kVertexRead);
+		}
+
+		//Host reads the copy, nothing in the graph consumes it
+		const uint32_t readbackPassIdx = Renderer::RenderGraph::AddPass("VirtualTextureReadback", [this](float dt) { Readback(); });
+		Renderer::RenderGraph::AddImageUsage(readbackPassIdx, m_FeedbackImageRefs, Renderer::RenderGraphAccess::kTransferRead, 0u, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		Renderer::RenderGraph::MarkPassSideEffects(readbackPassIdx);
+
+		return passIdx;
+	}
+
+	bool RenderPassVirtualTextureFeedback::LoadShaders(const std::string& vertShader, const std::string& fragShader)
+	{
+		DOD::Ref vert_ref = Renderer::Resource::GpuProgramManager::CreateGPUProgram(vertShader);
+		DOD::Ref frag_ref = Renderer::Resource::GpuProgramManager::CreateGPUProgram(fragShader);
+
+		bool bSaderLoaded = Renderer::Resource::GpuProgramManager::LoadAndCompileShader(vert_ref, "../../Assets/Shaders/", VK_SHADER_STAGE_VERTEX_BIT);
+		bSaderLoaded &= Renderer::Resource::GpuProgramManager::LoadAndCompileShader(frag_ref, "../../Assets/Shaders/", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		if (bSaderLoaded == false)
+		{
+			Renderer::Resource::GpuProgramManager::destroyResource(vert_ref);
+			Renderer::Resource::GpuProgramManager::destroyResource(frag_ref);
+			return false;
+		}
+
+		m_VertShaderRef = vert_ref;
+		m_FragShaderRef = frag_ref;
+
+		return true;
+	}
+
+	void RenderPassVirtualTextureFeedback::CreateRenderPass(const std::string& renderPassName)
+	{
+		m_RenderPassRef = Renderer::Resource::RenderPassManager::CreateRenderPass(renderPassName);
+		Renderer::Resource::RenderPassManager::ResetToDefault(m_RenderPassRef);
+
+		AttachementDescription feedbackAttachment =
+		{
+			VK_FORMAT_R32_UINT,
+			AttachementFlags::kClearOnLoad,
+			false
+		};
+
+		//Depth of the feedback resolution, tiles hidden behind other geometry are not requested
+		AttachementDescription depthAttachment =
+		{
+			Renderer::Vulkan::RenderSystem::vkDepthFormatToUse,
+			AttachementFlags::kClearOnLoad | AttachementFlags::kDiscardOnStore,
+			true
+		};
+
+		Renderer::Resource::RenderPassManager::GetAttachementDescription(m_RenderPassRef).push_back(feedbackAttachment);
+		Renderer::Resource::RenderPassManager::GetAttachementDescription(m_RenderPassRef).push_back(depthAttachment);
+		Renderer::Resource::RenderPassManager::CreateResource({ m_RenderPassRef });
+	}
+
+	void RenderPassVirtualTextureFeedback::CreateImages(const std::string& frameBufferName)
+	{
+		const size_t backBufferCount = Renderer::Vulkan::RenderSystem::vkSwapchainImages.size();
+		m_FeedbackImageRefs.clear();
+		m_FeedbackImageRefs.reserve(backBufferCount);
+		m_DepthImageRefs.clear();
+		m_DepthImageRefs.reserve(backBufferCount);
+
+		for (uint32_t backBufferIndex = 0u; backBufferIndex < backBufferCount; backBufferIndex++)
+		{
+			DOD::Ref imageRef = Renderer::Resource::ImageManager::CreateImage(frameBufferName + std::to_string(backBufferIndex) + "_Image");
+			Renderer::Resource::ImageManager::ResetToDefault(imageRef);
+			Renderer::Resource::ImageManager::GetResolutionScale(imageRef) = FEEDBACK_RESOLUTION_SCALE;
+			Renderer::Resource::ImageManager::GetImageFormat(imageRef) = VK_FORMAT_R32_UINT;
+			Renderer::Resource::ImageManager::GetMemoryPoolType(imageRef) = MemoryPoolTypes::kResolutionDependentImages;
+
+			DOD::Ref depthImageRef = Renderer::Resource::ImageManager::CreateImage(frameBufferName + std::to_string(backBufferIndex) + "_DepthImage");
+			Renderer::Resource::ImageManager::ResetToDefault(depthImageRef);
+			Renderer::Resource::ImageManager::GetResolutionScale(depthImageRef) = FEEDBACK_RESOLUTION_SCALE;
+			Renderer::Resource::ImageManager::GetImageFormat(depthImageRef) = Renderer::Vulkan::RenderSystem::vkDepthFormatToUse;
+			Renderer::Resource::ImageManager::GetImageFlags(depthImageRef) = ImageFlags::kUsageAttachment;
+			Renderer::Resource::ImageManager::GetMemoryPoolType(depthImageRef) = MemoryPoolTypes::kResolutionDependentImages;
+
+			m_FeedbackImageRefs.push_back(imageRef);
+			m_DepthImageRefs.push_back(depthImageRef);
+		}
+	}
+
+	void RenderPassVirtualTextureFeedback::CreateFrameBuffer(const std::string& frameBufferName)
+	{
+		m_FrameBufferRefs.clear();
+		m_FrameBufferRefs.reserve(m_FeedbackImageRefs.size());
+
+		for (uint32_t backBufferIndex = 0u; backBufferIndex < m_FeedbackImageRefs.size(); backBufferIndex++)
+		{
+			const DOD::Ref& imageRef = m_FeedbackImageRefs[backBufferIndex];
+			const glm::uvec3& dimensions = Renderer::Resource::ImageManager::GetImageDimensions(imageRef);
+			DOD::Ref frameBufferRef = Renderer::Resource::FrameBufferManager::CreateFrameBuffer(frameBufferName + std::to_string(backBufferIndex));
+			Renderer::Resource::FrameBufferManager::ResetToDefault(frameBufferRef);
+			Renderer::Resource::FrameBufferManager::GetDimensions(frameBufferRef) = glm::uvec2(dimensions.x, dimensions.y);
+			Renderer::Resource::FrameBufferManager::GetAttachedImiges(frameBufferRef).push_back(imageRef);
+			Renderer::Resource::FrameBufferManager::GetAttachedImiges(frameBufferRef).push_back(m_DepthImageRefs[backBufferIndex]);
+			Renderer::Resource::FrameBufferManager::GetRenderPassRef(frameBufferRef) = m_RenderPassRef;
+			Renderer::Resource::FrameBufferManager::CreateResource(frameBufferRef);
+
+			m_FrameBufferRefs.push_back(frameBufferRef);
+		}
+	}
+
+	void RenderPassVirtualTextureFeedback::CreatePipeline(const std::string& pipelineName, const RenderPassMesh& meshPass)
+	{
+		m_PipelineRef = Renderer::Resource::PipelineManager::CreatePipeline(pipelineName);
+		Renderer::Resource::PipelineManager::GetVertexShader(m_PipelineRef)		= m_VertShaderRef;
+		Renderer::Resource::PipelineManager::GetFragmentShader(m_PipelineRef)		= m_FragShaderRef;
+		Renderer::Resource::PipelineManager::GetPipelineLayoutRef(m_PipelineRef)	= m_PipelineLayoutRef;
+		Renderer::Resource::PipelineManager::GetRenderPassRef(m_PipelineRef)		= m_RenderPassRef;
+
+		//Same vertex streams as the mesh pass, the colors are fetched but not read
+		Renderer::Resource::PipelineManager::GetbufferLayoutRef(m_PipelineRef)	= meshPass.GetBufferLayoutRef();
+
+		Renderer::Resource::PipelineManager::CreateResourceAsync({ m_PipelineRef });
+	}
+
+	void RenderPassVirtualTextureFeedback::CreateReadbackBuffers()
+	{
+		m_ReadbackBuffers.resize(Renderer::Vulkan::RenderSystem::vkSwapchainImages.size());
+
+		for (auto& readbackBuffer : m_ReadbackBuffers)
+		{
+			VkBufferCreateInfo bufferCreateInfo = {};
+			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCreateInfo.size = FEEDBACK_MAX_EXTENT * FEEDBACK_MAX_EXTENT * sizeof(uint32_t);
+			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			VK_CHECK_RESULT(vkCreateBuffer(Renderer::Vulkan::RenderSystem::vkDevice, &bufferCreateInfo, nullptr, &readbackBuffer.buffer));
+
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(Renderer::Vulkan::RenderSystem::vkDevice, readbackBuffer.buffer, &memReqs);
+
+			//Host visible and mapped for the lifetime of the pool
+			readbackBuffer.memoryAllocationInfo = Renderer::Vulkan::GpuMemoryManager::AllocateOffset(MemoryPoolTypes::kStaticStagingBuffers,
+				static_cast<uint32_t>(memReqs.size), static_cast<uint32_t>(memReqs.alignment), memReqs.memoryTypeBits);
+			VK_CHECK_RESULT(vkBindBufferMemory(Renderer::Vulkan::RenderSystem::vkDevice, readbackBuffer.buffer,
+				readbackBuffer.memoryAllocationInfo._vkDeviceMemory, readbackBuffer.memoryAllocationInfo._offset));
+
+			readbackBuffer.extent = glm::uvec2(0u);
+		}
+	}
+
+	void RenderPassVirtualTextureFeedback::CreateDrawCall(const std::string& name, const RenderPassMesh& meshPass)
+	{
+		const DOD::Ref& meshDrawCallRef = meshPass.GetDrawCallRef();
+		m_DrawCallRef = Renderer::Resource::DrawCallManager::CreateDrawCall(name);
+
+		auto& binding_infos = Renderer::Resource::DrawCallManager::GetBindingInfo(m_DrawCallRef);
+		binding_infos.push_back(Renderer::Resource::BindingInfo{ 0, meshPass.GetUniformBufferRef() });
+		binding_infos.push_back(Renderer::Resource::BindingInfo{ 1, meshPass.GetInstanceBufferRef() });
+		binding_infos.push_back(Renderer::Resource::BindingInfo{ 2, meshPass.GetDrawInstanceBufferRef() });
+
+		//Draws whatever the mesh pass draws, including the culled indirect draws
+		Renderer::Resource::DrawCallManager::GetIndexCount(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetIndexCount(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetLods(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetLods(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetBoundingSphere(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetBoundingSphere(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetClusterBufferRef(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetClusterBufferRef(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetFirstCluster(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetFirstCluster(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetClusterCount(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetClusterCount(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetIndexBufferRef(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetIndexBufferRef(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetIndexType(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetIndexType(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetVertexBufferRef(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetVertexBufferRef(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetVertexStreamOffsets(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetVertexStreamOffsets(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetIndirectBufferRef(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetIndirectBufferRef(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetDrawCountBufferRef(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetDrawCountBufferRef(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetMaxDrawCount(m_DrawCallRef) = Renderer::Resource::DrawCallManager::GetMaxDrawCount(meshDrawCallRef);
+		Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(m_DrawCallRef) = m_PipelineLayoutRef;
+		Renderer::Resource::DrawCallManager::GetPipelineRef(m_DrawCallRef) = m_PipelineRef;
+
+		//Same transform as the mesh pass
+		const FeedbackParams feedbackParams =
+		{
+			meshPass.GetDrawConstants(),
+			m_TextureId,
+			Renderer::Resource::VirtualTextureSystem::GetPageCount(m_TextureId),
+			Renderer::Resource::VirtualTextureSystem::GetMipCount(m_TextureId),
+			FEEDBACK_MIP_BIAS
+		};
+		Renderer::Resource::DrawCallManager::SetPushConstants(m_DrawCallRef, feedbackParams);
+
+		Renderer::Resource::DrawCallManager::CreateResource({ m_DrawCallRef });
+	}
+}
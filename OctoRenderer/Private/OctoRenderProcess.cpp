@@ -1,9 +1,14 @@
 #include "OctoRenderProcess.h"
+#include "OctoRenderGraph.h"
 #include "Vulkan/VkRenderSystem.h"
+#include "Vulkan/VkVirtualTexture.h"
 
 namespace Renderer
 { 
 	std::vector<Renderer::RenderPassMesh> RenderProcess::m_MeshRenderPasses;
+	std::vector<Renderer::RenderPassSkinning> RenderProcess::m_SkinningPasses;
+	std::vector<Renderer::RenderPassGpuCulling> RenderProcess::m_GpuCullingPasses;
+	std::vector<Renderer::RenderPassVirtualTextureFeedback> RenderProcess::m_VirtualTextureFeedbackPasses;
 
 	void RenderProcess::Init()
 	{
@@ -11,26 +16,138 @@ namespace Renderer
 		meshRenderPass.Init();
 
 		m_MeshRenderPasses.emplace_back(std::move(meshRenderPass));
+
+		//Skinned meshes draw the streams of their skinning pass, so it has to exist before the passes sharing the draw call
+		for (auto& meshRenderPass : m_MeshRenderPasses)
+		{
+			if (!meshRenderPass.IsSkinned())
+			{
+				continue;
+			}
+
+			Renderer::RenderPassSkinning skinningPass;
+			skinningPass.Init(meshRenderPass.GetSkeleton(), meshRenderPass.GetVertexBufferRef(), meshRenderPass.GetAttributeStreamOffset(),
+				meshRenderPass.GetSkinBufferRef(), meshRenderPass.GetVertexCount(), Renderer::SkinningMethod::kLinearBlend, meshRenderPass.GetSkinningRanges());
+
+			//No clips are cooked yet, skinned meshes stay in their bind pose
+			skinningPass.SetPose(meshRenderPass.GetBindPose());
+			meshRenderPass.SetSkinnedVertexBuffer(skinningPass.GetSkinnedVertexBufferRef());
+
+			m_SkinningPasses.emplace_back(std::move(skinningPass));
+		}
+
+		for (auto& meshRenderPass : m_MeshRenderPasses)
+		{
+			Renderer::RenderPassGpuCulling gpuCullingPass;
+			gpuCullingPass.Init(meshRenderPass);
+
+			m_GpuCullingPasses.emplace_back(std::move(gpuCullingPass));
+		}
+
+		//Feedback only runs if the cooked texture is there
+		const uint32_t virtualTextureId = Renderer::Resource::VirtualTextureSystem::CreateVirtualTexture("../../Assets/Textures/Terrain.ovtx");
+		if (Renderer::Resource::VirtualTextureSystem::IsValid(virtualTextureId))
+		{
+			Renderer::RenderPassVirtualTextureFeedback feedbackPass;
+			feedbackPass.Init(m_MeshRenderPasses.front(), virtualTextureId);
+
+			m_VirtualTextureFeedbackPasses.emplace_back(std::move(feedbackPass));
+		}
+
+		//Passes are referenced by the graph from here on, the vectors must not grow anymore
+		for (auto& skinningPass : m_SkinningPasses)
+		{
+			skinningPass.AddToRenderGraph();
+		}
+
+		for (uint32_t i = 0u; i < m_MeshRenderPasses.size(); i++)
+		{
+			m_GpuCullingPasses[i].AddCullToRenderGraph(m_MeshRenderPasses[i]);
+			m_MeshRenderPasses[i].AddToRenderGraph();
+			m_GpuCullingPasses[i].AddHiZToRenderGraph(m_MeshRenderPasses[i]);
+		}
+
+		for (auto& feedbackPass : m_VirtualTextureFeedbackPasses)
+		{
+			feedbackPass.AddToRenderGraph(m_MeshRenderPasses.front());
+		}
+
+		//Resolution dependent images exist once the graph assigned their lifetimes
+		Renderer::RenderGraph::Compile();
+
+		for (uint32_t i = 0u; i < m_MeshRenderPasses.size(); i++)
+		{
+			m_MeshRenderPasses[i].InitAfterCompile();
+			m_GpuCullingPasses[i].InitAfterCompile(m_MeshRenderPasses[i]);
+		}
+
+		for (auto& feedbackPass : m_VirtualTextureFeedbackPasses)
+		{
+			feedbackPass.InitAfterCompile();
+		}
 	}
 
 	void RenderProcess::Update(float dt)
 	{
-		VkClearValue clearValues[2];
-		clearValues[0].color = { { 0.5f, 0.5f, 0.5f, 1.0f } };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+		//Window changes the message loop did not catch show up as an out of date swapchain
+		if (!Renderer::Vulkan::RenderSystem::StartFrame())
+		{
+			Resize();
+			return;
+		}
 
-		Renderer::Vulkan::RenderSystem::StartFrame();
+		Renderer::RenderGraph::Execute(dt);
+
+		if (!Renderer::Vulkan::RenderSystem::EndFrame())
+		{
+			Resize();
+		}
+	}
+
+	void RenderProcess::Resize()
+	{
+		if (!Renderer::Vulkan::RenderSystem::ResizeSwapchain())
+		{
+			return;
+		}
 
 		for (auto& meshRenderPass : m_MeshRenderPasses)
 		{
-			meshRenderPass.Render(dt, 800, 600);
+			meshRenderPass.Resize();
 		}
 
-		Renderer::Vulkan::RenderSystem::EndFrame();
+		for (auto& gpuCullingPass : m_GpuCullingPasses)
+		{
+			gpuCullingPass.Resize();
+		}
+
+		for (auto& feedbackPass : m_VirtualTextureFeedbackPasses)
+		{
+			feedbackPass.Resize();
+		}
+
+		Renderer::RenderGraph::Resize();
 	}
 
 	void RenderProcess::Destroy()
 	{
+		Renderer::RenderGraph::Reset();
+
+		for (auto& feedbackPass : m_VirtualTextureFeedbackPasses)
+		{
+			feedbackPass.Destroy();
+		}
+
+		for (auto& gpuCullingPass : m_GpuCullingPasses)
+		{
+			gpuCullingPass.Destroy();
+		}
+
+		for (auto& skinningPass : m_SkinningPasses)
+		{
+			skinningPass.Destroy();
+		}
+
 		for (auto& meshRenderPass : m_MeshRenderPasses)
 		{
 			meshRenderPass.Destroy();
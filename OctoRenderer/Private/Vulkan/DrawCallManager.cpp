@@ -1,8 +1,15 @@
 #include "Vulkan/DrawCallManager.h"
 #include "Vulkan/VkPipelineLayoutManager.h"
+#include "Vulkan/VkDescriptorSetCache.h"
+#include "Vulkan/VkImageManager.h"
+#include "Vulkan/VkTextureStreamer.h"
 #include "Vulkan/VkRenderSystem.h"
 #include "Vulkan/VulkanTools.h"
 
+//Other
+#include <algorithm>
+#include <cfloat>
+
 namespace Renderer
 {
 	namespace Resource
@@ -15,7 +22,22 @@ namespace Renderer
 				DOD::Ref pipeline_layout_ref = DrawCallManager::GetPipelineLayoutRef(ref);
 
 				VkDescriptorSet& descriptorSet = DrawCallManager::GetDescriptorSet(ref);
-				descriptorSet = Renderer::Resource::PipelineLayoutManager::AllocateWriteDescriptorSet(pipeline_layout_ref, infos);
+				//Draw calls binding the same resources share one set
+				descriptorSet = Renderer::Resource::DescriptorSetCache::Acquire(pipeline_layout_ref, infos);
+			}
+		}
+
+		void DrawCallManager::UpdateResources(const std::vector<DOD::Ref>& refs)
+		{
+			for (const auto& ref : refs)
+			{
+				VkDescriptorSet& descriptorSet = DrawCallManager::GetDescriptorSet(ref);
+				assert(descriptorSet != VK_NULL_HANDLE);
+
+				//Frames in flight keep the old set, it is freed once they are done with it
+				const VkDescriptorSet staleSet = descriptorSet;
+				descriptorSet = Renderer::Resource::DescriptorSetCache::Acquire(DrawCallManager::GetPipelineLayoutRef(ref), DrawCallManager::GetBindingInfo(ref));
+				Renderer::Resource::DescriptorSetCache::Release(staleSet);
 			}
 		}
 
@@ -24,6 +46,62 @@ namespace Renderer
 
 		}
 
+		void DrawCallManager::SelectLods(const std::vector<DOD::Ref>& refs, const glm::vec3& viewPosition, float lodScale)
+		{
+			for (const auto& ref : refs)
+			{
+				const std::vector<DrawCallLod>& lods = GetLods(ref);
+				if (lods.empty())
+				{
+					continue;
+				}
+
+				const glm::vec4& sphere = GetBoundingSphere(ref);
+				const float distance = glm::length(glm::vec3(sphere) - viewPosition) - sphere.w;
+
+				const DrawCallLod& lod = lods[SelectLod(lods, distance, lodScale)];
+				GetFirstIndex(ref) = lod.firstIndex;
+				GetIndexCount(ref) = lod.indexCount;
+			}
+		}
+
+		uint32_t DrawCallManager::SelectLod(const std::vector<DrawCallLod>& lods, float distance, float lodScale)
+		{
+			//Camera inside the bounds always gets full detail
+			if (distance <= 0.0f)
+			{
+				return 0u;
+			}
+
+			uint32_t lodIdx = 0u;
+			while (lodIdx + 1u < lods.size() && lods[lodIdx + 1u].error * lodScale <= distance)
+			{
+				lodIdx++;
+			}
+
+			return lodIdx;
+		}
+
+		void DrawCallManager::RequestTextureMips(const std::vector<DOD::Ref>& refs, const glm::vec3& viewPosition, float projectionScale)
+		{
+			for (const auto& ref : refs)
+			{
+				const glm::vec4& sphere = GetBoundingSphere(ref);
+				const float distance = glm::length(glm::vec3(sphere) - viewPosition) - sphere.w;
+
+				//Without bounds or with the camera inside them the texture may cover the whole screen
+				const float screenExtent = sphere.w > 0.0f && distance > 0.0f ? 2.0f * sphere.w * projectionScale / distance : FLT_MAX;
+
+				for (const auto& bindingInfo : GetBindingInfo(ref))
+				{
+					if (bindingInfo.image_ref.isValid() && ImageManager::GetImageType(bindingInfo.image_ref) == ImageType::Enum::kTextureFromFile)
+					{
+						TextureStreamer::RequestMip(bindingInfo.image_ref, screenExtent);
+					}
+				}
+			}
+		}
+
 		void DrawCallManager::DestroyDrawCallsAndResources(const std::vector<DOD::Ref>& refs)
 		{
 			DestroyResources(refs);
@@ -42,12 +120,10 @@ namespace Renderer
 
 				VkDescriptorSet& descriptorSet = GetDescriptorSet(drawCallRef);
 				DOD::Ref pipelineRef = GetPipelineRef(drawCallRef);
-				DOD::Ref pipelineLayoutRef = GetPipelineLayoutRef(drawCallRef);
 
 				if (descriptorSet != VK_NULL_HANDLE)
 				{
-					VkDescriptorPool descriptorPool = PipelineLayoutManager::GetDescriptorPool(pipelineLayoutRef);
-					VK_CHECK_RESULT(vkFreeDescriptorSets(Renderer::Vulkan::RenderSystem::vkDevice, descriptorPool, 1u, &descriptorSet));
+					DescriptorSetCache::Release(descriptorSet);
 
 					descriptorSet = VK_NULL_HANDLE;
 				}
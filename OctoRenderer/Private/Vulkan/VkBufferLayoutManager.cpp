@@ -1,7 +1,11 @@
 #include "Vulkan/VkBufferLayoutManager.h"
 #include "Vulkan/VulkanTools.h"
-#include "Geometry/VertData.h"
-#include "ThirdParty/glm/glm/glm.hpp"
+#include "Vulkan/VkGpuProgram.h"
+
+//Other
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
 
 namespace Renderer
 {
@@ -10,70 +14,78 @@ namespace Renderer
 		void BufferLayoutManager::CreateResource(const DOD::Ref& ref)
 		{
 			VkPipelineVertexInputStateCreateInfo& vertex_input = BufferLayoutManager::GetVertexInput(ref);
-			VkVertexInputBindingDescription& binding_description = BufferLayoutManager::GetBindingDescription(ref);
+			std::vector<VkVertexInputBindingDescription>& binding_descriptions = BufferLayoutManager::GetBindingDescriptions(ref);
 			std::vector<VkVertexInputAttributeDescription>& attribute_descriptions = BufferLayoutManager::GetAttributeDescriptions(ref);
 			std::vector<BufferLayoutDescription>& buffer_layout_description = BufferLayoutManager::GetBufferLayoutDescription(ref);
 
-			binding_description.binding = 0;
-			binding_description.stride = sizeof(drawVert);
-			binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
+			binding_descriptions.clear();
+			attribute_descriptions.clear();
 
 			for(auto& buffer : buffer_layout_description)
 			{
+				auto binding_it = std::find_if(binding_descriptions.begin(), binding_descriptions.end(),
+					[&buffer](const VkVertexInputBindingDescription& binding) { return binding.binding == buffer.binding; });
+
+				if (binding_it == binding_descriptions.end())
+				{
+					binding_descriptions.push_back({ buffer.binding, 0u, VK_VERTEX_INPUT_RATE_VERTEX });
+					binding_it = binding_descriptions.end() - 1;
+				}
+
+				//Attributes follow each other, 4 byte aligned so packed formats stay aligned
 				VkVertexInputAttributeDescription description;
 				description.location = buffer.location;
 				description.format = buffer.format;
-				description.binding = 0;
+				description.binding = buffer.binding;
+				description.offset = binding_it->stride;
 
-				switch (buffer.type)
-				{
-					case BufferObjectType::VERTEX:
-					{
-						description.offset = offsetof(drawVert, vertex);
-						break;
-					}
-					case BufferObjectType::NORMAL:
-					{
-						description.offset = offsetof(drawVert, normal);
-						break;
-					}
-					case BufferObjectType::TANGENT:
-					{
-						description.offset = offsetof(drawVert, tangent);
-						break;
-					}
-					case BufferObjectType::BITANGENT:
-					{
-						description.offset = offsetof(drawVert, bitangent);
-						break;
-					}
-					case BufferObjectType::TEX:
-					{
-						description.offset = offsetof(drawVert, tex);
-						break;
-					}
-					case BufferObjectType::COLOR:
-					{
-						description.offset = offsetof(drawVert, color);
-						break;
-					}
-				}
+				binding_it->stride += (VkTools::GetFormatSize(buffer.format) + 3u) & ~3u;
 
 				attribute_descriptions.push_back(std::move(description));
 			}
 
-
 			// Assign to vertex input state
 			vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 			vertex_input.pNext = NULL;
 			vertex_input.flags = VK_FLAGS_NONE;
-			vertex_input.vertexBindingDescriptionCount = 1;
-			vertex_input.pVertexBindingDescriptions = &binding_description;
+			vertex_input.vertexBindingDescriptionCount = static_cast<uint32_t>(binding_descriptions.size());
+			vertex_input.pVertexBindingDescriptions = binding_descriptions.data();
 			vertex_input.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
 			vertex_input.pVertexAttributeDescriptions = attribute_descriptions.data();
 		}
 
+		void BufferLayoutManager::CreateResource(const DOD::Ref& ref, const DOD::Ref& vertexShaderRef)
+		{
+			CreateResource(ref);
+
+			VkPipelineVertexInputStateCreateInfo& vertex_input = BufferLayoutManager::GetVertexInput(ref);
+			std::vector<VkVertexInputAttributeDescription>& attribute_descriptions = BufferLayoutManager::GetAttributeDescriptions(ref);
+			const std::vector<ShaderVertexInput>& vertex_inputs = GpuProgramManager::GetReflection(vertexShaderRef).vertexInputs;
+
+			auto is_read = [&vertex_inputs](const VkVertexInputAttributeDescription& description)
+			{
+				return std::any_of(vertex_inputs.begin(), vertex_inputs.end(), [&description](const ShaderVertexInput& input) { return input.location == description.location; });
+			};
+
+			attribute_descriptions.erase(std::remove_if(attribute_descriptions.begin(), attribute_descriptions.end(),
+				[&is_read](const VkVertexInputAttributeDescription& description) { return !is_read(description); }), attribute_descriptions.end());
+
+			for (const auto& input : vertex_inputs)
+			{
+				auto it = std::find_if(attribute_descriptions.begin(), attribute_descriptions.end(),
+					[&input](const VkVertexInputAttributeDescription& description) { return description.location == input.location; });
+
+				if (it == attribute_descriptions.end())
+				{
+					printf("ERROR: BufferLayoutManager::CreateResource: %s reads location %u which is not in the layout \n",
+						GpuProgramManager::GetNameByRef(vertexShaderRef).c_str(), input.location);
+					assert(false);
+				}
+			}
+
+			vertex_input.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
+			vertex_input.pVertexAttributeDescriptions = attribute_descriptions.data();
+		}
 
 		void BufferLayoutManager::DestroyResources(const std::vector<DOD::Ref>& refs)
 		{
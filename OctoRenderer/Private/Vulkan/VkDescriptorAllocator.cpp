@@ -0,0 +1,250 @@
+#include "Vulkan/VkDescriptorAllocator.h"
+#include "Vulkan/VkRenderSystem.h"
+#include "Vulkan/VulkanTools.h"
+
+//Other
+#include <algorithm>
+#include <cassert>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		std::vector<DescriptorPoolSignature> DescriptorAllocator::signatures;
+		std::vector<std::vector<RetiredDescriptorSet>> DescriptorAllocator::retiredSets;
+		uint32_t DescriptorAllocator::currentBackBufferIndex = 0u;
+
+		void DescriptorAllocator::Init()
+		{
+			signatures.clear();
+			retiredSets.assign(std::max<size_t>(Vulkan::RenderSystem::vkSwapchainImages.size(), 1u), std::vector<RetiredDescriptorSet>());
+			currentBackBufferIndex = 0u;
+		}
+
+		void DescriptorAllocator::Destroy()
+		{
+			//Destroying a pool frees all sets allocated from it
+			for (auto& signature : signatures)
+			{
+				for (auto& chunk : signature.chunks)
+				{
+					vkDestroyDescriptorPool(Vulkan::RenderSystem::vkDevice, chunk.pool, nullptr);
+				}
+
+				for (auto& chunks : signature.transientChunks)
+				{
+					for (auto& chunk : chunks)
+					{
+						vkDestroyDescriptorPool(Vulkan::RenderSystem::vkDevice, chunk.pool, nullptr);
+					}
+				}
+			}
+
+			signatures.clear();
+
+			//Freed along with their pools
+			retiredSets.clear();
+		}
+
+		uint32_t DescriptorAllocator::GetSignature(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+		{
+			//Descriptor count per type, sorted by type so equal layouts end up with the same sizes
+			std::vector<VkDescriptorPoolSize> set_sizes;
+			for (const auto& binding : bindings)
+			{
+				auto it = std::find_if(set_sizes.begin(), set_sizes.end(), [&](const VkDescriptorPoolSize& size) { return size.type == binding.descriptorType; });
+				if (it != set_sizes.end())
+				{
+					it->descriptorCount += binding.descriptorCount;
+				}
+				else if (binding.descriptorCount > 0u)
+				{
+					set_sizes.push_back(VkTools::Initializer::DescriptorPoolSize(binding.descriptorType, binding.descriptorCount));
+				}
+			}
+
+			std::sort(set_sizes.begin(), set_sizes.end(), [](const VkDescriptorPoolSize& lhs, const VkDescriptorPoolSize& rhs) { return lhs.type < rhs.type; });
+
+			for (uint32_t i = 0u; i < signatures.size(); i++)
+			{
+				const std::vector<VkDescriptorPoolSize>& sizes = signatures[i].setSizes;
+				if (std::equal(sizes.begin(), sizes.end(), set_sizes.begin(), set_sizes.end(), [](const VkDescriptorPoolSize& lhs, const VkDescriptorPoolSize& rhs)
+				{
+					return lhs.type == rhs.type && lhs.descriptorCount == rhs.descriptorCount;
+				}))
+				{
+					return i;
+				}
+			}
+
+			DescriptorPoolSignature signature;
+			signature.setSizes = std::move(set_sizes);
+			signatures.push_back(std::move(signature));
+			return static_cast<uint32_t>(signatures.size() - 1u);
+		}
+
+		DescriptorPoolChunk DescriptorAllocator::CreateChunk(const DescriptorPoolSignature& signature, uint32_t chunkIdx, bool transient)
+		{
+			DescriptorPoolChunk chunk;
+			chunk.maxSets = std::min(DESCRIPTOR_POOL_FIRST_CHUNK_SETS << std::min(chunkIdx, 31u), DESCRIPTOR_POOL_MAX_CHUNK_SETS);
+			chunk.allocatedSets = 0u;
+
+			std::vector<VkDescriptorPoolSize> pool_sizes = signature.setSizes;
+			for (auto& pool_size : pool_sizes)
+			{
+				pool_size.descriptorCount *= chunk.maxSets;
+			}
+
+			//Layouts without any descriptors still need a valid pool size
+			if (pool_sizes.empty())
+			{
+				pool_sizes.push_back(VkTools::Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1u));
+			}
+
+			VkDescriptorPoolCreateInfo descriptor_pool_info = VkTools::Initializer::DescriptorPoolCreateInfo(static_cast<uint32_t>(pool_sizes.size()), pool_sizes.data(), chunk.maxSets);
+
+			//Transient pools are only ever reset as a whole
+			if (transient)
+			{
+				descriptor_pool_info.flags = 0u;
+			}
+
+			VK_CHECK_RESULT(vkCreateDescriptorPool(Vulkan::RenderSystem::vkDevice, &descriptor_pool_info, nullptr, &chunk.pool));
+			return chunk;
+		}
+
+		bool DescriptorAllocator::TryAllocate(DescriptorPoolChunk& chunk, VkDescriptorSetLayout layout, VkDescriptorSet& set)
+		{
+			if (chunk.allocatedSets >= chunk.maxSets)
+			{
+				return false;
+			}
+
+			VkDescriptorSetAllocateInfo descriptor_allocate_info = VkTools::Initializer::DescriptorSetAllocateInfo(chunk.pool, &layout, 1u);
+			const VkResult result = vkAllocateDescriptorSets(Vulkan::RenderSystem::vkDevice, &descriptor_allocate_info, &set);
+
+			//A fragmented pool counts as full until one of its sets gets freed
+			if (result != VK_SUCCESS)
+			{
+				chunk.allocatedSets = chunk.maxSets;
+				return false;
+			}
+
+			chunk.allocatedSets++;
+			return true;
+		}
+
+		VkDescriptorSet DescriptorAllocator::Allocate(uint32_t signatureIdx, VkDescriptorSetLayout layout, VkDescriptorPool& pool)
+		{
+			assert(signatureIdx < signatures.size());
+			DescriptorPoolSignature& signature = signatures[signatureIdx];
+
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			for (auto& chunk : signature.chunks)
+			{
+				if (TryAllocate(chunk, layout, set))
+				{
+					pool = chunk.pool;
+					return set;
+				}
+			}
+
+			signature.chunks.push_back(CreateChunk(signature, static_cast<uint32_t>(signature.chunks.size()), false));
+
+			const bool allocated = TryAllocate(signature.chunks.back(), layout, set);
+			assert(allocated && "Descriptor set does not fit into a new pool");
+			pool = signature.chunks.back().pool;
+			return set;
+		}
+
+		void DescriptorAllocator::Free(uint32_t signatureIdx, VkDescriptorPool pool, VkDescriptorSet set)
+		{
+			assert(signatureIdx < signatures.size() && currentBackBufferIndex < retiredSets.size());
+			retiredSets[currentBackBufferIndex].push_back({ signatureIdx, pool, set });
+		}
+
+		void DescriptorAllocator::FreeRetired(const RetiredDescriptorSet& retired)
+		{
+			for (auto& chunk : signatures[retired.signatureIdx].chunks)
+			{
+				if (chunk.pool == retired.pool)
+				{
+					VK_CHECK_RESULT(vkFreeDescriptorSets(Vulkan::RenderSystem::vkDevice, retired.pool, 1u, &retired.set));
+
+					//Also lets a pool marked full by fragmentation try again
+					chunk.allocatedSets = chunk.allocatedSets > 0u ? chunk.allocatedSets - 1u : 0u;
+					return;
+				}
+			}
+
+			assert(false && "Descriptor set was not allocated from this signature");
+		}
+
+		VkDescriptorSet DescriptorAllocator::AllocateTransient(uint32_t signatureIdx, VkDescriptorSetLayout layout)
+		{
+			assert(signatureIdx < signatures.size());
+			DescriptorPoolSignature& signature = signatures[signatureIdx];
+
+			if (signature.transientChunks.size() <= currentBackBufferIndex)
+			{
+				signature.transientChunks.resize(currentBackBufferIndex + 1u);
+				signature.transientChunkIdx.resize(currentBackBufferIndex + 1u, 0u);
+			}
+
+			std::vector<DescriptorPoolChunk>& chunks = signature.transientChunks[currentBackBufferIndex];
+			uint32_t& chunkIdx = signature.transientChunkIdx[currentBackBufferIndex];
+
+			//Earlier chunks are full for the rest of the frame
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			for (; chunkIdx < chunks.size(); chunkIdx++)
+			{
+				if (TryAllocate(chunks[chunkIdx], layout, set))
+				{
+					return set;
+				}
+			}
+
+			chunks.push_back(CreateChunk(signature, chunkIdx, true));
+
+			const bool allocated = TryAllocate(chunks.back(), layout, set);
+			assert(allocated && "Descriptor set does not fit into a new pool");
+			return set;
+		}
+
+		void DescriptorAllocator::BeginFrame(uint32_t backBufferIndex)
+		{
+			currentBackBufferIndex = backBufferIndex;
+
+			//Recreated swapchains may come with more images
+			if (retiredSets.size() <= backBufferIndex)
+			{
+				retiredSets.resize(backBufferIndex + 1u);
+			}
+
+			for (const auto& retired : retiredSets[backBufferIndex])
+			{
+				FreeRetired(retired);
+			}
+			retiredSets[backBufferIndex].clear();
+
+			for (auto& signature : signatures)
+			{
+				if (signature.transientChunks.size() <= backBufferIndex)
+				{
+					continue;
+				}
+
+				for (auto& chunk : signature.transientChunks[backBufferIndex])
+				{
+					if (chunk.allocatedSets > 0u)
+					{
+						VK_CHECK_RESULT(vkResetDescriptorPool(Vulkan::RenderSystem::vkDevice, chunk.pool, 0u));
+						chunk.allocatedSets = 0u;
+					}
+				}
+
+				signature.transientChunkIdx[backBufferIndex] = 0u;
+			}
+		}
+	}
+}
@@ -0,0 +1,232 @@
+#include "Vulkan/VkDescriptorHeap.h"
+#include "Vulkan/VkBufferObjectManager.h"
+#include "Vulkan/VkImageManager.h"
+#include "Vulkan/VkRenderSystem.h"
+#include "Vulkan/VulkanTools.h"
+
+//Other
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		VkDescriptorSetLayout DescriptorHeap::vkDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool DescriptorHeap::vkDescriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet DescriptorHeap::vkDescriptorSet = VK_NULL_HANDLE;
+
+		std::vector<DescriptorHeap::ImageSlot> DescriptorHeap::imageSlots;
+		std::vector<DOD::Ref> DescriptorHeap::bufferSlots;
+		std::vector<uint32_t> DescriptorHeap::freeSlots[DescriptorHeapBinding::kCount];
+		std::vector<std::vector<uint32_t>> DescriptorHeap::retiredSlots[DescriptorHeapBinding::kCount];
+		uint32_t DescriptorHeap::currentBackBufferIndex = 0u;
+
+		void DescriptorHeap::Init()
+		{
+			if (!Vulkan::RenderSystem::supportsDescriptorIndexing)
+			{
+				return;
+			}
+
+			const VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+			std::array<VkDescriptorSetLayoutBinding, DescriptorHeapBinding::kCount> set_layout_bindings;
+			set_layout_bindings[DescriptorHeapBinding::kImages] = VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, stages, DescriptorHeapBinding::kImages);
+			set_layout_bindings[DescriptorHeapBinding::kImages].descriptorCount = MAX_HEAP_IMAGE_COUNT;
+			set_layout_bindings[DescriptorHeapBinding::kBuffers] = VkTools::Initializer::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, DescriptorHeapBinding::kBuffers);
+			set_layout_bindings[DescriptorHeapBinding::kBuffers].descriptorCount = MAX_HEAP_BUFFER_COUNT;
+
+			//Unused slots stay unwritten, written ones can change while earlier frames are still in flight
+			std::array<Vulkan::VkDescriptorBindingFlagsEXT, DescriptorHeapBinding::kCount> binding_flags;
+			binding_flags.fill(VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT);
+
+			Vulkan::VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info = {};
+			binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+			binding_flags_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
+			binding_flags_info.pBindingFlags = binding_flags.data();
+
+			VkDescriptorSetLayoutCreateInfo descriptor_layout = VkTools::Initializer::DescriptorSetLayoutCreateInfo(set_layout_bindings.data(), static_cast<uint32_t>(set_layout_bindings.size()));
+			descriptor_layout.pNext = &binding_flags_info;
+			descriptor_layout.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(Vulkan::RenderSystem::vkDevice, &descriptor_layout, nullptr, &vkDescriptorSetLayout));
+
+			std::array<VkDescriptorPoolSize, DescriptorHeapBinding::kCount> pool_sizes;
+			pool_sizes[DescriptorHeapBinding::kImages] = VkTools::Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_HEAP_IMAGE_COUNT);
+			pool_sizes[DescriptorHeapBinding::kBuffers] = VkTools::Initializer::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_HEAP_BUFFER_COUNT);
+
+			VkDescriptorPoolCreateInfo descriptor_pool_info = VkTools::Initializer::DescriptorPoolCreateInfo(static_cast<uint32_t>(pool_sizes.size()), pool_sizes.data(), 1u);
+			descriptor_pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+			VK_CHECK_RESULT(vkCreateDescriptorPool(Vulkan::RenderSystem::vkDevice, &descriptor_pool_info, nullptr, &vkDescriptorPool));
+
+			VkDescriptorSetAllocateInfo descriptor_allocate_info = VkTools::Initializer::DescriptorSetAllocateInfo(vkDescriptorPool, &vkDescriptorSetLayout, 1u);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(Vulkan::RenderSystem::vkDevice, &descriptor_allocate_info, &vkDescriptorSet));
+
+			imageSlots.resize(MAX_HEAP_IMAGE_COUNT);
+			bufferSlots.resize(MAX_HEAP_BUFFER_COUNT);
+
+			//Popped from the back, low slots get handed out first
+			const uint32_t slot_counts[DescriptorHeapBinding::kCount] = { MAX_HEAP_IMAGE_COUNT, MAX_HEAP_BUFFER_COUNT };
+			for (uint32_t binding = 0u; binding < DescriptorHeapBinding::kCount; binding++)
+			{
+				freeSlots[binding].resize(slot_counts[binding]);
+				for (uint32_t i = 0u; i < slot_counts[binding]; i++)
+				{
+					freeSlots[binding][i] = slot_counts[binding] - 1u - i;
+				}
+
+				retiredSlots[binding].assign(std::max<size_t>(Vulkan::RenderSystem::vkSwapchainImages.size(), 1u), std::vector<uint32_t>());
+			}
+		}
+
+		void DescriptorHeap::Destroy()
+		{
+			//Frees the set along with the pool
+			if (vkDescriptorPool != VK_NULL_HANDLE)
+			{
+				vkDestroyDescriptorPool(Vulkan::RenderSystem::vkDevice, vkDescriptorPool, nullptr);
+				vkDescriptorPool = VK_NULL_HANDLE;
+				vkDescriptorSet = VK_NULL_HANDLE;
+			}
+
+			if (vkDescriptorSetLayout != VK_NULL_HANDLE)
+			{
+				vkDestroyDescriptorSetLayout(Vulkan::RenderSystem::vkDevice, vkDescriptorSetLayout, nullptr);
+				vkDescriptorSetLayout = VK_NULL_HANDLE;
+			}
+
+			imageSlots.clear();
+			bufferSlots.clear();
+			for (uint32_t binding = 0u; binding < DescriptorHeapBinding::kCount; binding++)
+			{
+				freeSlots[binding].clear();
+				retiredSlots[binding].clear();
+			}
+		}
+
+		uint32_t DescriptorHeap::AcquireSlot(std::vector<uint32_t>& slots)
+		{
+			assert(IsSupported());
+
+			if (slots.empty())
+			{
+				printf("ERROR: Descriptor heap is full\n");
+				return INVALID_HEAP_INDEX;
+			}
+
+			const uint32_t index = slots.back();
+			slots.pop_back();
+			return index;
+		}
+
+		uint32_t DescriptorHeap::RegisterImage(const DOD::Ref& imageRef, VkSampler sampler, VkImageLayout imageLayout)
+		{
+			//Streamed images get replaced while frames are in flight, their slots could not be rewritten
+			assert(ImageManager::GetImageType(imageRef) != ImageType::Enum::kTextureFromFile && "Streamed images are sampled through per draw sets");
+
+			const uint32_t index = AcquireSlot(freeSlots[DescriptorHeapBinding::kImages]);
+			if (index != INVALID_HEAP_INDEX)
+			{
+				imageSlots[index] = { imageRef, sampler, imageLayout };
+				WriteImage(index);
+			}
+
+			return index;
+		}
+
+		uint32_t DescriptorHeap::RegisterBuffer(const DOD::Ref& bufferRef)
+		{
+			const uint32_t index = AcquireSlot(freeSlots[DescriptorHeapBinding::kBuffers]);
+			if (index != INVALID_HEAP_INDEX)
+			{
+				bufferSlots[index] = bufferRef;
+				WriteBuffer(index);
+			}
+
+			return index;
+		}
+
+		void DescriptorHeap::ReleaseImage(uint32_t index)
+		{
+			assert(index < imageSlots.size() && imageSlots[index].imageRef.isValid());
+
+			imageSlots[index].imageRef = DOD::Ref();
+			retiredSlots[DescriptorHeapBinding::kImages][currentBackBufferIndex].push_back(index);
+		}
+
+		void DescriptorHeap::ReleaseBuffer(uint32_t index)
+		{
+			assert(index < bufferSlots.size() && bufferSlots[index].isValid());
+
+			bufferSlots[index] = DOD::Ref();
+			retiredSlots[DescriptorHeapBinding::kBuffers][currentBackBufferIndex].push_back(index);
+		}
+
+		void DescriptorHeap::BeginFrame(uint32_t backBufferIndex)
+		{
+			if (!IsSupported())
+			{
+				return;
+			}
+
+			currentBackBufferIndex = backBufferIndex;
+
+			for (uint32_t binding = 0u; binding < DescriptorHeapBinding::kCount; binding++)
+			{
+				//Recreated swapchains may come with more images
+				if (retiredSlots[binding].size() <= backBufferIndex)
+				{
+					retiredSlots[binding].resize(backBufferIndex + 1u);
+				}
+
+				std::vector<uint32_t>& retired = retiredSlots[binding][backBufferIndex];
+				freeSlots[binding].insert(freeSlots[binding].end(), retired.begin(), retired.end());
+				retired.clear();
+			}
+		}
+
+		void DescriptorHeap::UpdateImages(const std::unordered_set<uint32_t>& imageIds)
+		{
+			if (!IsSupported())
+			{
+				return;
+			}
+
+			for (uint32_t i = 0u; i < imageSlots.size(); i++)
+			{
+				if (imageSlots[i].imageRef.isValid() && imageIds.count(imageSlots[i].imageRef._id) > 0u)
+				{
+					WriteImage(i);
+				}
+			}
+		}
+
+		void DescriptorHeap::WriteImage(uint32_t index)
+		{
+			const ImageSlot& slot = imageSlots[index];
+
+			VkDescriptorImageInfo image_info = VkTools::Initializer::DescriptorImageInfo(slot.sampler, ImageManager::GetImageView(slot.imageRef), slot.imageLayout);
+
+			VkWriteDescriptorSet write_descriptor_set = VkTools::Initializer::WriteDescriptorSet(vkDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DescriptorHeapBinding::kImages, &image_info);
+			write_descriptor_set.dstArrayElement = index;
+
+			vkUpdateDescriptorSets(Vulkan::RenderSystem::vkDevice, 1u, &write_descriptor_set, 0u, nullptr);
+		}
+
+		void DescriptorHeap::WriteBuffer(uint32_t index)
+		{
+			const DOD::Ref& bufferRef = bufferSlots[index];
+
+			VkDescriptorBufferInfo buffer_info;
+			buffer_info.buffer = BufferObjectManager::GetBufferObject(bufferRef).buffer;
+			buffer_info.offset = 0u;
+			buffer_info.range = BufferObjectManager::GetBufferSize(bufferRef);
+
+			VkWriteDescriptorSet write_descriptor_set = VkTools::Initializer::WriteDescriptorSet(vkDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DescriptorHeapBinding::kBuffers, &buffer_info);
+			write_descriptor_set.dstArrayElement = index;
+
+			vkUpdateDescriptorSets(Vulkan::RenderSystem::vkDevice, 1u, &write_descriptor_set, 0u, nullptr);
+		}
+	}
+}
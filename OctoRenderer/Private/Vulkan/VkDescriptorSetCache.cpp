@@ -0,0 +1,207 @@
+#include "Vulkan/VkDescriptorSetCache.h"
+#include "Vulkan/VkDescriptorAllocator.h"
+#include "Vulkan/VkPipelineLayoutManager.h"
+
+//Other
+#include <cassert>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		namespace
+		{
+			//FNV-1a step over one value
+			void HashValue(size_t& hash, uint64_t value)
+			{
+				for (uint32_t i = 0u; i < sizeof(value); i++)
+				{
+					hash = (hash ^ ((value >> (i * 8u)) & 0xFFu)) * static_cast<size_t>(1099511628211ull);
+				}
+			}
+
+			uint64_t RefKey(const DOD::Ref& ref)
+			{
+				return (static_cast<uint64_t>(ref._id) << 8u) | ref._generation;
+			}
+		}
+
+		std::unordered_map<VkDescriptorSet, DescriptorSetCacheEntry> DescriptorSetCache::entries;
+		std::unordered_multimap<size_t, VkDescriptorSet> DescriptorSetCache::lookup;
+		std::list<VkDescriptorSet> DescriptorSetCache::unused;
+
+		void DescriptorSetCache::Destroy()
+		{
+			entries.clear();
+			lookup.clear();
+			unused.clear();
+		}
+
+		size_t DescriptorSetCache::Hash(const DOD::Ref& pipelineLayoutRef, const std::vector<BindingInfo>& bindingInfos)
+		{
+			size_t hash = static_cast<size_t>(14695981039346656037ull);
+			HashValue(hash, RefKey(pipelineLayoutRef));
+
+			for (const auto& info : bindingInfos)
+			{
+				HashValue(hash, info.binding_location);
+				HashValue(hash, RefKey(info.buffer_ref));
+				HashValue(hash, RefKey(info.image_ref));
+				HashValue(hash, info.mip_level);
+				HashValue(hash, static_cast<uint64_t>(info.image_layout));
+				HashValue(hash, reinterpret_cast<uint64_t>(info.sampler));
+			}
+
+			return hash;
+		}
+
+		bool DescriptorSetCache::Equal(const DescriptorSetCacheEntry& entry, const DOD::Ref& pipelineLayoutRef, const std::vector<BindingInfo>& bindingInfos)
+		{
+			if (entry.pipelineLayoutRef != pipelineLayoutRef || entry.bindingInfos.size() != bindingInfos.size())
+			{
+				return false;
+			}
+
+			for (size_t i = 0u; i < bindingInfos.size(); i++)
+			{
+				const BindingInfo& lhs = entry.bindingInfos[i];
+				const BindingInfo& rhs = bindingInfos[i];
+
+				if (lhs.binding_location != rhs.binding_location || lhs.buffer_ref != rhs.buffer_ref || lhs.image_ref != rhs.image_ref ||
+					lhs.mip_level != rhs.mip_level || lhs.image_layout != rhs.image_layout || lhs.sampler != rhs.sampler)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		VkDescriptorSet DescriptorSetCache::Acquire(const DOD::Ref& pipelineLayoutRef, const std::vector<BindingInfo>& bindingInfos)
+		{
+			const size_t hash = Hash(pipelineLayoutRef, bindingInfos);
+
+			auto range = lookup.equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				DescriptorSetCacheEntry& entry = entries[it->second];
+				if (!Equal(entry, pipelineLayoutRef, bindingInfos))
+				{
+					continue;
+				}
+
+				if (entry.refCount == 0u)
+				{
+					unused.erase(entry.unusedIt);
+				}
+
+				entry.refCount++;
+				return it->second;
+			}
+
+			DescriptorSetCacheEntry entry;
+			entry.pipelineLayoutRef = pipelineLayoutRef;
+			entry.bindingInfos = bindingInfos;
+			entry.hash = hash;
+			entry.signatureIdx = PipelineLayoutManager::GetDescriptorPoolSignature(pipelineLayoutRef);
+			entry.refCount = 1u;
+			entry.stale = false;
+
+			const VkDescriptorSet descriptorSet = PipelineLayoutManager::AllocateWriteDescriptorSet(pipelineLayoutRef, bindingInfos, entry.pool);
+
+			lookup.insert(std::make_pair(hash, descriptorSet));
+			entries[descriptorSet] = std::move(entry);
+			return descriptorSet;
+		}
+
+		void DescriptorSetCache::Release(VkDescriptorSet descriptorSet)
+		{
+			auto it = entries.find(descriptorSet);
+			assert(it != entries.end() && it->second.refCount > 0u);
+
+			DescriptorSetCacheEntry& entry = it->second;
+			if (--entry.refCount > 0u)
+			{
+				return;
+			}
+
+			if (entry.stale)
+			{
+				DescriptorAllocator::Free(entry.signatureIdx, entry.pool, descriptorSet);
+				entries.erase(it);
+				return;
+			}
+
+			//Kept for reuse, evicted sets are only returned to their pool once the frames in flight are done with them
+			unused.push_back(descriptorSet);
+			entry.unusedIt = std::prev(unused.end());
+
+			while (unused.size() > MAX_UNUSED_DESCRIPTOR_SETS)
+			{
+				Evict(unused.front());
+			}
+		}
+
+		void DescriptorSetCache::InvalidateImages(const std::unordered_set<uint32_t>& imageIds)
+		{
+			std::vector<VkDescriptorSet> evicted;
+			for (auto& entryIt : entries)
+			{
+				DescriptorSetCacheEntry& entry = entryIt.second;
+				if (entry.stale)
+				{
+					continue;
+				}
+
+				for (const auto& info : entry.bindingInfos)
+				{
+					if (info.image_ref.isValid() && imageIds.count(info.image_ref._id) > 0u)
+					{
+						if (entry.refCount == 0u)
+						{
+							evicted.push_back(entryIt.first);
+						}
+						else
+						{
+							//Frames in flight and users not yet updated keep binding it until it is released
+							RemoveLookup(entryIt.first, entry.hash);
+							entry.stale = true;
+						}
+						break;
+					}
+				}
+			}
+
+			for (const VkDescriptorSet descriptorSet : evicted)
+			{
+				Evict(descriptorSet);
+			}
+		}
+
+		void DescriptorSetCache::Evict(VkDescriptorSet descriptorSet)
+		{
+			auto it = entries.find(descriptorSet);
+			assert(it != entries.end() && it->second.refCount == 0u);
+
+			DescriptorSetCacheEntry& entry = it->second;
+			unused.erase(entry.unusedIt);
+			RemoveLookup(descriptorSet, entry.hash);
+
+			DescriptorAllocator::Free(entry.signatureIdx, entry.pool, descriptorSet);
+			entries.erase(it);
+		}
+
+		void DescriptorSetCache::RemoveLookup(VkDescriptorSet descriptorSet, size_t hash)
+		{
+			auto range = lookup.equal_range(hash);
+			for (auto lookupIt = range.first; lookupIt != range.second; ++lookupIt)
+			{
+				if (lookupIt->second == descriptorSet)
+				{
+					lookup.erase(lookupIt);
+					break;
+				}
+			}
+		}
+	}
+}
@@ -7,26 +7,51 @@
 #include "Vulkan/VkRenderSystem.h"
 #include "Vulkan/VulkanTools.h"
 #include "Vulkan/VkFrameBufferManager.h"
+#include "Vulkan/VkDescriptorHeap.h"
 
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cstddef>
 
 namespace Renderer
 {
 	namespace Vulkan
 	{
-		
+		const uint32_t MAX_VERTEX_STREAMS = 4u;
+
+		//Each range gets the part of the draw call constants it covers
+		void PushConstants(VkCommandBuffer commandBuffer, const DOD::Ref& drawCallRef, const DOD::Ref& pipelineLayoutRef, VkPipelineLayout pipelineLayout)
+		{
+			const std::vector<uint8_t>& push_constants = Renderer::Resource::DrawCallManager::GetPushConstants(drawCallRef);
+			if (push_constants.empty())
+			{
+				return;
+			}
+
+			for (const auto& range : Renderer::Resource::PipelineLayoutManager::GetPushConstantRanges(pipelineLayoutRef))
+			{
+				if (range.offset >= push_constants.size())
+				{
+					continue;
+				}
+
+				const uint32_t size = std::min(range.size, static_cast<uint32_t>(push_constants.size()) - range.offset);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, range.stageFlags, range.offset, size, push_constants.data() + range.offset);
+			}
+		}
 
 		struct DrawCallParallelTask
 		{
 			void Execute()
 			{
 				const DOD::Ref pipeline_layout_ref = Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(drawCallRef);
-				const DOD::Ref pipeline_ref = Renderer::Resource::DrawCallManager::GetPipelineRef(drawCallRef);
 				const DOD::Ref vertex_buffer_ref = Renderer::Resource::DrawCallManager::GetVertexBufferRef(drawCallRef);
 				const DOD::Ref index_buffer_ref = Renderer::Resource::DrawCallManager::GetIndexBufferRef(drawCallRef);
+				const VkIndexType index_type = Renderer::Resource::DrawCallManager::GetIndexType(drawCallRef);
 
 				const VkPipelineLayout& pipeline_layout = Renderer::Resource::PipelineLayoutManager::GetPipelineLayout(pipeline_layout_ref);
-				const VkPipeline& pipeline = Renderer::Resource::PipelineManager::GetPipeline(pipeline_ref);
+				const VkPipeline& pipeline = Renderer::Resource::PipelineManager::GetPipeline(pipelineRef);
 				const VkRenderPass& render_pass = Renderer::Resource::RenderPassManager::GetRenderPass(renderPassRef);
 				const VkFramebuffer& frame_buffer = Renderer::Resource::FrameBufferManager::GetFrameBuffer(frameBufferRef);
 
@@ -45,25 +70,41 @@ namespace Renderer
 
 						vkCmdBindPipeline(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
-						// Bind triangle vertex buffer (contains position and colors)
-						VkDeviceSize offsets[1] = { 0 };
+						//Split vertex streams live in the same buffer, one binding per stream
+						const std::vector<VkDeviceSize>& stream_offsets = Renderer::Resource::DrawCallManager::GetVertexStreamOffsets(drawCallRef);
+						const VkDeviceSize default_offset = 0u;
+						const uint32_t stream_count = stream_offsets.empty() ? 1u : static_cast<uint32_t>(stream_offsets.size());
 
-						const VkDescriptorSet& descriptor_set = Renderer::Resource::DrawCallManager::GetDescriptorSet(drawCallRef);
+						const VkDescriptorSet descriptor_sets[] = { Renderer::Resource::DrawCallManager::GetDescriptorSet(drawCallRef), Renderer::Resource::DescriptorHeap::GetDescriptorSet() };
+						const uint32_t descriptor_set_count = Renderer::Resource::PipelineLayoutManager::GetDescriptorSetCount(pipeline_layout_ref);
 						const VkBuffer& vertex_buffer = Renderer::Resource::BufferObjectManager::GetBufferObject(vertex_buffer_ref).buffer;
 						const VkBuffer& index_buffer = Renderer::Resource::BufferObjectManager::GetBufferObject(index_buffer_ref).buffer;
 
 						//for (int j = 0; j < listLocalBuffersVerts.size(); j++)
 						{
 							// Bind descriptor sets describing shader binding points
-							vkCmdBindDescriptorSets(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_set, 0, NULL);
+							vkCmdBindDescriptorSets(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, descriptor_set_count, descriptor_sets, 0, NULL);
+							PushConstants(secondaryCommandBuffer, drawCallRef, pipeline_layout_ref, pipeline_layout);
 
 							//Bind Buffer
-							vkCmdBindVertexBuffers(secondaryCommandBuffer, 0, 1, &vertex_buffer, offsets);
-							vkCmdBindIndexBuffer(secondaryCommandBuffer, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+							std::array<VkBuffer, MAX_VERTEX_STREAMS> vertex_buffers;
+							vertex_buffers.fill(vertex_buffer);
+							assert(stream_count <= MAX_VERTEX_STREAMS);
+							vkCmdBindVertexBuffers(secondaryCommandBuffer, 0, stream_count, vertex_buffers.data(), stream_offsets.empty() ? &default_offset : stream_offsets.data());
+							vkCmdBindIndexBuffer(secondaryCommandBuffer, index_buffer, 0, index_type);
 
 							//Draw
-							const uint32_t index_count = Renderer::Resource::DrawCallManager::GetIndexCount(drawCallRef);
-							vkCmdDrawIndexed(secondaryCommandBuffer, index_count, 1, 0, 0, 1);
+							const DOD::Ref indirect_buffer_ref = Renderer::Resource::DrawCallManager::GetIndirectBufferRef(drawCallRef);
+							if (indirect_buffer_ref.isValid())
+							{
+								DrawIndirect(secondaryCommandBuffer, indirect_buffer_ref, pipeline_layout_ref, pipeline_layout);
+							}
+							else
+							{
+								const uint32_t index_count = Renderer::Resource::DrawCallManager::GetIndexCount(drawCallRef);
+								const uint32_t first_index = Renderer::Resource::DrawCallManager::GetFirstIndex(drawCallRef);
+								vkCmdDrawIndexed(secondaryCommandBuffer, index_count, 1, first_index, 0, 1);
+							}
 						}
 					}
 				}
@@ -71,7 +112,59 @@ namespace Renderer
 				Renderer::Vulkan::RenderSystem::EndSecondaryComandBuffer(secondaryCommandBufferIndex);
 			}
 
+			void DrawIndirect(VkCommandBuffer commandBuffer, const DOD::Ref& indirectBufferRef, const DOD::Ref& pipelineLayoutRef, VkPipelineLayout pipelineLayout)
+			{
+				const DOD::Ref draw_count_buffer_ref = Renderer::Resource::DrawCallManager::GetDrawCountBufferRef(drawCallRef);
+				const uint32_t max_draw_count = Renderer::Resource::DrawCallManager::GetMaxDrawCount(drawCallRef);
+				const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+				const VkBuffer& indirect_buffer = Renderer::Resource::BufferObjectManager::GetBufferObject(indirectBufferRef).buffer;
+
+				//Commands all start at instance 0, the vertex shader looks the instance up with the pushed command index
+				if (!RenderSystem::supportsDrawIndirectFirstInstance)
+				{
+					assert(Renderer::Resource::DrawCallManager::GetPushConstants(drawCallRef).size() >= sizeof(Renderer::Resource::DrawPushConstants)
+						&& "Indirect draws have to start their push constants with DrawPushConstants");
+
+					const uint32_t draw_index_offset = offsetof(Renderer::Resource::DrawPushConstants, drawIndex);
+					for (uint32_t i = 0u; i < max_draw_count; i++)
+					{
+						for (const auto& range : Renderer::Resource::PipelineLayoutManager::GetPushConstantRanges(pipelineLayoutRef))
+						{
+							if (range.offset <= draw_index_offset && draw_index_offset + sizeof(uint32_t) <= range.offset + range.size)
+							{
+								vkCmdPushConstants(commandBuffer, pipelineLayout, range.stageFlags, draw_index_offset, sizeof(uint32_t), &i);
+							}
+						}
+
+						vkCmdDrawIndexedIndirect(commandBuffer, indirect_buffer, i * stride, 1u, stride);
+					}
+					return;
+				}
+
+				if (RenderSystem::supportsDrawIndirectCount && draw_count_buffer_ref.isValid())
+				{
+					const VkBuffer& count_buffer = Renderer::Resource::BufferObjectManager::GetBufferObject(draw_count_buffer_ref).buffer;
+					RenderSystem::vkCmdDrawIndexedIndirectCount(commandBuffer, indirect_buffer, 0u, count_buffer, 0u, max_draw_count, stride);
+					return;
+				}
+
+				//Culled commands are zeroed by the culling pass, so issuing the full range is safe
+				if (RenderSystem::vkPhysicalDeviceFeatures.multiDrawIndirect)
+				{
+					vkCmdDrawIndexedIndirect(commandBuffer, indirect_buffer, 0u, max_draw_count, stride);
+				}
+				else
+				{
+					for (uint32_t i = 0u; i < max_draw_count; i++)
+					{
+						vkCmdDrawIndexedIndirect(commandBuffer, indirect_buffer, i * stride, 1u, stride);
+					}
+				}
+			}
+
 			DOD::Ref drawCallRef;
+			DOD::Ref pipelineRef;
 			DOD::Ref frameBufferRef;
 			DOD::Ref renderPassRef;
 			uint32_t secondaryCommandBufferIndex;
@@ -79,10 +172,48 @@ namespace Renderer
 			uint32_t height;
 		};
 
+		struct DispatchParallelTask
+		{
+			void Execute()
+			{
+				const DOD::Ref pipeline_layout_ref = Renderer::Resource::DrawCallManager::GetPipelineLayoutRef(dispatchRef);
+
+				const VkPipelineLayout& pipeline_layout = Renderer::Resource::PipelineLayoutManager::GetPipelineLayout(pipeline_layout_ref);
+				const VkPipeline& pipeline = Renderer::Resource::PipelineManager::GetPipeline(pipelineRef);
+				const VkDescriptorSet descriptor_sets[] = { Renderer::Resource::DrawCallManager::GetDescriptorSet(dispatchRef), Renderer::Resource::DescriptorHeap::GetDescriptorSet() };
+				const uint32_t descriptor_set_count = Renderer::Resource::PipelineLayoutManager::GetDescriptorSetCount(pipeline_layout_ref);
+
+				Renderer::Vulkan::RenderSystem::BeginSecondaryComandBuffer(secondaryCommandBufferIndex, VK_NULL_HANDLE, VK_NULL_HANDLE);
+				VkCommandBuffer& secondaryCommandBuffer = Renderer::Vulkan::RenderSystem::GetSecondaryCommandBuffer(secondaryCommandBufferIndex);
+
+				vkCmdBindPipeline(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+				vkCmdBindDescriptorSets(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, descriptor_set_count, descriptor_sets, 0, NULL);
+				PushConstants(secondaryCommandBuffer, dispatchRef, pipeline_layout_ref, pipeline_layout);
+				vkCmdDispatch(secondaryCommandBuffer, groupCountX, groupCountY, groupCountZ);
+
+				Renderer::Vulkan::RenderSystem::EndSecondaryComandBuffer(secondaryCommandBufferIndex);
+			}
+
+			DOD::Ref dispatchRef;
+			DOD::Ref pipelineRef;
+			uint32_t secondaryCommandBufferIndex;
+			uint32_t groupCountX;
+			uint32_t groupCountY;
+			uint32_t groupCountZ;
+		};
+
 		void DrawCall::QueuDrawCall(const DOD::Ref& ref, const DOD::Ref& frameBuffer, const DOD::Ref& renderPass, int width, int height)
 		{
+			//Pipelines still compiling render with their fallback, without one the draw is skipped
+			const DOD::Ref pipeline_ref = Renderer::Resource::PipelineManager::GetBindablePipeline(Renderer::Resource::DrawCallManager::GetPipelineRef(ref));
+			if (!pipeline_ref.isValid())
+			{
+				return;
+			}
+
 			DrawCallParallelTask task;
 			task.drawCallRef = ref;
+			task.pipelineRef = pipeline_ref;
 			task.frameBufferRef = frameBuffer;
 			task.renderPassRef = renderPass;
 			task.secondaryCommandBufferIndex = RenderSystem::RequestSecondaryCommandBuffers(1u);
@@ -94,5 +225,27 @@ namespace Renderer
 			vkCmdExecuteCommands(RenderSystem::GetPrimaryCommandBuffer(), 1u,
 				&Renderer::Vulkan::RenderSystem::GetSecondaryCommandBuffer(task.secondaryCommandBufferIndex));
 		}
+
+		void DrawCall::QueueDispatch(const DOD::Ref& ref, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+		{
+			const DOD::Ref pipeline_ref = Renderer::Resource::PipelineManager::GetBindablePipeline(Renderer::Resource::DrawCallManager::GetPipelineRef(ref));
+			if (!pipeline_ref.isValid())
+			{
+				return;
+			}
+
+			DispatchParallelTask task;
+			task.dispatchRef = ref;
+			task.pipelineRef = pipeline_ref;
+			task.secondaryCommandBufferIndex = RenderSystem::RequestSecondaryCommandBuffers(1u);
+			task.groupCountX = groupCountX;
+			task.groupCountY = groupCountY;
+			task.groupCountZ = groupCountZ;
+
+			task.Execute();
+
+			vkCmdExecuteCommands(RenderSystem::GetPrimaryCommandBuffer(), 1u,
+				&Renderer::Vulkan::RenderSystem::GetSecondaryCommandBuffer(task.secondaryCommandBufferIndex));
+		}
 	}
 }
\ No newline at end of file
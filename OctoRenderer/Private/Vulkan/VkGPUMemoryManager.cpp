@@ -3,6 +3,7 @@
 #include "Vulkan/VulkanTools.h"
 
 //Other
+#include <algorithm>
 #include <cassert>
 
 namespace Renderer
@@ -10,11 +11,13 @@ namespace Renderer
 	namespace Vulkan
 	{
 		std::vector<GpuMemoryPage> GpuMemoryManager::memoryPools[MemoryPoolTypes::kCount];
+		std::vector<GpuMemoryAliasSlot> GpuMemoryManager::aliasSlots[MemoryPoolTypes::kCount];
 		MemoryLocation::Enum GpuMemoryManager::memoryPoolToMemoryLocation[MemoryPoolTypes::kCount] = {};
 		uint32_t GpuMemoryManager::memoryLocationToMemoryPropertyFlags[MemoryLocation::kCount] =
 		{
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
 		};
 
 		void GpuMemoryManager::Init()
@@ -24,8 +27,10 @@ namespace Renderer
 			memoryPoolToMemoryLocation[MemoryPoolTypes::kStaticStagingBuffers] = MemoryLocation::kHostVisible;
 			memoryPoolToMemoryLocation[MemoryPoolTypes::kResolutionDependentBuffers] = MemoryLocation::kDeviceLocal;
 			memoryPoolToMemoryLocation[MemoryPoolTypes::kResolutionDependentImages] = MemoryLocation::kDeviceLocal;
+			memoryPoolToMemoryLocation[MemoryPoolTypes::kResolutionDependentTransientImages] = MemoryLocation::kLazilyAllocated;
 			memoryPoolToMemoryLocation[MemoryPoolTypes::kResolutionDependentStagingBuffers] = MemoryLocation::kHostVisible;
 			memoryPoolToMemoryLocation[MemoryPoolTypes::kVolatileStagingBuffers] = MemoryLocation::kHostVisible;
+			memoryPoolToMemoryLocation[MemoryPoolTypes::kStreamedImages] = MemoryLocation::kDeviceLocal;
 		}
 
 		void GpuMemoryManager::Destroy()
@@ -37,14 +42,28 @@ namespace Renderer
 		{
 			std::vector<GpuMemoryPage>& poolPages = memoryPools[poolType];
 
+			//Freed ranges first, the linear part of a page only ever grows
+			for (uint32_t pageIdX = 0u; pageIdX < poolPages.size(); pageIdX++)
+			{
+				GpuMemoryPage& page = poolPages[pageIdX];
+
+				uint32_t offset = 0u;
+				if ((memoryFlags & (1u << page._memoryTypeIdx)) > 0u && AllocateFreeRange(page, size, allignement, offset))
+				{
+					return { poolType, pageIdX, offset, page._vkDeviceMemory, size,
+							allignement, page._mappedMemory != nullptr ? &page._mappedMemory[offset] : nullptr };
+				}
+			}
+
 			for (uint32_t pageIdX = 0u; pageIdX < memoryPools[poolType].size(); pageIdX++)
 			{
 				GpuMemoryPage& page = poolPages[pageIdX];
 
-				if (memoryFlags & (1u << page._memoryTypeIdx) > 0u && page.allocator.Fits(size, allignement))
+				if ((memoryFlags & (1u << page._memoryTypeIdx)) > 0u && page.allocator.Fits(size, allignement))
 				{
 					void* ptr = page.allocator.Allocate(size, allignement);
-					const uint32_t offset = page.allocator.GetOffset();
+					//The allocator offset points past the allocation
+					const uint32_t offset = static_cast<uint32_t>(page.allocator.GetOffset() - size);
 
 					return { poolType, pageIdX, offset, page._vkDeviceMemory, size,
 							allignement, page._mappedMemory != nullptr ? &page._mappedMemory[offset]: nullptr };
@@ -57,7 +76,7 @@ namespace Renderer
 				const MemoryLocation::Enum memoryLocation = memoryPoolToMemoryLocation[poolType];
 				const uint32_t memoryPropertyFlag = memoryLocationToMemoryPropertyFlags[memoryLocation];
 
-				if (memoryPropertyFlag & memoryType.propertyFlags && (memoryFlags & (1u << memoryTypeIndex)) > 0u)
+				if ((memoryType.propertyFlags & memoryPropertyFlag) == memoryPropertyFlag && (memoryFlags & (1u << memoryTypeIndex)) > 0u)
 				{
 					poolPages.resize(poolPages.size() + 1u);
 					GpuMemoryPage& page = poolPages.back();
@@ -84,12 +103,147 @@ namespace Renderer
 
 					//assert(page.allocator.Fits(size, ) && "Allocation does not fit in a single page");
 					void* ptr = page.allocator.Allocate(size, allignement);
-					const uint32_t offset = page.allocator.GetOffset();
+					//The allocator offset points past the allocation
+					const uint32_t offset = static_cast<uint32_t>(page.allocator.GetOffset() - size);
 
 					return { poolType, static_cast<uint32_t>(poolPages.size() - 1u), offset, page._vkDeviceMemory, size, allignement,
 					page._mappedMemory != nullptr ? &page._mappedMemory[offset] : nullptr};
 				}
 			}
+
+			assert(false && "No memory type matches the pool");
+			return {};
+		}
+
+		MemoryPoolTypes::GpuMemoryAllocationInfo GpuMemoryManager::AllocateAliasedOffset(MemoryPoolTypes::Enum poolType, uint32_t size, uint32_t allignement, uint32_t memoryFlags, const glm::uvec2& lifetime)
+		{
+			std::vector<GpuMemoryAliasSlot>& poolSlots = aliasSlots[poolType];
+
+			for (auto& slot : poolSlots)
+			{
+				if ((memoryFlags & (1u << slot._memoryTypeIdx)) == 0u || slot._sizeInBytes < size || slot._offset % allignement != 0u)
+					continue;
+
+				bool overlaps = false;
+				for (const auto& slotLifetime : slot._lifetimes)
+				{
+					if (slotLifetime.x <= lifetime.y && lifetime.x <= slotLifetime.y)
+					{
+						overlaps = true;
+						break;
+					}
+				}
+
+				if (overlaps)
+					continue;
+
+				slot._lifetimes.push_back(lifetime);
+
+				GpuMemoryPage& page = memoryPools[poolType][slot._pageIdx];
+				return { poolType, slot._pageIdx, slot._offset, page._vkDeviceMemory, size, allignement,
+					page._mappedMemory != nullptr ? &page._mappedMemory[slot._offset] : nullptr };
+			}
+
+			const MemoryPoolTypes::GpuMemoryAllocationInfo allocationInfo = AllocateOffset(poolType, size, allignement, memoryFlags);
+
+			GpuMemoryAliasSlot slot;
+			slot._pageIdx = allocationInfo._pageIdx;
+			slot._offset = static_cast<uint32_t>(allocationInfo._offset);
+			slot._sizeInBytes = size;
+			slot._memoryTypeIdx = memoryPools[poolType][allocationInfo._pageIdx]._memoryTypeIdx;
+			slot._lifetimes.push_back(lifetime);
+			poolSlots.push_back(slot);
+
+			return allocationInfo;
+		}
+
+		void GpuMemoryManager::ResetPool(MemoryPoolTypes::Enum poolType)
+		{
+			for (auto& page : memoryPools[poolType])
+			{
+				page.allocator.Reset();
+				page._freeRanges.clear();
+			}
+
+			aliasSlots[poolType].clear();
+		}
+
+		void GpuMemoryManager::Free(const MemoryPoolTypes::GpuMemoryAllocationInfo& allocationInfo)
+		{
+			if (allocationInfo._vkDeviceMemory == VK_NULL_HANDLE || allocationInfo._sizeInBytes == 0u)
+				return;
+
+			const MemoryPoolTypes::Enum poolType = allocationInfo._memoryPoolType;
+			assert(poolType >= MemoryPoolTypes::kRangeStartStreamed && poolType <= MemoryPoolTypes::kRangeEndStreamed);
+
+			std::vector<glm::uvec2>& freeRanges = memoryPools[poolType][allocationInfo._pageIdx]._freeRanges;
+			glm::uvec2 range = glm::uvec2(static_cast<uint32_t>(allocationInfo._offset), allocationInfo._sizeInBytes);
+
+			auto rangeIt = std::lower_bound(freeRanges.begin(), freeRanges.end(), range, [](const glm::uvec2& lhs, const glm::uvec2& rhs)
+			{
+				return lhs.x < rhs.x;
+			});
+
+			//Merged with the neighbours so large images still find room after many small ones left
+			if (rangeIt != freeRanges.end() && range.x + range.y == rangeIt->x)
+			{
+				range.y += rangeIt->y;
+				rangeIt = freeRanges.erase(rangeIt);
+			}
+
+			if (rangeIt != freeRanges.begin() && (rangeIt - 1)->x + (rangeIt - 1)->y == range.x)
+			{
+				(rangeIt - 1)->y += range.y;
+				return;
+			}
+
+			freeRanges.insert(rangeIt, range);
+		}
+
+		bool GpuMemoryManager::AllocateFreeRange(GpuMemoryPage& page, uint32_t size, uint32_t allignement, uint32_t& offset)
+		{
+			for (size_t rangeIdx = 0u; rangeIdx < page._freeRanges.size(); rangeIdx++)
+			{
+				const glm::uvec2 range = page._freeRanges[rangeIdx];
+				const uint32_t alignedOffset = (range.x + allignement - 1u) / allignement * allignement;
+
+				if (alignedOffset + size > range.x + range.y)
+					continue;
+
+				//Padding in front stays free, so does whatever is left behind the allocation
+				page._freeRanges.erase(page._freeRanges.begin() + rangeIdx);
+
+				const uint32_t rangeEnd = range.x + range.y;
+				if (alignedOffset + size < rangeEnd)
+				{
+					page._freeRanges.insert(page._freeRanges.begin() + rangeIdx, glm::uvec2(alignedOffset + size, rangeEnd - alignedOffset - size));
+				}
+
+				if (alignedOffset > range.x)
+				{
+					page._freeRanges.insert(page._freeRanges.begin() + rangeIdx, glm::uvec2(range.x, alignedOffset - range.x));
+				}
+
+				offset = alignedOffset;
+				return true;
+			}
+
+			return false;
+		}
+
+		bool GpuMemoryManager::SupportsMemoryLocation(MemoryLocation::Enum memoryLocation, uint32_t memoryFlags)
+		{
+			const uint32_t memoryPropertyFlag = memoryLocationToMemoryPropertyFlags[memoryLocation];
+
+			for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < RenderSystem::vkPhysicalDeviceMemoryProperties.memoryTypeCount; ++memoryTypeIndex)
+			{
+				const VkMemoryType& memoryType = RenderSystem::vkPhysicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex];
+
+				if ((memoryType.propertyFlags & memoryPropertyFlag) == memoryPropertyFlag && (memoryFlags & (1u << memoryTypeIndex)) > 0u)
+					return true;
+			}
+
+			return false;
 		}
 	}
 }
\ No newline at end of file
@@ -1,55 +1,314 @@
 #include "Vulkan/VkGpuProgram.h"
 #include <cassert>
+#include <cstdio>
 
 #include "Vulkan/VulkanTools.h"
 #include "Vulkan/VkRenderSystem.h"
+#include "Vulkan/VkShaderCompiler.h"
+#include "OctoCore/Public/MappedFile.h"
+
+//Other
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 
 namespace Renderer
 {
 	namespace Resource
 	{
-		bool GpuProgramManager::LoadAndCompileShader(const DOD::Ref& ref, std::string file_path, VkShaderStageFlagBits stage)
+		namespace
 		{
-			VkPipelineShaderStageCreateInfo& shader_stage = GpuProgramManager::GetShaderStageCreateInfo(ref);
-			VkShaderModule& shader_module = GpuProgramManager::GetShaderModule(ref);
+			//FNV-1a over the words, 0 is kept for modules that are not shared
+			uint64_t HashSpirv(const uint32_t* code, size_t wordCount)
+			{
+				uint64_t hash = 14695981039346656037ull;
+				for (size_t i = 0u; i < wordCount; i++)
+				{
+					hash = (hash ^ code[i]) * 1099511628211ull;
+				}
+				return hash != 0u ? hash : 1u;
+			}
 
+			std::string ToHex(uint32_t value)
+			{
+				char text[9];
+				snprintf(text, sizeof(text), "%x", value);
+				return text;
+			}
+		}
+
+		std::unordered_map<uint64_t, SharedShaderModule> GpuProgramManager::modules;
+
+		bool GpuProgramManager::LoadAndCompileShader(const DOD::Ref& ref, std::string file_path, VkShaderStageFlagBits stage)
+		{
 			const std::string shader_name = GpuProgramManager::GetNameByRef(ref);
 
 #if defined(__ANDROID__)
+			VkPipelineShaderStageCreateInfo& shader_stage = GpuProgramManager::GetShaderStageCreateInfo(ref);
+			VkShaderModule& shader_module = GpuProgramManager::GetShaderModule(ref);
+
 			shader_module = VkTools::LoadShader(fileName.c_str(), Vulkan::RenderSystem::vkDevice, stage);
+
+			shader_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shader_stage.stage = stage;
+			shader_stage.module = shader_module;
+			shader_stage.pName = "main"; // todo : make param
+
+			assert(shader_stage.module != VK_NULL_HANDLE);
+			if (shader_stage.module == VK_NULL_HANDLE)
+			{
+				return false;
+			}
+
+			return true;
 #else
-			shader_module = VkTools::LoadShader(file_path.c_str() + shader_name, Vulkan::RenderSystem::vkDevice, stage);
+			return LoadShaderFile(ref, file_path + shader_name, stage);
 #endif
+		}
 
+		bool GpuProgramManager::LoadShaderFile(const DOD::Ref& ref, const std::string& path, VkShaderStageFlagBits stage)
+		{
+			//Reflected from the same mapping the module is created from
+			Core::Memory::MappedFile shader_file;
+			if (!shader_file.Map(path) || shader_file.GetSize() % sizeof(uint32_t) != 0u)
+			{
+				printf("ERROR: GpuProgramManager::LoadAndCompileShader: could not load %s \n", path.c_str());
+				return false;
+			}
+
+			const uint32_t* code = reinterpret_cast<const uint32_t*>(shader_file.GetData());
+			const size_t word_count = shader_file.GetSize() / sizeof(uint32_t);
+
+			ShaderReflection reflection;
+			if (!ShaderReflector::Reflect(code, word_count, reflection))
+			{
+				printf("ERROR: GpuProgramManager::LoadAndCompileShader: %s is no valid SPIR-V \n", path.c_str());
+				return false;
+			}
+
+			//Variants that compile to the same code, like unused defines, end up with one module
+			const uint64_t hash = HashSpirv(code, word_count);
+			auto module_it = modules.find(hash);
+			if (module_it == modules.end())
+			{
+				SharedShaderModule shared_module = { VkTools::CreateShaderModule(code, shader_file.GetSize(), Vulkan::RenderSystem::vkDevice), 0u };
+				module_it = modules.insert(std::make_pair(hash, shared_module)).first;
+			}
+			module_it->second.refCount++;
+
+			//Reloads keep the old module until the new one exists
+			ReleaseModule(ref);
+
+			VkShaderModule& shader_module = GpuProgramManager::GetShaderModule(ref);
+			shader_module = module_it->second.module;
+			GpuProgramManager::GetSpirvHash(ref) = hash;
+			GpuProgramManager::GetReflection(ref) = std::move(reflection);
+
+			VkPipelineShaderStageCreateInfo& shader_stage = GpuProgramManager::GetShaderStageCreateInfo(ref);
+			shader_stage = {};
 			shader_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			shader_stage.stage = stage;
 			shader_stage.module = shader_module;
 			shader_stage.pName = "main"; // todo : make param
+			shader_stage.pSpecializationInfo = GpuProgramManager::GetSpecializationEntries(ref).empty() ? nullptr : &GpuProgramManager::GetSpecializationInfo(ref);
 
 			assert(shader_stage.module != VK_NULL_HANDLE);
-			if (shader_stage.module == VK_NULL_HANDLE)
+			return shader_stage.module != VK_NULL_HANDLE;
+		}
+
+		DOD::Ref GpuProgramManager::GetVariant(const ShaderPermutation& permutation, uint32_t featureMask, const std::string& file_path)
+		{
+			const std::string name = permutation.source + "#" + ToHex(featureMask);
+
+			DOD::Ref ref = GetResourceByName(name);
+			if (ref.isValid())
+			{
+				return ref;
+			}
+
+			ShaderVariantInfo variant;
+			variant.permutation = permutation;
+			variant.featureMask = featureMask;
+			variant.filePath = file_path;
+
+			if (!CompileVariant(variant))
+			{
+				return DOD::Ref();
+			}
+
+			ref = CreateGPUProgram(name);
+			GetShaderModule(ref) = VK_NULL_HANDLE;
+			GetSpirvHash(ref) = 0u;
+			GetSpecializationEntries(ref).clear();
+			GetVariantInfo(ref) = std::move(variant);
+
+			if (!LoadVariant(ref))
+			{
+				GetVariantInfo(ref) = ShaderVariantInfo();
+				destroyResource(ref);
+				return DOD::Ref();
+			}
+
+			return ref;
+		}
+
+		bool GpuProgramManager::CompileVariant(const DOD::Ref& ref)
+		{
+			assert(IsVariant(ref));
+			return CompileVariant(GetVariantInfo(ref));
+		}
+
+		bool GpuProgramManager::LoadVariant(const DOD::Ref& ref)
+		{
+			const ShaderVariantInfo& variant = GetVariantInfo(ref);
+			if (!LoadShaderFile(ref, variant.spirvPath, variant.permutation.stage))
 			{
 				return false;
 			}
 
+			//Reflection of the new module may list other constants
+			SetSpecialization(ref, variant.permutation, variant.featureMask & variant.permutation.specializedFeatures);
 			return true;
 		}
 
-		void GpuProgramManager::DestroyResources(const std::vector<DOD::Ref>& refs)
+		bool GpuProgramManager::CompileVariant(ShaderVariantInfo& variant)
 		{
-			for (int i = 0; i < refs.size(); i++)
+			const ShaderPermutation& permutation = variant.permutation;
+			const uint32_t defineMask = variant.featureMask & ~permutation.specializedFeatures;
+
+			const std::filesystem::path source = variant.filePath + permutation.source;
+			const std::filesystem::path cache = variant.filePath + "Cache/";
+			variant.spirvPath = (cache / (permutation.source + "." + ToHex(defineMask) + ".spv")).string();
+
+			//Edits may add or drop includes, so they are collected again on every compile
+			variant.dependencies.clear();
+			CollectIncludes(variant.filePath, permutation.source, variant.dependencies);
+
+			//Cached SPIR-V is reused until the source or one of its includes changes
+			std::error_code error;
+			const bool cached = std::filesystem::exists(variant.spirvPath, error);
+			bool upToDate = cached;
+			for (const auto& dependency : variant.dependencies)
 			{
-				const DOD::Ref& ref = refs[i];
-				VkShaderModule& shader_module = GpuProgramManager::GetShaderModule(ref);
+				upToDate = upToDate && std::filesystem::last_write_time(variant.spirvPath, error) >= std::filesystem::last_write_time(variant.filePath + dependency, error);
+			}
 
-				if (shader_module != VK_NULL_HANDLE)
+			if (upToDate)
+			{
+				return true;
+			}
+
+			std::vector<std::string> arguments;
+			for (uint32_t bit = 0u; bit < permutation.features.size(); bit++)
+			{
+				if (defineMask & (1u << bit))
 				{
-					vkDestroyShaderModule(Vulkan::RenderSystem::vkDevice, shader_module, nullptr);
-					VkShaderModule null_module = VK_NULL_HANDLE;
+					arguments.push_back("-D" + permutation.features[bit]);
+				}
+			}
+
+			std::filesystem::create_directories(cache, error);
+			if (ShaderCompiler::Compile(source.string(), variant.spirvPath, arguments))
+			{
+				return true;
+			}
+
+			//Without a compiler a stale variant still beats none
+			printf("ERROR: GpuProgramManager::CompileVariant: could not compile %s \n", variant.spirvPath.c_str());
+			return cached;
+		}
+
+		void GpuProgramManager::CollectIncludes(const std::string& file_path, const std::string& name, std::vector<std::string>& files)
+		{
+			if (std::find(files.begin(), files.end(), name) != files.end())
+			{
+				return;
+			}
+			files.push_back(name);
+
+			//Only quoted includes next to the shaders are followed
+			std::ifstream file(file_path + name);
+			std::string line;
+			while (std::getline(file, line))
+			{
+				const size_t directive = line.find("#include \"");
+				if (directive == std::string::npos)
+				{
+					continue;
+				}
 
-					shader_module = null_module;
+				const size_t begin = directive + sizeof("#include \"") - 1u;
+				const size_t end = line.find('"', begin);
+				if (end != std::string::npos)
+				{
+					CollectIncludes(file_path, line.substr(begin, end - begin), files);
 				}
 			}
 		}
+
+		void GpuProgramManager::SetSpecialization(const DOD::Ref& ref, const ShaderPermutation& permutation, uint32_t specializedMask)
+		{
+			std::vector<VkSpecializationMapEntry>& entries = GetSpecializationEntries(ref);
+			std::vector<uint32_t>& values = GetSpecializationData(ref);
+			entries.clear();
+			values.clear();
+
+			//Every specialized feature is set, so variants never depend on the defaults in the shader
+			for (const auto& constant : GetReflection(ref).specializationConstants)
+			{
+				const uint32_t bit = constant.constantId;
+				if (bit >= permutation.features.size() || !(permutation.specializedFeatures & (1u << bit)) || constant.size != sizeof(uint32_t))
+				{
+					continue;
+				}
+
+				entries.push_back({ bit, static_cast<uint32_t>(values.size() * sizeof(uint32_t)), sizeof(uint32_t) });
+				values.push_back((specializedMask >> bit) & 1u);
+			}
+
+			VkSpecializationInfo& info = GetSpecializationInfo(ref);
+			info.mapEntryCount = static_cast<uint32_t>(entries.size());
+			info.pMapEntries = entries.data();
+			info.dataSize = values.size() * sizeof(uint32_t);
+			info.pData = values.data();
+
+			GetShaderStageCreateInfo(ref).pSpecializationInfo = entries.empty() ? nullptr : &info;
+		}
+
+		void GpuProgramManager::ReleaseModule(const DOD::Ref& ref)
+		{
+			VkShaderModule& shader_module = GpuProgramManager::GetShaderModule(ref);
+			if (shader_module == VK_NULL_HANDLE)
+			{
+				return;
+			}
+
+			auto module_it = modules.find(GpuProgramManager::GetSpirvHash(ref));
+			if (module_it == modules.end())
+			{
+				vkDestroyShaderModule(Vulkan::RenderSystem::vkDevice, shader_module, nullptr);
+			}
+			else if (--module_it->second.refCount == 0u)
+			{
+				vkDestroyShaderModule(Vulkan::RenderSystem::vkDevice, shader_module, nullptr);
+				modules.erase(module_it);
+			}
+
+			shader_module = VK_NULL_HANDLE;
+			GpuProgramManager::GetSpirvHash(ref) = 0u;
+		}
+
+		void GpuProgramManager::DestroyResources(const std::vector<DOD::Ref>& refs)
+		{
+			for (int i = 0; i < refs.size(); i++)
+			{
+				const DOD::Ref& ref = refs[i];
+
+				ReleaseModule(ref);
+				GpuProgramManager::GetSpecializationEntries(ref).clear();
+				GpuProgramManager::GetSpecializationData(ref).clear();
+				GpuProgramManager::GetVariantInfo(ref) = ShaderVariantInfo();
+			}
+		}
 	}
-}
\ No newline at end of file
+}
@@ -2,10 +2,14 @@
 #include "Vulkan/VkRenderSystem.h"
 #include "Vulkan/VkGPUMemoryManager.h"
 #include "Vulkan/VulkanTools.h"
+#include "Vulkan/VkTextureStreamer.h"
+
+//Other
+#include <algorithm>
 
 namespace
 {
-	void AllocateMemory(MemoryPoolTypes::GpuMemoryAllocationInfo& memAllocInfo, MemoryPoolTypes::Enum poolType, const VkMemoryRequirements memRegs)
+	void AllocateMemory(MemoryPoolTypes::GpuMemoryAllocationInfo& memAllocInfo, MemoryPoolTypes::Enum poolType, const VkMemoryRequirements memRegs, const glm::uvec2& aliasingLifetime)
 	{
 		bool bNeedsAlloc = true;
 		
@@ -19,7 +23,14 @@ namespace
 
 		if (bNeedsAlloc)
 		{
-			memAllocInfo = Renderer::Vulkan::GpuMemoryManager::AllocateOffset(poolType, memRegs.size, memRegs.alignment, memRegs.memoryTypeBits);
+			if (poolType == MemoryPoolTypes::kResolutionDependentImages || poolType == MemoryPoolTypes::kResolutionDependentTransientImages)
+			{
+				memAllocInfo = Renderer::Vulkan::GpuMemoryManager::AllocateAliasedOffset(poolType, memRegs.size, memRegs.alignment, memRegs.memoryTypeBits, aliasingLifetime);
+			}
+			else
+			{
+				memAllocInfo = Renderer::Vulkan::GpuMemoryManager::AllocateOffset(poolType, memRegs.size, memRegs.alignment, memRegs.memoryTypeBits);
+			}
 		}
 	}
 }
@@ -27,12 +38,16 @@ namespace Renderer
 {
 	namespace Resource
 	{
-		void ImageManager::CreateResource(const DOD::Ref p_Images)
+		bool ImageManager::CreateResource(const DOD::Ref p_Images)
 		{
 			ImageType::Enum imageType  = ImageManager::GetImageType(p_Images);
 
 			if (imageType == ImageType::Enum::kTexture)
 				CreateTexture(p_Images);
+			else if (imageType == ImageType::Enum::kTextureFromFile)
+				return TextureStreamer::CreateTexture(p_Images);
+
+			return true;
 		}
 
 		void ImageManager::CreateTexture(const DOD::Ref ref)
@@ -42,8 +57,27 @@ namespace Renderer
 			glm::uvec3& dimensions = ImageManager::GetImageDimensions(ref);
 			uint8_t imageFlags = ImageManager::GetImageFlags(ref);
 			const uint32_t arrayLayerCount = ImageManager::GetArrayLayerCount(ref);
+			const float resolutionScale = ImageManager::GetResolutionScale(ref);
+
+			if (resolutionScale > 0.0f)
+			{
+				const glm::vec2 scaledDimensions = glm::vec2(Renderer::Vulkan::RenderSystem::backBufferDimensions) * resolutionScale;
+				dimensions = glm::uvec3(std::max(static_cast<uint32_t>(scaledDimensions.x), 1u), std::max(static_cast<uint32_t>(scaledDimensions.y), 1u), 1u);
+			}
+
+			if ((imageFlags & ImageFlags::kFullMipChain) > 0u)
+			{
+				uint32_t fullMipLevelCount = 1u;
+				while ((std::max(std::max(dimensions.x, dimensions.y), dimensions.z) >> fullMipLevelCount) > 0u)
+				{
+					fullMipLevelCount++;
+				}
+
+				ImageManager::GetMipLevelCount(ref) = fullMipLevelCount;
+			}
+
 			const uint32_t mipLevelCount = ImageManager::GetMipLevelCount(ref);
-			const MemoryPoolTypes::Enum memoryPoolType = ImageManager::GetMemoryPoolType(ref);
+			MemoryPoolTypes::Enum memoryPoolType = ImageManager::GetMemoryPoolType(ref);
 			MemoryPoolTypes::GpuMemoryAllocationInfo& memoryAllocationInfo = ImageManager::GetMemoryAllocationInfo(ref);
 
 			assert(dimensions.x >= 1.0f && dimensions.y >= 1.0f && dimensions.z >= 1.0f);
@@ -52,8 +86,8 @@ namespace Renderer
 			VkImageViewType vkImageViewTypeSubResource = VK_IMAGE_VIEW_TYPE_1D;
 			VkImageViewType vkImageViewType = arrayLayerCount == 1u ? VK_IMAGE_VIEW_TYPE_1D : VK_IMAGE_VIEW_TYPE_1D_ARRAY;
 
-			bool isDepthTarget = false;
-			bool isStencilTarget = false;
+			const bool isDepthTarget = ImageManager::IsDepthFormat(imageFormat);
+			const bool isStencilTarget = ImageManager::IsStencilFormat(imageFormat);
 
 			if (dimensions.y >= 2.0f && dimensions.z == 1.0f)
 			{
@@ -82,13 +116,13 @@ namespace Renderer
 			{ 
 				if(isDepthTarget || isStencilTarget)
 				{
-					if (props.linearTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+					if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
 					{
-						imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
+						imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 					}
-					else if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+					else if (props.linearTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
 					{
-						imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+						imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
 					}
 					else
 					{
@@ -98,13 +132,14 @@ namespace Renderer
 			}
 			else
 			{
-				if (props.linearTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+				//Linear images can not have a mip chain
+				if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
 				{
-					imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
+					imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 				}
-				else if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+				else if (props.linearTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT && mipLevelCount == 1u)
 				{
-					imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+					imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
 				}
 				else
 				{
@@ -112,16 +147,6 @@ namespace Renderer
 				}
 			}
 
-			if (imageFlags & ImageFlags::kUsageSampled > 0u)
-			{
-
-			}
-
-			if (imageFlags & ImageFlags::kUsageStorage > 0u)
-			{
-
-			}
-
 			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 			imageCreateInfo.pNext = nullptr;
 			imageCreateInfo.imageType = vkImageType;
@@ -137,19 +162,22 @@ namespace Renderer
 			imageCreateInfo.pQueueFamilyIndices = nullptr;
 			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-			// Setup usage
-			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-			if (imageFlags & ImageFlags::kUsageAttachment > 0)
+			// Setup usage, transient attachments may not have any other usage
+			const bool isTransient = (imageFlags & ImageFlags::kUsageTransient) > 0u;
+			assert(!isTransient || (imageFlags & (ImageFlags::kUsageSampled | ImageFlags::kUsageStorage)) == 0u);
+
+			imageCreateInfo.usage = isTransient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : (VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+			if ((imageFlags & ImageFlags::kUsageAttachment) > 0u)
 			{
 				imageCreateInfo.usage |= (isDepthTarget || isStencilTarget) ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 			}
 
-			if (imageFlags & ImageFlags::kUsageSampled > 0u)
+			if ((imageFlags & ImageFlags::kUsageSampled) > 0u)
 			{
 				imageCreateInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
 			}
 
-			if (imageFlags & ImageFlags::kUsageStorage > 0u)
+			if ((imageFlags & ImageFlags::kUsageStorage) > 0u)
 			{
 				imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
 			}
@@ -161,7 +189,14 @@ namespace Renderer
 			VkMemoryRequirements memReqs;
 			vkGetImageMemoryRequirements(Renderer::Vulkan::RenderSystem::vkDevice, image, &memReqs);
 
-			AllocateMemory(memoryAllocationInfo, memoryPoolType, memReqs);
+			//Lazily allocated memory is only backed if the attachment ever has to leave tile memory
+			if (isTransient && memoryPoolType == MemoryPoolTypes::kResolutionDependentImages &&
+				Renderer::Vulkan::GpuMemoryManager::SupportsMemoryLocation(MemoryLocation::kLazilyAllocated, memReqs.memoryTypeBits))
+			{
+				memoryPoolType = MemoryPoolTypes::kResolutionDependentTransientImages;
+			}
+
+			AllocateMemory(memoryAllocationInfo, memoryPoolType, memReqs, ImageManager::GetAliasingLifetime(ref));
 			VK_CHECK_RESULT(vkBindImageMemory(Renderer::Vulkan::RenderSystem::vkDevice, image, memoryAllocationInfo._vkDeviceMemory, memoryAllocationInfo._offset));
 
 			VkImageViewCreateInfo imageViewCreateInfo = {};
@@ -174,7 +209,8 @@ namespace Renderer
 			imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_B;
 			imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_A;
 
-			imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			// Sampled depth views may only expose a single aspect
+			imageViewCreateInfo.subresourceRange.aspectMask = isDepthTarget ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
 			imageViewCreateInfo.flags = 0;
 			imageViewCreateInfo.image = image;
 
@@ -251,19 +287,70 @@ namespace Renderer
 					}
 				}
 				imageViews.clear();
+
+				//Other pools only give their memory back all at once
+				if (GetMemoryPoolType(ref) == MemoryPoolTypes::kStreamedImages)
+				{
+					Renderer::Vulkan::GpuMemoryManager::Free(GetMemoryAllocationInfo(ref));
+					GetMemoryAllocationInfo(ref) = {};
+				}
+			}
+		}
+
+		bool ImageManager::IsDepthFormat(VkFormat format)
+		{
+			switch (format)
+			{
+				case VK_FORMAT_D16_UNORM:
+				case VK_FORMAT_X8_D24_UNORM_PACK32:
+				case VK_FORMAT_D32_SFLOAT:
+				case VK_FORMAT_D16_UNORM_S8_UINT:
+				case VK_FORMAT_D24_UNORM_S8_UINT:
+				case VK_FORMAT_D32_SFLOAT_S8_UINT:
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		bool ImageManager::IsStencilFormat(VkFormat format)
+		{
+			switch (format)
+			{
+				case VK_FORMAT_S8_UINT:
+				case VK_FORMAT_D16_UNORM_S8_UINT:
+				case VK_FORMAT_D24_UNORM_S8_UINT:
+				case VK_FORMAT_D32_SFLOAT_S8_UINT:
+					return true;
+				default:
+					return false;
 			}
 		}
 
+		VkImageAspectFlags ImageManager::GetImageAspectFlags(const DOD::Ref ref)
+		{
+			const VkFormat format = GetImageFormat(ref);
+
+			VkImageAspectFlags aspectFlags = 0u;
+			if (IsDepthFormat(format))
+				aspectFlags |= VK_IMAGE_ASPECT_DEPTH_BIT;
+
+			if (IsStencilFormat(format))
+				aspectFlags |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+			return aspectFlags != 0u ? aspectFlags : VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+
 		void ImageManager::InsertImageMemoryBarrier(VkCommandBuffer commandBuffer, DOD::Ref imageRef,
 			VkImageLayout srcImageLayout, VkImageLayout dstImageLayout,
 			VkPipelineStageFlags srcStages,
 			VkPipelineStageFlags dstStages)
 		{
 			VkImageSubresourceRange range;
-			range.aspectMask = GetImageFormat(imageRef) != Renderer::Vulkan::RenderSystem::vkDepthFormatToUse ? VK_IMAGE_ASPECT_COLOR_BIT : (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+			range.aspectMask = GetImageAspectFlags(imageRef);
 
 			range.baseMipLevel = 0u;
-			range.levelCount = GetMipLevelCount(imageRef);
+			range.levelCount = GetResidentMipLevelCount(imageRef);
 			range.baseArrayLayer = 0u;
 			range.layerCount = GetArrayLayerCount(imageRef);
 
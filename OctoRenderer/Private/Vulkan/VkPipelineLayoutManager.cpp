@@ -1,61 +1,217 @@
 #include "Vulkan/VkPipelineLayoutManager.h"
 #include "Vulkan/VkUniformBufferManager.h"
+#include "Vulkan/VkBufferObjectManager.h"
+#include "Vulkan/VkImageManager.h"
+#include "Vulkan/VkDescriptorHeap.h"
+#include "Vulkan/VkDescriptorAllocator.h"
+#include "Vulkan/VkGpuProgram.h"
 
 #include "Vulkan/VulkanTools.h"
 #include "Vulkan/VkRenderSystem.h"
 
 //other
+#include <array>
 #include <vector>
 #include <algorithm>
+#include <cassert>
+#include <cstdio>
 
 namespace Renderer
 {
 	namespace Resource
 	{
+		std::vector<DOD::Ref> PipelineLayoutManager::reflectedLayouts;
+
 		void PipelineLayoutManager::CreateResource(const std::vector<DOD::Ref>& refs)
 		{
 			for (const auto& ref : refs)
 			{
 				VkPipelineLayout& pipeline_layout = PipelineLayoutManager::GetPipelineLayout(ref);
 				VkDescriptorSetLayout& descriptor_set_layout = PipelineLayoutManager::GetDescriptorSetLayout(ref);
-				VkDescriptorPool& descriptor_pool = PipelineLayoutManager::GetDescriptorPool(ref);
-
 				std::vector<VkDescriptorSetLayoutBinding>& set_layout_bindings = PipelineLayoutManager::GetDescriptorSetLayoutBinding(ref);
 
 				VkDescriptorSetLayoutCreateInfo descriptor_layout = VkTools::Initializer::DescriptorSetLayoutCreateInfo(set_layout_bindings.data(), set_layout_bindings.size());
 				VK_CHECK_RESULT(vkCreateDescriptorSetLayout(Vulkan::RenderSystem::vkDevice, &descriptor_layout, nullptr, &descriptor_set_layout));
 
-				VkPipelineLayoutCreateInfo pipeline_layout_create_info = VkTools::Initializer::PipelineLayoutCreateInfo(&descriptor_set_layout, 1);
+				const std::array<VkDescriptorSetLayout, 2u> descriptor_set_layouts = { descriptor_set_layout, DescriptorHeap::GetDescriptorSetLayout() };
+				static_assert(DESCRIPTOR_HEAP_SET == 1u, "Descriptor heap has to follow the per draw set");
+
+				VkPipelineLayoutCreateInfo pipeline_layout_create_info = VkTools::Initializer::PipelineLayoutCreateInfo(descriptor_set_layouts.data(), PipelineLayoutManager::GetDescriptorSetCount(ref));
+
+				const std::vector<VkPushConstantRange>& push_constant_ranges = PipelineLayoutManager::GetPushConstantRanges(ref);
+				pipeline_layout_create_info.pushConstantRangeCount = static_cast<uint32_t>(push_constant_ranges.size());
+				pipeline_layout_create_info.pPushConstantRanges = push_constant_ranges.data();
 				VK_CHECK_RESULT(vkCreatePipelineLayout(Vulkan::RenderSystem::vkDevice, &pipeline_layout_create_info, nullptr, &pipeline_layout));
 
-				std::vector<VkDescriptorPoolSize> pool_size;
-				pool_size.reserve(set_layout_bindings.size());
+				//Layouts with the same descriptor counts share their pools
+				PipelineLayoutManager::GetDescriptorPoolSignature(ref) = DescriptorAllocator::GetSignature(set_layout_bindings);
+			}
+		}
+
+		DOD::Ref PipelineLayoutManager::CreatePipelineLayoutFromShaders(const std::string& name, const std::vector<DOD::Ref>& shaderRefs)
+		{
+			std::vector<VkDescriptorSetLayoutBinding> set_layout_bindings;
+			std::vector<VkPushConstantRange> push_constant_ranges;
+			uint8_t uses_descriptor_heap = 0u;
+
+			for (const auto& shader_ref : shaderRefs)
+			{
+				const ShaderReflection& reflection = GpuProgramManager::GetReflection(shader_ref);
+				const VkShaderStageFlagBits stage = GpuProgramManager::GetShaderStageCreateInfo(shader_ref).stage;
+
+				for (const auto& binding : reflection.bindings)
+				{
+					if (binding.set == DESCRIPTOR_HEAP_SET)
+					{
+						uses_descriptor_heap = 1u;
+						continue;
+					}
+
+					if (binding.set != 0u || binding.descriptorCount == 0u)
+					{
+						printf("ERROR: PipelineLayoutManager::CreatePipelineLayoutFromShaders: %s binding %u of set %u is not supported \n", name.c_str(), binding.binding, binding.set);
+						assert(false);
+						continue;
+					}
+
+					auto it = std::find_if(set_layout_bindings.begin(), set_layout_bindings.end(),
+						[&binding](const VkDescriptorSetLayoutBinding& layout_binding) { return layout_binding.binding == binding.binding; });
+
+					if (it == set_layout_bindings.end())
+					{
+						set_layout_bindings.push_back(VkTools::Initializer::DescriptorSetLayoutBinding(binding.descriptorType, stage, binding.binding));
+						set_layout_bindings.back().descriptorCount = binding.descriptorCount;
+						continue;
+					}
+
+					if (it->descriptorType != binding.descriptorType)
+					{
+						printf("ERROR: PipelineLayoutManager::CreatePipelineLayoutFromShaders: %s stages disagree on binding %u \n", name.c_str(), binding.binding);
+						assert(false);
+						continue;
+					}
+
+					it->stageFlags |= stage;
+					it->descriptorCount = std::max(it->descriptorCount, binding.descriptorCount);
+				}
+
+				//One range over the blocks of all stages, overlapping ranges would have to be pushed with the stages of each other
+				if (reflection.pushConstantSize > 0u)
+				{
+					if (push_constant_ranges.empty())
+					{
+						push_constant_ranges.push_back(VkTools::Initializer::PushConstantRange(stage, reflection.pushConstantSize, reflection.pushConstantOffset));
+					}
+					else
+					{
+						VkPushConstantRange& range = push_constant_ranges.back();
+						const uint32_t end = std::max(range.offset + range.size, reflection.pushConstantOffset + reflection.pushConstantSize);
+
+						range.stageFlags |= stage;
+						range.offset = std::min(range.offset, reflection.pushConstantOffset);
+						range.size = end - range.offset;
+					}
+				}
+			}
+
+			std::sort(set_layout_bindings.begin(), set_layout_bindings.end(),
+				[](const VkDescriptorSetLayoutBinding& lhs, const VkDescriptorSetLayoutBinding& rhs) { return lhs.binding < rhs.binding; });
 
-				uint32_t max_pool_count = 0u;
-				for (auto& layout_binding : set_layout_bindings)
+			for (const auto& ref : reflectedLayouts)
+			{
+				if (IsSameInterface(ref, set_layout_bindings, push_constant_ranges, uses_descriptor_heap))
 				{
-					pool_size.push_back(VkTools::Initializer::DescriptorPoolSize(layout_binding.descriptorType, layout_binding.descriptorCount));
-					max_pool_count = std::max(max_pool_count, layout_binding.descriptorCount);
+					GetReflectedRefCount(ref)++;
+					return ref;
 				}
+			}
+
+			DOD::Ref ref = CreatePipelineLayout(name);
+			GetDescriptorSetLayoutBinding(ref) = std::move(set_layout_bindings);
+			GetPushConstantRanges(ref) = std::move(push_constant_ranges);
+			GetUsesDescriptorHeap(ref) = uses_descriptor_heap;
+			GetReflectedRefCount(ref) = 1u;
+
+			CreateResource({ ref });
+			reflectedLayouts.push_back(ref);
+
+			return ref;
+		}
+
+		void PipelineLayoutManager::ReleasePipelineLayout(const DOD::Ref& ref)
+		{
+			uint32_t& ref_count = GetReflectedRefCount(ref);
+			assert(ref_count > 0u && "Layout was not created from shaders");
 
-				VkDescriptorPoolCreateInfo descriptorPoolInfo = VkTools::Initializer::DescriptorPoolCreateInfo(pool_size.size(), pool_size.data(), max_pool_count);
-				VK_CHECK_RESULT(vkCreateDescriptorPool(Vulkan::RenderSystem::vkDevice, &descriptorPoolInfo, nullptr, &descriptor_pool));
+			if (--ref_count > 0u)
+			{
+				return;
 			}
+
+			reflectedLayouts.erase(std::remove(reflectedLayouts.begin(), reflectedLayouts.end(), ref), reflectedLayouts.end());
+			DestroyPipelineLayoutAndResources({ ref });
 		}
 
-		VkDescriptorSet PipelineLayoutManager::AllocateWriteDescriptorSet(const DOD::Ref& ref, const std::vector<BindingInfo>& binding_infos)
+		bool PipelineLayoutManager::IsSameInterface(const DOD::Ref& ref, const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkPushConstantRange>& push_constant_ranges, uint8_t uses_descriptor_heap)
 		{
-			VkDescriptorPool& descriptor_pool = PipelineLayoutManager::GetDescriptorPool(ref);
-			VkDescriptorSetLayout& descriptor_set_layout = PipelineLayoutManager::GetDescriptorSetLayout(ref);
-			
-			
-			VkDescriptorSetAllocateInfo descriptor_allocate_info = VkTools::Initializer::DescriptorSetAllocateInfo(descriptor_pool, &descriptor_set_layout, 1);
+			const std::vector<VkDescriptorSetLayoutBinding>& ref_bindings = GetDescriptorSetLayoutBinding(ref);
+			const std::vector<VkPushConstantRange>& ref_ranges = GetPushConstantRanges(ref);
+
+			if (GetUsesDescriptorHeap(ref) != uses_descriptor_heap || ref_bindings.size() != bindings.size() || ref_ranges.size() != push_constant_ranges.size())
+			{
+				return false;
+			}
 
-			VkDescriptorSet descriptor_set;
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(Vulkan::RenderSystem::vkDevice, &descriptor_allocate_info, &descriptor_set));
+			for (size_t i = 0u; i < bindings.size(); i++)
+			{
+				if (ref_bindings[i].binding != bindings[i].binding || ref_bindings[i].descriptorType != bindings[i].descriptorType ||
+					ref_bindings[i].descriptorCount != bindings[i].descriptorCount || ref_bindings[i].stageFlags != bindings[i].stageFlags)
+				{
+					return false;
+				}
+			}
 
+			for (size_t i = 0u; i < push_constant_ranges.size(); i++)
+			{
+				if (ref_ranges[i].stageFlags != push_constant_ranges[i].stageFlags || ref_ranges[i].offset != push_constant_ranges[i].offset || ref_ranges[i].size != push_constant_ranges[i].size)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		uint32_t PipelineLayoutManager::GetDescriptorSetCount(const DOD::Ref& ref)
+		{
+			//Without descriptor indexing the resources have to be in the per draw set
+			return GetUsesDescriptorHeap(ref) && DescriptorHeap::IsSupported() ? 2u : 1u;
+		}
+
+		VkDescriptorSet PipelineLayoutManager::AllocateWriteDescriptorSet(const DOD::Ref& ref, const std::vector<BindingInfo>& binding_infos, VkDescriptorPool& descriptor_pool)
+		{
+			const VkDescriptorSet descriptor_set = DescriptorAllocator::Allocate(GetDescriptorPoolSignature(ref), GetDescriptorSetLayout(ref), descriptor_pool);
+
+			WriteDescriptorSet(ref, descriptor_set, binding_infos);
+			return descriptor_set;
+		}
+
+		VkDescriptorSet PipelineLayoutManager::AllocateWriteTransientDescriptorSet(const DOD::Ref& ref, const std::vector<BindingInfo>& binding_infos)
+		{
+			const VkDescriptorSet descriptor_set = DescriptorAllocator::AllocateTransient(GetDescriptorPoolSignature(ref), GetDescriptorSetLayout(ref));
+
+			WriteDescriptorSet(ref, descriptor_set, binding_infos);
+			return descriptor_set;
+		}
+
+		void PipelineLayoutManager::FreeDescriptorSet(const DOD::Ref& ref, VkDescriptorPool descriptor_pool, VkDescriptorSet descriptor_set)
+		{
+			DescriptorAllocator::Free(GetDescriptorPoolSignature(ref), descriptor_pool, descriptor_set);
+		}
+
+		void PipelineLayoutManager::WriteDescriptorSet(const DOD::Ref& ref, VkDescriptorSet descriptor_set, const std::vector<BindingInfo>& binding_infos)
+		{
 			auto& pipeline_layouts = PipelineLayoutManager::GetDescriptorSetLayoutBinding(ref);
-			
 
 			std::vector<VkWriteDescriptorSet>   write_descriptor_set;
 			std::vector<VkDescriptorImageInfo>  image_infos;
@@ -69,21 +225,75 @@ namespace Renderer
 			{
 				auto& pipeline_layout = pipeline_layouts[i];
 
-				const BindingInfo&     info			= binding_infos[i];
-				UniformBufferObject& buffer_object  = UniformBufferManager::GetUniformBufferObject(info.buffer_ref);
-				const VkDeviceSize size_in_bytes	= UniformBufferManager::GetUniformBufferSize(info.buffer_ref);
+				//Layout bindings come in reflection order, the infos in whatever order the pass pushed them
+				auto info_it = std::find_if(binding_infos.begin(), binding_infos.end(), [&pipeline_layout](const BindingInfo& info)
+				{
+					return info.binding_location == pipeline_layout.binding;
+				});
+
+				if (info_it == binding_infos.end())
+				{
+					printf("ERROR: PipelineLayoutManager::WriteDescriptorSet: no resource for binding %u \n", pipeline_layout.binding);
+					assert(false);
+					return;
+				}
+
+				const BindingInfo&     info			= *info_it;
+
+				switch (pipeline_layout.descriptorType)
+				{
+					case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+					{
+						UniformBufferObject& buffer_object  = UniformBufferManager::GetUniformBufferObject(info.buffer_ref);
+						const VkDeviceSize size_in_bytes	= UniformBufferManager::GetUniformBufferSize(info.buffer_ref);
+
+						VkDescriptorBufferInfo& buffer_info = buffer_infos[i];
 
-				VkDescriptorBufferInfo& buffer_info = buffer_infos[i];
+						buffer_info.buffer = buffer_object.buffer;
+						buffer_info.offset = 0u;
+						buffer_info.range  = size_in_bytes;
 
-				buffer_info.buffer = buffer_object.buffer;
-				buffer_info.offset = 0u;
-				buffer_info.range  = size_in_bytes;
+						write_descriptor_set[i] = VkTools::Initializer::WriteDescriptorSet(descriptor_set, pipeline_layout.descriptorType, pipeline_layout.binding, &buffer_info);
+						break;
+					}
+					case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+					{
+						BufferObject& buffer_object = BufferObjectManager::GetBufferObject(info.buffer_ref);
+						const VkDeviceSize size_in_bytes = BufferObjectManager::GetBufferSize(info.buffer_ref);
 
-				write_descriptor_set[i] = VkTools::Initializer::WriteDescriptorSet(descriptor_set, pipeline_layout.descriptorType, pipeline_layout.binding, &buffer_info);
+						VkDescriptorBufferInfo& buffer_info = buffer_infos[i];
+
+						buffer_info.buffer = buffer_object.buffer;
+						buffer_info.offset = 0u;
+						buffer_info.range = size_in_bytes;
+
+						write_descriptor_set[i] = VkTools::Initializer::WriteDescriptorSet(descriptor_set, pipeline_layout.descriptorType, pipeline_layout.binding, &buffer_info);
+						break;
+					}
+					case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+					case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+					{
+						//Per level bindings of a resized image may point past its chain until their owner rebuilds them
+						const VkImageView image_view = info.mip_level == ALL_MIP_LEVELS
+							? ImageManager::GetImageView(info.image_ref)
+							: ImageManager::GetSubresourceImageViews(info.image_ref, 0u, std::min(info.mip_level, ImageManager::GetMipLevelCount(info.image_ref) - 1u));
+
+						const VkImageLayout image_layout = pipeline_layout.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+							? VK_IMAGE_LAYOUT_GENERAL
+							: info.image_layout;
+
+						image_infos[i] = VkTools::Initializer::DescriptorImageInfo(info.sampler, image_view, image_layout);
+
+						write_descriptor_set[i] = VkTools::Initializer::WriteDescriptorSet(descriptor_set, pipeline_layout.descriptorType, pipeline_layout.binding, &image_infos[i]);
+						break;
+					}
+					default:
+						assert(false && "Descriptor type is not supported");
+						break;
+				}
 			}
 
 			vkUpdateDescriptorSets(Vulkan::RenderSystem::vkDevice, write_descriptor_set.size(), write_descriptor_set.data(), 0, NULL);
-			return descriptor_set;
 		}
 
 		void PipelineLayoutManager::DestroyPipelineLayoutAndResources(const std::vector<DOD::Ref>& refs)
@@ -115,13 +325,6 @@ namespace Renderer
 					vkDestroyDescriptorSetLayout(Vulkan::RenderSystem::vkDevice, descriptor_layout, nullptr);
 					descriptor_layout = VK_NULL_HANDLE;
 				}
-
-				VkDescriptorPool& descriptor_pool = GetDescriptorPool(ref);
-				if (descriptor_pool != VK_NULL_HANDLE)
-				{
-					vkDestroyDescriptorPool(Vulkan::RenderSystem::vkDevice, descriptor_pool, nullptr);
-					descriptor_pool = VK_NULL_HANDLE;
-				}
 			}
 		}
 	}
@@ -7,111 +7,300 @@
 #include "Vulkan\VulkanTools.h"
 #include "Vulkan\VulkanRendererInitializer.h"
 
+//Other
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
 namespace Renderer
 {
     namespace Resource
     {
+		namespace
+		{
+			//Integer color attachments can not be blended
+			bool IsIntegerFormat(VkFormat format)
+			{
+				switch (format)
+				{
+					case VK_FORMAT_R8_UINT: case VK_FORMAT_R8_SINT:
+					case VK_FORMAT_R16_UINT: case VK_FORMAT_R16_SINT:
+					case VK_FORMAT_R32_UINT: case VK_FORMAT_R32_SINT:
+					case VK_FORMAT_R32G32_UINT: case VK_FORMAT_R32G32_SINT:
+					case VK_FORMAT_R8G8B8A8_UINT: case VK_FORMAT_R16G16B16A16_UINT:
+					case VK_FORMAT_R32G32B32A32_UINT: case VK_FORMAT_R32G32B32A32_SINT:
+						return true;
+					default:
+						return false;
+				}
+			}
+		}
+
+		std::vector<std::thread> PipelineManager::compileThreads;
+		std::mutex PipelineManager::compileMutex;
+		std::condition_variable PipelineManager::compileCondition;
+		std::condition_variable PipelineManager::idleCondition;
+		std::deque<DOD::Ref> PipelineManager::compileQueue;
+		std::vector<std::pair<DOD::Ref, VkPipeline>> PipelineManager::compiledPipelines;
+		uint32_t PipelineManager::compilingCount = 0u;
+		bool PipelineManager::stopCompileThreads = false;
+
         void PipelineManager::CreateResource(const std::vector<DOD::Ref>& refs)
         {
 			for (const auto& ref : refs)
 			{
-				VkPipeline&   pipeline = PipelineManager::GetPipeline(ref);
-
-				const DOD::Ref renderPassRef = PipelineManager::GetRenderPassRef(ref);
-				VkRenderPass& render_pass = RenderPassManager::GetRenderPass(renderPassRef);
-
-				const DOD::Ref pipelineLayoutRef = PipelineManager::GetPipelineLayoutRef(ref);
-				VkPipelineLayout& pipeline_layout = PipelineLayoutManager::GetPipelineLayout(pipelineLayoutRef);
-
-				const DOD::Ref bufferLayoutRef = PipelineManager::GetbufferLayoutRef(ref);
-				VkPipelineVertexInputStateCreateInfo& vertex_input = BufferLayoutManager::GetVertexInput(bufferLayoutRef);
-
-				uint32_t shader_stage_count = 0u;
-				VkPipelineShaderStageCreateInfo shader_stages[3];
-
-				DOD::Ref vertex_shader = PipelineManager::GetVertexShader(ref);
-				DOD::Ref geometry_shader = PipelineManager::GetGeometryShader(ref);
-				DOD::Ref fragment_shader = PipelineManager::GetFragmentShader(ref);
-
-				if (vertex_shader.isValid())
-					shader_stages[shader_stage_count++] = GpuProgramManager::GetShaderStageCreateInfo(vertex_shader);
-
-				if (geometry_shader.isValid())
-					shader_stages[shader_stage_count++] = GpuProgramManager::GetShaderStageCreateInfo(geometry_shader);
-
-				if (fragment_shader.isValid())
-					shader_stages[shader_stage_count++] = GpuProgramManager::GetShaderStageCreateInfo(fragment_shader);
-
-				VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
-					VkTools::Initializer::PipelineInputAssemblyStateCreateInfo(
-						VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-						0,
-						VK_FALSE);
-
-				VkPipelineRasterizationStateCreateInfo rasterizationState =
-					VkTools::Initializer::PipelineRasterizationStateCreateInfo(
-						VK_POLYGON_MODE_FILL,
-						VK_CULL_MODE_BACK_BIT,
-						VK_FRONT_FACE_CLOCKWISE,
-						0);
-
-				VkPipelineColorBlendAttachmentState blendAttachmentState =
-					VkTools::Initializer::PipelineColorBlendAttachmentState(
-						VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-						VK_TRUE);
-
-				VkPipelineColorBlendStateCreateInfo colorBlendState =
-					VkTools::Initializer::PipelineColorBlendStateCreateInfo(
-						1,
-						&blendAttachmentState);
-
-				VkPipelineDepthStencilStateCreateInfo depthStencilState =
-					VkTools::Initializer::PipelineDepthStencilStateCreateInfo(
-						VK_TRUE,
-						VK_TRUE,
-						VK_COMPARE_OP_LESS_OR_EQUAL);
-
-				VkPipelineViewportStateCreateInfo viewportState =
-					VkTools::Initializer::PipelineViewportStateCreateInfo(1, 1, 0);
-
-				VkPipelineMultisampleStateCreateInfo multisampleState =
-					VkTools::Initializer::PipelineMultisampleStateCreateInfo(
-						VK_SAMPLE_COUNT_1_BIT,
-						0);
-
-				std::vector<VkDynamicState> dynamicStateEnables = {
-					VK_DYNAMIC_STATE_VIEWPORT,
-					VK_DYNAMIC_STATE_SCISSOR
-				};
-				VkPipelineDynamicStateCreateInfo dynamicState =
-					VkTools::Initializer::PipelineDynamicStateCreateInfo(
-						dynamicStateEnables.data(),
-						static_cast<uint32_t>(dynamicStateEnables.size()),
-						0);
-
-				// Create Pipeline state VI-IA-VS-VP-RS-FS-CB
-				VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-
-				pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-				pipelineCreateInfo.layout = pipeline_layout;
-				pipelineCreateInfo.renderPass = render_pass;
-
-				pipelineCreateInfo.stageCount = shader_stage_count;
-				pipelineCreateInfo.pStages = shader_stages;
-				pipelineCreateInfo.pVertexInputState = &vertex_input;
-				pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-				pipelineCreateInfo.pRasterizationState = &rasterizationState;
-				pipelineCreateInfo.pColorBlendState = &colorBlendState;
-				pipelineCreateInfo.pMultisampleState = &multisampleState;
-				pipelineCreateInfo.pViewportState = &viewportState;
-				pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-				pipelineCreateInfo.pDynamicState = &dynamicState;
-
-				// Create rendering pipeline
-				VK_CHECK_RESULT(vkCreateGraphicsPipelines(Vulkan::RenderSystem::vkDevice, VulkanRendererInitializer::m_PipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+				VK_CHECK_RESULT(BuildPipeline(ref, PipelineManager::GetPipeline(ref)));
+				PipelineManager::GetState(ref) = PipelineState::kReady;
 			}
         }
 
+		VkResult PipelineManager::BuildPipeline(const DOD::Ref& ref, VkPipeline& pipeline)
+		{
+			//Only reads the description of the pipeline, so it runs on the compile threads as well
+			const DOD::Ref pipelineLayoutRef = PipelineManager::GetPipelineLayoutRef(ref);
+			VkPipelineLayout& pipeline_layout = PipelineLayoutManager::GetPipelineLayout(pipelineLayoutRef);
+
+			//Compute pipelines only need the shader stage and the layout
+			DOD::Ref compute_shader = PipelineManager::GetComputeShader(ref);
+			if (compute_shader.isValid())
+			{
+				VkComputePipelineCreateInfo computePipelineCreateInfo = {};
+				computePipelineCreateInfo.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+				computePipelineCreateInfo.layout = pipeline_layout;
+				computePipelineCreateInfo.stage  = GpuProgramManager::GetShaderStageCreateInfo(compute_shader);
+
+				return vkCreateComputePipelines(Vulkan::RenderSystem::vkDevice, VulkanRendererInitializer::m_PipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline);
+			}
+
+			const DOD::Ref renderPassRef = PipelineManager::GetRenderPassRef(ref);
+			VkRenderPass& render_pass = RenderPassManager::GetRenderPass(renderPassRef);
+
+			const DOD::Ref bufferLayoutRef = PipelineManager::GetbufferLayoutRef(ref);
+			VkPipelineVertexInputStateCreateInfo& vertex_input = BufferLayoutManager::GetVertexInput(bufferLayoutRef);
+
+			uint32_t shader_stage_count = 0u;
+			VkPipelineShaderStageCreateInfo shader_stages[3];
+
+			DOD::Ref vertex_shader = PipelineManager::GetVertexShader(ref);
+			DOD::Ref geometry_shader = PipelineManager::GetGeometryShader(ref);
+			DOD::Ref fragment_shader = PipelineManager::GetFragmentShader(ref);
+
+			if (vertex_shader.isValid())
+				shader_stages[shader_stage_count++] = GpuProgramManager::GetShaderStageCreateInfo(vertex_shader);
+
+			if (geometry_shader.isValid())
+				shader_stages[shader_stage_count++] = GpuProgramManager::GetShaderStageCreateInfo(geometry_shader);
+
+			if (fragment_shader.isValid())
+				shader_stages[shader_stage_count++] = GpuProgramManager::GetShaderStageCreateInfo(fragment_shader);
+
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
+				VkTools::Initializer::PipelineInputAssemblyStateCreateInfo(
+					VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+					0,
+					VK_FALSE);
+
+			VkPipelineRasterizationStateCreateInfo rasterizationState =
+				VkTools::Initializer::PipelineRasterizationStateCreateInfo(
+					VK_POLYGON_MODE_FILL,
+					VK_CULL_MODE_BACK_BIT,
+					VK_FRONT_FACE_CLOCKWISE,
+					0);
+
+			bool blendEnable = true;
+			for (const auto& attachment : RenderPassManager::GetAttachementDescription(renderPassRef))
+			{
+				if (!attachment.depthFormat)
+				{
+					blendEnable = !IsIntegerFormat(attachment.format);
+					break;
+				}
+			}
+
+			VkPipelineColorBlendAttachmentState blendAttachmentState =
+				VkTools::Initializer::PipelineColorBlendAttachmentState(
+					VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+					blendEnable ? VK_TRUE : VK_FALSE);
+
+			VkPipelineColorBlendStateCreateInfo colorBlendState =
+				VkTools::Initializer::PipelineColorBlendStateCreateInfo(
+					1,
+					&blendAttachmentState);
+
+			VkPipelineDepthStencilStateCreateInfo depthStencilState =
+				VkTools::Initializer::PipelineDepthStencilStateCreateInfo(
+					VK_TRUE,
+					VK_TRUE,
+					VK_COMPARE_OP_LESS_OR_EQUAL);
+
+			VkPipelineViewportStateCreateInfo viewportState =
+				VkTools::Initializer::PipelineViewportStateCreateInfo(1, 1, 0);
+
+			VkPipelineMultisampleStateCreateInfo multisampleState =
+				VkTools::Initializer::PipelineMultisampleStateCreateInfo(
+					VK_SAMPLE_COUNT_1_BIT,
+					0);
+
+			std::vector<VkDynamicState> dynamicStateEnables = {
+				VK_DYNAMIC_STATE_VIEWPORT,
+				VK_DYNAMIC_STATE_SCISSOR
+			};
+			VkPipelineDynamicStateCreateInfo dynamicState =
+				VkTools::Initializer::PipelineDynamicStateCreateInfo(
+					dynamicStateEnables.data(),
+					static_cast<uint32_t>(dynamicStateEnables.size()),
+					0);
+
+			// Create Pipeline state VI-IA-VS-VP-RS-FS-CB
+			VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+
+			pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineCreateInfo.layout = pipeline_layout;
+			pipelineCreateInfo.renderPass = render_pass;
+
+			pipelineCreateInfo.stageCount = shader_stage_count;
+			pipelineCreateInfo.pStages = shader_stages;
+			pipelineCreateInfo.pVertexInputState = &vertex_input;
+			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+			pipelineCreateInfo.pRasterizationState = &rasterizationState;
+			pipelineCreateInfo.pColorBlendState = &colorBlendState;
+			pipelineCreateInfo.pMultisampleState = &multisampleState;
+			pipelineCreateInfo.pViewportState = &viewportState;
+			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+			pipelineCreateInfo.pDynamicState = &dynamicState;
+
+			// Create rendering pipeline
+			return vkCreateGraphicsPipelines(Vulkan::RenderSystem::vkDevice, VulkanRendererInitializer::m_PipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+		}
+
+		void PipelineManager::CreateResourceAsync(const std::vector<DOD::Ref>& refs)
+		{
+			std::lock_guard<std::mutex> lock(compileMutex);
+
+			if (compileThreads.empty())
+			{
+				stopCompileThreads = false;
+				for (uint32_t i = 0u; i < MAX_PIPELINE_COMPILE_THREADS; i++)
+				{
+					compileThreads.push_back(std::thread(&PipelineManager::CompileThread));
+				}
+			}
+
+			for (const auto& ref : refs)
+			{
+				assert(GetPipeline(ref) == VK_NULL_HANDLE && "Destroy the pipeline before recreating it");
+
+				GetState(ref) = PipelineState::kCompiling;
+				compileQueue.push_back(ref);
+				compilingCount++;
+			}
+
+			compileCondition.notify_all();
+		}
+
+		void PipelineManager::CompileThread()
+		{
+			while (true)
+			{
+				DOD::Ref ref;
+				{
+					std::unique_lock<std::mutex> lock(compileMutex);
+					compileCondition.wait(lock, [] { return stopCompileThreads || !compileQueue.empty(); });
+
+					if (stopCompileThreads)
+					{
+						return;
+					}
+
+					ref = compileQueue.front();
+					compileQueue.pop_front();
+				}
+
+				VkPipeline pipeline = VK_NULL_HANDLE;
+				const VkResult result = BuildPipeline(ref, pipeline);
+
+				{
+					std::lock_guard<std::mutex> lock(compileMutex);
+					compiledPipelines.push_back(std::make_pair(ref, result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE));
+					compilingCount--;
+				}
+
+				idleCondition.notify_all();
+			}
+		}
+
+		void PipelineManager::Update()
+		{
+			std::vector<std::pair<DOD::Ref, VkPipeline>> compiled;
+			{
+				std::lock_guard<std::mutex> lock(compileMutex);
+				compiled.swap(compiledPipelines);
+			}
+
+			for (const auto& entry : compiled)
+			{
+				GetPipeline(entry.first) = entry.second;
+				GetState(entry.first) = entry.second != VK_NULL_HANDLE ? PipelineState::kReady : PipelineState::kFailed;
+
+				if (entry.second == VK_NULL_HANDLE)
+				{
+					printf("ERROR: PipelineManager::Update: could not create %s \n", GetNameByRef(entry.first).c_str());
+				}
+			}
+		}
+
+		void PipelineManager::Flush()
+		{
+			{
+				std::unique_lock<std::mutex> lock(compileMutex);
+				idleCondition.wait(lock, [] { return compilingCount == 0u; });
+			}
+
+			Update();
+		}
+
+		void PipelineManager::ShutdownCompileThreads()
+		{
+			//Pipelines still queued are dropped, the ones being created are finished
+			{
+				std::lock_guard<std::mutex> lock(compileMutex);
+				for (const auto& ref : compileQueue)
+				{
+					GetState(ref) = PipelineState::kNone;
+				}
+
+				compilingCount -= static_cast<uint32_t>(compileQueue.size());
+				compileQueue.clear();
+				stopCompileThreads = true;
+			}
+
+			compileCondition.notify_all();
+			for (auto& thread : compileThreads)
+			{
+				thread.join();
+			}
+			compileThreads.clear();
+
+			Update();
+		}
+
+		DOD::Ref PipelineManager::GetBindablePipeline(const DOD::Ref& ref)
+		{
+			if (GetState(ref) == PipelineState::kReady)
+			{
+				return ref;
+			}
+
+			const DOD::Ref fallback = GetFallbackPipeline(ref);
+			if (fallback.isValid() && GetState(fallback) == PipelineState::kReady)
+			{
+				assert(GetPipelineLayoutRef(fallback) == GetPipelineLayoutRef(ref) && "Fallback is bound with the descriptor sets of the draw");
+				return fallback;
+			}
+
+			return DOD::Ref();
+		}
+
 		void PipelineManager::DestroyPipelineAndResources(const std::vector<DOD::Ref>& refs)
 		{
 			DestroyResources(refs);
@@ -124,6 +313,12 @@ namespace Renderer
 
 		void PipelineManager::DestroyResources(const std::vector<DOD::Ref>& refs)
 		{
+			//A compile thread may still write the handle
+			if (std::any_of(refs.begin(), refs.end(), [](const DOD::Ref& ref) { return GetState(ref) == PipelineState::kCompiling; }))
+			{
+				Flush();
+			}
+
 			for(const auto& ref: refs)
 			{
 				VkPipeline& pipeline = GetPipeline(ref);
@@ -132,6 +327,8 @@ namespace Renderer
 					vkDestroyPipeline(Vulkan::RenderSystem::vkDevice, pipeline, nullptr);
 					pipeline = VK_NULL_HANDLE;
 				}
+
+				GetState(ref) = PipelineState::kNone;
 			}
 		}
         
@@ -30,16 +30,22 @@ namespace Renderer
 					attachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
 					attachmentDesc.loadOp = (attachement.flags & AttachementFlags::kClearOnLoad) > 0u
 						? VK_ATTACHMENT_LOAD_OP_CLEAR
-						: VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+						: (attachement.flags & AttachementFlags::kLoadOnLoad) > 0u
+							? VK_ATTACHMENT_LOAD_OP_LOAD
+							: VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 
-					attachmentDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+					attachmentDesc.storeOp = (attachement.flags & AttachementFlags::kDiscardOnStore) > 0u
+						? VK_ATTACHMENT_STORE_OP_DONT_CARE
+						: VK_ATTACHMENT_STORE_OP_STORE;
 					attachmentDesc.stencilLoadOp = (attachement.flags & AttachementFlags::kClearStencilOnLoad) > 0u
 						? VK_ATTACHMENT_LOAD_OP_CLEAR
 						: VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 
 					attachmentDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-					attachmentDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-					attachmentDesc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+					attachmentDesc.initialLayout = attachement.initialLayout;
+					attachmentDesc.finalLayout = attachement.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED
+						? attachement.finalLayout
+						: !attachement.depthFormat ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 					attachmentDesc.flags = 0u;
 
 					attachementsDescriptions.push_back(std::move(attachmentDesc));
@@ -84,8 +90,8 @@ namespace Renderer
 				srcDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 				VkSubpassDependency dstDependency = { 0 };
-				dstDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-				dstDependency.dstSubpass = 0;
+				dstDependency.srcSubpass = 0;
+				dstDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
 				dstDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 				dstDependency.dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
 				dstDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -14,11 +14,19 @@
 #include "Vulkan/VkGPUMemoryManager.h"
 #include "Vulkan/VkImageManager.h"
 #include "Vulkan/VkFrameBufferManager.h"
+#include "Vulkan/VkDescriptorHeap.h"
+#include "Vulkan/VkDescriptorAllocator.h"
+#include "Vulkan/VkDescriptorSetCache.h"
+#include "Vulkan/VkShaderHotReload.h"
+#include "Vulkan/VkTextureStreamer.h"
+#include "Vulkan/VkVirtualTexture.h"
 
 //Other
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <unordered_set>
 
 
 
@@ -45,6 +53,12 @@ namespace Renderer
 
 		VkPhysicalDevice			 RenderSystem::vkPhysicalDevice = nullptr;
 		VkPhysicalDeviceMemoryProperties RenderSystem::vkPhysicalDeviceMemoryProperties;
+		VkPhysicalDeviceFeatures	 RenderSystem::vkPhysicalDeviceFeatures;
+		bool						 RenderSystem::supportsDrawIndirectCount = false;
+		bool						 RenderSystem::supportsDrawIndirectFirstInstance = false;
+		PFN_vkCmdDrawIndexedIndirectCountKHR RenderSystem::vkCmdDrawIndexedIndirectCount = nullptr;
+		bool						 RenderSystem::supportsPhysicalDeviceProperties2 = false;
+		bool						 RenderSystem::supportsDescriptorIndexing = false;
 
 		uint32_t                     RenderSystem::vkGraphicsQueueFamilyIndex = 0;
 		VkQueue                      RenderSystem::vkQueue;
@@ -61,6 +75,8 @@ namespace Renderer
 		uint32_t                     RenderSystem::activeBackbufferMask = 0u;
 		uint32_t					 RenderSystem::allocatedSecondaryCmdBufferCount = 0u;
 		glm::uvec2                   RenderSystem::backBufferDimensions = glm::uvec2(0, 0);
+		bool                         RenderSystem::vsyncEnabled = true;
+		bool                         RenderSystem::swapchainOutOfDate = false;
 
 		VkPipelineCache              RenderSystem::vkPipelineCache = nullptr;
 
@@ -82,6 +98,16 @@ namespace Renderer
 			std::vector<VkExtensionProperties> available_instance_extensions(instance_extension_count);
 			VK_CHECK_RESULT(vkEnumerateInstanceExtensionProperties(nullptr, &instance_extension_count, available_instance_extensions.data()));
 
+			//Needed to query the descriptor indexing features
+			supportsPhysicalDeviceProperties2 = std::any_of(available_instance_extensions.begin(), available_instance_extensions.end(), [](const VkExtensionProperties& extension)
+			{
+				return strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0;
+			});
+			if (supportsPhysicalDeviceProperties2)
+			{
+				enabledExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			}
+
 			//Get available validations
 			uint32_t instance_layer_count;
 			VK_CHECK_RESULT(vkEnumerateInstanceLayerProperties(&instance_layer_count, nullptr));
@@ -113,6 +139,10 @@ namespace Renderer
 			//wait on the host for the completion of outstanding queue operations for all queues on a given logical device
 			vkDeviceWaitIdle(vkDevice);
 
+			Renderer::Resource::ShaderHotReload::Shutdown();
+			Renderer::Resource::PipelineManager::ShutdownCompileThreads();
+			Renderer::Resource::TextureStreamer::Shutdown();
+			Renderer::Resource::VirtualTextureSystem::Shutdown();
 			Renderer::Vulkan::RenderSystem::DestroyCommandBuffers();
 
 			//Release resources
@@ -121,6 +151,9 @@ namespace Renderer
 			Renderer::Resource::GpuProgramManager::DestroyResources(Renderer::Resource::GpuProgramManager::activeRefs);
 			Renderer::Resource::PipelineLayoutManager::DestroyResources(Renderer::Resource::PipelineLayoutManager::activeRefs);
 			Renderer::Resource::PipelineManager::DestroyResources(Renderer::Resource::PipelineManager::activeRefs);
+			Renderer::Resource::DescriptorHeap::Destroy();
+			Renderer::Resource::DescriptorSetCache::Destroy();
+			Renderer::Resource::DescriptorAllocator::Destroy();
 			Renderer::Resource::BufferObjectManager::DestroyResources(Renderer::Resource::BufferObjectManager::activeRefs);
 			Renderer::Resource::UniformBufferManager::DestroyResources(Renderer::Resource::UniformBufferManager::activeRefs);
 			Renderer::Vulkan::GpuMemoryManager::Destroy();
@@ -205,6 +238,11 @@ namespace Renderer
 			// Get physical device memory properties and features
 			vkGetPhysicalDeviceMemoryProperties(vkPhysicalDevice, &vkPhysicalDeviceMemoryProperties);
 			vkGetPhysicalDeviceFeatures(vkPhysicalDevice, &deviceFeatures);
+			vkPhysicalDeviceFeatures = deviceFeatures;
+
+			// Culled draws start at the instance they were written for, without it each command is drawn with its index pushed
+			supportsDrawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance == VK_TRUE;
+			deviceFeatures.drawIndirectFirstInstance = supportsDrawIndirectFirstInstance ? VK_TRUE : VK_FALSE;
 
 
 			uint32_t queueFamilyCount = 0;
@@ -267,6 +305,59 @@ namespace Renderer
 				//enableDebugMarkers = true;
 			}
 
+			// GPU driven draws can consume the draw count written by the culling pass
+			supportsDrawIndirectCount = VkTools::CheckDeviceExtensionPresent(vkPhysicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			if (supportsDrawIndirectCount)
+			{
+				enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			}
+
+			// Bindless resources live in one descriptor heap written after it was bound, see DescriptorHeap
+			VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {};
+			descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+			supportsDescriptorIndexing = supportsPhysicalDeviceProperties2
+				&& VkTools::CheckDeviceExtensionPresent(vkPhysicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+				&& VkTools::CheckDeviceExtensionPresent(vkPhysicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			if (supportsDescriptorIndexing)
+			{
+				PFN_vkGetPhysicalDeviceFeatures2KHR getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+					vkGetInstanceProcAddr(vkInstance, "vkGetPhysicalDeviceFeatures2KHR"));
+
+				VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedFeatures = {};
+				supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+				VkPhysicalDeviceFeatures2KHR features2 = {};
+				features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+				features2.pNext = &supportedFeatures;
+
+				if (getPhysicalDeviceFeatures2 != nullptr)
+				{
+					getPhysicalDeviceFeatures2(vkPhysicalDevice, &features2);
+				}
+
+				supportsDescriptorIndexing = supportedFeatures.shaderSampledImageArrayNonUniformIndexing
+					&& supportedFeatures.shaderStorageBufferArrayNonUniformIndexing
+					&& supportedFeatures.descriptorBindingSampledImageUpdateAfterBind
+					&& supportedFeatures.descriptorBindingStorageBufferUpdateAfterBind
+					&& supportedFeatures.descriptorBindingUpdateUnusedWhilePending
+					&& supportedFeatures.descriptorBindingPartiallyBound;
+			}
+
+			if (supportsDescriptorIndexing)
+			{
+				descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+				descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+				descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+				descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+				descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+				descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+				deviceCreateInfo.pNext = &descriptorIndexingFeatures;
+
+				enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+				enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			}
+
 			if (enabledExtensions.size() > 0)
 			{
 				deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
@@ -278,6 +369,13 @@ namespace Renderer
 			//Get graphics	queue
 			vkGetDeviceQueue(vkDevice, vkGraphicsQueueFamilyIndex, 0, &vkQueue);
 
+			if (supportsDrawIndirectCount)
+			{
+				vkCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+					vkGetDeviceProcAddr(vkDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+				supportsDrawIndirectCount = vkCmdDrawIndexedIndirectCount != nullptr;
+			}
+
 			if (benableValidation)
 			{
 				vkDebug::DebugMarker::setup(vkDevice);
@@ -381,17 +479,23 @@ namespace Renderer
 			Renderer::Resource::FrameBufferManager::init();
 			Renderer::Resource::DrawCallManager::init();
 			Renderer::Vulkan::GpuMemoryManager::Init();
+			Renderer::Resource::DescriptorAllocator::Init();
 
 			InitVulkanInstance(enableValidation, application_name);
 			InitVulkanDebug(enableValidation);
 			InitVulkanDevice(enableValidation);
 			InitPlatformDependentFormats();
 			InitVulkanSurface(handle, window);
-			InitOrUpdateVulkanSwapChain(enableVsync);
+			vsyncEnabled = enableVsync;
+			InitOrUpdateVulkanSwapChain(vsyncEnabled);
 			InitVulkanSynchronization();
 			InitCommandPool();
 			InitCommandBuffers();
 			InitVulkanPipelineCache();
+			Renderer::Resource::DescriptorHeap::Init();
+			Renderer::Resource::ShaderHotReload::Init("../../Assets/Shaders/");
+			Renderer::Resource::TextureStreamer::Init();
+			Renderer::Resource::VirtualTextureSystem::Init();
 		}
 
 		void RenderSystem::InitVulkanSurface(
@@ -679,32 +783,162 @@ namespace Renderer
 			VK_CHECK_RESULT(result);
 		}
 
-		void RenderSystem::ResizeSwapchain()
+		bool RenderSystem::ResizeSwapchain()
 		{
-			vkDeviceWaitIdle(vkDevice);
-			InitOrUpdateVulkanSwapChain(true);
+			VkSurfaceCapabilitiesKHR surfaceCapabilities;
+			VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vkPhysicalDevice, vkSurface, &surfaceCapabilities));
+
+			//Minimized windows have no extent, the swapchain is kept until they come back
+			const glm::uvec2 extent = glm::uvec2(surfaceCapabilities.currentExtent.width, surfaceCapabilities.currentExtent.height);
+			if (extent.x == 0u || extent.y == 0u || (extent == backBufferDimensions && !swapchainOutOfDate))
+				return false;
+
+			swapchainOutOfDate = false;
+
+			VK_CHECK_RESULT(vkDeviceWaitIdle(vkDevice));
 
-			Renderer::Resource::DrawCallManager::DestroyDrawCallsAndResources(Renderer::Resource::DrawCallManager::activeRefs);
-			Renderer::Resource::PipelineLayoutManager::DestroyPipelineLayoutAndResources(Renderer::Resource::PipelineLayoutManager::activeRefs);
-			Renderer::Resource::PipelineManager::DestroyPipelineAndResources(Renderer::Resource::PipelineManager::activeRefs);
-			Renderer::Resource::FrameBufferManager::DestroyFrameBufferAndResources(Renderer::Resource::FrameBufferManager::activeRefs);
-			Renderer::Resource::RenderPassManager::DestroyRenderPassAndResources(Renderer::Resource::FrameBufferManager::activeRefs);
+			//Fences and command buffers are per back buffer, the image count has to stay the same
+			const size_t swapchainImageCount = vkSwapchainImages.size();
+			InitOrUpdateVulkanSwapChain(vsyncEnabled);
+			assert(vkSwapchainImages.size() == swapchainImageCount);
+
+			//Pipelines use dynamic viewport and scissor, render passes and pipelines stay untouched
+			RecreateResolutionDependentResources();
+			return true;
 		}
 
-		void RenderSystem::StartFrame()
+		void RenderSystem::RecreateResolutionDependentResources()
 		{
+			std::vector<DOD::Ref> imageRefs;
+			for (const auto& ref : Renderer::Resource::ImageManager::activeRefs)
+			{
+				if (Renderer::Resource::ImageManager::IsResolutionDependent(ref))
+					imageRefs.push_back(ref);
+			}
+
+			//Largest first, smaller images then land in the alias slots of the larger ones.
+			//Memory requirements only exist once an image was created, so the texels at the new resolution order them
+			auto getTexelCount = [](const DOD::Ref& ref)
+			{
+				const float resolutionScale = Renderer::Resource::ImageManager::GetResolutionScale(ref);
+				const glm::uvec3& dimensions = Renderer::Resource::ImageManager::GetImageDimensions(ref);
+				const glm::vec2 extent = resolutionScale > 0.0f ? glm::vec2(backBufferDimensions) * resolutionScale : glm::vec2(dimensions);
+
+				uint64_t texelCount = static_cast<uint64_t>(std::max(extent.x, 1.0f)) * static_cast<uint64_t>(std::max(extent.y, 1.0f)) *
+					std::max(dimensions.z, 1u) * Renderer::Resource::ImageManager::GetArrayLayerCount(ref);
+
+				//A mip chain adds up to a third
+				if (Renderer::Resource::ImageManager::HasImageFlags(ref, ImageFlags::kFullMipChain) || Renderer::Resource::ImageManager::GetMipLevelCount(ref) > 1u)
+					texelCount += texelCount / 3u;
+
+				return texelCount;
+			};
+
+			std::sort(imageRefs.begin(), imageRefs.end(), [&getTexelCount](const DOD::Ref& lhs, const DOD::Ref& rhs)
+			{
+				return getTexelCount(lhs) > getTexelCount(rhs);
+			});
+
+			Renderer::Resource::ImageManager::DestroyResource(imageRefs);
+			GpuMemoryManager::ResetPool(MemoryPoolTypes::kResolutionDependentImages);
+			GpuMemoryManager::ResetPool(MemoryPoolTypes::kResolutionDependentTransientImages);
+
+			std::unordered_set<uint32_t> imageIds;
+			for (const auto& ref : imageRefs)
+			{
+				Renderer::Resource::ImageManager::CreateResource(ref);
+				imageIds.insert(ref._id);
+			}
+
+			//Back buffers are replaced along with the swapchain
+			for (uint32_t i = 0u; i < vkSwapchainImages.size(); i++)
+			{
+				imageIds.insert(Renderer::Resource::ImageManager::GetResourceByName("Backbuffer" + std::to_string(i))._id);
+			}
+
+			//Image views changed, frame buffers and descriptor sets using them have to follow
+			for (const auto& frameBufferRef : Renderer::Resource::FrameBufferManager::activeRefs)
+			{
+				const AttachementInfoArray& attachedImages = Renderer::Resource::FrameBufferManager::GetAttachedImiges(frameBufferRef);
+
+				for (const auto& attachmentInfo : attachedImages)
+				{
+					if (imageIds.count(attachmentInfo.imageRef._id) > 0u)
+					{
+						const glm::uvec3& dimensions = Renderer::Resource::ImageManager::GetImageDimensions(attachedImages[0].imageRef);
+						Renderer::Resource::FrameBufferManager::GetDimensions(frameBufferRef) = glm::uvec2(dimensions.x, dimensions.y);
+
+						Renderer::Resource::FrameBufferManager::DestroyResources({ frameBufferRef });
+						Renderer::Resource::FrameBufferManager::CreateResource(frameBufferRef);
+						break;
+					}
+				}
+			}
+
+			UpdateImageDescriptors(imageIds);
+
+			//The device is idle, heap slots can be rewritten in place
+			Renderer::Resource::DescriptorHeap::UpdateImages(imageIds);
+		}
+
+		void RenderSystem::UpdateImageDescriptors(const std::unordered_set<uint32_t>& imageIds)
+		{
+			std::vector<DOD::Ref> drawCallsToUpdate;
+			for (const auto& drawCallRef : Renderer::Resource::DrawCallManager::activeRefs)
+			{
+				for (const auto& bindingInfo : Renderer::Resource::DrawCallManager::GetBindingInfo(drawCallRef))
+				{
+					if (bindingInfo.image_ref.isValid() && imageIds.count(bindingInfo.image_ref._id) > 0u)
+					{
+						drawCallsToUpdate.push_back(drawCallRef);
+						break;
+					}
+				}
+			}
+
+			Renderer::Resource::DescriptorSetCache::InvalidateImages(imageIds);
+			Renderer::Resource::DrawCallManager::UpdateResources(drawCallsToUpdate);
+		}
+
+		bool RenderSystem::StartFrame()
+		{
+			//Between frames nothing is recorded with the pipelines about to be replaced
+			Renderer::Resource::ShaderHotReload::ApplyChanges();
+			Renderer::Resource::PipelineManager::Update();
+
+			//Out of date acquires no image and leaves the semaphore unsignaled, suboptimal images are still presented
 			VkResult result = vkAcquireNextImageKHR(vkDevice, vkSwapchain, UINT64_MAX, vkImageAcquireSemaphore, VK_NULL_HANDLE, &backBufferIndex);
-			VK_CHECK_RESULT(result);
+			if (result == VK_ERROR_OUT_OF_DATE_KHR)
+			{
+				swapchainOutOfDate = true;
+				return false;
+			}
+
+			if (result == VK_SUBOPTIMAL_KHR)
+			{
+				swapchainOutOfDate = true;
+			}
+			else
+			{
+				VK_CHECK_RESULT(result);
+			}
 
 			WaitForFrame(backBufferIndex);
+			Renderer::Resource::DescriptorHeap::BeginFrame(backBufferIndex);
+			Renderer::Resource::DescriptorAllocator::BeginFrame(backBufferIndex);
 
 			allocatedSecondaryCmdBufferCount = 0u;
 
 			BeginPrimaryCommandBuffer();
 			InsertPostPresentBarrier();
+
+			//Uploads land before the first pass samples the textures
+			Renderer::Resource::TextureStreamer::Update(GetPrimaryCommandBuffer(), backBufferIndex);
+			Renderer::Resource::VirtualTextureSystem::Update(GetPrimaryCommandBuffer(), backBufferIndex);
+			return true;
 		}
 
-		void RenderSystem::EndFrame()
+		bool RenderSystem::EndFrame()
 		{
 			//Wait for all rendering tasks to finnish here
 			//Scheduler.wait_for_all_tasks
@@ -713,7 +947,7 @@ namespace Renderer
 			EndPrimaryCommandBuffer();
 
 			{
-				VkPipelineStageFlags pipeStageFlags = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+				VkPipelineStageFlags pipeStageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 				VkSubmitInfo submitInfo = {};
 				{
 					submitInfo.pNext = nullptr;
@@ -747,8 +981,17 @@ namespace Renderer
 				}
 
 				VkResult result = vkQueuePresentKHR(vkQueue, &present);
-				VK_CHECK_RESULT(result);
+				if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+				{
+					swapchainOutOfDate = true;
+				}
+				else
+				{
+					VK_CHECK_RESULT(result);
+				}
 			}
+
+			return !swapchainOutOfDate;
 		}
 
 		bool RenderSystem::WaitForFrame(const uint32_t index)
@@ -806,7 +1049,8 @@ namespace Renderer
 			{
 				commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 				commandBufferBeginInfo.pNext = nullptr;
-				commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+				//Compute work is recorded without a render pass and executed outside of it
+				commandBufferBeginInfo.flags = p_VkRenderPass != VK_NULL_HANDLE ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0u;
 				commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 			}
 
@@ -850,7 +1094,7 @@ namespace Renderer
 			{
 				postPresentBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 				postPresentBarrier.pNext = nullptr;
-				postPresentBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+				postPresentBarrier.srcAccessMask = 0u;
 				postPresentBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 				postPresentBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 				postPresentBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -863,7 +1107,8 @@ namespace Renderer
 				postPresentBarrier.subresourceRange.layerCount = 1u;
 				postPresentBarrier.image = vkSwapchainImages[backBufferIndex];
 
-				vkCmdPipelineBarrier(vkCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &postPresentBarrier);
+				//Chained to the acquire semaphore wait, which happens at color attachment output
+				vkCmdPipelineBarrier(vkCmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &postPresentBarrier);
 			}
 		}
 
@@ -888,7 +1133,7 @@ namespace Renderer
 				prePresentBarrier.subresourceRange.layerCount = 1u;
 				prePresentBarrier.image = vkSwapchainImages[backBufferIndex];
 
-				vkCmdPipelineBarrier(vkCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &prePresentBarrier);
+				vkCmdPipelineBarrier(vkCmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &prePresentBarrier);
 			}
 		}
 	}
@@ -0,0 +1,53 @@
+#include "Vulkan/VkShaderCompiler.h"
+
+//Other
+#include <cstdlib>
+#include <filesystem>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		bool ShaderCompiler::Compile(const std::string& source, const std::string& output, const std::vector<std::string>& arguments)
+		{
+			const std::string temporary = output + ".tmp";
+
+			std::string command = "\"" + GetCompiler() + "\" -V";
+			for (const auto& argument : arguments)
+			{
+				command += " " + argument;
+			}
+			command += " \"" + source + "\" -o \"" + temporary + "\"";
+
+#if defined(_WIN32)
+			//cmd strips the outer quotes of the command line
+			command = "\"" + command + "\"";
+#endif
+
+			if (std::system(command.c_str()) != 0)
+			{
+				return false;
+			}
+
+			std::error_code error;
+			std::filesystem::rename(temporary, output, error);
+			return !error;
+		}
+
+		std::string ShaderCompiler::GetCompiler()
+		{
+			//Installed SDKs export their location, otherwise it has to be on the path
+			const char* sdk = std::getenv("VULKAN_SDK");
+			if (sdk == nullptr)
+			{
+				return "glslangValidator";
+			}
+
+#if defined(_WIN32)
+			return std::string(sdk) + "\\Bin\\glslangValidator.exe";
+#else
+			return std::string(sdk) + "/bin/glslangValidator";
+#endif
+		}
+	}
+}
@@ -0,0 +1,426 @@
+#include "Vulkan/VkShaderHotReload.h"
+#include "Vulkan/VkShaderCompiler.h"
+#include "Vulkan/VkGpuProgram.h"
+#include "Vulkan/VkPipelineManager.h"
+#include "Vulkan/VkRenderSystem.h"
+#include "OctoCore/Public/MappedFile.h"
+
+//Other
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		namespace
+		{
+			bool IsShaderSource(const std::filesystem::path& path)
+			{
+				const std::string extension = path.extension().string();
+				return extension == ".vert" || extension == ".frag" || extension == ".geom" || extension == ".comp" || extension == ".glsl";
+			}
+
+			std::string ReadText(const std::string& path)
+			{
+				std::ifstream file(path);
+				std::stringstream text;
+				text << file.rdbuf();
+				return text.str();
+			}
+
+			//Everything the pipeline layout and the vertex input state are built from
+			bool IsSameInterface(const ShaderReflection& lhs, const ShaderReflection& rhs)
+			{
+				if (lhs.bindings.size() != rhs.bindings.size() || lhs.vertexInputs.size() != rhs.vertexInputs.size() ||
+					lhs.pushConstantOffset != rhs.pushConstantOffset || lhs.pushConstantSize != rhs.pushConstantSize)
+				{
+					return false;
+				}
+
+				for (size_t i = 0u; i < lhs.bindings.size(); i++)
+				{
+					if (lhs.bindings[i].set != rhs.bindings[i].set || lhs.bindings[i].binding != rhs.bindings[i].binding ||
+						lhs.bindings[i].descriptorType != rhs.bindings[i].descriptorType ||
+						lhs.bindings[i].descriptorCount != rhs.bindings[i].descriptorCount)
+					{
+						return false;
+					}
+				}
+
+				for (size_t i = 0u; i < lhs.vertexInputs.size(); i++)
+				{
+					if (lhs.vertexInputs[i].location != rhs.vertexInputs[i].location || lhs.vertexInputs[i].format != rhs.vertexInputs[i].format)
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			//@return false if the file is no valid SPIR-V module
+			bool ReflectFile(const std::string& path, ShaderReflection& reflection)
+			{
+				Core::Memory::MappedFile file;
+				if (!file.Map(path) || file.GetSize() % sizeof(uint32_t) != 0u)
+				{
+					return false;
+				}
+
+				return ShaderReflector::Reflect(reinterpret_cast<const uint32_t*>(file.GetData()), file.GetSize() / sizeof(uint32_t), reflection);
+			}
+		}
+
+		std::string ShaderHotReload::directory;
+		std::vector<ShaderCompileJob> ShaderHotReload::jobs;
+		std::unordered_map<std::string, int64_t> ShaderHotReload::writeTimes;
+		std::thread ShaderHotReload::watcher;
+		std::atomic<bool> ShaderHotReload::running(false);
+		std::mutex ShaderHotReload::readyMutex;
+		std::vector<std::string> ShaderHotReload::readyOutputs;
+		std::vector<std::string> ShaderHotReload::changedSources;
+
+		void ShaderHotReload::Init(const std::string& shaderDirectory)
+		{
+			if (!SHADER_HOT_RELOAD_ENABLED || running)
+			{
+				return;
+			}
+
+			directory = shaderDirectory;
+			ParseCompileJobs();
+
+			if (jobs.empty())
+			{
+				printf("ERROR: ShaderHotReload::Init: no shaders found in %sgenerate-spirv.bat \n", directory.c_str());
+				return;
+			}
+
+			//Only changes made from now on are compiled
+			writeTimes.clear();
+			std::error_code error;
+			for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+			{
+				if (IsShaderSource(entry.path()))
+				{
+					writeTimes[entry.path().filename().string()] = std::filesystem::last_write_time(entry.path(), error).time_since_epoch().count();
+				}
+			}
+
+			running = true;
+			watcher = std::thread(&ShaderHotReload::Watch);
+		}
+
+		void ShaderHotReload::Shutdown()
+		{
+			if (!running)
+			{
+				return;
+			}
+
+			running = false;
+			watcher.join();
+
+			std::lock_guard<std::mutex> lock(readyMutex);
+			readyOutputs.clear();
+			changedSources.clear();
+		}
+
+		void ShaderHotReload::ParseCompileJobs()
+		{
+			jobs.clear();
+
+			std::ifstream script(directory + "generate-spirv.bat");
+			std::string line;
+			while (std::getline(script, line))
+			{
+				std::istringstream tokens(line);
+				std::string token;
+				std::vector<std::string> words;
+				while (tokens >> token)
+				{
+					words.push_back(token);
+				}
+
+				if (words.empty())
+				{
+					continue;
+				}
+
+				ShaderCompileJob job;
+				for (size_t i = 1u; i < words.size(); i++)
+				{
+					if (words[i] == "-o" && i + 1u < words.size())
+					{
+						job.output = words[++i];
+					}
+					else if (words[i] == "-V")
+					{
+						continue;
+					}
+					else if (words[i][0] == '-')
+					{
+						job.arguments.push_back(words[i]);
+					}
+					else
+					{
+						job.source = words[i];
+					}
+				}
+
+				if (!job.source.empty() && !job.output.empty())
+				{
+					jobs.push_back(std::move(job));
+				}
+			}
+		}
+
+		void ShaderHotReload::Watch()
+		{
+#if defined(_WIN32)
+			HANDLE notification = FindFirstChangeNotificationA(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+#elif defined(__linux__)
+			const int notification = inotify_init1(IN_NONBLOCK);
+			if (notification >= 0)
+			{
+				inotify_add_watch(notification, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			}
+#endif
+
+			while (running)
+			{
+				//Wakes up on a change, the timeout lets Shutdown() get through and covers missed notifications
+#if defined(_WIN32)
+				if (notification != INVALID_HANDLE_VALUE)
+				{
+					if (WaitForSingleObject(notification, SHADER_WATCH_INTERVAL_MS) == WAIT_OBJECT_0)
+					{
+						FindNextChangeNotification(notification);
+					}
+				}
+				else
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(SHADER_WATCH_INTERVAL_MS));
+				}
+#elif defined(__linux__)
+				if (notification >= 0)
+				{
+					pollfd descriptor = { notification, POLLIN, 0 };
+					if (poll(&descriptor, 1, SHADER_WATCH_INTERVAL_MS) > 0)
+					{
+						char events[4096];
+						while (read(notification, events, sizeof(events)) > 0)
+						{
+						}
+					}
+				}
+				else
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(SHADER_WATCH_INTERVAL_MS));
+				}
+#else
+				std::this_thread::sleep_for(std::chrono::milliseconds(SHADER_WATCH_INTERVAL_MS));
+#endif
+
+				CompileChanged();
+			}
+
+#if defined(_WIN32)
+			if (notification != INVALID_HANDLE_VALUE)
+			{
+				FindCloseChangeNotification(notification);
+			}
+#elif defined(__linux__)
+			if (notification >= 0)
+			{
+				close(notification);
+			}
+#endif
+		}
+
+		void ShaderHotReload::CompileChanged()
+		{
+			//Notifications only tell that something changed, write times tell what
+			std::vector<std::string> changed;
+			std::error_code error;
+			for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+			{
+				if (!IsShaderSource(entry.path()))
+				{
+					continue;
+				}
+
+				const std::string name = entry.path().filename().string();
+				const int64_t writeTime = std::filesystem::last_write_time(entry.path(), error).time_since_epoch().count();
+
+				int64_t& knownWriteTime = writeTimes[name];
+				if (knownWriteTime != writeTime)
+				{
+					knownWriteTime = writeTime;
+					changed.push_back(name);
+				}
+			}
+
+			if (changed.empty())
+			{
+				return;
+			}
+
+			std::vector<std::string> outputs;
+			for (const auto& job : jobs)
+			{
+				//Includes are only followed one level, like descriptor_heap.glsl is used
+				const bool sourceChanged = std::find(changed.begin(), changed.end(), job.source) != changed.end();
+				bool includeChanged = false;
+
+				if (!sourceChanged)
+				{
+					const std::string source = ReadText(directory + job.source);
+					for (const auto& name : changed)
+					{
+						includeChanged |= source.find("#include \"" + name + "\"") != std::string::npos;
+					}
+				}
+
+				if ((sourceChanged || includeChanged) && Compile(job))
+				{
+					outputs.push_back(job.output);
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(readyMutex);
+			for (const auto& output : outputs)
+			{
+				if (std::find(readyOutputs.begin(), readyOutputs.end(), output) == readyOutputs.end())
+				{
+					readyOutputs.push_back(output);
+				}
+			}
+
+			//Variants are compiled by ApplyChanges(), the watcher does not know them
+			for (const auto& name : changed)
+			{
+				if (std::find(changedSources.begin(), changedSources.end(), name) == changedSources.end())
+				{
+					changedSources.push_back(name);
+				}
+			}
+		}
+
+		bool ShaderHotReload::Compile(const ShaderCompileJob& job)
+		{
+			if (!ShaderCompiler::Compile(directory + job.source, directory + job.output, job.arguments))
+			{
+				printf("ERROR: ShaderHotReload::Compile: %s failed, keeping the last %s \n", job.source.c_str(), job.output.c_str());
+				return false;
+			}
+
+			return true;
+		}
+
+		void ShaderHotReload::ApplyChanges()
+		{
+			std::vector<std::string> outputs;
+			std::vector<std::string> sources;
+			{
+				std::lock_guard<std::mutex> lock(readyMutex);
+				outputs.swap(readyOutputs);
+				sources.swap(changedSources);
+			}
+
+			if (outputs.empty() && sources.empty())
+			{
+				return;
+			}
+
+			//Frames in flight still use the old modules and pipelines, so may the compile threads
+			vkDeviceWaitIdle(Vulkan::RenderSystem::vkDevice);
+			PipelineManager::Flush();
+
+			std::vector<DOD::Ref> reloaded;
+			for (const auto& ref : GpuProgramManager::activeRefs)
+			{
+				const std::string name = GpuProgramManager::GetNameByRef(ref);
+				const bool isVariant = GpuProgramManager::IsVariant(ref);
+
+				if (isVariant)
+				{
+					const std::vector<std::string>& dependencies = GpuProgramManager::GetVariantInfo(ref).dependencies;
+					const bool changed = std::find_first_of(dependencies.begin(), dependencies.end(), sources.begin(), sources.end()) != dependencies.end();
+
+					//Compiled here, the watcher thread does not know the variants
+					if (!changed || !GpuProgramManager::CompileVariant(ref))
+					{
+						continue;
+					}
+				}
+				else if (std::find(outputs.begin(), outputs.end(), name) == outputs.end())
+				{
+					continue;
+				}
+
+				//Pipeline layouts are not rebuilt, a new interface would not match the one its pipelines use
+				const std::string path = isVariant ? GpuProgramManager::GetVariantInfo(ref).spirvPath : directory + name;
+				ShaderReflection reflection;
+				if (!ReflectFile(path, reflection))
+				{
+					printf("ERROR: ShaderHotReload::ApplyChanges: %s is no valid SPIR-V, keeping the old module \n", path.c_str());
+					continue;
+				}
+
+				if (!IsSameInterface(reflection, GpuProgramManager::GetReflection(ref)))
+				{
+					printf("ERROR: ShaderHotReload::ApplyChanges: interface of %s changed, keeping the old module until restart \n", name.c_str());
+					continue;
+				}
+
+				//The old module is released once the new one is loaded
+				const bool loaded = isVariant ? GpuProgramManager::LoadVariant(ref) :
+					GpuProgramManager::LoadAndCompileShader(ref, directory, GpuProgramManager::GetShaderStageCreateInfo(ref).stage);
+
+				if (loaded)
+				{
+					reloaded.push_back(ref);
+				}
+			}
+
+			//Only pipelines using one of the new modules are rebuilt
+			std::vector<DOD::Ref> pipelines;
+			for (const auto& ref : PipelineManager::activeRefs)
+			{
+				const DOD::Ref shaders[] =
+				{
+					PipelineManager::GetVertexShader(ref),
+					PipelineManager::GetFragmentShader(ref),
+					PipelineManager::GetGeometryShader(ref),
+					PipelineManager::GetComputeShader(ref)
+				};
+
+				for (const auto& shader : shaders)
+				{
+					if (shader.isValid() && std::find(reloaded.begin(), reloaded.end(), shader) != reloaded.end())
+					{
+						pipelines.push_back(ref);
+						break;
+					}
+				}
+			}
+
+			PipelineManager::DestroyResources(pipelines);
+			PipelineManager::CreateResource(pipelines);
+		}
+	}
+}
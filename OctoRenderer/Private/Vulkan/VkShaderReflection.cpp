@@ -0,0 +1,623 @@
+#include "Vulkan/VkShaderReflection.h"
+
+//Other
+#include <algorithm>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		namespace
+		{
+			const uint32_t SPIRV_MAGIC = 0x07230203u;
+			const uint32_t SPIRV_HEADER_WORDS = 5u;
+			const uint32_t INVALID_VALUE = ~0u;
+
+			namespace SpvOp
+			{
+				enum Enum : uint32_t
+				{
+					kEntryPoint = 15,
+					kTypeBool = 20,
+					kTypeInt = 21,
+					kTypeFloat = 22,
+					kTypeVector = 23,
+					kTypeMatrix = 24,
+					kTypeImage = 25,
+					kTypeSampler = 26,
+					kTypeSampledImage = 27,
+					kTypeArray = 28,
+					kTypeRuntimeArray = 29,
+					kTypeStruct = 30,
+					kTypePointer = 32,
+					kTypeForwardPointer = 39,
+					kConstant = 43,
+					kSpecConstantTrue = 48,
+					kSpecConstantFalse = 49,
+					kSpecConstant = 50,
+					kVariable = 59,
+					kDecorate = 71,
+					kMemberDecorate = 72
+				};
+			}
+
+			namespace SpvDecoration
+			{
+				enum Enum : uint32_t
+				{
+					kSpecId = 1,
+					kBufferBlock = 3,
+					kArrayStride = 6,
+					kMatrixStride = 7,
+					kBuiltIn = 11,
+					kLocation = 30,
+					kBinding = 33,
+					kDescriptorSet = 34,
+					kOffset = 35
+				};
+			}
+
+			namespace SpvStorageClass
+			{
+				enum Enum : uint32_t
+				{
+					kUniformConstant = 0,
+					kInput = 1,
+					kUniform = 2,
+					kPushConstant = 9,
+					kStorageBuffer = 12
+				};
+			}
+
+			const uint32_t SPV_EXECUTION_MODEL_VERTEX = 0u;
+			const uint32_t SPV_DIM_BUFFER = 5u;
+			const uint32_t SPV_DIM_SUBPASS_DATA = 6u;
+
+			struct SpvMember
+			{
+				uint32_t offset = INVALID_VALUE;
+				uint32_t matrixStride = INVALID_VALUE;
+			};
+
+			//Decorations and type operands of one result id
+			struct SpvId
+			{
+				uint32_t op = 0u;
+				std::vector<uint32_t> operands;
+				std::vector<SpvMember> members;
+
+				uint32_t set = INVALID_VALUE;
+				uint32_t binding = INVALID_VALUE;
+				uint32_t location = INVALID_VALUE;
+				uint32_t specId = INVALID_VALUE;
+				uint32_t arrayStride = INVALID_VALUE;
+				bool bufferBlock = false;
+				bool builtIn = false;
+
+				//Constants only
+				uint32_t value = 0u;
+			};
+
+			struct SpvVariable
+			{
+				uint32_t pointerType;
+				uint32_t id;
+				uint32_t storageClass;
+			};
+
+			class SpvModule
+			{
+				public:
+					SpvModule(const uint32_t* code, size_t wordCount)
+					{
+						//Every id needs a defining instruction, a larger bound only comes from a corrupt header
+						if (code[3] <= wordCount)
+						{
+							m_Ids.resize(code[3]);
+							Parse(code, wordCount);
+						}
+					}
+
+					bool IsValid() const { return m_Valid; }
+
+					const SpvId& Get(uint32_t id) const
+					{
+						static const SpvId invalid;
+						return id < m_Ids.size() ? m_Ids[id] : invalid;
+					}
+
+					const std::vector<SpvVariable>& GetVariables() const { return m_Variables; }
+					const std::vector<uint32_t>& GetSpecConstants() const { return m_SpecConstants; }
+					uint32_t GetExecutionModel() const { return m_ExecutionModel; }
+
+					uint32_t GetSize(uint32_t typeId, uint32_t matrixStride = INVALID_VALUE) const
+					{
+						const SpvId& type = Get(typeId);
+						switch (type.op)
+						{
+							case SpvOp::kTypeBool:
+								return 4u;
+							case SpvOp::kTypeInt:
+							case SpvOp::kTypeFloat:
+								return type.operands[0] / 8u;
+							case SpvOp::kTypeVector:
+								return GetSize(type.operands[0]) * type.operands[1];
+							case SpvOp::kTypeMatrix:
+								return (matrixStride != INVALID_VALUE ? matrixStride : GetSize(type.operands[0])) * type.operands[1];
+							case SpvOp::kTypeArray:
+							{
+								const uint32_t stride = type.arrayStride != INVALID_VALUE ? type.arrayStride : GetSize(type.operands[0], matrixStride);
+								return stride * Get(type.operands[1]).value;
+							}
+							case SpvOp::kTypeStruct:
+							{
+								//Members are explicitly laid out, the block ends with the furthest member
+								uint32_t size = 0u;
+								for (size_t i = 0u; i < type.operands.size(); i++)
+								{
+									const SpvMember member = i < type.members.size() ? type.members[i] : SpvMember();
+									const uint32_t offset = member.offset != INVALID_VALUE ? member.offset : size;
+									size = std::max(size, offset + GetSize(type.operands[i], member.matrixStride));
+								}
+								return size;
+							}
+							default:
+								return 0u;
+						}
+					}
+
+					//Lowest member offset of a push_constant block, blocks of later stages usually start past 0
+					uint32_t GetFirstOffset(uint32_t structId) const
+					{
+						const SpvId& type = Get(structId);
+						uint32_t offset = type.members.empty() ? 0u : INVALID_VALUE;
+						for (const auto& member : type.members)
+						{
+							offset = std::min(offset, member.offset != INVALID_VALUE ? member.offset : 0u);
+						}
+						return offset;
+					}
+
+				private:
+					void Parse(const uint32_t* code, size_t wordCount)
+					{
+						size_t word = SPIRV_HEADER_WORDS;
+						while (word < wordCount)
+						{
+							const uint32_t instructionWords = code[word] >> 16u;
+							const uint32_t op = code[word] & 0xFFFFu;
+							if (instructionWords == 0u || word + instructionWords > wordCount)
+							{
+								return;
+							}
+
+							if (!ParseInstruction(op, code + word + 1u, instructionWords - 1u, wordCount))
+							{
+								return;
+							}
+
+							word += instructionWords;
+						}
+
+						m_Valid = true;
+					}
+
+					//Operands the instruction needs before its optional ones, 0 for instructions that are skipped
+					static uint32_t GetMinOperandCount(uint32_t op)
+					{
+						switch (op)
+						{
+							case SpvOp::kTypeBool:
+							case SpvOp::kTypeSampler:
+							case SpvOp::kTypeStruct:
+								return 1u;
+							case SpvOp::kDecorate:
+							case SpvOp::kTypeFloat:
+							case SpvOp::kTypeSampledImage:
+							case SpvOp::kTypeRuntimeArray:
+							case SpvOp::kTypeForwardPointer:
+							case SpvOp::kSpecConstantTrue:
+							case SpvOp::kSpecConstantFalse:
+								return 2u;
+							case SpvOp::kEntryPoint:
+							case SpvOp::kMemberDecorate:
+							case SpvOp::kTypeInt:
+							case SpvOp::kTypeVector:
+							case SpvOp::kTypeMatrix:
+							case SpvOp::kTypeArray:
+							case SpvOp::kTypePointer:
+							case SpvOp::kConstant:
+							case SpvOp::kSpecConstant:
+							case SpvOp::kVariable:
+								return 3u;
+							case SpvOp::kTypeImage:
+								return 8u;
+							default:
+								return 0u;
+						}
+					}
+
+					static bool HasLiteral(uint32_t decoration)
+					{
+						switch (decoration)
+						{
+							case SpvDecoration::kSpecId:
+							case SpvDecoration::kArrayStride:
+							case SpvDecoration::kMatrixStride:
+							case SpvDecoration::kBuiltIn:
+							case SpvDecoration::kLocation:
+							case SpvDecoration::kBinding:
+							case SpvDecoration::kDescriptorSet:
+							case SpvDecoration::kOffset:
+								return true;
+							default:
+								return false;
+						}
+					}
+
+					//Types may only reference types declared before them, which also rules out cycles in GetSize()
+					bool IsDeclared(uint32_t id) const
+					{
+						return id < m_Ids.size() && m_Ids[id].op != 0u;
+					}
+
+					//Result ids are defined once, only a forward declared pointer gets its declaration later
+					bool CanDeclare(uint32_t id, uint32_t op) const
+					{
+						return id < m_Ids.size() && (m_Ids[id].op == 0u || (op == SpvOp::kTypePointer && m_Ids[id].op == SpvOp::kTypePointer && m_Ids[id].operands.empty()));
+					}
+
+					//@return false if an operand is missing or an id is out of the bound
+					bool ParseInstruction(uint32_t op, const uint32_t* operands, uint32_t operandCount, size_t wordCount)
+					{
+						if (operandCount < GetMinOperandCount(op))
+						{
+							return false;
+						}
+
+						switch (op)
+						{
+							case SpvOp::kEntryPoint:
+							{
+								if (m_ExecutionModel == INVALID_VALUE)
+								{
+									m_ExecutionModel = operands[0];
+								}
+								break;
+							}
+							case SpvOp::kDecorate:
+							{
+								if (operands[0] >= m_Ids.size() || (HasLiteral(operands[1]) && operandCount < 3u))
+								{
+									return false;
+								}
+
+								Decorate(m_Ids[operands[0]], operands[1], operandCount > 2u ? operands[2] : 0u);
+								break;
+							}
+							case SpvOp::kMemberDecorate:
+							{
+								//Every member takes a word of the struct declaration
+								if (operands[0] >= m_Ids.size() || operands[1] >= wordCount || (HasLiteral(operands[2]) && operandCount < 4u))
+								{
+									return false;
+								}
+
+								std::vector<SpvMember>& members = m_Ids[operands[0]].members;
+								if (members.size() <= operands[1])
+								{
+									members.resize(operands[1] + 1u);
+								}
+
+								if (operands[2] == SpvDecoration::kOffset)
+								{
+									members[operands[1]].offset = operands[3];
+								}
+								else if (operands[2] == SpvDecoration::kMatrixStride)
+								{
+									members[operands[1]].matrixStride = operands[3];
+								}
+								break;
+							}
+							case SpvOp::kTypeBool:
+							case SpvOp::kTypeInt:
+							case SpvOp::kTypeFloat:
+							case SpvOp::kTypeVector:
+							case SpvOp::kTypeMatrix:
+							case SpvOp::kTypeImage:
+							case SpvOp::kTypeSampler:
+							case SpvOp::kTypeSampledImage:
+							case SpvOp::kTypeArray:
+							case SpvOp::kTypeRuntimeArray:
+							case SpvOp::kTypeStruct:
+							case SpvOp::kTypePointer:
+							{
+								if (!CanDeclare(operands[0], op))
+								{
+									return false;
+								}
+
+								//Pointers are not followed by GetSize(), so they may point at types declared later
+								const bool componentType = op == SpvOp::kTypeVector || op == SpvOp::kTypeMatrix || op == SpvOp::kTypeSampledImage ||
+									op == SpvOp::kTypeArray || op == SpvOp::kTypeRuntimeArray;
+								if (componentType && !IsDeclared(operands[1]))
+								{
+									return false;
+								}
+
+								if (op == SpvOp::kTypeArray && !IsDeclared(operands[2]))
+								{
+									return false;
+								}
+
+								for (uint32_t i = 1u; op == SpvOp::kTypeStruct && i < operandCount; i++)
+								{
+									if (!IsDeclared(operands[i]))
+									{
+										return false;
+									}
+								}
+
+								SpvId& type = m_Ids[operands[0]];
+								type.op = op;
+								type.operands.assign(operands + 1u, operands + operandCount);
+								break;
+							}
+							case SpvOp::kTypeForwardPointer:
+							{
+								if (!CanDeclare(operands[0], op))
+								{
+									return false;
+								}
+
+								//Declared without operands until its OpTypePointer follows
+								m_Ids[operands[0]].op = SpvOp::kTypePointer;
+								break;
+							}
+							case SpvOp::kConstant:
+							case SpvOp::kSpecConstant:
+							case SpvOp::kSpecConstantTrue:
+							case SpvOp::kSpecConstantFalse:
+							{
+								if (!CanDeclare(operands[1], op) || !IsDeclared(operands[0]))
+								{
+									return false;
+								}
+
+								SpvId& constant = m_Ids[operands[1]];
+								constant.op = op;
+								constant.operands.assign(1u, operands[0]);
+								constant.value = op == SpvOp::kSpecConstantTrue ? 1u : (operandCount > 2u ? operands[2] : 0u);
+
+								if (op != SpvOp::kConstant)
+								{
+									m_SpecConstants.push_back(operands[1]);
+								}
+								break;
+							}
+							case SpvOp::kVariable:
+							{
+								if (operands[0] >= m_Ids.size() || operands[1] >= m_Ids.size())
+								{
+									return false;
+								}
+
+								m_Variables.push_back({ operands[0], operands[1], operands[2] });
+								break;
+							}
+							default:
+								break;
+						}
+
+						return true;
+					}
+
+					static void Decorate(SpvId& id, uint32_t decoration, uint32_t literal)
+					{
+						switch (decoration)
+						{
+							case SpvDecoration::kSpecId:		id.specId = literal; break;
+							case SpvDecoration::kBufferBlock:	id.bufferBlock = true; break;
+							case SpvDecoration::kArrayStride:	id.arrayStride = literal; break;
+							case SpvDecoration::kBuiltIn:		id.builtIn = true; break;
+							case SpvDecoration::kLocation:		id.location = literal; break;
+							case SpvDecoration::kBinding:		id.binding = literal; break;
+							case SpvDecoration::kDescriptorSet:	id.set = literal; break;
+							default: break;
+						}
+					}
+
+					std::vector<SpvId> m_Ids;
+					std::vector<SpvVariable> m_Variables;
+					std::vector<uint32_t> m_SpecConstants;
+					uint32_t m_ExecutionModel = INVALID_VALUE;
+					bool m_Valid = false;
+			};
+
+			bool GetDescriptorType(const SpvId& type, uint32_t storageClass, VkDescriptorType& descriptorType)
+			{
+				switch (type.op)
+				{
+					case SpvOp::kTypeSampledImage:
+						descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+						return true;
+					case SpvOp::kTypeSampler:
+						descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+						return true;
+					case SpvOp::kTypeImage:
+					{
+						//Operands: sampled type, dim, depth, arrayed, ms, sampled
+						const uint32_t dim = type.operands[1];
+						const bool storage = type.operands[5] == 2u;
+
+						if (dim == SPV_DIM_SUBPASS_DATA)
+						{
+							descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+						}
+						else if (dim == SPV_DIM_BUFFER)
+						{
+							descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+						}
+						else
+						{
+							descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+						}
+						return true;
+					}
+					case SpvOp::kTypeStruct:
+					{
+						//Before SPIR-V 1.3 storage buffers are uniform blocks decorated as BufferBlock
+						if (storageClass == SpvStorageClass::kStorageBuffer || type.bufferBlock)
+						{
+							descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+							return true;
+						}
+
+						if (storageClass == SpvStorageClass::kUniform)
+						{
+							descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+							return true;
+						}
+						return false;
+					}
+					default:
+						return false;
+				}
+			}
+
+			VkFormat GetVertexFormat(const SpvModule& module, const SpvId& type)
+			{
+				const bool vector = type.op == SpvOp::kTypeVector;
+				const SpvId& component = vector ? module.Get(type.operands[0]) : type;
+				const uint32_t componentCount = vector ? type.operands[1] : 1u;
+
+				if (componentCount < 1u || componentCount > 4u || component.operands.empty() || component.operands[0] != 32u)
+				{
+					return VK_FORMAT_UNDEFINED;
+				}
+
+				static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+				static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+				static const VkFormat sintFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+
+				if (component.op == SpvOp::kTypeFloat)
+				{
+					return floatFormats[componentCount - 1u];
+				}
+
+				if (component.op == SpvOp::kTypeInt)
+				{
+					return component.operands[1] ? sintFormats[componentCount - 1u] : uintFormats[componentCount - 1u];
+				}
+
+				return VK_FORMAT_UNDEFINED;
+			}
+		}
+
+		bool ShaderReflector::Reflect(const uint32_t* code, size_t wordCount, ShaderReflection& reflection)
+		{
+			reflection = ShaderReflection();
+
+			if (code == nullptr || wordCount < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC)
+			{
+				return false;
+			}
+
+			const SpvModule module(code, wordCount);
+			if (!module.IsValid())
+			{
+				return false;
+			}
+
+			for (const auto& variable : module.GetVariables())
+			{
+				const SpvId& id = module.Get(variable.id);
+				const SpvId& pointer = module.Get(variable.pointerType);
+				if (pointer.op != SpvOp::kTypePointer || pointer.operands.size() < 2u)
+				{
+					continue;
+				}
+
+				const SpvId* type = &module.Get(pointer.operands[1]);
+
+				switch (variable.storageClass)
+				{
+					case SpvStorageClass::kUniformConstant:
+					case SpvStorageClass::kUniform:
+					case SpvStorageClass::kStorageBuffer:
+					{
+						//Arrays of descriptors, one level deep like GLSL allows
+						uint32_t descriptorCount = 1u;
+						if (type->op == SpvOp::kTypeArray)
+						{
+							descriptorCount = module.Get(type->operands[1]).value;
+							type = &module.Get(type->operands[0]);
+						}
+						else if (type->op == SpvOp::kTypeRuntimeArray)
+						{
+							descriptorCount = 0u;
+							type = &module.Get(type->operands[0]);
+						}
+
+						ShaderBinding binding;
+						binding.set = id.set != INVALID_VALUE ? id.set : 0u;
+						binding.binding = id.binding != INVALID_VALUE ? id.binding : 0u;
+						binding.descriptorCount = descriptorCount;
+
+						if (GetDescriptorType(*type, variable.storageClass, binding.descriptorType))
+						{
+							reflection.bindings.push_back(binding);
+						}
+						break;
+					}
+					case SpvStorageClass::kPushConstant:
+					{
+						const uint32_t offset = module.GetFirstOffset(pointer.operands[1]);
+						reflection.pushConstantOffset = offset;
+						reflection.pushConstantSize = module.GetSize(pointer.operands[1]) - offset;
+						break;
+					}
+					case SpvStorageClass::kInput:
+					{
+						if (module.GetExecutionModel() != SPV_EXECUTION_MODEL_VERTEX || id.builtIn || id.location == INVALID_VALUE)
+						{
+							break;
+						}
+
+						const VkFormat format = GetVertexFormat(module, *type);
+						if (format != VK_FORMAT_UNDEFINED)
+						{
+							reflection.vertexInputs.push_back({ id.location, format });
+						}
+						break;
+					}
+					default:
+						break;
+				}
+			}
+
+			for (const uint32_t constantId : module.GetSpecConstants())
+			{
+				const SpvId& constant = module.Get(constantId);
+				if (constant.specId == INVALID_VALUE)
+				{
+					continue;
+				}
+
+				reflection.specializationConstants.push_back({ constant.specId, module.GetSize(constant.operands[0]), constant.value });
+			}
+
+			std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ShaderBinding& lhs, const ShaderBinding& rhs)
+			{
+				return lhs.set != rhs.set ? lhs.set < rhs.set : lhs.binding < rhs.binding;
+			});
+
+			std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [](const ShaderVertexInput& lhs, const ShaderVertexInput& rhs)
+			{
+				return lhs.location < rhs.location;
+			});
+
+			return true;
+		}
+	}
+}
@@ -5,6 +5,9 @@
 #include "VkTexture2D.h"
 #include "VulkanTools.h"
 
+//Other
+#include <algorithm>
+
 
 
 
@@ -46,7 +49,14 @@ void VkTexture2D::GenerateTexture(void * pImageData, VkFormat format, uint32_t s
 
 	this->width = width;
 	this->height = height;
-	this->mipLevels = miplevels;
+
+	//Only the first mip is uploaded, the others are blitted from it on the GPU
+	const uint32_t fullMipLevels = VkTools::GetFullMipLevelCount(width, height);
+	this->mipLevels = std::min(miplevels == 0u ? fullMipLevels : miplevels, fullMipLevels);
+	if (this->mipLevels > 1u && (bForceLinear || !VkTools::SupportsMipmapGeneration(physicalDevice, format)))
+	{
+		this->mipLevels = 1u;
+	}
 
 
 	// Get device properites for the requested texture format
@@ -96,34 +106,23 @@ void VkTexture2D::GenerateTexture(void * pImageData, VkFormat format, uint32_t s
 		// Copy texture data into staging buffer
 		uint8_t *data;
 		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, data, size);
+		memcpy(data, pImageData, size);
 		vkUnmapMemory(device, stagingMemory);
 
-		// Setup buffer copy regions for each mip level
+		// Setup buffer copy region of the first mip level
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
-		uint32_t offset = 0;
-
-		for (uint32_t i = 0; i < miplevels; i++)
-		{
-			VkBufferImageCopy bufferCopyRegion = {};
-			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			bufferCopyRegion.imageSubresource.mipLevel = i;
-			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-			bufferCopyRegion.imageSubresource.layerCount = 1;
-			//bufferCopyRegion.imageExtent.width = static_cast<uint32_t>(tex2D[i].extent().x);
-			//bufferCopyRegion.imageExtent.height = static_cast<uint32_t>(tex2D[i].extent().y);
-
-			//bufferCopyRegion.imageExtent.width = static_cast<uint32_t>(pngLoader.width);
-			//bufferCopyRegion.imageExtent.height = static_cast<uint32_t>(pngLoader.height);
 
-			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
+		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferCopyRegion.imageSubresource.mipLevel = 0;
+		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+		bufferCopyRegion.imageSubresource.layerCount = 1;
+		bufferCopyRegion.imageExtent.width = this->width;
+		bufferCopyRegion.imageExtent.height = this->height;
+		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = 0;
 
-			bufferCopyRegions.push_back(bufferCopyRegion);
-
-			//offset += static_cast<uint32_t>(sizeof(pngLoader.image_data));
-			//offset += static_cast<uint32_t>(tex2D[i].size());
-		}
+		bufferCopyRegions.push_back(bufferCopyRegion);
 
 		// Create optimal tiled target image
 		VkImageCreateInfo imageCreateInfo = VkTools::Initializer::ImageCreateInfo();
@@ -137,7 +136,7 @@ void VkTexture2D::GenerateTexture(void * pImageData, VkFormat format, uint32_t s
 		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { this->width, this->height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &this->image));
 
@@ -175,15 +174,15 @@ void VkTexture2D::GenerateTexture(void * pImageData, VkFormat format, uint32_t s
 			bufferCopyRegions.data()
 		);
 
-		// Change texture image layout to shader read after all mip levels have been copied
+		// Remaining mips are generated from the copied one, all of them end up in shader read
 		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		VkTools::SetImageLayout(
+		VkTools::GenerateMipmaps(
 			cmdBuffer,
 			this->image,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			this->imageLayout,
-			subresourceRange);
+			this->width,
+			this->height,
+			this->mipLevels,
+			this->imageLayout);
 
 		// Submit command buffer containing copy and image layout commands
 		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
@@ -0,0 +1,708 @@
+#include "Vulkan/VkTextureStreamer.h"
+#include "Vulkan/VkRenderSystem.h"
+#include "Vulkan/VkGPUMemoryManager.h"
+#include "Vulkan/VulkanTools.h"
+#include "OctoCore/Public/MappedFile.h"
+
+//ThirdParty
+#include <ThirdParty/gli/gli/gli.hpp>
+
+//Other
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		namespace
+		{
+			//Staged mips start at offsets every format can be copied from
+			const size_t STAGING_ALIGNMENT = 16u;
+
+			gli::texture2d LoadTextureFile(const std::string& fileName)
+			{
+				Core::Memory::MappedFile textureFile;
+				if (!textureFile.Map(fileName))
+				{
+					return gli::texture2d();
+				}
+
+				return gli::texture2d(gli::load(reinterpret_cast<const char*>(textureFile.GetData()), textureFile.GetSize()));
+			}
+
+			VkExtent3D GetMipExtent(const glm::uvec3& dimensions, uint32_t mip)
+			{
+				return { std::max(dimensions.x >> mip, 1u), std::max(dimensions.y >> mip, 1u), 1u };
+			}
+
+			//gli formats share the values of VkFormat
+			uint64_t GetMipSize(VkFormat format, const glm::uvec3& dimensions, uint32_t mip)
+			{
+				const gli::format textureFormat = static_cast<gli::format>(format);
+				const gli::ivec3 blockExtent = gli::block_extent(textureFormat);
+				const VkExtent3D extent = GetMipExtent(dimensions, mip);
+
+				const uint64_t blockCountX = (extent.width + blockExtent.x - 1u) / blockExtent.x;
+				const uint64_t blockCountY = (extent.height + blockExtent.y - 1u) / blockExtent.y;
+				return blockCountX * blockCountY * gli::block_size(textureFormat);
+			}
+
+			//Staging memory mips [firstMip, lastMip) take up when staged from an aligned offset
+			uint64_t GetStagedSize(VkFormat format, const glm::uvec3& dimensions, uint32_t firstMip, uint32_t lastMip)
+			{
+				uint64_t size = 0u;
+				for (uint32_t mip = firstMip; mip < lastMip; mip++)
+				{
+					size += (GetMipSize(format, dimensions, mip) + STAGING_ALIGNMENT - 1u) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+				}
+
+				return size;
+			}
+
+			void CopyMips(const gli::texture2d& texture, TextureStreamingLoad& load)
+			{
+				load.data.clear();
+				load.mipOffsets.clear();
+
+				for (uint32_t mip = load.firstMip; mip < load.lastMip; mip++)
+				{
+					const uint8_t* mipData = static_cast<const uint8_t*>(texture.data(0u, 0u, mip));
+
+					load.mipOffsets.push_back(load.data.size());
+					load.data.insert(load.data.end(), mipData, mipData + texture.size(mip));
+				}
+			}
+		}
+
+		uint64_t TextureStreamer::budget = TEXTURE_STREAMING_DEFAULT_BUDGET_IN_BYTES;
+		uint32_t TextureStreamer::frame = 0u;
+		uint32_t TextureStreamer::lastSwapFrame = 0u;
+		std::vector<StreamingStagingBuffer> TextureStreamer::stagingBuffers;
+		std::vector<size_t> TextureStreamer::stagingOffsets;
+		std::vector<std::vector<RetiredStreamedImage>> TextureStreamer::retiredImages;
+		std::unordered_set<uint32_t> TextureStreamer::pendingLoads;
+		std::thread TextureStreamer::loader;
+		bool TextureStreamer::running = false;
+		std::mutex TextureStreamer::loadMutex;
+		std::condition_variable TextureStreamer::loadCondition;
+		std::deque<TextureStreamingLoad> TextureStreamer::queuedLoads;
+		std::vector<TextureStreamingLoad> TextureStreamer::finishedLoads;
+
+		void TextureStreamer::Init()
+		{
+			const size_t backBufferCount = Vulkan::RenderSystem::vkSwapchainImages.size();
+
+			stagingBuffers.resize(backBufferCount + 1u);
+			stagingOffsets.assign(backBufferCount + 1u, 0u);
+			retiredImages.resize(backBufferCount);
+
+			for (auto& stagingBuffer : stagingBuffers)
+			{
+				VkBufferCreateInfo bufferCreateInfo = {};
+				bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				bufferCreateInfo.size = TEXTURE_STREAMING_STAGING_SIZE_IN_BYTES;
+				bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+				bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+				VK_CHECK_RESULT(vkCreateBuffer(Vulkan::RenderSystem::vkDevice, &bufferCreateInfo, nullptr, &stagingBuffer.buffer));
+
+				VkMemoryRequirements memReqs;
+				vkGetBufferMemoryRequirements(Vulkan::RenderSystem::vkDevice, stagingBuffer.buffer, &memReqs);
+
+				stagingBuffer.memoryAllocationInfo = Vulkan::GpuMemoryManager::AllocateOffset(MemoryPoolTypes::kStaticStagingBuffers,
+					static_cast<uint32_t>(memReqs.size), static_cast<uint32_t>(memReqs.alignment), memReqs.memoryTypeBits);
+				VK_CHECK_RESULT(vkBindBufferMemory(Vulkan::RenderSystem::vkDevice, stagingBuffer.buffer, stagingBuffer.memoryAllocationInfo._vkDeviceMemory, stagingBuffer.memoryAllocationInfo._offset));
+			}
+
+			running = true;
+			loader = std::thread(&TextureStreamer::LoadThread);
+		}
+
+		void TextureStreamer::Shutdown()
+		{
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				if (!running)
+				{
+					return;
+				}
+
+				running = false;
+				queuedLoads.clear();
+			}
+
+			loadCondition.notify_all();
+			loader.join();
+
+			finishedLoads.clear();
+			pendingLoads.clear();
+
+			for (auto& retired : retiredImages)
+			{
+				ReleaseRetired(retired);
+			}
+
+			for (auto& stagingBuffer : stagingBuffers)
+			{
+				vkDestroyBuffer(Vulkan::RenderSystem::vkDevice, stagingBuffer.buffer, nullptr);
+			}
+			stagingBuffers.clear();
+		}
+
+		bool TextureStreamer::CreateTexture(const DOD::Ref& ref)
+		{
+			const std::string& fileName = ImageManager::GetFileName(ref);
+
+			gli::texture2d texture(LoadTextureFile(fileName));
+			if (texture.empty())
+			{
+				printf("ERROR: TextureStreamer::CreateTexture: could not load %s \n", fileName.c_str());
+				return false;
+			}
+
+			ImageManager::GetImageFormat(ref) = static_cast<VkFormat>(texture.format());
+			ImageManager::GetImageDimensions(ref) = glm::uvec3(texture.extent().x, texture.extent().y, 1u);
+			ImageManager::GetImageTextureType(ref) = ImageTextureType::k2D;
+			ImageManager::GetImageFlags(ref) = ImageFlags::kUsageSampled;
+			ImageManager::GetMemoryPoolType(ref) = MemoryPoolTypes::kStreamedImages;
+			ImageManager::GetArrayLayerCount(ref) = 1u;
+			ImageManager::GetMipLevelCount(ref) = static_cast<uint32_t>(texture.levels());
+
+			//Nothing is resident yet, the tail load ends where the chain does
+			ImageManager::GetVkImage(ref) = VK_NULL_HANDLE;
+			ImageManager::GetImageView(ref) = VK_NULL_HANDLE;
+			ImageManager::GetMemoryAllocationInfo(ref) = {};
+			ImageManager::GetResidentMip(ref) = ImageManager::GetMipLevelCount(ref);
+			ImageManager::GetRequestedMip(ref) = GetTailMip(ref);
+			ImageManager::GetLastUsedFrame(ref) = frame;
+
+			TextureStreamingLoad load = { ref, fileName, GetTailMip(ref), ImageManager::GetMipLevelCount(ref) };
+			CopyMips(texture, load);
+
+			VkCommandBuffer commandBuffer;
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
+			cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			cmdBufAllocateInfo.commandPool = Vulkan::RenderSystem::vkPrimalCommandPool;
+			cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			cmdBufAllocateInfo.commandBufferCount = 1u;
+
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(Vulkan::RenderSystem::vkDevice, &cmdBufAllocateInfo, &commandBuffer));
+			VkCommandBufferBeginInfo cmdBufInfo = VkTools::Initializer::CommandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+			//The last staging buffer is only used here and the queue is idle after each use
+			const uint32_t stagingIdx = static_cast<uint32_t>(stagingBuffers.size() - 1u);
+			stagingOffsets[stagingIdx] = 0u;
+
+			//The tail is clamped to the staging memory, only a single mip larger than all of it is left over
+			RetiredStreamedImage retired;
+			if (!Restream(commandBuffer, stagingIdx, ref, load.firstMip, &load, retired))
+			{
+				printf("ERROR: TextureStreamer::CreateTexture: coarsest mip of %s does not fit into the staging memory \n", fileName.c_str());
+				vkFreeCommandBuffers(Vulkan::RenderSystem::vkDevice, Vulkan::RenderSystem::vkPrimalCommandPool, 1u, &commandBuffer);
+				return false;
+			}
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+			VkSubmitInfo submitInfo = {};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1u;
+			submitInfo.pCommandBuffers = &commandBuffer;
+
+			VK_CHECK_RESULT(vkQueueSubmit(Vulkan::RenderSystem::vkQueue, 1u, &submitInfo, VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueWaitIdle(Vulkan::RenderSystem::vkQueue));
+
+			vkFreeCommandBuffers(Vulkan::RenderSystem::vkDevice, Vulkan::RenderSystem::vkPrimalCommandPool, 1u, &commandBuffer);
+			return true;
+		}
+
+		void TextureStreamer::RequestMip(const DOD::Ref& ref, float screenExtentInPixels)
+		{
+			const glm::uvec3& dimensions = ImageManager::GetImageDimensions(ref);
+			const float texelsPerPixel = static_cast<float>(std::max(dimensions.x, dimensions.y)) / std::max(screenExtentInPixels, 1.0f);
+
+			RequestMip(ref, texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0u);
+		}
+
+		void TextureStreamer::RequestMip(const DOD::Ref& ref, uint32_t mip)
+		{
+			uint32_t& requestedMip = ImageManager::GetRequestedMip(ref);
+			uint32_t& lastUsedFrame = ImageManager::GetLastUsedFrame(ref);
+
+			//Used several times within a frame, the closest use wins
+			requestedMip = lastUsedFrame == frame ? std::min(requestedMip, mip) : mip;
+			lastUsedFrame = frame;
+		}
+
+		uint64_t TextureStreamer::GetResidentSize()
+		{
+			uint64_t residentSize = 0u;
+			for (const auto& ref : ImageManager::activeRefs)
+			{
+				if (ImageManager::GetImageType(ref) == ImageType::Enum::kTextureFromFile)
+				{
+					residentSize += ImageManager::GetMemoryAllocationInfo(ref)._sizeInBytes;
+				}
+			}
+
+			return residentSize;
+		}
+
+		uint64_t TextureStreamer::GetRetiredSize()
+		{
+			uint64_t retiredSize = 0u;
+			for (const auto& retired : retiredImages)
+			{
+				for (const auto& image : retired)
+				{
+					retiredSize += image.memoryAllocationInfo._sizeInBytes;
+				}
+			}
+
+			return retiredSize;
+		}
+
+		void TextureStreamer::Update(VkCommandBuffer commandBuffer, uint32_t backBufferIndex)
+		{
+			frame++;
+
+			ReleaseRetired(retiredImages[backBufferIndex]);
+			stagingOffsets[backBufferIndex] = 0u;
+
+			std::vector<DOD::Ref> refs;
+			for (const auto& ref : ImageManager::activeRefs)
+			{
+				if (ImageManager::GetImageType(ref) == ImageType::Enum::kTextureFromFile && ImageManager::GetVkImage(ref) != VK_NULL_HANDLE)
+				{
+					refs.push_back(ref);
+				}
+			}
+
+			const std::vector<uint32_t> targetMips = AssignBudget(refs);
+
+			//Finer mips have to come from the file first
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				for (size_t i = 0u; i < refs.size(); i++)
+				{
+					const uint32_t residentMip = ImageManager::GetResidentMip(refs[i]);
+					if (targetMips[i] < residentMip && pendingLoads.insert(refs[i]._id).second)
+					{
+						queuedLoads.push_back({ refs[i], ImageManager::GetFileName(refs[i]), targetMips[i], residentMip });
+					}
+				}
+			}
+			loadCondition.notify_one();
+
+			if (frame - lastSwapFrame < TEXTURE_STREAMING_SWAP_INTERVAL_FRAMES)
+			{
+				return;
+			}
+
+			std::vector<TextureStreamingLoad> loads;
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				loads.swap(finishedLoads);
+			}
+
+			//Index into refs and the new resident mip
+			std::vector<std::pair<size_t, uint32_t>> evictions;
+			for (size_t i = 0u; i < refs.size(); i++)
+			{
+				if (targetMips[i] > ImageManager::GetResidentMip(refs[i]))
+				{
+					evictions.push_back(std::make_pair(i, targetMips[i]));
+				}
+			}
+
+			std::vector<std::pair<size_t, uint32_t>> uploads;
+			for (size_t loadIdx = 0u; loadIdx < loads.size(); loadIdx++)
+			{
+				const TextureStreamingLoad& load = loads[loadIdx];
+				pendingLoads.erase(load.imageRef._id);
+
+				auto refIt = std::find(refs.begin(), refs.end(), load.imageRef);
+				if (load.failed || refIt == refs.end())
+				{
+					continue;
+				}
+
+				//The budget may have shrunk since the load was queued, only the part still wanted is uploaded
+				const size_t refIdx = refIt - refs.begin();
+				const uint32_t residentMip = std::max(load.firstMip, targetMips[refIdx]);
+				if (load.lastMip == ImageManager::GetResidentMip(load.imageRef) && residentMip < load.lastMip)
+				{
+					uploads.push_back(std::make_pair(loadIdx, residentMip));
+				}
+			}
+
+			if (evictions.empty() && uploads.empty())
+			{
+				return;
+			}
+
+			//Replaced images keep their memory until their frame is done, so evictions only make room for later swaps.
+			//Sizes are counted like AssignBudget() does, the old mips an upload copies from are not held against it.
+			uint64_t allocatedSize = GetRetiredSize();
+			for (const auto& ref : refs)
+			{
+				allocatedSize += GetMipChainSize(ref, ImageManager::GetResidentMip(ref));
+			}
+
+			std::unordered_set<uint32_t> imageIds;
+			for (const auto& eviction : evictions)
+			{
+				RetiredStreamedImage retired;
+				if (Restream(commandBuffer, backBufferIndex, refs[eviction.first], eviction.second, nullptr, retired))
+				{
+					retiredImages[backBufferIndex].push_back(retired);
+					imageIds.insert(refs[eviction.first]._id);
+					allocatedSize += GetMipChainSize(refs[eviction.first], eviction.second);
+				}
+			}
+
+			for (const auto& upload : uploads)
+			{
+				TextureStreamingLoad& load = loads[upload.first];
+
+				//Only the coarser mips may fit into what is left of the staging memory, the finer ones are loaded again by a later frame
+				const VkFormat format = ImageManager::GetImageFormat(load.imageRef);
+				const glm::uvec3& dimensions = ImageManager::GetImageDimensions(load.imageRef);
+				const size_t stagingOffset = (stagingOffsets[backBufferIndex] + STAGING_ALIGNMENT - 1u) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+
+				uint32_t residentMip = upload.second;
+				while (residentMip < load.lastMip && stagingOffset + GetStagedSize(format, dimensions, residentMip, load.lastMip) > TEXTURE_STREAMING_STAGING_SIZE_IN_BYTES)
+				{
+					residentMip++;
+				}
+
+				const uint64_t residentSize = GetMipChainSize(load.imageRef, ImageManager::GetResidentMip(load.imageRef));
+				const uint64_t uploadedSize = GetMipChainSize(load.imageRef, residentMip);
+
+				RetiredStreamedImage retired;
+				if (residentMip < load.lastMip && allocatedSize - residentSize + uploadedSize <= budget &&
+					Restream(commandBuffer, backBufferIndex, load.imageRef, residentMip, &load, retired))
+				{
+					retiredImages[backBufferIndex].push_back(retired);
+					imageIds.insert(load.imageRef._id);
+					allocatedSize += uploadedSize - residentSize;
+					continue;
+				}
+
+				//Budget or staging memory of this frame is used up, the load waits for the next swap
+				std::lock_guard<std::mutex> lock(loadMutex);
+				pendingLoads.insert(load.imageRef._id);
+				finishedLoads.push_back(std::move(load));
+			}
+
+			//Frames in flight keep their descriptor sets, the replaced images are retired until this back buffer comes around
+			Vulkan::RenderSystem::UpdateImageDescriptors(imageIds);
+			lastSwapFrame = frame;
+		}
+
+		uint32_t TextureStreamer::GetTailMip(const DOD::Ref& ref)
+		{
+			const glm::uvec3& dimensions = ImageManager::GetImageDimensions(ref);
+			const uint32_t mipLevelCount = ImageManager::GetMipLevelCount(ref);
+
+			uint32_t mip = 0u;
+			while (mip + 1u < mipLevelCount && std::max(dimensions.x >> mip, dimensions.y >> mip) > TEXTURE_STREAMING_TAIL_EXTENT)
+			{
+				mip++;
+			}
+
+			//Uploaded at once by CreateTexture(), the rest of the chain gets streamed
+			const VkFormat format = ImageManager::GetImageFormat(ref);
+			while (mip + 1u < mipLevelCount && GetStagedSize(format, dimensions, mip, mipLevelCount) > TEXTURE_STREAMING_STAGING_SIZE_IN_BYTES)
+			{
+				mip++;
+			}
+
+			return mip;
+		}
+
+		uint32_t TextureStreamer::GetFirstStreamableMip(const DOD::Ref& ref)
+		{
+			const VkFormat format = ImageManager::GetImageFormat(ref);
+			const glm::uvec3& dimensions = ImageManager::GetImageDimensions(ref);
+			const uint32_t mipLevelCount = ImageManager::GetMipLevelCount(ref);
+
+			uint32_t mip = 0u;
+			while (mip + 1u < mipLevelCount && GetStagedSize(format, dimensions, mip, mip + 1u) > TEXTURE_STREAMING_STAGING_SIZE_IN_BYTES)
+			{
+				mip++;
+			}
+
+			return mip;
+		}
+
+		uint64_t TextureStreamer::GetMipChainSize(const DOD::Ref& ref, uint32_t firstMip)
+		{
+			const VkFormat format = ImageManager::GetImageFormat(ref);
+			const glm::uvec3& dimensions = ImageManager::GetImageDimensions(ref);
+
+			uint64_t size = 0u;
+			for (uint32_t mip = firstMip; mip < ImageManager::GetMipLevelCount(ref); mip++)
+			{
+				size += GetMipSize(format, dimensions, mip);
+			}
+
+			return size;
+		}
+
+		std::vector<uint32_t> TextureStreamer::AssignBudget(const std::vector<DOD::Ref>& refs)
+		{
+			std::vector<uint32_t> targetMips(refs.size());
+			uint64_t usedBudget = 0u;
+
+			for (size_t i = 0u; i < refs.size(); i++)
+			{
+				targetMips[i] = GetTailMip(refs[i]);
+				usedBudget += GetMipChainSize(refs[i], targetMips[i]);
+			}
+
+			//Most recently used textures get their mips first
+			std::vector<size_t> order(refs.size());
+			std::iota(order.begin(), order.end(), 0u);
+			std::sort(order.begin(), order.end(), [&refs](size_t lhs, size_t rhs)
+			{
+				return ImageManager::GetLastUsedFrame(refs[lhs]) > ImageManager::GetLastUsedFrame(refs[rhs]);
+			});
+
+			for (const size_t i : order)
+			{
+				const DOD::Ref& ref = refs[i];
+				if (frame - ImageManager::GetLastUsedFrame(ref) > TEXTURE_STREAMING_UNUSED_FRAMES)
+				{
+					continue;
+				}
+
+				const uint32_t tailMip = targetMips[i];
+				const uint64_t tailSize = GetMipChainSize(ref, tailMip);
+
+				uint32_t mip = std::max(std::min(ImageManager::GetRequestedMip(ref), tailMip), GetFirstStreamableMip(ref));
+				while (mip < tailMip && usedBudget + GetMipChainSize(ref, mip) - tailSize > budget)
+				{
+					mip++;
+				}
+
+				usedBudget += GetMipChainSize(ref, mip) - tailSize;
+				targetMips[i] = mip;
+			}
+
+			return targetMips;
+		}
+
+		void TextureStreamer::LoadThread()
+		{
+			while (true)
+			{
+				TextureStreamingLoad load;
+				{
+					std::unique_lock<std::mutex> lock(loadMutex);
+					loadCondition.wait(lock, []() { return !running || !queuedLoads.empty(); });
+
+					if (!running)
+					{
+						return;
+					}
+
+					load = std::move(queuedLoads.front());
+					queuedLoads.pop_front();
+				}
+
+				load.failed = !ReadMips(load);
+
+				std::lock_guard<std::mutex> lock(loadMutex);
+				finishedLoads.push_back(std::move(load));
+			}
+		}
+
+		bool TextureStreamer::ReadMips(TextureStreamingLoad& load)
+		{
+			gli::texture2d texture(LoadTextureFile(load.fileName));
+			if (texture.empty() || texture.levels() < load.lastMip)
+			{
+				printf("ERROR: TextureStreamer::ReadMips: could not load mips of %s \n", load.fileName.c_str());
+				return false;
+			}
+
+			CopyMips(texture, load);
+			return true;
+		}
+
+		bool TextureStreamer::StageMips(uint32_t stagingIdx, const TextureStreamingLoad& load, uint32_t residentMip, std::vector<VkBufferImageCopy>& regions)
+		{
+			const glm::uvec3& dimensions = ImageManager::GetImageDimensions(load.imageRef);
+			const StreamingStagingBuffer& stagingBuffer = stagingBuffers[stagingIdx];
+
+			size_t stagingOffset = stagingOffsets[stagingIdx];
+			for (uint32_t mip = residentMip; mip < load.lastMip; mip++)
+			{
+				const size_t mipIdx = mip - load.firstMip;
+				const size_t mipSize = (mipIdx + 1u < load.mipOffsets.size() ? load.mipOffsets[mipIdx + 1u] : load.data.size()) - load.mipOffsets[mipIdx];
+
+				stagingOffset = (stagingOffset + STAGING_ALIGNMENT - 1u) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+				if (stagingOffset + mipSize > TEXTURE_STREAMING_STAGING_SIZE_IN_BYTES)
+				{
+					regions.clear();
+					return false;
+				}
+
+				memcpy(stagingBuffer.memoryAllocationInfo._mappedMemory + stagingOffset, load.data.data() + load.mipOffsets[mipIdx], mipSize);
+
+				VkBufferImageCopy region = {};
+				region.bufferOffset = stagingOffset;
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - residentMip, 0u, 1u };
+				region.imageExtent = GetMipExtent(dimensions, mip);
+				regions.push_back(region);
+
+				stagingOffset += mipSize;
+			}
+
+			stagingOffsets[stagingIdx] = stagingOffset;
+			return true;
+		}
+
+		bool TextureStreamer::Restream(VkCommandBuffer commandBuffer, uint32_t stagingIdx, const DOD::Ref& ref, uint32_t residentMip, const TextureStreamingLoad* load, RetiredStreamedImage& retired)
+		{
+			const VkDevice device = Vulkan::RenderSystem::vkDevice;
+			const VkFormat format = ImageManager::GetImageFormat(ref);
+			const glm::uvec3& dimensions = ImageManager::GetImageDimensions(ref);
+			const uint32_t mipLevelCount = ImageManager::GetMipLevelCount(ref);
+			const uint32_t oldResidentMip = ImageManager::GetResidentMip(ref);
+			const uint32_t levelCount = mipLevelCount - residentMip;
+
+			assert(load == nullptr || load->lastMip == oldResidentMip);
+
+			//Staged before anything is created, so running out of staging memory leaves the image as it is
+			std::vector<VkBufferImageCopy> uploadRegions;
+			if (load != nullptr && !StageMips(stagingIdx, *load, residentMip, uploadRegions))
+			{
+				return false;
+			}
+
+			VkImageCreateInfo imageCreateInfo = {};
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = format;
+			imageCreateInfo.extent = GetMipExtent(dimensions, residentMip);
+			imageCreateInfo.mipLevels = levelCount;
+			imageCreateInfo.arrayLayers = 1u;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			VkImage image;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &image));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, image, &memReqs);
+
+			const MemoryPoolTypes::GpuMemoryAllocationInfo memoryAllocationInfo = Vulkan::GpuMemoryManager::AllocateOffset(MemoryPoolTypes::kStreamedImages,
+				static_cast<uint32_t>(memReqs.size), static_cast<uint32_t>(memReqs.alignment), memReqs.memoryTypeBits);
+			VK_CHECK_RESULT(vkBindImageMemory(device, image, memoryAllocationInfo._vkDeviceMemory, memoryAllocationInfo._offset));
+
+			const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, levelCount, 0u, 1u };
+			const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			VkTools::InsertImageMemoryBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+			//Mips both images hold are copied on the GPU instead of being read again
+			const VkImage oldImage = ImageManager::GetVkImage(ref);
+			const uint32_t firstCopiedMip = std::max(residentMip, oldResidentMip);
+			if (oldImage != VK_NULL_HANDLE && firstCopiedMip < mipLevelCount)
+			{
+				const VkImageSubresourceRange oldRange = { VK_IMAGE_ASPECT_COLOR_BIT, firstCopiedMip - oldResidentMip, mipLevelCount - firstCopiedMip, 0u, 1u };
+				VkTools::InsertImageMemoryBarrier(commandBuffer, oldImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, oldRange,
+					shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+				std::vector<VkImageCopy> copyRegions;
+				for (uint32_t mip = firstCopiedMip; mip < mipLevelCount; mip++)
+				{
+					VkImageCopy copyRegion = {};
+					copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - oldResidentMip, 0u, 1u };
+					copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - residentMip, 0u, 1u };
+					copyRegion.extent = GetMipExtent(dimensions, mip);
+					copyRegions.push_back(copyRegion);
+				}
+
+				vkCmdCopyImage(commandBuffer, oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+			}
+
+			if (!uploadRegions.empty())
+			{
+				vkCmdCopyBufferToImage(commandBuffer, stagingBuffers[stagingIdx].buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<uint32_t>(uploadRegions.size()), uploadRegions.data());
+			}
+
+			VkTools::InsertImageMemoryBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages);
+
+			VkImageViewCreateInfo imageViewCreateInfo = {};
+			imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			imageViewCreateInfo.image = image;
+			imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageViewCreateInfo.format = format;
+			imageViewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+			imageViewCreateInfo.subresourceRange = range;
+
+			VkImageView imageView;
+			VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageView));
+
+			ImageViewArray subresourceImageViews(1u, std::vector<VkImageView>(levelCount));
+			for (uint32_t mipLevelIdx = 0u; mipLevelIdx < levelCount; ++mipLevelIdx)
+			{
+				imageViewCreateInfo.subresourceRange.baseMipLevel = mipLevelIdx;
+				imageViewCreateInfo.subresourceRange.levelCount = 1u;
+				VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &subresourceImageViews[0u][mipLevelIdx]));
+			}
+
+			retired = { oldImage, ImageManager::GetImageView(ref), std::move(ImageManager::GetSubresourceImageViews(ref)), ImageManager::GetMemoryAllocationInfo(ref) };
+
+			ImageManager::GetVkImage(ref) = image;
+			ImageManager::GetImageView(ref) = imageView;
+			ImageManager::GetSubresourceImageViews(ref) = std::move(subresourceImageViews);
+			ImageManager::GetMemoryAllocationInfo(ref) = memoryAllocationInfo;
+			ImageManager::GetResidentMip(ref) = residentMip;
+			return true;
+		}
+
+		void TextureStreamer::ReleaseRetired(std::vector<RetiredStreamedImage>& retired)
+		{
+			for (auto& retiredImage : retired)
+			{
+				for (const auto& mipImageViews : retiredImage.subresourceImageViews)
+				{
+					for (const VkImageView imageView : mipImageViews)
+					{
+						vkDestroyImageView(Vulkan::RenderSystem::vkDevice, imageView, nullptr);
+					}
+				}
+
+				if (retiredImage.imageView != VK_NULL_HANDLE)
+				{
+					vkDestroyImageView(Vulkan::RenderSystem::vkDevice, retiredImage.imageView, nullptr);
+				}
+
+				if (retiredImage.image != VK_NULL_HANDLE)
+				{
+					vkDestroyImage(Vulkan::RenderSystem::vkDevice, retiredImage.image, nullptr);
+				}
+
+				Vulkan::GpuMemoryManager::Free(retiredImage.memoryAllocationInfo);
+			}
+
+			retired.clear();
+		}
+	}
+}
@@ -0,0 +1,760 @@
+#include "Vulkan/VkVirtualTexture.h"
+#include "Vulkan/VkRenderSystem.h"
+#include "Vulkan/VkGPUMemoryManager.h"
+#include "Vulkan/VkImageManager.h"
+#include "Vulkan/VkDescriptorHeap.h"
+#include "Vulkan/VulkanTools.h"
+
+//Other
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		namespace
+		{
+			const uint32_t INVALID_SLOT = ~0u;
+
+			//Tiles and page table rows start at offsets every copy can read from
+			const size_t STAGING_ALIGNMENT = 16u;
+
+			const uint32_t ATLAS_TILE_EXTENT = Core::Texture::VIRTUAL_TEXTURE_TILE_SIZE + 2u * Core::Texture::VIRTUAL_TEXTURE_TILE_BORDER;
+			const uint32_t ATLAS_EXTENT = VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE * ATLAS_TILE_EXTENT;
+			const uint32_t TILE_DATA_SIZE = ATLAS_TILE_EXTENT * ATLAS_TILE_EXTENT * 4u;
+
+			const VkPipelineStageFlags SHADER_STAGES = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+			struct TileCoords
+			{
+				uint32_t textureId;
+				uint32_t mip;
+				uint32_t pageX;
+				uint32_t pageY;
+			};
+
+			TileCoords DecodeTile(uint32_t tileKey)
+			{
+				return { tileKey >> 28u, (tileKey >> 24u) & 0xFu, tileKey & 0xFFFu, (tileKey >> 12u) & 0xFFFu };
+			}
+
+			//Little endian RGBA8, what virtual_texture.glsl reads back from the page table
+			uint32_t PackPageTableEntry(uint32_t slotIdx, uint32_t mip)
+			{
+				const uint32_t atlasX = slotIdx % VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE;
+				const uint32_t atlasY = slotIdx / VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE;
+				return atlasX | (atlasY << 8u) | (mip << 16u) | (0xFFu << 24u);
+			}
+
+			size_t AlignStagingOffset(size_t offset)
+			{
+				return (offset + STAGING_ALIGNMENT - 1u) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+			}
+		}
+
+		VirtualTexture VirtualTextureSystem::textures[VIRTUAL_TEXTURE_MAX_COUNT];
+		uint32_t VirtualTextureSystem::frame = 0u;
+		DOD::Ref VirtualTextureSystem::atlasRef;
+		uint32_t VirtualTextureSystem::atlasHeapIndex = INVALID_HEAP_INDEX;
+		VkSampler VirtualTextureSystem::pageTableSampler = VK_NULL_HANDLE;
+		VkSampler VirtualTextureSystem::atlasSampler = VK_NULL_HANDLE;
+		std::vector<VirtualTextureSlot> VirtualTextureSystem::atlasSlots;
+		std::vector<VkBuffer> VirtualTextureSystem::stagingBuffers;
+		std::vector<MemoryPoolTypes::GpuMemoryAllocationInfo> VirtualTextureSystem::stagingMemory;
+		std::vector<size_t> VirtualTextureSystem::stagingOffsets;
+		std::unordered_set<uint32_t> VirtualTextureSystem::requestedTiles;
+		std::unordered_set<uint32_t> VirtualTextureSystem::pendingLoads;
+		std::thread VirtualTextureSystem::loader;
+		bool VirtualTextureSystem::running = false;
+		std::mutex VirtualTextureSystem::loadMutex;
+		std::condition_variable VirtualTextureSystem::loadCondition;
+		std::deque<VirtualTextureTileLoad> VirtualTextureSystem::queuedLoads;
+		std::vector<VirtualTextureTileLoad> VirtualTextureSystem::finishedLoads;
+
+		void VirtualTextureSystem::Init()
+		{
+			const size_t backBufferCount = Vulkan::RenderSystem::vkSwapchainImages.size();
+
+			stagingBuffers.resize(backBufferCount + 1u);
+			stagingMemory.resize(backBufferCount + 1u);
+			stagingOffsets.assign(backBufferCount + 1u, 0u);
+
+			for (size_t i = 0u; i < stagingBuffers.size(); i++)
+			{
+				CreateStagingBuffer(stagingMemory[i], stagingBuffers[i]);
+			}
+
+			CreateSamplers();
+			CreateAtlas();
+
+			running = true;
+			loader = std::thread(&VirtualTextureSystem::LoadThread);
+		}
+
+		void VirtualTextureSystem::Shutdown()
+		{
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				if (!running)
+				{
+					return;
+				}
+
+				running = false;
+				queuedLoads.clear();
+			}
+
+			loadCondition.notify_all();
+			loader.join();
+
+			finishedLoads.clear();
+			pendingLoads.clear();
+			requestedTiles.clear();
+
+			for (uint32_t textureId = 0u; textureId < VIRTUAL_TEXTURE_MAX_COUNT; textureId++)
+			{
+				if (IsValid(textureId))
+				{
+					DestroyVirtualTexture(textureId);
+				}
+			}
+
+			if (atlasHeapIndex != INVALID_HEAP_INDEX)
+			{
+				DescriptorHeap::ReleaseImage(atlasHeapIndex);
+				atlasHeapIndex = INVALID_HEAP_INDEX;
+			}
+
+			ImageManager::DestroyResource({ atlasRef });
+			ImageManager::DestroyImage(atlasRef);
+			atlasSlots.clear();
+
+			vkDestroySampler(Vulkan::RenderSystem::vkDevice, pageTableSampler, nullptr);
+			vkDestroySampler(Vulkan::RenderSystem::vkDevice, atlasSampler, nullptr);
+
+			for (const VkBuffer buffer : stagingBuffers)
+			{
+				vkDestroyBuffer(Vulkan::RenderSystem::vkDevice, buffer, nullptr);
+			}
+			stagingBuffers.clear();
+		}
+
+		void VirtualTextureSystem::CreateSamplers()
+		{
+			//Page table texels are fetched, never filtered
+			VkSamplerCreateInfo samplerCreateInfo = VkTools::Initializer::SamplerCreateInfo();
+			samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+			samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+			samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCreateInfo.minLod = 0.0f;
+			samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+			samplerCreateInfo.maxAnisotropy = 1.0f;
+			samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+			VK_CHECK_RESULT(vkCreateSampler(Vulkan::RenderSystem::vkDevice, &samplerCreateInfo, nullptr, &pageTableSampler));
+
+			//Tile borders cover the bilinear footprint, the atlas has no mips of its own
+			samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+			samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+			samplerCreateInfo.maxLod = 0.0f;
+			VK_CHECK_RESULT(vkCreateSampler(Vulkan::RenderSystem::vkDevice, &samplerCreateInfo, nullptr, &atlasSampler));
+		}
+
+		void VirtualTextureSystem::CreateAtlas()
+		{
+			atlasRef = ImageManager::CreateImage("VirtualTextureSystem_Atlas");
+			ImageManager::ResetToDefault(atlasRef);
+			ImageManager::GetImageFormat(atlasRef) = VK_FORMAT_R8G8B8A8_UNORM;
+			ImageManager::GetImageDimensions(atlasRef) = glm::uvec3(ATLAS_EXTENT, ATLAS_EXTENT, 1u);
+			ImageManager::GetImageFlags(atlasRef) = ImageFlags::kUsageSampled;
+			ImageManager::CreateResource(atlasRef);
+
+			atlasSlots.assign(VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE * VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE, { VIRTUAL_TEXTURE_NO_FEEDBACK, 0u, false });
+
+			//Free slots are never pointed at, the contents may stay undefined
+			VkCommandBuffer commandBuffer = BeginOneShot();
+			VkTools::InsertImageMemoryBarrier(commandBuffer, ImageManager::GetVkImage(atlasRef), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, 0u, 1u }, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, SHADER_STAGES);
+			SubmitAndWait(commandBuffer);
+
+			if (DescriptorHeap::IsSupported())
+			{
+				atlasHeapIndex = DescriptorHeap::RegisterImage(atlasRef, atlasSampler);
+			}
+		}
+
+		void VirtualTextureSystem::CreateStagingBuffer(MemoryPoolTypes::GpuMemoryAllocationInfo& memoryAllocationInfo, VkBuffer& buffer)
+		{
+			VkBufferCreateInfo bufferCreateInfo = {};
+			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCreateInfo.size = VIRTUAL_TEXTURE_STAGING_SIZE_IN_BYTES;
+			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			VK_CHECK_RESULT(vkCreateBuffer(Vulkan::RenderSystem::vkDevice, &bufferCreateInfo, nullptr, &buffer));
+
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(Vulkan::RenderSystem::vkDevice, buffer, &memReqs);
+
+			memoryAllocationInfo = Vulkan::GpuMemoryManager::AllocateOffset(MemoryPoolTypes::kStaticStagingBuffers,
+				static_cast<uint32_t>(memReqs.size), static_cast<uint32_t>(memReqs.alignment), memReqs.memoryTypeBits);
+			VK_CHECK_RESULT(vkBindBufferMemory(Vulkan::RenderSystem::vkDevice, buffer, memoryAllocationInfo._vkDeviceMemory, memoryAllocationInfo._offset));
+		}
+
+		VkCommandBuffer VirtualTextureSystem::BeginOneShot()
+		{
+			VkCommandBuffer commandBuffer;
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
+			cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			cmdBufAllocateInfo.commandPool = Vulkan::RenderSystem::vkPrimalCommandPool;
+			cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			cmdBufAllocateInfo.commandBufferCount = 1u;
+
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(Vulkan::RenderSystem::vkDevice, &cmdBufAllocateInfo, &commandBuffer));
+			VkCommandBufferBeginInfo cmdBufInfo = VkTools::Initializer::CommandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+			return commandBuffer;
+		}
+
+		void VirtualTextureSystem::SubmitAndWait(VkCommandBuffer commandBuffer)
+		{
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+			VkSubmitInfo submitInfo = {};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1u;
+			submitInfo.pCommandBuffers = &commandBuffer;
+
+			VK_CHECK_RESULT(vkQueueSubmit(Vulkan::RenderSystem::vkQueue, 1u, &submitInfo, VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueWaitIdle(Vulkan::RenderSystem::vkQueue));
+
+			vkFreeCommandBuffers(Vulkan::RenderSystem::vkDevice, Vulkan::RenderSystem::vkPrimalCommandPool, 1u, &commandBuffer);
+		}
+
+		uint32_t VirtualTextureSystem::CreateVirtualTexture(const std::string& fileName)
+		{
+			uint32_t textureId = 0u;
+			while (textureId < VIRTUAL_TEXTURE_MAX_COUNT && IsValid(textureId))
+			{
+				textureId++;
+			}
+
+			if (textureId == VIRTUAL_TEXTURE_MAX_COUNT)
+			{
+				printf("ERROR: VirtualTextureSystem::CreateVirtualTexture: no id left for %s \n", fileName.c_str());
+				return VIRTUAL_TEXTURE_NO_FEEDBACK;
+			}
+
+			std::shared_ptr<Core::Texture::VirtualTextureFile> file = std::make_shared<Core::Texture::VirtualTextureFile>();
+			if (!file->Load(fileName))
+			{
+				printf("ERROR: VirtualTextureSystem::CreateVirtualTexture: could not load %s \n", fileName.c_str());
+				return VIRTUAL_TEXTURE_NO_FEEDBACK;
+			}
+
+			const uint32_t pageCount = file->GetPageCount(0u);
+			const uint32_t mipCount = file->GetHeader().mipCount;
+			assert(pageCount <= Core::Texture::VIRTUAL_TEXTURE_MAX_PAGES_PER_SIDE && mipCount <= 16u);
+
+			VirtualTexture& texture = textures[textureId];
+			texture.file = file;
+			texture.generation++;
+			texture.pageTableHeapIndex = INVALID_HEAP_INDEX;
+
+			//Pages of a mip map to texels of the same mip, the cooked chain ends at a single page
+			texture.pageTableRef = ImageManager::CreateImage(fileName + "_PageTable");
+			ImageManager::ResetToDefault(texture.pageTableRef);
+			ImageManager::GetImageFormat(texture.pageTableRef) = VK_FORMAT_R8G8B8A8_UNORM;
+			ImageManager::GetImageDimensions(texture.pageTableRef) = glm::uvec3(pageCount, pageCount, 1u);
+			ImageManager::GetMipLevelCount(texture.pageTableRef) = mipCount;
+			ImageManager::GetImageFlags(texture.pageTableRef) = ImageFlags::kUsageSampled;
+
+			//Destroyed page tables give their memory back
+			ImageManager::GetMemoryPoolType(texture.pageTableRef) = MemoryPoolTypes::kStreamedImages;
+			ImageManager::CreateResource(texture.pageTableRef);
+
+			texture.pageTable.resize(mipCount);
+			texture.slots.resize(mipCount);
+			for (uint32_t mip = 0u; mip < mipCount; mip++)
+			{
+				const uint32_t mipPageCount = file->GetPageCount(mip);
+				texture.pageTable[mip].assign(mipPageCount * mipPageCount, 0u);
+				texture.slots[mip].assign(mipPageCount * mipPageCount, INVALID_SLOT);
+			}
+
+			texture.dirtyRects.clear();
+			texture.dirtyRectMips.clear();
+
+			//Coarsest mip is read right away and never evicted, every page falls back to it
+			const uint32_t slotIdx = AcquireSlot();
+			if (slotIdx == INVALID_SLOT)
+			{
+				printf("ERROR: VirtualTextureSystem::CreateVirtualTexture: atlas is full, %s is not created \n", fileName.c_str());
+				DestroyVirtualTexture(textureId);
+				return VIRTUAL_TEXTURE_NO_FEEDBACK;
+			}
+
+			const uint32_t tileKey = EncodeVirtualTextureTile(textureId, mipCount - 1u, 0u, 0u);
+			VirtualTextureTileLoad load = { tileKey, texture.generation, file };
+			const uint8_t* tileData = file->GetTileData(mipCount - 1u, 0u, 0u);
+			load.data.assign(tileData, tileData + file->GetTileDataSize());
+
+			VkCommandBuffer commandBuffer = BeginOneShot();
+			VkTools::InsertImageMemoryBarrier(commandBuffer, ImageManager::GetVkImage(texture.pageTableRef), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, 0u, mipCount, 0u, 1u }, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, SHADER_STAGES);
+
+			//The last staging buffer is only used here and the queue is idle after each use
+			const uint32_t stagingIdx = static_cast<uint32_t>(stagingBuffers.size() - 1u);
+			stagingOffsets[stagingIdx] = 0u;
+
+			//A taken slot belongs to another texture, whose page table has to let go of it in the same submit
+			if (atlasSlots[slotIdx].tileKey != VIRTUAL_TEXTURE_NO_FEEDBACK)
+			{
+				UnmapTile(atlasSlots[slotIdx].tileKey);
+			}
+
+			VkBufferImageCopy region;
+			const bool staged = StageTile(stagingIdx, load, slotIdx, region);
+			assert(staged && "Tile does not fit into the staging memory");
+
+			const VkImage atlasImage = ImageManager::GetVkImage(atlasRef);
+			const VkImageSubresourceRange atlasRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, 0u, 1u };
+			VkTools::InsertImageMemoryBarrier(commandBuffer, atlasImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, atlasRange,
+				SHADER_STAGES, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffers[stagingIdx], atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1u, &region);
+			VkTools::InsertImageMemoryBarrier(commandBuffer, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, atlasRange,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, SHADER_STAGES);
+
+			MapTile(tileKey, slotIdx);
+			atlasSlots[slotIdx].pinned = true;
+
+			for (auto& dirtyTexture : textures)
+			{
+				if (dirtyTexture.file != nullptr && !dirtyTexture.dirtyRects.empty())
+				{
+					const bool uploaded = UploadPageTable(commandBuffer, stagingIdx, dirtyTexture);
+					assert(uploaded && "Page table does not fit into the staging memory");
+				}
+			}
+
+			SubmitAndWait(commandBuffer);
+
+			texture.pageTableHeapIndex = DescriptorHeap::IsSupported() ? DescriptorHeap::RegisterImage(texture.pageTableRef, pageTableSampler) : INVALID_HEAP_INDEX;
+			return textureId;
+		}
+
+		void VirtualTextureSystem::DestroyVirtualTexture(uint32_t textureId)
+		{
+			VirtualTexture& texture = textures[textureId];
+
+			VK_CHECK_RESULT(vkDeviceWaitIdle(Vulkan::RenderSystem::vkDevice));
+
+			for (auto& slot : atlasSlots)
+			{
+				if (slot.tileKey != VIRTUAL_TEXTURE_NO_FEEDBACK && (slot.tileKey >> 28u) == textureId)
+				{
+					slot = { VIRTUAL_TEXTURE_NO_FEEDBACK, 0u, false };
+				}
+			}
+
+			if (texture.pageTableHeapIndex != INVALID_HEAP_INDEX)
+			{
+				DescriptorHeap::ReleaseImage(texture.pageTableHeapIndex);
+			}
+			texture.pageTableHeapIndex = INVALID_HEAP_INDEX;
+
+			ImageManager::DestroyResource({ texture.pageTableRef });
+			ImageManager::DestroyImage(texture.pageTableRef);
+			texture.pageTableRef = DOD::Ref();
+
+			//Loads in flight hold on to the file, they are dropped by their generation
+			texture.file.reset();
+			texture.pageTable.clear();
+			texture.slots.clear();
+			texture.dirtyRects.clear();
+			texture.dirtyRectMips.clear();
+		}
+
+		void VirtualTextureSystem::AddFeedback(const uint32_t* texels, size_t texelCount)
+		{
+			uint32_t lastTexel = VIRTUAL_TEXTURE_NO_FEEDBACK;
+			for (size_t i = 0u; i < texelCount; i++)
+			{
+				//Neighbouring texels mostly hit the same tile
+				if (texels[i] != lastTexel && texels[i] != VIRTUAL_TEXTURE_NO_FEEDBACK)
+				{
+					requestedTiles.insert(texels[i]);
+				}
+				lastTexel = texels[i];
+			}
+		}
+
+		void VirtualTextureSystem::Update(VkCommandBuffer commandBuffer, uint32_t backBufferIndex)
+		{
+			frame++;
+			stagingOffsets[backBufferIndex] = 0u;
+
+			//Requested tiles and the tiles they fall back to stay resident, missing ones are loaded coarsest first
+			std::vector<uint32_t> missingTiles;
+			for (const uint32_t tileKey : requestedTiles)
+			{
+				const TileCoords tile = DecodeTile(tileKey);
+				if (!IsValid(tile.textureId))
+				{
+					continue;
+				}
+
+				const VirtualTexture& texture = textures[tile.textureId];
+				if (tile.mip >= texture.file->GetHeader().mipCount || tile.pageX >= texture.file->GetPageCount(tile.mip) || tile.pageY >= texture.file->GetPageCount(tile.mip))
+				{
+					continue;
+				}
+
+				for (uint32_t mip = tile.mip; mip < texture.slots.size(); mip++)
+				{
+					const uint32_t shift = mip - tile.mip;
+					const uint32_t slotIdx = texture.slots[mip][(tile.pageY >> shift) * texture.file->GetPageCount(mip) + (tile.pageX >> shift)];
+					if (slotIdx != INVALID_SLOT)
+					{
+						atlasSlots[slotIdx].lastUsedFrame = frame;
+					}
+					else if (mip == tile.mip && pendingLoads.count(tileKey) == 0u)
+					{
+						missingTiles.push_back(tileKey);
+					}
+				}
+			}
+			requestedTiles.clear();
+
+			std::sort(missingTiles.begin(), missingTiles.end(), [](uint32_t lhs, uint32_t rhs)
+			{
+				return DecodeTile(lhs).mip > DecodeTile(rhs).mip;
+			});
+
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				for (const uint32_t tileKey : missingTiles)
+				{
+					if (pendingLoads.size() >= VIRTUAL_TEXTURE_MAX_PENDING_LOADS)
+					{
+						break;
+					}
+
+					const VirtualTexture& texture = textures[DecodeTile(tileKey).textureId];
+					pendingLoads.insert(tileKey);
+					queuedLoads.push_back({ tileKey, texture.generation, texture.file });
+				}
+			}
+			loadCondition.notify_one();
+
+			std::vector<VirtualTextureTileLoad> loads;
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				loads.swap(finishedLoads);
+			}
+
+			//Page table texels the mapped tiles need are reserved before the tiles are staged
+			uint64_t pageTableSize = 0u;
+			for (const auto& texture : textures)
+			{
+				for (size_t i = 0u; i < texture.dirtyRects.size(); i++)
+				{
+					const glm::uvec4& rect = texture.dirtyRects[i];
+					pageTableSize += AlignStagingOffset(static_cast<size_t>(rect.z - rect.x) * (rect.w - rect.y) * sizeof(uint32_t));
+				}
+			}
+
+			std::vector<VkBufferImageCopy> regions;
+			size_t loadIdx = 0u;
+			for (; loadIdx < loads.size() && regions.size() < VIRTUAL_TEXTURE_MAX_UPLOADS_PER_FRAME; loadIdx++)
+			{
+				const VirtualTextureTileLoad& load = loads[loadIdx];
+				const TileCoords tile = DecodeTile(load.tileKey);
+				if (!IsValid(tile.textureId) || textures[tile.textureId].generation != load.generation)
+				{
+					pendingLoads.erase(load.tileKey);
+					continue;
+				}
+
+				const uint32_t slotIdx = AcquireSlot();
+				if (slotIdx == INVALID_SLOT)
+				{
+					break;
+				}
+
+				uint64_t neededSize = TILE_DATA_SIZE + STAGING_ALIGNMENT + GetDirtySize(textures[tile.textureId], tile.mip);
+				const uint32_t evictedKey = atlasSlots[slotIdx].tileKey;
+				if (evictedKey != VIRTUAL_TEXTURE_NO_FEEDBACK)
+				{
+					neededSize += GetDirtySize(textures[evictedKey >> 28u], DecodeTile(evictedKey).mip);
+				}
+
+				if (stagingOffsets[backBufferIndex] + pageTableSize + neededSize > VIRTUAL_TEXTURE_STAGING_SIZE_IN_BYTES)
+				{
+					break;
+				}
+
+				//Pages of the evicted tile fall back to coarser tiles with the same page table upload
+				if (evictedKey != VIRTUAL_TEXTURE_NO_FEEDBACK)
+				{
+					UnmapTile(evictedKey);
+				}
+
+				VkBufferImageCopy region;
+				StageTile(backBufferIndex, load, slotIdx, region);
+				regions.push_back(region);
+
+				MapTile(load.tileKey, slotIdx);
+				pendingLoads.erase(load.tileKey);
+				pageTableSize += neededSize - TILE_DATA_SIZE - STAGING_ALIGNMENT;
+			}
+
+			//Out of staging memory or slots, the remaining tiles wait for the next frame
+			if (loadIdx < loads.size())
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				for (; loadIdx < loads.size(); loadIdx++)
+				{
+					finishedLoads.push_back(std::move(loads[loadIdx]));
+				}
+			}
+
+			//Frames in flight are done with the slots by the time the copy runs, the queue keeps the order
+			if (!regions.empty())
+			{
+				const VkImage atlasImage = ImageManager::GetVkImage(atlasRef);
+				const VkImageSubresourceRange atlasRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, 0u, 1u };
+
+				VkTools::InsertImageMemoryBarrier(commandBuffer, atlasImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, atlasRange,
+					SHADER_STAGES, VK_PIPELINE_STAGE_TRANSFER_BIT);
+				vkCmdCopyBufferToImage(commandBuffer, stagingBuffers[backBufferIndex], atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<uint32_t>(regions.size()), regions.data());
+				VkTools::InsertImageMemoryBarrier(commandBuffer, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, atlasRange,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, SHADER_STAGES);
+			}
+
+			for (auto& texture : textures)
+			{
+				if (texture.file != nullptr && !texture.dirtyRects.empty())
+				{
+					const bool uploaded = UploadPageTable(commandBuffer, backBufferIndex, texture);
+					assert(uploaded && "Page table texels were not reserved");
+				}
+			}
+		}
+
+		void VirtualTextureSystem::LoadThread()
+		{
+			while (true)
+			{
+				VirtualTextureTileLoad load;
+				{
+					std::unique_lock<std::mutex> lock(loadMutex);
+					loadCondition.wait(lock, []() { return !running || !queuedLoads.empty(); });
+
+					if (!running)
+					{
+						return;
+					}
+
+					load = std::move(queuedLoads.front());
+					queuedLoads.pop_front();
+				}
+
+				//Touching the mapping is what reads the tile from disk
+				const TileCoords tile = DecodeTile(load.tileKey);
+				const uint8_t* tileData = load.file->GetTileData(tile.mip, tile.pageX, tile.pageY);
+				load.data.assign(tileData, tileData + load.file->GetTileDataSize());
+
+				std::lock_guard<std::mutex> lock(loadMutex);
+				finishedLoads.push_back(std::move(load));
+			}
+		}
+
+		uint32_t VirtualTextureSystem::AcquireSlot()
+		{
+			//Free slots first, then the least recently used tile not needed by this frame
+			uint32_t victimIdx = INVALID_SLOT;
+			for (uint32_t slotIdx = 0u; slotIdx < atlasSlots.size(); slotIdx++)
+			{
+				const VirtualTextureSlot& slot = atlasSlots[slotIdx];
+				if (slot.tileKey == VIRTUAL_TEXTURE_NO_FEEDBACK)
+				{
+					return slotIdx;
+				}
+
+				if (!slot.pinned && slot.lastUsedFrame != frame && (victimIdx == INVALID_SLOT || slot.lastUsedFrame < atlasSlots[victimIdx].lastUsedFrame))
+				{
+					victimIdx = slotIdx;
+				}
+			}
+
+			return victimIdx;
+		}
+
+		void VirtualTextureSystem::MapTile(uint32_t tileKey, uint32_t slotIdx)
+		{
+			const TileCoords tile = DecodeTile(tileKey);
+			VirtualTexture& texture = textures[tile.textureId];
+
+			texture.slots[tile.mip][tile.pageY * texture.file->GetPageCount(tile.mip) + tile.pageX] = slotIdx;
+			atlasSlots[slotIdx] = { tileKey, frame, false };
+
+			MarkDirty(texture, tile.mip, tile.pageX, tile.pageY);
+		}
+
+		void VirtualTextureSystem::UnmapTile(uint32_t tileKey)
+		{
+			const TileCoords tile = DecodeTile(tileKey);
+			VirtualTexture& texture = textures[tile.textureId];
+
+			const uint32_t pageIdx = tile.pageY * texture.file->GetPageCount(tile.mip) + tile.pageX;
+			atlasSlots[texture.slots[tile.mip][pageIdx]] = { VIRTUAL_TEXTURE_NO_FEEDBACK, 0u, false };
+			texture.slots[tile.mip][pageIdx] = INVALID_SLOT;
+
+			MarkDirty(texture, tile.mip, tile.pageX, tile.pageY);
+		}
+
+		void VirtualTextureSystem::MarkDirty(VirtualTexture& texture, uint32_t mip, uint32_t pageX, uint32_t pageY)
+		{
+			//Footprint of the page in every finer mip
+			for (uint32_t finerMip = 0u; finerMip <= mip; finerMip++)
+			{
+				const uint32_t shift = mip - finerMip;
+				texture.dirtyRects.push_back(glm::uvec4(pageX << shift, pageY << shift, (pageX + 1u) << shift, (pageY + 1u) << shift));
+				texture.dirtyRectMips.push_back(finerMip);
+			}
+		}
+
+		uint64_t VirtualTextureSystem::GetDirtySize(const VirtualTexture& texture, uint32_t mip)
+		{
+			uint64_t size = 0u;
+			for (uint32_t finerMip = 0u; finerMip <= mip; finerMip++)
+			{
+				const uint64_t extent = 1ull << (mip - finerMip);
+				size += AlignStagingOffset(static_cast<size_t>(extent * extent * sizeof(uint32_t)));
+			}
+
+			return size;
+		}
+
+		bool VirtualTextureSystem::UploadPageTable(VkCommandBuffer commandBuffer, uint32_t stagingIdx, VirtualTexture& texture)
+		{
+			uint64_t size = 0u;
+			for (const glm::uvec4& rect : texture.dirtyRects)
+			{
+				size += AlignStagingOffset(static_cast<size_t>(rect.z - rect.x) * (rect.w - rect.y) * sizeof(uint32_t));
+			}
+
+			size_t stagingOffset = AlignStagingOffset(stagingOffsets[stagingIdx]);
+			if (stagingOffset + size > VIRTUAL_TEXTURE_STAGING_SIZE_IN_BYTES)
+			{
+				return false;
+			}
+
+			//Coarse rects first, finer pages fall back to entries already rebuilt
+			std::vector<size_t> order(texture.dirtyRects.size());
+			for (size_t i = 0u; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+			std::stable_sort(order.begin(), order.end(), [&texture](size_t lhs, size_t rhs)
+			{
+				return texture.dirtyRectMips[lhs] > texture.dirtyRectMips[rhs];
+			});
+
+			const uint32_t mipCount = static_cast<uint32_t>(texture.pageTable.size());
+			for (const size_t rectIdx : order)
+			{
+				const glm::uvec4& rect = texture.dirtyRects[rectIdx];
+				const uint32_t mip = texture.dirtyRectMips[rectIdx];
+				const uint32_t pageCount = texture.file->GetPageCount(mip);
+
+				for (uint32_t pageY = rect.y; pageY < rect.w; pageY++)
+				{
+					for (uint32_t pageX = rect.x; pageX < rect.z; pageX++)
+					{
+						const uint32_t slotIdx = texture.slots[mip][pageY * pageCount + pageX];
+						uint32_t& entry = texture.pageTable[mip][pageY * pageCount + pageX];
+
+						if (slotIdx != INVALID_SLOT)
+						{
+							entry = PackPageTableEntry(slotIdx, mip);
+						}
+						else if (mip + 1u < mipCount)
+						{
+							entry = texture.pageTable[mip + 1u][(pageY / 2u) * texture.file->GetPageCount(mip + 1u) + pageX / 2u];
+						}
+					}
+				}
+			}
+
+			//Rects are staged after all of them got rebuilt, later ones may have changed the earlier ones
+			std::vector<VkBufferImageCopy> regions;
+			for (size_t rectIdx = 0u; rectIdx < texture.dirtyRects.size(); rectIdx++)
+			{
+				const glm::uvec4& rect = texture.dirtyRects[rectIdx];
+				const uint32_t mip = texture.dirtyRectMips[rectIdx];
+				const uint32_t pageCount = texture.file->GetPageCount(mip);
+				const uint32_t width = rect.z - rect.x;
+
+				uint8_t* staging = stagingMemory[stagingIdx]._mappedMemory + stagingOffset;
+				for (uint32_t pageY = rect.y; pageY < rect.w; pageY++)
+				{
+					memcpy(staging + (pageY - rect.y) * width * sizeof(uint32_t), &texture.pageTable[mip][pageY * pageCount + rect.x], width * sizeof(uint32_t));
+				}
+
+				VkBufferImageCopy region = {};
+				region.bufferOffset = stagingOffset;
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0u, 1u };
+				region.imageOffset = { static_cast<int32_t>(rect.x), static_cast<int32_t>(rect.y), 0 };
+				region.imageExtent = { width, rect.w - rect.y, 1u };
+				regions.push_back(region);
+
+				stagingOffset = AlignStagingOffset(stagingOffset + static_cast<size_t>(width) * (rect.w - rect.y) * sizeof(uint32_t));
+			}
+			stagingOffsets[stagingIdx] = stagingOffset;
+
+			const VkImage pageTableImage = ImageManager::GetVkImage(texture.pageTableRef);
+			const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, mipCount, 0u, 1u };
+
+			VkTools::InsertImageMemoryBarrier(commandBuffer, pageTableImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range,
+				SHADER_STAGES, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffers[stagingIdx], pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(regions.size()), regions.data());
+			VkTools::InsertImageMemoryBarrier(commandBuffer, pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, SHADER_STAGES);
+
+			texture.dirtyRects.clear();
+			texture.dirtyRectMips.clear();
+			return true;
+		}
+
+		bool VirtualTextureSystem::StageTile(uint32_t stagingIdx, const VirtualTextureTileLoad& load, uint32_t slotIdx, VkBufferImageCopy& region)
+		{
+			const size_t stagingOffset = AlignStagingOffset(stagingOffsets[stagingIdx]);
+			if (stagingOffset + load.data.size() > VIRTUAL_TEXTURE_STAGING_SIZE_IN_BYTES)
+			{
+				return false;
+			}
+
+			memcpy(stagingMemory[stagingIdx]._mappedMemory + stagingOffset, load.data.data(), load.data.size());
+
+			region = {};
+			region.bufferOffset = stagingOffset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, 0u, 1u };
+			region.imageOffset = { static_cast<int32_t>(slotIdx % VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE * ATLAS_TILE_EXTENT),
+				static_cast<int32_t>(slotIdx / VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE * ATLAS_TILE_EXTENT), 0 };
+			region.imageExtent = { ATLAS_TILE_EXTENT, ATLAS_TILE_EXTENT, 1u };
+
+			stagingOffsets[stagingIdx] = stagingOffset + load.data.size();
+			return true;
+		}
+	}
+}
@@ -1,10 +1,32 @@
 //Vulkan Renderer Includes
 #include "Vulkan/VulkanTools.h"
 #include"Vulkan/VulkanTextureLoader.h"
+#include "OctoCore/Public/MappedFile.h"
 
 //ThirdParty
 #include <ThirdParty/gli/gli/gli.hpp>
 
+//Other
+#include <algorithm>
+#include <cstdio>
+
+#if !defined(__ANDROID__)
+namespace
+{
+	//gli parses straight from the mapping instead of reading the whole file into the heap first
+	gli::texture LoadMappedTexture(const std::string& filename)
+	{
+		Core::Memory::MappedFile textureFile;
+		if (!textureFile.Map(filename))
+		{
+			return gli::texture();
+		}
+
+		return gli::load(reinterpret_cast<const char*>(textureFile.GetData()), textureFile.GetSize());
+	}
+}
+#endif
+
 VkTools::VulkanTextureLoader::VulkanTextureLoader(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, VkCommandPool cmdPool)
 {
 	this->physicalDevice = physicalDevice;
@@ -35,12 +57,15 @@ bool VkTools::VulkanTextureLoader::GenerateTexture(void * pImageData, VulkanText
 {
 	texture->width = width;
 	texture->height = height;
-	texture->mipLevels = 0;
 
-
-	// Get device properites for the requested texture format
-	VkFormatProperties formatProperties;
-	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	//Mips below the uploaded one are blitted on the GPU, formats that can not be blitted keep a single mip
+	const uint32_t fullMipLevels = VkTools::GetFullMipLevelCount(width, height);
+	texture->mipLevels = std::min(miplevels == 0u ? fullMipLevels : miplevels, fullMipLevels);
+	if (texture->mipLevels > 1u && !VkTools::SupportsMipmapGeneration(physicalDevice, format))
+	{
+		printf("ERROR: VulkanTextureLoader::GenerateTexture: format %d can not be blitted, mips are not generated \n", format);
+		texture->mipLevels = 1u;
+	}
 
 	VkMemoryAllocateInfo memAllocInfo = VkTools::Initializer::MemoryAllocateInfo();
 	VkMemoryRequirements memReqs;
@@ -104,14 +129,14 @@ bool VkTools::VulkanTextureLoader::GenerateTexture(void * pImageData, VulkanText
 		VkImageCreateInfo imageCreateInfo = VkTools::Initializer::ImageCreateInfo();
 		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.mipLevels = texture->mipLevels;
 		imageCreateInfo.arrayLayers = 1;
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { texture->width, texture->height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture->image));
 
@@ -124,14 +149,21 @@ bool VkTools::VulkanTextureLoader::GenerateTexture(void * pImageData, VulkanText
 		VK_CHECK_RESULT(vkBindImageMemory(device, texture->image, texture->deviceMemory, 0));
 
 
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = texture->mipLevels;
+		subresourceRange.layerCount = 1;
+
 		// Image barrier for optimal image (target)
-		// Optimal image will be used as destination for the copy
+		// Optimal image will be used as destination for the copy and the blits
 		VkTools::SetImageLayout(
 			cmdBuffer,
 			texture->image,
 			VK_IMAGE_ASPECT_COLOR_BIT,
 			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			subresourceRange);
 
 		// Copy mip levels from staging buffer
 		vkCmdCopyBufferToImage(
@@ -143,13 +175,14 @@ bool VkTools::VulkanTextureLoader::GenerateTexture(void * pImageData, VulkanText
 			bufferCopyRegions.data()
 		);
 
-		// Change texture image layout to shader read after all mip levels have been copied
+		// Remaining mips are generated from the copied one, all of them end up in shader read
 		texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		SetImageLayout(
+		VkTools::GenerateMipmaps(
 			cmdBuffer,
 			texture->image,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			texture->width,
+			texture->height,
+			texture->mipLevels,
 			texture->imageLayout);
 
 
@@ -189,7 +222,7 @@ bool VkTools::VulkanTextureLoader::GenerateTexture(void * pImageData, VulkanText
 	sampler.minLod = 0.0f;
 
 	// Max level-of-detail should match mip level count
-	sampler.maxLod = 1;
+	sampler.maxLod = static_cast<float>(texture->mipLevels);
 	// Enable anisotropic filtering
 	sampler.maxAnisotropy = 8;
 	sampler.anisotropyEnable = VK_TRUE;
@@ -208,9 +241,7 @@ bool VkTools::VulkanTextureLoader::GenerateTexture(void * pImageData, VulkanText
 	view.format = format;
 	view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
 	view.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-	// Linear tiling usually won't support mip maps
-	// Only set mip map count if optimal tiling is used
-	view.subresourceRange.levelCount = 1;
+	view.subresourceRange.levelCount = texture->mipLevels;
 	view.image = texture->image;
 	VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture->view));
 
@@ -265,8 +296,7 @@ bool VkTools::VulkanTextureLoader::LoadTexture(const std::string& filename, VkFo
 
 	//}
 
-	
-	gli::texture2d tex2D(gli::load(filename.c_str()));
+	gli::texture2d tex2D(LoadMappedTexture(filename));
 	assert(!tex2D.empty());
 	if (tex2D.empty())
 	{
@@ -643,7 +673,7 @@ bool VkTools::VulkanTextureLoader::LoadCubemap(std::string filename, VkFormat fo
 
 	free(textureData);
 #else
-	gli::texture_cube texCube(gli::load(filename));
+	gli::texture_cube texCube(LoadMappedTexture(filename));
 #endif	
 	assert(!texCube.empty());
 	if (texCube.empty())
@@ -854,7 +884,7 @@ bool VkTools::VulkanTextureLoader::LoadTextureArray(std::string filename, VkForm
 
 	free(textureData);
 #else
-	gli::texture2d_array tex2DArray(gli::load(filename));
+	gli::texture2d_array tex2DArray(LoadMappedTexture(filename));
 #endif	
 
 	if (!tex2DArray.empty())
@@ -1,6 +1,8 @@
 #include "Vulkan\VulkanTools.h"
+#include "OctoCore/Public/MappedFile.h"
 
 //Other
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
@@ -81,6 +83,82 @@ void VkTools::InsertImageMemoryBarrier(
 		1, &imageMemoryBarrier);
 }
 
+void VkTools::InsertMemoryBarrier(
+	VkCommandBuffer cmdbuffer,
+	VkAccessFlags srcAccessMask,
+	VkAccessFlags dstAccessMask,
+	VkPipelineStageFlags srcStageMask,
+	VkPipelineStageFlags dstStageMask)
+{
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = srcAccessMask;
+	memoryBarrier.dstAccessMask = dstAccessMask;
+
+	vkCmdPipelineBarrier(
+		cmdbuffer,
+		srcStageMask,
+		dstStageMask,
+		0,
+		1, &memoryBarrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+uint32_t VkTools::GetFullMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t mipLevels = 1u;
+	while ((std::max(width, height) >> mipLevels) > 0u)
+	{
+		mipLevels++;
+	}
+
+	return mipLevels;
+}
+
+VkBool32 VkTools::SupportsMipmapGeneration(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+	const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures ? VK_TRUE : VK_FALSE;
+}
+
+void VkTools::GenerateMipmaps(
+	VkCommandBuffer cmdbuffer,
+	VkImage image,
+	uint32_t width,
+	uint32_t height,
+	uint32_t mipLevels,
+	VkImageLayout newImageLayout,
+	VkPipelineStageFlags dstStageMask)
+{
+	for (uint32_t mipLevel = 1u; mipLevel < mipLevels; mipLevel++)
+	{
+		//Previous mip is complete once the copy or the last blit wrote it
+		const VkImageSubresourceRange srcRange = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel - 1u, 1u, 0u, 1u };
+		VkTools::InsertImageMemoryBarrier(cmdbuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcRange,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		VkImageBlit imageBlit = {};
+		imageBlit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel - 1u, 0u, 1u };
+		imageBlit.srcOffsets[1] = { static_cast<int32_t>(std::max(width >> (mipLevel - 1u), 1u)), static_cast<int32_t>(std::max(height >> (mipLevel - 1u), 1u)), 1 };
+		imageBlit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 0u, 1u };
+		imageBlit.dstOffsets[1] = { static_cast<int32_t>(std::max(width >> mipLevel, 1u)), static_cast<int32_t>(std::max(height >> mipLevel, 1u)), 1 };
+
+		vkCmdBlitImage(cmdbuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1u, &imageBlit, VK_FILTER_LINEAR);
+
+		VkTools::InsertImageMemoryBarrier(cmdbuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImageLayout, srcRange,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask);
+	}
+
+	//Last mip was only written
+	const VkImageSubresourceRange lastRange = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - 1u, 1u, 0u, 1u };
+	VkTools::InsertImageMemoryBarrier(cmdbuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, newImageLayout, lastRange,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask);
+}
+
 void VkTools::CreateFrameBufferAttachement(
 	uint32_t iWidth, uint32_t iHeight, 
 	VkFormat format, 
@@ -800,6 +878,46 @@ VkBool32 VkTools::GetSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFor
 	return false;
 }
 
+uint32_t VkTools::GetFormatSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R8G8_SNORM:
+	case VK_FORMAT_R16_SFLOAT:
+		return 2u;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SNORM:
+	case VK_FORMAT_R8G8B8A8_UINT:
+	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+	case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+	case VK_FORMAT_R16G16_UNORM:
+	case VK_FORMAT_R16G16_SNORM:
+	case VK_FORMAT_R16G16_SFLOAT:
+	case VK_FORMAT_R32_SFLOAT:
+	case VK_FORMAT_R32_UINT:
+		return 4u;
+	case VK_FORMAT_R16G16B16_UNORM:
+	case VK_FORMAT_R16G16B16_SNORM:
+	case VK_FORMAT_R16G16B16_SFLOAT:
+		return 6u;
+	case VK_FORMAT_R16G16B16A16_UNORM:
+	case VK_FORMAT_R16G16B16A16_SNORM:
+	case VK_FORMAT_R16G16B16A16_UINT:
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R32G32_SFLOAT:
+		return 8u;
+	case VK_FORMAT_R32G32B32_SFLOAT:
+		return 12u;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+	case VK_FORMAT_R32G32B32A32_UINT:
+		return 16u;
+	default:
+		assert(false && "Unknown format size");
+		return 0u;
+	}
+}
+
 void VkTools::DestroyUniformData(VkDevice device, VkTools::UniformData& uniformData)
 {
 	if (uniformData.mapped != nullptr)
@@ -843,40 +961,31 @@ VkShaderModule VkTools::LoadShader(AAssetManager* assetManager, const char *file
 #else
 VkShaderModule VkTools::LoadShader(const std::string& fileName, VkDevice device, VkShaderStageFlagBits stage)
 {
-	size_t size;
+	//SPIR-V is consumed straight from the mapping, it is page aligned so pCode alignment holds
+	Core::Memory::MappedFile shaderFile;
+	const bool mapped = shaderFile.Map(fileName);
+	assert(mapped);
+	assert(shaderFile.GetSize() > 0 && shaderFile.GetSize() % sizeof(uint32_t) == 0);
 
-	FILE *fp = fopen(fileName.c_str(), "rb");
-	assert(fp);
+	return CreateShaderModule(reinterpret_cast<const uint32_t*>(shaderFile.GetData()), shaderFile.GetSize(), device);
+}
 
-	fseek(fp, 0L, SEEK_END);
-	size = ftell(fp);
 
-	fseek(fp, 0L, SEEK_SET);
 
-	//shaderCode = malloc(size);
-	char *shaderCode = new char[size];
-	size_t retval = fread(shaderCode, size, 1, fp);
-	assert(retval == 1);
-	assert(size > 0);
 
-	fclose(fp);
+#endif
 
+VkShaderModule VkTools::CreateShaderModule(const uint32_t* code, size_t codeSize, VkDevice device)
+{
 	VkShaderModule shaderModule;
 	VkShaderModuleCreateInfo moduleCreateInfo;
 	moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	moduleCreateInfo.pNext = NULL;
-	moduleCreateInfo.codeSize = size;
-	moduleCreateInfo.pCode = (uint32_t*)shaderCode;
+	moduleCreateInfo.codeSize = codeSize;
+	moduleCreateInfo.pCode = code;
 	moduleCreateInfo.flags = 0;
 
 	VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
 
-	delete[] shaderCode;
-
 	return shaderModule;
-}
-
-
-
-
-#endif
\ No newline at end of file
+}
\ No newline at end of file
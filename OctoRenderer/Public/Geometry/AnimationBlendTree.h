@@ -0,0 +1,61 @@
+#pragma once
+#include "AnimationSampler.h"
+
+namespace AnimationBlendNodeType
+{
+	enum Enum
+	{
+		//Samples a looping clip
+		kClip,
+
+		//Blends two children by the node weight
+		kLerp,
+
+		//Blends a layer over a base child, scaled per joint by the node mask
+		kLayer
+	};
+};
+
+struct AnimationBlendNode
+{
+	AnimationBlendNodeType::Enum type;
+	float weight = 0.0f;
+
+	//Clip nodes only, seconds of clip time per second
+	float speed = 1.0f;
+	AnimationCursor cursor;
+
+	//Lerp and layer nodes only, base and blended child
+	uint32_t children[2] = { 0u, 0u };
+
+	//Layer nodes only, padded to a multiple of four joints
+	std::vector<float> jointMask;
+};
+
+/*
+	Blend tree of one character.
+	Children are added before their parents, the last added node is the root.
+	Branches with a weight of 0 or 1 skip the child that does not contribute.
+*/
+class AnimationBlendTree
+{
+	public:
+		uint32_t AddClip(const AnimationClip& clip, float speed = 1.0f);
+		uint32_t AddLerp(uint32_t first, uint32_t second, float weight);
+
+		//@param jointMask one weight per joint, joints past its end are not layered
+		uint32_t AddLayer(uint32_t base, uint32_t layer, float weight, const std::vector<float>& jointMask);
+
+		float& GetWeight(uint32_t nodeIdx) { return m_Nodes[nodeIdx].weight; }
+
+		//@param time in seconds since the tree started playing
+		void Evaluate(float time, SkeletonPose& pose);
+
+	private:
+		void EvaluateNode(uint32_t nodeIdx, float time, SkeletonPose& pose);
+
+		std::vector<AnimationBlendNode> m_Nodes;
+
+		//One scratch pose per node, allocated once on the first evaluation
+		std::vector<SkeletonPose> m_NodePoses;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include "JointTransform.h"
+
+//Other
+#include <cstdint>
+#include <vector>
+
+/*
+	Smallest three quaternion, the largest component is dropped and rebuilt from the unit length.
+	The other three lie within +-1/sqrt(2) and are stored in 15 bits each,
+	the top bits of the first two values hold the index of the dropped component.
+*/
+struct PackedQuat
+{
+	uint16_t data[3];
+};
+
+//Key ranges of one joint in the key arrays of the clip
+struct AnimationTrack
+{
+	uint32_t firstRotationKey;
+	uint32_t rotationKeyCount;
+	uint32_t firstTranslationKey;
+	uint32_t translationKeyCount;
+};
+
+/*
+	Joint animation sampled at a fixed frame rate.
+	Every track keeps only the frames needed to stay within the compression error,
+	the first and last frame are always kept unless the track is constant, then its only key is frame 0.
+	Key frames are sorted per track.
+*/
+struct AnimationClip
+{
+	static PackedQuat PackQuat(const glm::quat& q);
+	static glm::quat UnpackQuat(const PackedQuat& packed);
+
+	float GetDuration() const { return frameCount > 1u ? (frameCount - 1u) / frameRate : 0.0f; }
+	uint32_t GetJointCount() const { return static_cast<uint32_t>(tracks.size()); }
+	uint32_t GetKeyCount() const { return static_cast<uint32_t>(rotations.size() + translations.size()); }
+
+	float    frameRate = 30.0f;
+	uint32_t frameCount = 0u;
+
+	std::vector<AnimationTrack> tracks;
+	std::vector<uint16_t>   rotationFrames;
+	std::vector<PackedQuat> rotations;
+	std::vector<uint16_t>   translationFrames;
+	std::vector<glm::vec3>  translations;
+};
+
+struct AnimationCompressionSettings
+{
+	//Largest angle in radians between a dropped rotation key and its interpolation
+	float rotationError = 0.001f;
+
+	//Largest distance between a dropped translation key and its interpolation
+	float translationError = 0.0001f;
+};
+
+struct AnimationClipBuilder
+{
+	/*
+		@param frames local joint transforms, frameCount * jointCount of them ordered by frame
+		@return false if there are no frames or more than 65536 of them
+	*/
+	static bool Build(const std::vector<JointQuat>& frames, uint32_t jointCount, float frameRate,
+		const AnimationCompressionSettings& settings, AnimationClip& clip);
+};
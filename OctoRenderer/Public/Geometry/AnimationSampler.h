@@ -0,0 +1,46 @@
+#pragma once
+#include "AnimationClip.h"
+#include "Skeleton.h"
+
+/*
+	Playback position in one clip.
+	Keys are searched forward from the ones of the last sample, so playing forward
+	touches every key once. Sampling an earlier time starts over from the first keys.
+*/
+struct AnimationCursor
+{
+	void Reset(const AnimationClip& clip);
+
+	const AnimationClip* clip = nullptr;
+	float time = 0.0f;
+
+	//Key before the sampled frame, one per track
+	std::vector<uint32_t> rotationKeys;
+	std::vector<uint32_t> translationKeys;
+};
+
+struct AnimationSampleJob
+{
+	AnimationCursor* cursor;
+	float time;
+	SkeletonPose* pose;
+};
+
+/*
+	Samples clips into SkeletonPoses and blends poses.
+	Keys are decoded per joint, the interpolation runs on four joints at once with SSE2.
+*/
+struct AnimationSampler
+{
+	//@param time in seconds, clamped to the clip duration
+	static void Sample(AnimationCursor& cursor, float time, SkeletonPose& pose);
+
+	//Jobs share nothing, so callers can split a batch of characters across threads
+	static void SampleBatch(const AnimationSampleJob* jobs, uint32_t jobCount);
+
+	/*
+		Normalized linear interpolation of the rotations and linear interpolation of the translations.
+		@param jointWeights optional per joint factor of the weight, padded like the pose components
+	*/
+	static void Blend(const SkeletonPose& a, const SkeletonPose& b, float weight, const float* jointWeights, SkeletonPose& result);
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include "JointTransform.h"
+
+//Other
+#include <cstdint>
+#include <vector>
+
+/*
+	Joint hierarchy of a skinned mesh.
+	Parents always come before their children, so the hierarchy is evaluated in a single pass.
+*/
+struct Skeleton
+{
+	uint32_t GetJointCount() const { return static_cast<uint32_t>(parents.size()); }
+
+	//-1 for root joints
+	std::vector<int32_t>  parents;
+
+	//Model space to joint space in bind pose
+	std::vector<JointMat> inverseBindPose;
+};
+
+/*
+	Local joint transforms relative to the parent joint.
+	Components are stored in separate arrays padded to a multiple of four joints,
+	so blending and the hierarchy evaluation work on four joints at once.
+*/
+struct SkeletonPose
+{
+	void Resize(uint32_t jointCount);
+
+	void SetJoint(uint32_t jointIdx, const JointQuat& joint);
+	JointQuat GetJoint(uint32_t jointIdx) const;
+
+	uint32_t GetJointCount() const { return jointCount; }
+
+	uint32_t jointCount = 0u;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> translationX, translationY, translationZ;
+};
+
+//Palette entry for dual quaternion skinning, layout of the palette read by skinning.comp (std430)
+struct JointDualQuat
+{
+	//Quaternions as x, y, z, w
+	glm::vec4 real;
+	glm::vec4 dual;
+};
+
+/*
+	Turns poses into skinning palettes.
+	Linear blend palettes are 3x4 row major JointMats, the layout read by skinning.comp.
+	Dual quaternion palettes assume joints without scale.
+*/
+struct SkeletonEvaluator
+{
+	//Model space joint transforms, four joints are converted at once with SSE2
+	static void LocalToModel(const Skeleton& skeleton, const SkeletonPose& pose, std::vector<JointMat>& modelPose);
+
+	static void BuildLinearBlendPalette(const Skeleton& skeleton, const std::vector<JointMat>& modelPose, std::vector<JointMat>& palette);
+	static void BuildDualQuatPalette(const Skeleton& skeleton, const std::vector<JointMat>& modelPose, std::vector<JointDualQuat>& palette);
+};
@@ -4,7 +4,9 @@
 *	This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 #pragma once
+#include <ThirdParty/glm/glm/glm.hpp>
 
+//Whole meshes are cooked with Core::Mesh::TangentGenerator, these are for single triangles and vertices
 
 /*
 	Calculates Tangent and Binormal
@@ -18,7 +20,7 @@
 	glm::vec2 Edge1Uv = uv2 - uv1;
 	glm::vec2 Edge2Uv = uv3 - uv1;
 */
-void TangentAndBinormalCalculator(const glm::vec3& Edge1, const glm::vec3& Edge2, const glm::vec2& Edge1Uv, const glm::vec2& Edge2Uv,  glm::vec3 & n, glm::vec3 & t, glm::vec3 & b)
+inline void TangentAndBinormalCalculator(const glm::vec3& Edge1, const glm::vec3& Edge2, const glm::vec2& Edge1Uv, const glm::vec2& Edge2Uv,  glm::vec3 & n, glm::vec3 & t, glm::vec3 & b)
 {
 	//calculate edges
 	//glm::vec3 Edge1 = v2 - v1;
@@ -48,13 +50,10 @@ void TangentAndBinormalCalculator(const glm::vec3& Edge1, const glm::vec3& Edge2
 
 /*
 	This one uses current calculated normal and tangent to calculate binormal
-	@param: objMesh_t& pMe
-	@param: uint32_t iCurrentIndex
+	@param const glm::vec3& n - normal, glm::vec3& t - tangent, glm::vec3& b - binormal
 */
-void TangentAndBinormalCalculator(objMesh_t& pMesh, uint32_t iCurrentIndex)
+inline void TangentAndBinormalCalculator(const glm::vec3& n, glm::vec3& t, glm::vec3& b)
 {
-	const glm::vec3 & n = pMesh.normals[iCurrentIndex];
-	const glm::vec3 & t = pMesh.tangent[iCurrentIndex];
-	pMesh.tangent[iCurrentIndex] = glm::orthonormalize(t, n);
-	pMesh.binormal[iCurrentIndex] = (glm::cross(pMesh.tangent[iCurrentIndex], n));
-}
\ No newline at end of file
+	t = glm::normalize(t - n * glm::dot(n, t));
+	b = glm::cross(t, n);
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include "OctoCore/Public/DODResource.h"
+
+//Vulkan
+#include <ThirdParty/vulkan/vulkan.h>
+
+//Other
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+namespace Renderer
+{
+	namespace RenderGraphAccess
+	{
+		enum Enum
+		{
+			kColorAttachment = 0x01u,
+			kDepthAttachment = 0x02u,
+			kSampled = 0x04u,
+			kStorageRead = 0x08u,
+			kStorageWrite = 0x10u,
+			kUniformRead = 0x20u,
+			kIndirectRead = 0x40u,
+			kVertexRead = 0x80u,
+			kTransferRead = 0x100u,
+			kTransferWrite = 0x200u,
+
+			kWriteMask = kColorAttachment | kDepthAttachment | kStorageWrite | kTransferWrite,
+			kAttachmentMask = kColorAttachment | kDepthAttachment
+		};
+	};
+
+	namespace RenderGraphResourceType
+	{
+		enum Enum
+		{
+			kImage,
+			kBuffer
+		};
+	};
+
+	struct RenderGraphResourceUsage
+	{
+		RenderGraphResourceType::Enum type;
+		uint32_t access;
+
+		//Either one resource or one per back buffer
+		std::vector<DOD::Ref> refs;
+
+		//Shader stages for sampled, storage and uniform accesses
+		VkPipelineStageFlags shaderStages;
+
+		//Undefined derives the layout from the access
+		VkImageLayout layout;
+		bool clear;
+
+		const DOD::Ref& GetRef(uint32_t backBufferIndex) const
+		{
+			return refs.size() == 1u ? refs[0] : refs[backBufferIndex];
+		}
+	};
+
+	struct RenderGraphPass
+	{
+		std::string name;
+		std::function<void(float)> execute;
+
+		//Graphics passes get their attachment load/store ops and layouts patched on compile,
+		//attachment usages have to be declared in render pass attachment order
+		DOD::Ref renderPassRef;
+
+		std::vector<RenderGraphResourceUsage> usages;
+		bool hasSideEffects = false;
+		bool culled = false;
+	};
+
+	/*
+		Frame graph of the render process.
+		Passes declare how they access ImageManager and BufferObjectManager resources,
+		Compile() culls passes nobody consumes and derives attachment load/store ops,
+		Execute() records the passes with the minimal set of barriers in between.
+	*/
+	struct RenderGraph
+	{
+			static uint32_t AddPass(const std::string& name, std::function<void(float)> execute, const DOD::Ref& renderPassRef = DOD::Ref());
+
+			static void AddImageUsage(uint32_t passIdx, const std::vector<DOD::Ref>& imageRefs, uint32_t access,
+				VkPipelineStageFlags shaderStages = 0u, VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED, bool clear = false);
+
+			static void AddBufferUsage(uint32_t passIdx, const std::vector<DOD::Ref>& bufferRefs, uint32_t access,
+				VkPipelineStageFlags shaderStages = 0u);
+
+			//Outputs outlive the frame, they are always stored and their writers never culled
+			static void MarkOutput(const std::vector<DOD::Ref>& imageRefs);
+			static void MarkPassSideEffects(uint32_t passIdx);
+
+			static void Compile();
+			static void Execute(float dt);
+			static void Reset();
+
+			//Call after the swapchain resize recreated the resolution dependent images
+			static void Resize();
+
+			static bool IsPassCulled(uint32_t passIdx)
+			{
+				return m_Passes[passIdx].culled;
+			}
+
+			//First and last pass using the image, transient images share memory if these do not overlap
+			static bool GetImageLifetime(const DOD::Ref& imageRef, uint32_t& firstPass, uint32_t& lastPass);
+			static bool IsTransientImage(const DOD::Ref& imageRef);
+
+		private:
+			struct ResourceState
+			{
+				VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+				VkPipelineStageFlags writeStages = 0u;
+				VkAccessFlags writeAccess = 0u;
+
+				//Reads since the last write, writers have to wait on them
+				VkPipelineStageFlags readStages = 0u;
+
+				//Stage/access pairs that already see the last write
+				VkPipelineStageFlags visibleStages = 0u;
+				VkAccessFlags visibleAccess = 0u;
+			};
+
+			struct ResourceLifetime
+			{
+				uint32_t firstPass;
+				uint32_t lastPass;
+				bool transient;
+
+				//All accesses of the alive passes
+				uint32_t access;
+			};
+
+			static uint64_t GetResourceKey(RenderGraphResourceType::Enum type, const DOD::Ref& ref)
+			{
+				return (static_cast<uint64_t>(type) << 32u) | ref._id;
+			}
+
+			static void InsertBarriers(const RenderGraphPass& pass, uint32_t passIdx);
+			static void PatchRenderPass(const RenderGraphPass& pass, uint32_t passIdx);
+			static void AliasResolutionDependentImages();
+			static void CollectImageAliases();
+
+			static std::vector<RenderGraphPass> m_Passes;
+			static std::vector<uint64_t> m_Outputs;
+			static std::unordered_map<uint64_t, ResourceState> m_ResourceStates;
+			static std::unordered_map<uint64_t, ResourceLifetime> m_ImageLifetimes;
+
+			//Transient images sharing memory with each other
+			static std::unordered_map<uint64_t, std::vector<uint64_t>> m_ImageAliases;
+	};
+}
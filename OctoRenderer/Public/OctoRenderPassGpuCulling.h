@@ -0,0 +1,99 @@
+#pragma once
+#include "OctoCore/Public/DODResource.h"
+
+//Vulkan
+#include <ThirdParty/vulkan/vulkan.h>
+
+//ThirdParty
+#include <ThirdParty/glm/glm/glm.hpp>
+
+//Other
+#include <vector>
+
+namespace Renderer
+{
+	struct RenderPassMesh;
+
+	/*
+		GPU driven culling of the mesh pass instances.
+		Cull() runs before the mesh pass and writes compacted indirect draw commands,
+		visible instances with clusters at LOD 0 are expanded into one command per surviving cluster,
+		BuildHiZ() runs after it and reduces the depth buffer into the Hi-Z pyramid
+		used for occlusion culling in the next frame.
+	*/
+	struct RenderPassGpuCulling
+	{
+			void Init(RenderPassMesh& meshPass);
+
+			//Dispatches bind the Hi-Z levels and the depth buffers RenderGraph::Compile creates
+			void InitAfterCompile(const RenderPassMesh& meshPass);
+			void Destroy();
+
+			//Call after the swapchain resize recreated the Hi-Z pyramid
+			void Resize();
+
+			void Cull(const RenderPassMesh& meshPass);
+			void BuildHiZ(const RenderPassMesh& meshPass);
+
+			//Culling has to be added before the mesh pass, the Hi-Z build after it
+			uint32_t AddCullToRenderGraph(const RenderPassMesh& meshPass);
+			uint32_t AddHiZToRenderGraph(const RenderPassMesh& meshPass);
+
+		protected:
+			//@param cullSource GLSL source compiled into the instance and cluster culling variants
+			bool LoadShaders(const std::string& hizShader, const std::string& cullSource);
+			void CreateHiZImage(const std::string& imageName);
+			void CreateSampler();
+			void CreatePipelineLayouts(const std::string& pipelineLayoutName);
+			void CreatePipelines(const std::string& pipelineName);
+			void CreateBuffers(const std::string& bufferName, uint32_t instanceCount, uint32_t maxDrawCount);
+			void CreateDispatches(const std::string& dispatchName, const RenderPassMesh& meshPass);
+			void CreateHiZLevelDispatches(const std::string& dispatchName);
+
+		private:
+			//Matches CullParams in gpu_cull.comp (std140)
+			struct CullParams
+			{
+				glm::mat4 viewProjection;
+				glm::vec4 frustumPlanes[6];
+				glm::vec4 hizSize;
+
+				//View position and LOD scale
+				glm::vec4 lodParams;
+				uint32_t  instanceCount;
+				uint32_t  hizEnabled;
+				uint32_t  clusterInstanceCount;
+				uint32_t  firstInstanceEnabled;
+			};
+
+			CullParams m_CullParams;
+			bool       m_HiZValid = false;
+
+			DOD::Ref m_HiZShaderRef;
+			DOD::Ref m_CullShaderRef;
+			DOD::Ref m_ClusterCullShaderRef;
+			DOD::Ref m_HiZPipelineLayoutRef;
+			DOD::Ref m_CullPipelineLayoutRef;
+			DOD::Ref m_ClusterCullPipelineLayoutRef;
+			DOD::Ref m_HiZPipelineRef;
+			DOD::Ref m_CullPipelineRef;
+			DOD::Ref m_ClusterCullPipelineRef;
+
+			DOD::Ref m_HiZImageRef;
+			VkSampler m_HiZSampler = VK_NULL_HANDLE;
+
+			//One dispatch per depth buffer for the first level, one per remaining level
+			std::vector<DOD::Ref> m_HiZFirstLevelDispatchRefs;
+			std::vector<DOD::Ref> m_HiZLevelDispatchRefs;
+			DOD::Ref m_CullDispatchRef;
+			DOD::Ref m_ClusterCullDispatchRef;
+
+			//Data
+			DOD::Ref m_CullParamsBufferRef;
+			DOD::Ref m_IndirectBufferRef;
+			DOD::Ref m_DrawCountBufferRef;
+
+			//Per instance, set by the instance culling when its clusters have to be culled
+			DOD::Ref m_InstanceVisibilityBufferRef;
+	};
+}
@@ -1,5 +1,9 @@
 #pragma once
 #include "OctoCore/Public/DODResource.h"
+#include "Vulkan/DrawCallManager.h"
+#include "OctoCore/Public/VertexPacking.h"
+#include "OctoRenderPassSkinning.h"
+#include "Geometry/Skeleton.h"
 
 //Vulkan
 #include <ThirdParty/vulkan/vulkan.h>
@@ -19,20 +23,97 @@
 
 namespace Renderer
 {
+	//Per instance data read by the culling pass and the vertex shader (std430)
+	struct InstanceData
+	{
+		glm::mat4 modelMatrix;
+		glm::vec4 boundingSphere;
+
+		//Range in the LOD buffer, the culling pass picks the index range
+		uint32_t  firstLod;
+		uint32_t  lodCount;
+		int32_t   vertexOffset;
+
+		//Instances with clusters are drawn per cluster whenever LOD 0 is selected
+		uint32_t  clusterCount;
+
+		//Core::Mesh::PositionQuantization of the submesh, w unused
+		glm::vec4 positionOffset;
+		glm::vec4 positionScale;
+	};
+
 	struct RenderPassMesh
 	{
 			void Init();
+
+			//Frame buffers view the images RenderGraph::Compile creates
+			void InitAfterCompile();
 			void Destroy();
 			void Render(float dt, float width, float height);
+			uint32_t AddToRenderGraph();
+
+			//Resolution dependent images are recreated by the render system, only the projection changes
+			void Resize();
+
+			const DOD::Ref& GetDrawCallRef() const { return m_DrawCallRef; }
+			const DOD::Ref& GetInstanceBufferRef() const { return m_InstanceBufferRef; }
+			const DOD::Ref& GetLodBufferRef() const { return m_LodBufferRef; }
+			const DOD::Ref& GetUniformBufferRef() const { return m_UniformBufferRef; }
+			const DOD::Ref& GetBufferLayoutRef() const { return m_BufferLayoutRef; }
+
+			//One instance and cluster index pair per cluster of every instance, the cluster culling threads
+			const DOD::Ref& GetClusterInstanceBufferRef() const { return m_ClusterInstanceBufferRef; }
+
+			//Instance of each culled command, written by the culling pass
+			const DOD::Ref& GetDrawInstanceBufferRef() const { return m_DrawInstanceBufferRef; }
+			uint32_t GetClusterInstanceCount() const { return static_cast<uint32_t>(m_ClusterInstances.size()); }
+			uint32_t GetInstanceCount() const { return static_cast<uint32_t>(m_InstanceData.size()); }
+			const DOD::Ref& GetDepthImageRef(uint32_t backBufferIndex) const { return m_DepthImageRefs[backBufferIndex]; }
+			const std::vector<DOD::Ref>& GetDepthImageRefs() const { return m_DepthImageRefs; }
+			const std::vector<DOD::Ref>& GetColorImageRefs() const { return m_ColorImageRefs; }
+			const DOD::Ref& GetRenderPassRef() const { return m_RenderPassRef; }
+			const Renderer::Resource::DrawPushConstants& GetDrawConstants() const { return m_DrawConstants; }
+
+			//Culling and LOD selection work on the instances before the model matrix of the draw is applied
+			glm::mat4 GetViewProjectionMatrix() const { return m_UboData.projectionMatrix * m_UboData.viewMatrix * m_DrawConstants.modelMatrix; }
+			glm::vec3 GetViewPosition() const { return glm::vec3(glm::inverse(m_UboData.viewMatrix * m_DrawConstants.modelMatrix)[3]); }
+
+			//See DrawCallManager::SelectLods
+			float GetLodScale() const { return m_LodScale; }
+
+			//Skinned meshes are drawn from the streams a RenderPassSkinning writes
+			bool IsSkinned() const { return m_Skeleton.GetJointCount() > 0u; }
+			const Skeleton& GetSkeleton() const { return m_Skeleton; }
+			const SkeletonPose& GetBindPose() const { return m_BindPose; }
+			const DOD::Ref& GetVertexBufferRef() const { return m_StagingBufferVerticesRef; }
+			const DOD::Ref& GetSkinBufferRef() const { return m_SkinBufferRef; }
+			const DOD::Ref& GetSkinnedVertexBufferRef() const { return m_SkinnedVertexBufferRef; }
+			VkDeviceSize GetAttributeStreamOffset() const { return m_VertexStreamOffsets[1]; }
+			uint32_t GetVertexCount() const { return m_VertexCount; }
+			std::vector<SkinningRange> GetSkinningRanges() const;
+
+			//Passes sharing the draw call pick the skinned buffer up if they are created after this
+			void SetSkinnedVertexBuffer(const DOD::Ref& skinnedVertexBufferRef);
 
 		protected:
-			bool LoadShaders(const std::string& vertShader, const std::string& fragShader);
+			bool LoadShaders(const std::string& vertShader, const std::string& fragSource);
+
+			//Streamed through the TextureStreamer, the draw is left untextured if the file is missing
+			bool CreateAlbedoTexture(const std::string& imageName, const std::string& texturePath);
 			void CreatePipelineLayout(const std::string& pipelineLayoutName);
 			void CreateRenderPass(const std::string& renderPassName);
+
+			//Only described, the render graph creates them
+			void CreateImages(const std::string& frameBufferName);
 			void CreateFramBuffer(const std::string& frameBufferName);
 			void CrreateBufferLayout(const std::string& bufferLayoutName);
 			void CreatePipeline(const std::string& pipelineName);
 			void UpdateUniformBufferData();
+			void CreateInstanceData();
+
+			//Cooked mesh written by Core::Mesh::AssimpLoader, the quad is used if there is none
+			bool LoadMesh(const std::string& meshName, const std::string& meshPath);
+			void CreateFallbackMesh(const std::string& meshName);
 
 			DOD::Ref CreateBuffer(const std::string& name, VkBufferUsageFlagBits usage, void* bufferData, int32_t bufferSize);
 			DOD::Ref CreateUniformBuffer(const std::string& name, VkBufferUsageFlagBits usage, void* bufferData, int32_t bufferSize);
@@ -43,19 +124,40 @@ namespace Renderer
 			struct UBO
 			{
 				glm::mat4 projectionMatrix;
-				glm::mat4 modelMatrix;
 				glm::mat4 viewMatrix;
 				glm::vec4 viewPos;
 				float lodBias = 0.0f;
 			};
 
+			//Draw ranges of the loaded mesh, instances pick one of them
+			struct Submesh
+			{
+				glm::vec4 boundingSphere;
+				uint32_t  firstLod;
+				uint32_t  lodCount;
+				int32_t   vertexOffset;
+				uint32_t  vertexCount;
+				uint32_t  firstCluster;
+				uint32_t  clusterCount;
+
+				//Draws decode with the skinned box of skinned meshes, the bind pose box is read by the skinning pass only
+				Core::Mesh::PositionQuantization quantization;
+				Core::Mesh::PositionQuantization bindPoseQuantization;
+			};
+
 			UBO m_UboData;
+			Renderer::Resource::DrawPushConstants m_DrawConstants = {};
+			bool m_UniformBufferDirty = false;
+			float m_LodScale = 1.0f;
+			float m_ProjectionScale = 1.0f;
 
 			DOD::Ref m_VertShaderRef;
 			DOD::Ref m_FragShaderRef;
 			DOD::Ref m_PipeleinLayoutRef;
 			DOD::Ref m_RenderPassRef;
 			std::vector<DOD::Ref> m_FrameBufferRefs;
+			std::vector<DOD::Ref> m_ColorImageRefs;
+			std::vector<DOD::Ref> m_DepthImageRefs;
 			DOD::Ref m_BufferLayoutRef;
 			DOD::Ref m_PipelineRef;
 			DOD::Ref m_DrawCallRef;
@@ -64,5 +166,25 @@ namespace Renderer
 			DOD::Ref m_StagingBufferVerticesRef;
 			DOD::Ref m_StagingBufferIndicesRef;
 			DOD::Ref m_UniformBufferRef;
+			DOD::Ref m_InstanceBufferRef;
+			DOD::Ref m_LodBufferRef;
+			DOD::Ref m_ClusterBufferRef;
+			DOD::Ref m_ClusterInstanceBufferRef;
+			DOD::Ref m_DrawInstanceBufferRef;
+			DOD::Ref m_SkinBufferRef;
+			DOD::Ref m_SkinnedVertexBufferRef;
+			DOD::Ref m_AlbedoImageRef;
+			VkSampler m_AlbedoSampler = VK_NULL_HANDLE;
+			std::vector<InstanceData> m_InstanceData;
+			std::vector<Submesh> m_Submeshes;
+			std::vector<Renderer::Resource::DrawCallLod> m_Lods;
+			std::vector<Renderer::Resource::DrawCallCluster> m_Clusters;
+			std::vector<glm::uvec2> m_ClusterInstances;
+			std::vector<VkDeviceSize> m_VertexStreamOffsets;
+			Skeleton m_Skeleton;
+			SkeletonPose m_BindPose;
+			uint32_t m_VertexCount = 0u;
+			uint32_t m_IndexCount = 0u;
+			VkIndexType m_IndexType = VK_INDEX_TYPE_UINT32;
 	};
 }
\ No newline at end of file
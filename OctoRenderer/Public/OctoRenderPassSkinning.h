@@ -0,0 +1,109 @@
+#pragma once
+#include "OctoCore/Public/DODResource.h"
+#include "Geometry/Skeleton.h"
+#include "OctoCore/Public/VertexPacking.h"
+
+//Vulkan
+#include <ThirdParty/vulkan/vulkan.h>
+
+//Other
+#include <vector>
+
+namespace Renderer
+{
+	namespace SkinningMethod
+	{
+		enum Enum
+		{
+			//Blends 3x4 matrices, collapses around twisting joints
+			kLinearBlend,
+
+			//Blends dual quaternions, keeps the volume but ignores joint scale
+			kDualQuaternion
+		};
+	};
+
+	//Vertices of one submesh, positions are quantized to a box per submesh
+	struct SkinningRange
+	{
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		Core::Mesh::PositionQuantization bindPoseQuantization;
+
+		//Has to hold every pose, positions outside are clamped
+		Core::Mesh::PositionQuantization skinnedQuantization;
+	};
+
+	/*
+		Compute skinning of one skinned mesh.
+		SetPose() evaluates the skeleton on the CPU, Skin() uploads the palette and writes the skinned
+		vertex streams once per frame, so shadow, depth and color passes all draw the same vertices.
+		The pass is culled by the render graph unless some pass reads the skinned vertex buffer.
+	*/
+	struct RenderPassSkinning
+	{
+			/*
+				@param vertexBufferRef Core::Mesh packed streams in bind pose, needs storage buffer usage
+				@param attributeStreamOffset offset of the attribute stream in the vertex buffer
+				@param skinBufferRef one Core::Mesh::PackedSkin per vertex, needs storage buffer usage
+				@param ranges vertex ranges to skin, one dispatch each
+			*/
+			void Init(const Skeleton& skeleton, const DOD::Ref& vertexBufferRef, VkDeviceSize attributeStreamOffset,
+				const DOD::Ref& skinBufferRef, uint32_t vertexCount, SkinningMethod::Enum method, const std::vector<SkinningRange>& ranges);
+			void Destroy();
+
+			//Call once per frame before the render graph executes
+			void SetPose(const SkeletonPose& pose);
+
+			void Skin();
+			uint32_t AddToRenderGraph();
+
+			//Same stream layout as the bind pose vertex buffer, bind it with the same stream offsets
+			const DOD::Ref& GetSkinnedVertexBufferRef() const { return m_SkinnedVertexBufferRef; }
+
+		protected:
+			//@param skinningSource GLSL source, the skinning method picks its variant
+			bool LoadShader(const std::string& skinningSource);
+			void CreatePipelineLayout(const std::string& pipelineLayoutName);
+			void CreatePipeline(const std::string& pipelineName);
+			void CreateBuffers(const std::string& bufferName);
+			void CreateDispatch(const std::string& dispatchName);
+
+		private:
+			//Matches the SkinningParams push constants in skinning.comp
+			struct SkinningParams
+			{
+				uint32_t vertexCount;
+				uint32_t attributeOffset;
+				uint32_t jointCount;
+				uint32_t firstVertex;
+
+				//Core::Mesh::PositionQuantization, w unused
+				glm::vec4 bindPoseOffset;
+				glm::vec4 bindPoseScale;
+				glm::vec4 skinnedOffset;
+				glm::vec4 skinnedScale;
+			};
+
+			Skeleton m_Skeleton;
+			SkinningMethod::Enum m_Method = SkinningMethod::kLinearBlend;
+			std::vector<SkinningParams> m_SkinningParams;
+
+			//Palette of the current pose, only the one of the skinning method is built
+			std::vector<JointMat> m_ModelPose;
+			std::vector<JointMat> m_LinearBlendPalette;
+			std::vector<JointDualQuat> m_DualQuatPalette;
+
+			DOD::Ref m_SkinningShaderRef;
+			DOD::Ref m_PipelineLayoutRef;
+			DOD::Ref m_PipelineRef;
+			std::vector<DOD::Ref> m_DispatchRefs;
+
+			//Data
+			DOD::Ref m_VertexBufferRef;
+			DOD::Ref m_SkinBufferRef;
+			DOD::Ref m_PaletteBufferRef;
+			DOD::Ref m_SkinnedVertexBufferRef;
+			VkDeviceSize m_VertexDataSize = 0u;
+	};
+}
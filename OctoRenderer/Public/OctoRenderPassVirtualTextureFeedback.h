@@ -0,0 +1,88 @@
+#pragma once
+#include "OctoCore/Public/DODResource.h"
+#include "Vulkan/VkEnums.h"
+#include "Vulkan/DrawCallManager.h"
+
+//Vulkan
+#include <ThirdParty/vulkan/vulkan.h>
+
+//ThirdParty
+#include <ThirdParty/glm/glm/glm.hpp>
+
+//Other
+#include <vector>
+
+namespace Renderer
+{
+	struct RenderPassMesh;
+
+	/*
+		Feedback of one virtual texture.
+		Draws the mesh pass geometry into a small R32_UINT target, every texel holds the tile its pixel samples,
+		see virtual_texture.glsl. The target is copied into host visible memory after the pass and handed to
+		Resource::VirtualTextureSystem once the back buffer comes around again, so requests lag a few frames.
+	*/
+	struct RenderPassVirtualTextureFeedback
+	{
+			//Call after the culling pass set up the indirect draws of the mesh pass
+			void Init(RenderPassMesh& meshPass, uint32_t textureId);
+
+			//Frame buffers view the images RenderGraph::Compile creates
+			void InitAfterCompile();
+			void Destroy();
+
+			//Readbacks of the old resolution are dropped
+			void Resize();
+
+			void Render(float dt);
+			void Readback();
+
+			//Has to be added after the mesh pass, reads its indirect draws
+			uint32_t AddToRenderGraph(const RenderPassMesh& meshPass);
+
+		protected:
+			bool LoadShaders(const std::string& vertShader, const std::string& fragShader);
+			void CreateRenderPass(const std::string& renderPassName);
+
+			//Only described, the render graph creates them
+			void CreateImages(const std::string& frameBufferName);
+			void CreateFrameBuffer(const std::string& frameBufferName);
+			void CreatePipeline(const std::string& pipelineName, const RenderPassMesh& meshPass);
+			void CreateReadbackBuffers();
+			void CreateDrawCall(const std::string& name, const RenderPassMesh& meshPass);
+
+		private:
+			//Matches DrawConstants in vt_feedback.vert followed by FeedbackParams in vt_feedback.frag
+			struct FeedbackParams
+			{
+				Renderer::Resource::DrawPushConstants draw;
+				uint32_t textureId;
+				uint32_t pageCount;
+				uint32_t mipCount;
+				float    mipBias;
+			};
+
+			//Host visible copy of one back buffer's feedback
+			struct ReadbackBuffer
+			{
+				VkBuffer buffer;
+				MemoryPoolTypes::GpuMemoryAllocationInfo memoryAllocationInfo;
+
+				//Zero until a copy was recorded for the current resolution
+				glm::uvec2 extent;
+			};
+
+			uint32_t m_TextureId = ~0u;
+
+			DOD::Ref m_VertShaderRef;
+			DOD::Ref m_FragShaderRef;
+			DOD::Ref m_PipelineLayoutRef;
+			DOD::Ref m_RenderPassRef;
+			DOD::Ref m_PipelineRef;
+			DOD::Ref m_DrawCallRef;
+			std::vector<DOD::Ref> m_FrameBufferRefs;
+			std::vector<DOD::Ref> m_FeedbackImageRefs;
+			std::vector<DOD::Ref> m_DepthImageRefs;
+			std::vector<ReadbackBuffer> m_ReadbackBuffers;
+	};
+}
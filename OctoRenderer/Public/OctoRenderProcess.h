@@ -1,5 +1,8 @@
 #pragma once
 #include "OctoRenderPassMesh.h"
+#include "OctoRenderPassSkinning.h"
+#include "OctoRenderPassGpuCulling.h"
+#include "OctoRenderPassVirtualTextureFeedback.h"
 
 namespace Renderer
 {
@@ -9,7 +12,13 @@ namespace Renderer
 			static void Update(float dt);
 			static void Destroy();
 
+			//Swapchain and resolution dependent resources follow the window size
+			static void Resize();
+
 		private:
 			static std::vector<Renderer::RenderPassMesh> m_MeshRenderPasses;
+			static std::vector<Renderer::RenderPassSkinning> m_SkinningPasses;
+			static std::vector<Renderer::RenderPassGpuCulling> m_GpuCullingPasses;
+			static std::vector<Renderer::RenderPassVirtualTextureFeedback> m_VirtualTextureFeedbackPasses;
 	};
 }
\ No newline at end of file
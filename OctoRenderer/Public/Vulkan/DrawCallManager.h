@@ -1,18 +1,73 @@
 #pragma once
 #include <vector>
+#include <cstring>
 #include "ThirdParty/vulkan/vulkan.h"
 #include "OctoCore/Public/DODResource.h"
+#include "VkPipelineManager.h"
+
+//ThirdParty
+#include <ThirdParty/glm/glm/glm.hpp>
 
 namespace Renderer
 {
 	namespace Resource
 	{
 		const uint32_t MAX_DRAW_CALLS = (1024 * 10);
+		const uint32_t ALL_MIP_LEVELS = ~0u;
+		const uint32_t MAX_DRAW_CALL_LODS = 5u;
+
+		//Push constant space every device supports
+		const uint32_t MAX_PUSH_CONSTANT_SIZE = 128u;
+
+		//DrawPushConstants::drawIndex of draws whose instance is gl_InstanceIndex
+		const uint32_t NO_DRAW_INDEX = 0xFFFFFFFFu;
 
 		struct BindingInfo
 		{
 			uint32_t binding_location;
 			DOD::Ref buffer_ref;
+
+			//Used by image descriptors only
+			DOD::Ref image_ref;
+			uint32_t mip_level = ALL_MIP_LEVELS;
+			VkImageLayout image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			VkSampler sampler = VK_NULL_HANDLE;
+		};
+
+		//Index range of one detail level, also the layout of the LOD buffer read by gpu_cull.comp (std430)
+		struct DrawCallLod
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+
+			//Deviation from full detail in object space units
+			float    error;
+			uint32_t padding;
+		};
+
+		//Part of the LOD 0 index range culled on its own, layout of the cluster buffer read by gpu_cull.comp (std430)
+		struct DrawCallCluster
+		{
+			glm::vec4 boundingSphere;
+
+			//Axis and sine of the cone angle, a cutoff of 1 is never back facing
+			glm::vec4 cone;
+
+			uint32_t  firstIndex;
+			uint32_t  indexCount;
+			uint32_t  padding[2];
+		};
+
+		//Common per draw constants, layout of the push_constant block of shaders using them (std430)
+		struct DrawPushConstants
+		{
+			glm::mat4 modelMatrix;
+			uint32_t  objectIndex;
+			uint32_t  materialIndex;
+
+			//Indirect command being drawn, set by the dispatcher when commands can not start at their instance
+			uint32_t  drawIndex;
+			uint32_t  padding;
 		};
 
 		struct DrawCallData : DOD::Resource::ResourceDatabase
@@ -22,25 +77,61 @@ namespace Renderer
 				binding_infos.resize(MAX_DRAW_CALLS);
 				vertex_count.resize(MAX_DRAW_CALLS);
 				index_count.resize(MAX_DRAW_CALLS);
+				first_index.resize(MAX_DRAW_CALLS, 0u);
+				lods.resize(MAX_DRAW_CALLS);
+				bounding_sphere.resize(MAX_DRAW_CALLS, glm::vec4(0.0f));
+				cluster_buffer_ref.resize(MAX_DRAW_CALLS);
+				first_cluster.resize(MAX_DRAW_CALLS, 0u);
+				cluster_count.resize(MAX_DRAW_CALLS, 0u);
 				descriptor_sets.resize(MAX_DRAW_CALLS);
+				push_constants.resize(MAX_DRAW_CALLS);
 				vertex_buffer_ref.resize(MAX_DRAW_CALLS);
+				vertex_stream_offsets.resize(MAX_DRAW_CALLS);
 				index_buffer_ref.resize(MAX_DRAW_CALLS);
+				index_type.resize(MAX_DRAW_CALLS, VK_INDEX_TYPE_UINT32);
 				pipeline_layout_references.resize(MAX_DRAW_CALLS);
 				pipeline_ref.resize(MAX_DRAW_CALLS);
+				indirect_buffer_ref.resize(MAX_DRAW_CALLS);
+				draw_count_buffer_ref.resize(MAX_DRAW_CALLS);
+				max_draw_count.resize(MAX_DRAW_CALLS);
 			}
 
 			std::vector<std::vector<BindingInfo>> binding_infos;
 			std::vector<VkDescriptorSet> descriptor_sets;
 
+			//Pushed from offset 0 before the draw, split over the push constant ranges of the pipeline layout
+			std::vector<std::vector<uint8_t>> push_constants;
+
+
 			std::vector<uint32_t>    vertex_count;
 			std::vector<uint32_t>    index_count;
+			std::vector<uint32_t>    first_index;
+
+			//Detail levels ordered from full to lowest, empty draws the index range as set
+			std::vector<std::vector<DrawCallLod>> lods;
+
+			//World space, used for the LOD distance
+			std::vector<glm::vec4>   bounding_sphere;
+
+			//Cluster ranges, culled per cluster by the culling pass, see DrawCallCluster
+			std::vector<DOD::Ref>	 cluster_buffer_ref;
+			std::vector<uint32_t>	 first_cluster;
+			std::vector<uint32_t>	 cluster_count;
 
 			std::vector<DOD::Ref>	 vertex_buffer_ref;
+
+			//Offset of each vertex stream binding inside the vertex buffer, empty binds one stream at 0
+			std::vector<std::vector<VkDeviceSize>> vertex_stream_offsets;
 			std::vector<DOD::Ref>	 index_buffer_ref;
+			std::vector<VkIndexType> index_type;
 
 			std::vector<DOD::Ref>	 pipeline_layout_references;
 			std::vector<DOD::Ref>    pipeline_ref;
-				
+
+			//GPU driven draws, commands and count are written by the culling pass
+			std::vector<DOD::Ref>	 indirect_buffer_ref;
+			std::vector<DOD::Ref>	 draw_count_buffer_ref;
+			std::vector<uint32_t>	 max_draw_count;
 		};
 
 		struct DrawCallManager : DOD::Resource::ResourceManagerBase<DrawCallData, MAX_DRAW_CALLS>
@@ -59,8 +150,31 @@ namespace Renderer
 				return ref;
 			}
 
+			//Freed ids are handed out again, so everything set per draw call is reset here
 			static void DestroyDrawCall(const DOD::Ref& ref)
 			{
+				const uint32_t id = ref._id;
+				data.binding_infos[id].clear();
+				data.descriptor_sets[id] = VK_NULL_HANDLE;
+				data.push_constants[id].clear();
+				data.vertex_count[id] = 0u;
+				data.index_count[id] = 0u;
+				data.first_index[id] = 0u;
+				data.lods[id].clear();
+				data.bounding_sphere[id] = glm::vec4(0.0f);
+				data.cluster_buffer_ref[id] = DOD::Ref();
+				data.first_cluster[id] = 0u;
+				data.cluster_count[id] = 0u;
+				data.vertex_buffer_ref[id] = DOD::Ref();
+				data.vertex_stream_offsets[id].clear();
+				data.index_buffer_ref[id] = DOD::Ref();
+				data.index_type[id] = VK_INDEX_TYPE_UINT32;
+				data.pipeline_layout_references[id] = DOD::Ref();
+				data.pipeline_ref[id] = DOD::Ref();
+				data.indirect_buffer_ref[id] = DOD::Ref();
+				data.draw_count_buffer_ref[id] = DOD::Ref();
+				data.max_draw_count[id] = 0u;
+
 				DOD::Resource::ResourceManagerBase<
 					DrawCallData, MAX_DRAW_CALLS>::destroyResource(ref);
 			}
@@ -76,8 +190,26 @@ namespace Renderer
 			static void CreateResource(const std::vector<DOD::Ref>& refs);
 			static void DestroyResources(const std::vector<DOD::Ref>& refs);
 
+			//Replaces the descriptor sets after the bound resources got recreated, call DescriptorSetCache::InvalidateImages first
+			static void UpdateResources(const std::vector<DOD::Ref>& refs);
+
 			static void CreateDrawCallForMesh(const DOD::Ref& ref);
 
+			/*
+				Picks the index range of every draw call with LODs for this frame.
+				@param lodScale screen space error of one object space unit at distance one, in pixel thresholds
+			*/
+			static void SelectLods(const std::vector<DOD::Ref>& refs, const glm::vec3& viewPosition, float lodScale);
+
+			//Lowest detail level whose error projects below the threshold, mirrored by gpu_cull.comp
+			static uint32_t SelectLod(const std::vector<DrawCallLod>& lods, float distance, float lodScale);
+
+			/*
+				Asks the TextureStreamer for the mips the streamed textures bound by the draw calls need this frame.
+				@param projectionScale pixels covered by one object space unit at distance one
+			*/
+			static void RequestTextureMips(const std::vector<DOD::Ref>& refs, const glm::vec3& viewPosition, float projectionScale);
+
 			static std::vector<BindingInfo>& GetBindingInfo(const DOD::Ref& ref)
 			{
 				return data.binding_infos[ref._id];
@@ -88,6 +220,22 @@ namespace Renderer
 				return data.descriptor_sets[ref._id];
 			}
 
+			static std::vector<uint8_t>& GetPushConstants(const DOD::Ref& ref)
+			{
+				return data.push_constants[ref._id];
+			}
+
+			//Changes need no descriptor update, the constants are recorded along with the draw
+			template<typename T>
+			static void SetPushConstants(const DOD::Ref& ref, const T& constants)
+			{
+				static_assert(sizeof(T) <= MAX_PUSH_CONSTANT_SIZE && sizeof(T) % 4u == 0u, "Push constants have to fit the guaranteed space in whole uints");
+
+				std::vector<uint8_t>& push_constants = data.push_constants[ref._id];
+				push_constants.resize(sizeof(T));
+				memcpy(push_constants.data(), &constants, sizeof(T));
+			}
+
 			static DOD::Ref& GetPipelineLayoutRef(const DOD::Ref& ref)
 			{
 				return data.pipeline_layout_references[ref._id];
@@ -98,16 +246,32 @@ namespace Renderer
 				return data.pipeline_ref[ref._id];
 			}
 
+			//Not ready while the pipeline compiles, the draw then uses the fallback pipeline or is skipped
+			static bool IsPipelineReady(const DOD::Ref& ref)
+			{
+				return PipelineManager::GetState(data.pipeline_ref[ref._id]) == PipelineState::kReady;
+			}
+
 			static DOD::Ref& GetVertexBufferRef(const DOD::Ref& ref)
 			{
 				return data.vertex_buffer_ref[ref._id];
 			}
 
+			static std::vector<VkDeviceSize>& GetVertexStreamOffsets(const DOD::Ref& ref)
+			{
+				return data.vertex_stream_offsets[ref._id];
+			}
+
 			static DOD::Ref& GetIndexBufferRef(const DOD::Ref& ref)
 			{
 				return data.index_buffer_ref[ref._id];
 			}
 
+			static VkIndexType& GetIndexType(const DOD::Ref& ref)
+			{
+				return data.index_type[ref._id];
+			}
+
 			static uint32_t& GetVertexCount(const DOD::Ref& ref)
 			{
 				return data.vertex_count[ref._id];
@@ -118,6 +282,51 @@ namespace Renderer
 				return data.index_count[ref._id];
 			}
 
+			static uint32_t& GetFirstIndex(const DOD::Ref& ref)
+			{
+				return data.first_index[ref._id];
+			}
+
+			static std::vector<DrawCallLod>& GetLods(const DOD::Ref& ref)
+			{
+				return data.lods[ref._id];
+			}
+
+			static glm::vec4& GetBoundingSphere(const DOD::Ref& ref)
+			{
+				return data.bounding_sphere[ref._id];
+			}
+
+			static DOD::Ref& GetClusterBufferRef(const DOD::Ref& ref)
+			{
+				return data.cluster_buffer_ref[ref._id];
+			}
+
+			static uint32_t& GetFirstCluster(const DOD::Ref& ref)
+			{
+				return data.first_cluster[ref._id];
+			}
+
+			static uint32_t& GetClusterCount(const DOD::Ref& ref)
+			{
+				return data.cluster_count[ref._id];
+			}
+
+			static DOD::Ref& GetIndirectBufferRef(const DOD::Ref& ref)
+			{
+				return data.indirect_buffer_ref[ref._id];
+			}
+
+			static DOD::Ref& GetDrawCountBufferRef(const DOD::Ref& ref)
+			{
+				return data.draw_count_buffer_ref[ref._id];
+			}
+
+			static uint32_t& GetMaxDrawCount(const DOD::Ref& ref)
+			{
+				return data.max_draw_count[ref._id];
+			}
+
 		};
 	}
 }
\ No newline at end of file
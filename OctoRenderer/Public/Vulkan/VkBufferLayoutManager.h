@@ -19,11 +19,18 @@ namespace Renderer
 			TEX
 		};
 
+		/*
+			Attributes are packed in description order within their binding,
+			offsets and strides follow from the formats.
+		*/
 		struct BufferLayoutDescription
 		{
 			uint32_t location;
 			BufferObjectType type;
 			VkFormat format;
+
+			//Vertex stream, split streams are bound from the draw call vertex stream offsets
+			uint32_t binding = 0u;
 		};
 
 		struct BufferLayoutData : DOD::Resource::ResourceDatabase
@@ -37,7 +44,7 @@ namespace Renderer
 			}
 
 			std::vector<VkPipelineVertexInputStateCreateInfo> input_states;
-			std::vector<VkVertexInputBindingDescription> binding_descriptions;
+			std::vector<std::vector<VkVertexInputBindingDescription>> binding_descriptions;
 			std::vector<std::vector<VkVertexInputAttributeDescription>> attribute_descriptions;
 			std::vector<std::vector<BufferLayoutDescription>> buffer_layout_description;
 		};
@@ -69,6 +76,9 @@ namespace Renderer
 			}
 
 			static void CreateResource(const DOD::Ref& ref);
+
+			//Only attributes the vertex shader reads are passed to the pipeline, the streams keep their full stride
+			static void CreateResource(const DOD::Ref& ref, const DOD::Ref& vertexShaderRef);
 			static void DestroyResources(const std::vector<DOD::Ref>& refs);
 
 			static VkPipelineVertexInputStateCreateInfo& GetVertexInput(const DOD::Ref& ref)
@@ -76,7 +86,7 @@ namespace Renderer
 				return data.input_states[ref._id];
 			}
 
-			static VkVertexInputBindingDescription& GetBindingDescription(const DOD::Ref& ref)
+			static std::vector<VkVertexInputBindingDescription>& GetBindingDescriptions(const DOD::Ref& ref)
 			{
 				return data.binding_descriptions[ref._id];
 			}
@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include "ThirdParty/vulkan/vulkan.h"
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		//Sets of the first pool of a signature, every further pool doubles up to the maximum
+		const uint32_t DESCRIPTOR_POOL_FIRST_CHUNK_SETS = 16u;
+		const uint32_t DESCRIPTOR_POOL_MAX_CHUNK_SETS = 1024u;
+
+		struct DescriptorPoolChunk
+		{
+			VkDescriptorPool pool;
+			uint32_t maxSets;
+			uint32_t allocatedSets;
+		};
+
+		//Pools shared by all set layouts with the same descriptor counts
+		struct DescriptorPoolSignature
+		{
+			std::vector<VkDescriptorPoolSize> setSizes;
+			std::vector<DescriptorPoolChunk> chunks;
+
+			//Per back buffer, reset as a whole once the back buffer comes around
+			std::vector<std::vector<DescriptorPoolChunk>> transientChunks;
+			std::vector<uint32_t> transientChunkIdx;
+		};
+
+		//Set freed while frames in flight may still bind it
+		struct RetiredDescriptorSet
+		{
+			uint32_t signatureIdx;
+			VkDescriptorPool pool;
+			VkDescriptorSet set;
+		};
+
+		/*
+			Hands out descriptor sets from pools grouped by layout signature.
+			Persistent sets come from pools that allow freeing single sets, freed sets make room for the next allocation
+			once the back buffer they were freed in comes around again.
+			Transient sets live for one frame only, their pools are reset in BeginFrame instead of freeing sets.
+			A new pool is added to the signature whenever the existing ones are exhausted.
+		*/
+		struct DescriptorAllocator
+		{
+			static void Init();
+			static void Destroy();
+
+			//@return index of the signature matching the descriptor counts of the bindings
+			static uint32_t GetSignature(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+			//@param pool receives the pool of the set, needed to free it again
+			static VkDescriptorSet Allocate(uint32_t signatureIdx, VkDescriptorSetLayout layout, VkDescriptorPool& pool);
+
+			//Frames in flight may still use the set, it is returned to its pool once this back buffer comes around
+			static void Free(uint32_t signatureIdx, VkDescriptorPool pool, VkDescriptorSet set);
+
+			//Valid until this back buffer gets rendered again
+			static VkDescriptorSet AllocateTransient(uint32_t signatureIdx, VkDescriptorSetLayout layout);
+
+			//Resets the transient pools of the back buffer and frees the sets retired in it, its fence has to be waited on
+			static void BeginFrame(uint32_t backBufferIndex);
+
+		private:
+			static void FreeRetired(const RetiredDescriptorSet& retired);
+
+			static DescriptorPoolChunk CreateChunk(const DescriptorPoolSignature& signature, uint32_t chunkIdx, bool transient);
+			static bool TryAllocate(DescriptorPoolChunk& chunk, VkDescriptorSetLayout layout, VkDescriptorSet& set);
+
+			static std::vector<DescriptorPoolSignature> signatures;
+			static std::vector<std::vector<RetiredDescriptorSet>> retiredSets;
+			static uint32_t currentBackBufferIndex;
+		};
+	}
+}
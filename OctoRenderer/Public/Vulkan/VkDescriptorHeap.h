@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <unordered_set>
+#include "ThirdParty/vulkan/vulkan.h"
+#include "OctoCore/Public/DODResource.h"
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		const uint32_t MAX_HEAP_IMAGE_COUNT = 4096u;
+		const uint32_t MAX_HEAP_BUFFER_COUNT = 4096u;
+		const uint32_t INVALID_HEAP_INDEX = ~0u;
+
+		//Set of the heap in pipeline layouts reading it, set 0 stays the per draw set
+		const uint32_t DESCRIPTOR_HEAP_SET = 1u;
+
+		namespace DescriptorHeapBinding
+		{
+			enum Enum
+			{
+				//Combined image samplers, heapImages in descriptor_heap.glsl
+				kImages,
+
+				//Storage buffers, DESCRIPTOR_HEAP_BUFFER in descriptor_heap.glsl
+				kBuffers,
+
+				kCount
+			};
+		};
+
+		/*
+			One descriptor set holding every registered image and storage buffer, bound once per draw next to the per draw set.
+			Shaders index it with the slot returned on registration, passed in through per draw data.
+			Slots are written after the set got bound, so registering never waits on the GPU.
+			Without VK_EXT_descriptor_indexing IsSupported() is false and resources stay in the per draw sets.
+		*/
+		struct DescriptorHeap
+		{
+			static void Init();
+			static void Destroy();
+
+			static bool IsSupported()
+			{
+				return vkDescriptorSet != VK_NULL_HANDLE;
+			}
+
+			//@return slot of the image in heapImages, INVALID_HEAP_INDEX if the heap is full
+			static uint32_t RegisterImage(const DOD::Ref& imageRef, VkSampler sampler, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			static uint32_t RegisterBuffer(const DOD::Ref& bufferRef);
+
+			//Frames in flight may still read the slot, it is handed out again once this back buffer comes around
+			static void ReleaseImage(uint32_t index);
+			static void ReleaseBuffer(uint32_t index);
+
+			//Recycles the slots released the last time this back buffer was recorded, its fence has to be waited on
+			static void BeginFrame(uint32_t backBufferIndex);
+
+			//Rewrites the slots of images whose views got recreated, frames in flight must not read them anymore
+			static void UpdateImages(const std::unordered_set<uint32_t>& imageIds);
+
+			static VkDescriptorSetLayout GetDescriptorSetLayout()
+			{
+				return vkDescriptorSetLayout;
+			}
+
+			static VkDescriptorSet GetDescriptorSet()
+			{
+				return vkDescriptorSet;
+			}
+
+		private:
+			struct ImageSlot
+			{
+				DOD::Ref imageRef;
+				VkSampler sampler;
+				VkImageLayout imageLayout;
+			};
+
+			static void WriteImage(uint32_t index);
+			static void WriteBuffer(uint32_t index);
+			static uint32_t AcquireSlot(std::vector<uint32_t>& freeSlots);
+
+			static VkDescriptorSetLayout vkDescriptorSetLayout;
+			static VkDescriptorPool vkDescriptorPool;
+			static VkDescriptorSet vkDescriptorSet;
+
+			static std::vector<ImageSlot> imageSlots;
+			static std::vector<DOD::Ref> bufferSlots;
+			static std::vector<uint32_t> freeSlots[DescriptorHeapBinding::kCount];
+
+			//Released slots per back buffer and binding
+			static std::vector<std::vector<uint32_t>> retiredSlots[DescriptorHeapBinding::kCount];
+			static uint32_t currentBackBufferIndex;
+		};
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ThirdParty/vulkan/vulkan.h"
+#include "OctoCore/Public/DODResource.h"
+
+//BindingInfo
+#include "DrawCallManager.h"
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		//Sets nobody references anymore are kept for reuse up to this count, the least recently released are evicted first
+		const uint32_t MAX_UNUSED_DESCRIPTOR_SETS = 256u;
+
+		struct DescriptorSetCacheEntry
+		{
+			DOD::Ref pipelineLayoutRef;
+			std::vector<BindingInfo> bindingInfos;
+			size_t hash;
+
+			VkDescriptorPool pool;
+			uint32_t signatureIdx;
+			uint32_t refCount;
+
+			//Points at replaced resources, no longer handed out and freed once released
+			bool stale;
+
+			//Position in the unused list, only valid while refCount is 0
+			std::list<VkDescriptorSet>::iterator unusedIt;
+		};
+
+		/*
+			Shares descriptor sets between users binding the same resources with the same pipeline layout.
+			Sets are reference counted, unreferenced sets stay cached until they get evicted in LRU order.
+			Binding infos of an acquired set must not change, sets of recreated resources are replaced instead of rewritten.
+		*/
+		struct DescriptorSetCache
+		{
+			//Forgets every cached set, their pools get destroyed by the DescriptorAllocator
+			static void Destroy();
+
+			static VkDescriptorSet Acquire(const DOD::Ref& pipelineLayoutRef, const std::vector<BindingInfo>& bindingInfos);
+			static void Release(VkDescriptorSet descriptorSet);
+
+			//Sets pointing at recreated images are no longer handed out, users acquire new ones and release the stale sets
+			static void InvalidateImages(const std::unordered_set<uint32_t>& imageIds);
+
+		private:
+			static size_t Hash(const DOD::Ref& pipelineLayoutRef, const std::vector<BindingInfo>& bindingInfos);
+			static bool Equal(const DescriptorSetCacheEntry& entry, const DOD::Ref& pipelineLayoutRef, const std::vector<BindingInfo>& bindingInfos);
+			static void Evict(VkDescriptorSet descriptorSet);
+			static void RemoveLookup(VkDescriptorSet descriptorSet, size_t hash);
+
+			static std::unordered_map<VkDescriptorSet, DescriptorSetCacheEntry> entries;
+			static std::unordered_multimap<size_t, VkDescriptorSet> lookup;
+
+			//Oldest release first
+			static std::list<VkDescriptorSet> unused;
+		};
+	}
+}
@@ -8,6 +8,9 @@ namespace Renderer
 		struct DrawCall
 		{
 			static void QueuDrawCall(const DOD::Ref& ref, const DOD::Ref& frameBuffer, const DOD::Ref& renderPass, int width, int height);
+
+			//Has to be queued outside of a render pass
+			static void QueueDispatch(const DOD::Ref& ref, uint32_t groupCountX, uint32_t groupCountY = 1u, uint32_t groupCountZ = 1u);
 		};
 	}
 }
\ No newline at end of file
@@ -11,7 +11,9 @@ namespace AttachementFlags
 	enum Enum
 	{
 		kClearOnLoad = 0x01u,
-		kClearStencilOnLoad = 0x02u
+		kClearStencilOnLoad = 0x02u,
+		kLoadOnLoad = 0x04u,
+		kDiscardOnStore = 0x08u
 	};
 }
 
@@ -20,6 +22,10 @@ struct AttachementDescription
 	VkFormat format;
 	uint8_t flags;
 	bool  depthFormat;
+
+	//Undefined keeps the default present/depth attachment layout
+	VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 };
 
 namespace ImageFlags
@@ -32,7 +38,13 @@ namespace ImageFlags
 
 		kUsageAttachment = 0x08u,
 		kUsageSampled = 0x10u,
-		kUsageStorage = 0x20u
+		kUsageStorage = 0x20u,
+
+		//Contents never leave the render pass, can be backed by lazily allocated memory
+		kUsageTransient = 0x40u,
+
+		//Mip level count follows the dimensions
+		kFullMipChain = 0x80u
 	};
 };
 namespace ImageType
@@ -71,11 +83,15 @@ namespace MemoryPoolTypes
 		kStaticStagingBuffers,
 
 		kResolutionDependentImages,
+		kResolutionDependentTransientImages,
 		kResolutionDependentBuffers,
 		kResolutionDependentStagingBuffers,
 
 		kVolatileStagingBuffers,
 
+		//Freed one allocation at a time, see GpuMemoryManager::Free()
+		kStreamedImages,
+
 		kCount,
 
 		kRangeStartStatic = kStaticImages,
@@ -83,7 +99,9 @@ namespace MemoryPoolTypes
 		kRangeStartResolutionDependent = kResolutionDependentImages,
 		kRangeEndResolutionDependent = kResolutionDependentStagingBuffers,
 		kRangeStartVolatile = kVolatileStagingBuffers,
-		kRangeEndVolatile = kVolatileStagingBuffers
+		kRangeEndVolatile = kVolatileStagingBuffers,
+		kRangeStartStreamed = kStreamedImages,
+		kRangeEndStreamed = kStreamedImages
 	};
 
 	struct GpuMemoryAllocationInfo
@@ -105,6 +123,7 @@ namespace MemoryLocation
 	{
 		kDeviceLocal,
 		kHostVisible,
+		kLazilyAllocated,
 		kCount
 	};
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <vector>
 #include "ThirdParty\vulkan\vulkan.h"
 #include "VkEnums.h"
+#include "ThirdParty/glm/glm/vec2.hpp"
 
 //Core
 #include "OctoCore/Public/LinearAllocator.h"
@@ -18,6 +19,19 @@ namespace Renderer
 			VkDeviceMemory _vkDeviceMemory;
 			uint8_t* _mappedMemory;
 			uint32_t _memoryTypeIdx;
+
+			//Offset and size of ranges given back by GpuMemoryManager::Free(), sorted by offset
+			std::vector<glm::uvec2> _freeRanges;
+		};
+
+		//Memory range shared by allocations whose lifetimes do not overlap
+		struct GpuMemoryAliasSlot
+		{
+			uint32_t _pageIdx;
+			uint32_t _offset;
+			uint32_t _sizeInBytes;
+			uint32_t _memoryTypeIdx;
+			std::vector<glm::uvec2> _lifetimes;
 		};
 
 		struct GpuMemoryManager
@@ -26,8 +40,25 @@ namespace Renderer
 			static void Destroy();
 			static MemoryPoolTypes::GpuMemoryAllocationInfo AllocateOffset(MemoryPoolTypes::Enum poolType, uint32_t size, uint32_t allignement, uint32_t memoryFlags);
 
+			/*
+				Lifetime is the first and last pass using the allocation within a frame,
+				memory of an allocation that is not alive anymore gets handed out again.
+			*/
+			static MemoryPoolTypes::GpuMemoryAllocationInfo AllocateAliasedOffset(MemoryPoolTypes::Enum poolType, uint32_t size, uint32_t allignement, uint32_t memoryFlags, const glm::uvec2& lifetime);
+
+			//Pages are kept, all offsets handed out from the pool become invalid
+			static void ResetPool(MemoryPoolTypes::Enum poolType);
+
+			//Streamed pools only, the range is handed out again before the pool grows
+			static void Free(const MemoryPoolTypes::GpuMemoryAllocationInfo& allocationInfo);
+
+			static bool SupportsMemoryLocation(MemoryLocation::Enum memoryLocation, uint32_t memoryFlags);
+
 		private:
+			static bool AllocateFreeRange(GpuMemoryPage& page, uint32_t size, uint32_t allignement, uint32_t& offset);
+
 			static std::vector<GpuMemoryPage> memoryPools[MemoryPoolTypes::kCount];
+			static std::vector<GpuMemoryAliasSlot> aliasSlots[MemoryPoolTypes::kCount];
 			static MemoryLocation::Enum memoryPoolToMemoryLocation[MemoryPoolTypes::kCount];
 			static uint32_t memoryLocationToMemoryPropertyFlags[MemoryLocation::kCount];
 		};
@@ -1,7 +1,10 @@
 #pragma once
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include "ThirdParty\vulkan\vulkan.h"
 #include "OctoCore/Public/DODResource.h"
+#include "VkShaderReflection.h"
 
 namespace Renderer
 {
@@ -9,16 +12,67 @@ namespace Renderer
 	{
 		const uint32_t MAX_GPU_PROGRAMS = 1024u;
 
+		/*
+			Feature bits of a shader source, e.g. skinned, alpha test or normal map.
+			Specialized features become the bool specialization constant with constant_id = bit and share one SPIR-V,
+			the others are compiled as defines named by features[bit] into Cache/ next to the shaders.
+		*/
+		struct ShaderPermutation
+		{
+			std::string source;
+			VkShaderStageFlagBits stage;
+			std::vector<std::string> features;
+			uint32_t specializedFeatures = 0u;
+		};
+
+		//Where a variant of GetVariant() comes from, the source stays empty for programs loaded by name
+		struct ShaderVariantInfo
+		{
+			ShaderPermutation permutation;
+			uint32_t featureMask = 0u;
+			std::string filePath;
+			std::string spirvPath;
+
+			//Source and every file it includes, relative to filePath
+			std::vector<std::string> dependencies;
+		};
+
+		//Programs with the same SPIR-V share their module
+		struct SharedShaderModule
+		{
+			VkShaderModule module;
+			uint32_t refCount;
+		};
+
 		struct GpuProgramData : DOD::Resource::ResourceDatabase
 		{
 			GpuProgramData(): ResourceDatabase(MAX_GPU_PROGRAMS)
 			{
 				shader_stage_create_info.resize(MAX_GPU_PROGRAMS);
 				shader_modules.resize(MAX_GPU_PROGRAMS);
+				reflections.resize(MAX_GPU_PROGRAMS);
+				spirv_hashes.resize(MAX_GPU_PROGRAMS, 0u);
+				specialization_entries.resize(MAX_GPU_PROGRAMS);
+				specialization_data.resize(MAX_GPU_PROGRAMS);
+				specialization_infos.resize(MAX_GPU_PROGRAMS);
+				variants.resize(MAX_GPU_PROGRAMS);
 			}
 
 			std::vector<VkPipelineShaderStageCreateInfo> shader_stage_create_info;
 			std::vector<VkShaderModule> shader_modules;
+
+			//Interface of the SPIR-V, filled by LoadAndCompileShader
+			std::vector<ShaderReflection> reflections;
+
+			//Key of the shared module, 0 if the module is not shared
+			std::vector<uint64_t> spirv_hashes;
+
+			//Referenced by the shader stage of permutation variants, one uint32_t per constant
+			std::vector<std::vector<VkSpecializationMapEntry>> specialization_entries;
+			std::vector<std::vector<uint32_t>> specialization_data;
+			std::vector<VkSpecializationInfo> specialization_infos;
+
+			std::vector<ShaderVariantInfo> variants;
 		};
 
 		struct GpuProgramManager : DOD::Resource::ResourceManagerBase<GpuProgramData, MAX_GPU_PROGRAMS>
@@ -47,8 +101,27 @@ namespace Renderer
 				return ref;
 			}
 
+			//Loads file_path + name, a program already loaded keeps its old module if loading fails
 			static bool LoadAndCompileShader(const DOD::Ref& ref, std::string file_path, VkShaderStageFlagBits stage);
 
+			/*
+				Variant of the permutation with the features of the mask, compiled on first use and cached in memory and on disk.
+				@param file_path directory of the source, with trailing slash
+				@return invalid ref if the variant could not be compiled
+			*/
+			static DOD::Ref GetVariant(const ShaderPermutation& permutation, uint32_t featureMask, const std::string& file_path);
+
+			//Compiles the variant again if its source or one of its includes is newer than the cached SPIR-V
+			static bool CompileVariant(const DOD::Ref& ref);
+
+			//Loads the compiled SPIR-V of the variant, the old module is kept if loading fails
+			static bool LoadVariant(const DOD::Ref& ref);
+
+			static bool IsVariant(const DOD::Ref& ref)
+			{
+				return !data.variants[ref._id].permutation.source.empty();
+			}
+
 			static VkPipelineShaderStageCreateInfo& GetShaderStageCreateInfo(const DOD::Ref& ref)
 			{
 				return data.shader_stage_create_info[ref._id];
@@ -59,12 +132,51 @@ namespace Renderer
 				return data.shader_modules[ref._id];
 			}
 
+			static ShaderReflection& GetReflection(const DOD::Ref& ref)
+			{
+				return data.reflections[ref._id];
+			}
+
+			static uint64_t& GetSpirvHash(const DOD::Ref& ref)
+			{
+				return data.spirv_hashes[ref._id];
+			}
+
+			static std::vector<VkSpecializationMapEntry>& GetSpecializationEntries(const DOD::Ref& ref)
+			{
+				return data.specialization_entries[ref._id];
+			}
+
+			static std::vector<uint32_t>& GetSpecializationData(const DOD::Ref& ref)
+			{
+				return data.specialization_data[ref._id];
+			}
+
+			static VkSpecializationInfo& GetSpecializationInfo(const DOD::Ref& ref)
+			{
+				return data.specialization_infos[ref._id];
+			}
+
+			static ShaderVariantInfo& GetVariantInfo(const DOD::Ref& ref)
+			{
+				return data.variants[ref._id];
+			}
+
 			static void DestroyAllGpuResources()
 			{
 				DestroyResources(activeRefs);
 			}
 
 			static void DestroyResources(const std::vector<DOD::Ref>& refs);
+
+		private:
+			static bool LoadShaderFile(const DOD::Ref& ref, const std::string& path, VkShaderStageFlagBits stage);
+			static bool CompileVariant(ShaderVariantInfo& variant);
+			static void CollectIncludes(const std::string& file_path, const std::string& name, std::vector<std::string>& files);
+			static void SetSpecialization(const DOD::Ref& ref, const ShaderPermutation& permutation, uint32_t specializedMask);
+			static void ReleaseModule(const DOD::Ref& ref);
+
+			static std::unordered_map<uint64_t, SharedShaderModule> modules;
 		};
 	}
 }
\ No newline at end of file
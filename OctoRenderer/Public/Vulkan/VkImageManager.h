@@ -3,12 +3,16 @@
 #include "ThirdParty/vulkan/vulkan.h"
 #include "VkEnums.h"
 #include "OctoCore/Public/DODResource.h"
+#include "ThirdParty/glm/glm/vec2.hpp"
 #include "ThirdParty/glm/glm/vec3.hpp"
 
 namespace Renderer
 {
 	const uint32_t _INTR_MAX_IMAGE_COUNT = 1024u;
 
+	//Alive for the whole frame, the memory is never shared
+	const glm::uvec2 ALIASING_LIFETIME_FRAME = glm::uvec2(0u, ~0u);
+
 	namespace Resource
 	{
 		typedef std::vector<std::vector<VkImageView>> ImageViewArray;
@@ -26,11 +30,17 @@ namespace Renderer
 				descArrayLayerCount.resize(_INTR_MAX_IMAGE_COUNT);
 				descMipLevelCount.resize(_INTR_MAX_IMAGE_COUNT);
 				descFileName.resize(_INTR_MAX_IMAGE_COUNT);
+				descAliasingLifetime.resize(_INTR_MAX_IMAGE_COUNT);
+				descResolutionScale.resize(_INTR_MAX_IMAGE_COUNT);
 
 				vkImage.resize(_INTR_MAX_IMAGE_COUNT);
 				vkImageView.resize(_INTR_MAX_IMAGE_COUNT);
 				vkSubResourceImageViews.resize(_INTR_MAX_IMAGE_COUNT);
 				memoryAllocationInfo.resize(_INTR_MAX_IMAGE_COUNT);
+
+				streamingResidentMip.resize(_INTR_MAX_IMAGE_COUNT);
+				streamingRequestedMip.resize(_INTR_MAX_IMAGE_COUNT);
+				streamingLastUsedFrame.resize(_INTR_MAX_IMAGE_COUNT);
 			}
 
 			// Description
@@ -44,11 +54,23 @@ namespace Renderer
 			std::vector<uint32_t> descMipLevelCount;
 			std::vector<std::string> descFileName;
 
+			//Passes using the image, resolution dependent images only share memory if these do not overlap
+			std::vector<glm::uvec2> descAliasingLifetime;
+
+			//Dimensions relative to the back buffer, zero keeps the given dimensions
+			std::vector<float> descResolutionScale;
+
 			// Resources
 			std::vector<VkImage> vkImage;
 			std::vector<VkImageView> vkImageView;
 			std::vector<ImageViewArray> vkSubResourceImageViews;
 			std::vector<MemoryPoolTypes::GpuMemoryAllocationInfo> memoryAllocationInfo;
+
+			//Streamed textures, mips of the full chain before this one are not in the image
+			std::vector<uint32_t> streamingResidentMip;
+			//Finest mip requested since the texture was last used
+			std::vector<uint32_t> streamingRequestedMip;
+			std::vector<uint32_t> streamingLastUsedFrame;
 		};
 
 		struct ImageManager : DOD::Resource::ResourceManagerBase<ImageData, _INTR_MAX_IMAGE_COUNT>
@@ -85,6 +107,11 @@ namespace Renderer
 				GetImageDimensions(p_Ref) = glm::uvec3(0u, 0u, 0u);
 				GetArrayLayerCount(p_Ref) = 1u;
 				GetMipLevelCount(p_Ref) = 1u;
+				GetAliasingLifetime(p_Ref) = ALIASING_LIFETIME_FRAME;
+				GetResolutionScale(p_Ref) = 0.0f;
+				GetResidentMip(p_Ref) = 0u;
+				GetRequestedMip(p_Ref) = 0u;
+				GetLastUsedFrame(p_Ref) = 0u;
 				//_descFileName(p_Ref) = "";
 			}
 
@@ -102,7 +129,8 @@ namespace Renderer
 				//createResources(_activeRefs);
 			}
 
-			static void CreateResource(const DOD::Ref p_Images);
+			//False if a texture file could not be loaded, see TextureStreamer::CreateTexture()
+			static bool CreateResource(const DOD::Ref p_Images);
 			static void CreateTexture(const DOD::Ref p_Images);
 
 			static uint8_t& GetImageFlags(const DOD::Ref ref)
@@ -150,6 +178,42 @@ namespace Renderer
 				return data.descArrayLayerCount[ref._id];
 			}
 	
+			static glm::uvec2& GetAliasingLifetime(const DOD::Ref ref)
+			{
+				return data.descAliasingLifetime[ref._id];
+			}
+
+			static float& GetResolutionScale(const DOD::Ref ref)
+			{
+				return data.descResolutionScale[ref._id];
+			}
+
+			static std::string& GetFileName(const DOD::Ref ref)
+			{
+				return data.descFileName[ref._id];
+			}
+
+			static uint32_t& GetResidentMip(const DOD::Ref ref)
+			{
+				return data.streamingResidentMip[ref._id];
+			}
+
+			static uint32_t& GetRequestedMip(const DOD::Ref ref)
+			{
+				return data.streamingRequestedMip[ref._id];
+			}
+
+			static uint32_t& GetLastUsedFrame(const DOD::Ref ref)
+			{
+				return data.streamingLastUsedFrame[ref._id];
+			}
+
+			//Mip levels of the VkImage, level 0 is the resident mip of the full chain
+			static uint32_t GetResidentMipLevelCount(const DOD::Ref ref)
+			{
+				return data.descMipLevelCount[ref._id] - data.streamingResidentMip[ref._id];
+			}
+	
 			static VkImageView& GetSubresourceImageViews(const DOD::Ref ref, uint32_t p_ArrayLayerIndex, uint32_t p_MipLevelIdx)
 			{
 				return data.vkSubResourceImageViews[ref._id][p_ArrayLayerIndex][p_MipLevelIdx];
@@ -180,6 +244,17 @@ namespace Renderer
 				return data.memoryAllocationInfo[ref._id];
 			}
 
+			//Recreated on resize and when the render graph assigns aliasing lifetimes
+			static bool IsResolutionDependent(const DOD::Ref ref)
+			{
+				return data.descMemoryPoolType[ref._id] == MemoryPoolTypes::kResolutionDependentImages ||
+					data.descMemoryPoolType[ref._id] == MemoryPoolTypes::kResolutionDependentTransientImages;
+			}
+
+			static bool IsDepthFormat(VkFormat format);
+			static bool IsStencilFormat(VkFormat format);
+			static VkImageAspectFlags GetImageAspectFlags(const DOD::Ref ref);
+
 			static void InsertImageMemoryBarrier(VkCommandBuffer commandBuffer, DOD::Ref imageRef, 
 				VkImageLayout srcImageLayout, VkImageLayout dstImageLayout, 
 				VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
@@ -20,14 +20,27 @@ namespace Renderer
 				pipeline_layouts.resize(MAX_PIPELINE_LAYOUT_COUNT);
 				descriptor_set_layouts.resize(MAX_PIPELINE_LAYOUT_COUNT);
 				descriptor_set_layout_bindings.resize(MAX_PIPELINE_LAYOUT_COUNT);
-				descriptor_pools.resize(MAX_PIPELINE_LAYOUT_COUNT);
+				descriptor_pool_signatures.resize(MAX_PIPELINE_LAYOUT_COUNT, 0u);
+				push_constant_ranges.resize(MAX_PIPELINE_LAYOUT_COUNT);
+				uses_descriptor_heap.resize(MAX_PIPELINE_LAYOUT_COUNT, 0u);
+				reflected_ref_counts.resize(MAX_PIPELINE_LAYOUT_COUNT, 0u);
 			}
 
 			std::vector<VkPipelineLayout>			   pipeline_layouts;
 			std::vector<VkDescriptorSetLayout>		   descriptor_set_layouts;
 			std::vector<std::vector<VkDescriptorSetLayoutBinding>>  descriptor_set_layout_bindings;
-			std::vector<VkDescriptorPool>	           descriptor_pools;
-			
+
+			//Pools of the set layout in the DescriptorAllocator
+			std::vector<uint32_t>					   descriptor_pool_signatures;
+
+			//Filled from the push constants of each draw call, see DrawCallManager::SetPushConstants
+			std::vector<std::vector<VkPushConstantRange>> push_constant_ranges;
+
+			//Adds the descriptor heap as set DESCRIPTOR_HEAP_SET when descriptor indexing is supported
+			std::vector<uint8_t>					   uses_descriptor_heap;
+
+			//Users of a layout built from shader reflection, 0 for hand described layouts
+			std::vector<uint32_t>					   reflected_ref_counts;
 		};
 
 		struct PipelineLayoutManager : DOD::Resource::ResourceManagerBase<PipelineLayoutData, MAX_PIPELINE_LAYOUT_COUNT>
@@ -46,11 +59,25 @@ namespace Renderer
 
 			static void	CreateResource(const std::vector<DOD::Ref>& refs);
 
-			static VkDescriptorSet AllocateWriteDescriptorSet(const DOD::Ref& ref, const std::vector<BindingInfo>& binding_infos);
+			//@param descriptor_pool receives the pool of the set, needed by FreeDescriptorSet
+			static VkDescriptorSet AllocateWriteDescriptorSet(const DOD::Ref& ref, const std::vector<BindingInfo>& binding_infos, VkDescriptorPool& descriptor_pool);
+
+			//Valid for the current frame only, never freed
+			static VkDescriptorSet AllocateWriteTransientDescriptorSet(const DOD::Ref& ref, const std::vector<BindingInfo>& binding_infos);
+			static void FreeDescriptorSet(const DOD::Ref& ref, VkDescriptorPool descriptor_pool, VkDescriptorSet descriptor_set);
+
+			static void WriteDescriptorSet(const DOD::Ref& ref, VkDescriptorSet descriptor_set, const std::vector<BindingInfo>& binding_infos);
 
 
 			static void DestroyPipelineLayoutAndResources(const std::vector<DOD::Ref>& refs);
 
+			/*
+				Builds the layout from the reflection of the shaders, bindings of all stages are merged and sorted by binding.
+				Shaders with the same interface get the same layout, every call has to be paired with ReleasePipelineLayout.
+			*/
+			static DOD::Ref CreatePipelineLayoutFromShaders(const std::string& name, const std::vector<DOD::Ref>& shaderRefs);
+			static void ReleasePipelineLayout(const DOD::Ref& ref);
+
 			static DOD::Ref CreatePipelineLayout(const std::string& name)
 			{
 				DOD::Ref ref = DOD::Resource::
@@ -76,9 +103,9 @@ namespace Renderer
 				return data.descriptor_set_layouts[ref._id];
 			}
 
-			static VkDescriptorPool& GetDescriptorPool(const DOD::Ref& ref)
+			static uint32_t& GetDescriptorPoolSignature(const DOD::Ref& ref)
 			{
-				return data.descriptor_pools[ref._id];
+				return data.descriptor_pool_signatures[ref._id];
 			}
 
 			static std::vector<VkDescriptorSetLayoutBinding>& GetDescriptorSetLayoutBinding(const DOD::Ref& ref)
@@ -86,6 +113,28 @@ namespace Renderer
 				return data.descriptor_set_layout_bindings[ref._id];
 			}
 
+			static std::vector<VkPushConstantRange>& GetPushConstantRanges(const DOD::Ref& ref)
+			{
+				return data.push_constant_ranges[ref._id];
+			}
+
+			static uint8_t& GetUsesDescriptorHeap(const DOD::Ref& ref)
+			{
+				return data.uses_descriptor_heap[ref._id];
+			}
+
+			static uint32_t& GetReflectedRefCount(const DOD::Ref& ref)
+			{
+				return data.reflected_ref_counts[ref._id];
+			}
+
+			//Sets bound per draw, the per draw set followed by the descriptor heap if the layout reads it
+			static uint32_t GetDescriptorSetCount(const DOD::Ref& ref);
+
+		private:
+			static bool IsSameInterface(const DOD::Ref& ref, const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkPushConstantRange>& push_constant_ranges, uint8_t uses_descriptor_heap);
+
+			static std::vector<DOD::Ref> reflectedLayouts;
 		};
 	}
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include "ThirdParty\vulkan\vulkan.h"
 #include "OctoCore/Public/DODResource.h"
 
@@ -9,6 +13,20 @@ namespace Renderer
 	{
 		const uint32_t MAX_PIPELINES = 1024u;
 
+		//Threads creating pipelines queued with CreateResourceAsync
+		const uint32_t MAX_PIPELINE_COMPILE_THREADS = 2u;
+
+		namespace PipelineState
+		{
+			enum Enum : uint8_t
+			{
+				kNone,
+				kCompiling,
+				kReady,
+				kFailed
+			};
+		}
+
 		struct PipelineData : DOD::Resource::ResourceDatabase
 		{
 			PipelineData(): ResourceDatabase(MAX_PIPELINES)
@@ -22,6 +40,8 @@ namespace Renderer
 				bufferLayoutRef.resize(MAX_PIPELINES);
 				pipelines.resize(MAX_PIPELINES);
 				input_state.resize(MAX_PIPELINES);
+				states.resize(MAX_PIPELINES, PipelineState::kNone);
+				fallback_pipelines.resize(MAX_PIPELINES);
 			}
 
 			std::vector<DOD::Ref>								vertex_shaders;
@@ -33,6 +53,10 @@ namespace Renderer
 			std::vector<DOD::Ref>								bufferLayoutRef;
 			std::vector<VkPipeline>								pipelines;
 			std::vector<VkPipelineVertexInputStateCreateInfo>   input_state;
+			std::vector<PipelineState::Enum>					states;
+
+			//Used while the pipeline compiles, has to share the pipeline layout
+			std::vector<DOD::Ref>								fallback_pipelines;
 		};
 
 		struct PipelineManager : DOD::Resource::ResourceManagerBase<PipelineData, MAX_PIPELINES>
@@ -48,6 +72,22 @@ namespace Renderer
 			static void	CreateResource(const std::vector<DOD::Ref>& ref);
 			static void DestroyResources(const std::vector<DOD::Ref>& refs);
 
+			/*
+				Creates the pipelines on the compile threads, they stay kCompiling until the
+				first Update() after they are done. Draw calls use the fallback pipeline meanwhile.
+			*/
+			static void CreateResourceAsync(const std::vector<DOD::Ref>& refs);
+
+			//Publishes finished pipelines, called between frames so recording never sees a handle change
+			static void Update();
+
+			//Waits for all queued pipelines and publishes them
+			static void Flush();
+			static void ShutdownCompileThreads();
+
+			//The pipeline to bind for the ref, its fallback while it compiles, invalid if neither is ready
+			static DOD::Ref GetBindablePipeline(const DOD::Ref& ref);
+
 			static void CreateAllResources()
 			{
 				DestroyResources(activeRefs);
@@ -59,6 +99,9 @@ namespace Renderer
 				DOD::Ref ref = DOD::Resource::
 					ResourceManagerBase<PipelineData, MAX_PIPELINES>::createResource(name);
 
+				data.states[ref._id] = PipelineState::kNone;
+				data.fallback_pipelines[ref._id] = DOD::Ref();
+
 				return ref;
 			}
 
@@ -112,6 +155,29 @@ namespace Renderer
 			{
 				return data.input_state[ref._id];
 			}
+
+			static PipelineState::Enum& GetState(const DOD::Ref& ref)
+			{
+				return data.states[ref._id];
+			}
+
+			static DOD::Ref& GetFallbackPipeline(const DOD::Ref& ref)
+			{
+				return data.fallback_pipelines[ref._id];
+			}
+
+		private:
+			static VkResult BuildPipeline(const DOD::Ref& ref, VkPipeline& pipeline);
+			static void CompileThread();
+
+			static std::vector<std::thread> compileThreads;
+			static std::mutex compileMutex;
+			static std::condition_variable compileCondition;
+			static std::condition_variable idleCondition;
+			static std::deque<DOD::Ref> compileQueue;
+			static std::vector<std::pair<DOD::Ref, VkPipeline>> compiledPipelines;
+			static uint32_t compilingCount;
+			static bool stopCompileThreads;
 		};
 	}
 }
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <Windowsx.h>
 #include <mmsystem.h>
 #include <string>
+#include <unordered_set>
 
 namespace Renderer
 {
@@ -18,6 +19,70 @@ namespace Renderer
 	{
 		#define SECONDARY_COMMAND_BUFFER_COUNT 128u
 
+		//Not part of the bundled vulkan.h yet
+		#ifndef VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
+		#define VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME "VK_KHR_draw_indirect_count"
+		typedef void (VKAPI_PTR *PFN_vkCmdDrawIndexedIndirectCountKHR)(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, 
+			VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride);
+		#endif
+
+		#ifndef VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
+		#define VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME "VK_KHR_get_physical_device_properties2"
+		#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR static_cast<VkStructureType>(1000059000)
+		typedef struct VkPhysicalDeviceFeatures2KHR
+		{
+			VkStructureType          sType;
+			void*                    pNext;
+			VkPhysicalDeviceFeatures features;
+		} VkPhysicalDeviceFeatures2KHR;
+		typedef void (VKAPI_PTR *PFN_vkGetPhysicalDeviceFeatures2KHR)(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2KHR* pFeatures);
+		#endif
+
+		#ifndef VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+		#define VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME "VK_EXT_descriptor_indexing"
+		#define VK_KHR_MAINTENANCE3_EXTENSION_NAME "VK_KHR_maintenance3"
+		#define VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT static_cast<VkStructureType>(1000161000)
+		#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT static_cast<VkStructureType>(1000161001)
+		#define VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT 0x00000002
+		#define VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT 0x00000002
+		#define VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT 0x00000001
+		#define VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT 0x00000002
+		#define VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT 0x00000004
+		typedef VkFlags VkDescriptorBindingFlagsEXT;
+		typedef struct VkDescriptorSetLayoutBindingFlagsCreateInfoEXT
+		{
+			VkStructureType                    sType;
+			const void*                        pNext;
+			uint32_t                           bindingCount;
+			const VkDescriptorBindingFlagsEXT* pBindingFlags;
+		} VkDescriptorSetLayoutBindingFlagsCreateInfoEXT;
+		typedef struct VkPhysicalDeviceDescriptorIndexingFeaturesEXT
+		{
+			VkStructureType sType;
+			void*           pNext;
+			VkBool32        shaderInputAttachmentArrayDynamicIndexing;
+			VkBool32        shaderUniformTexelBufferArrayDynamicIndexing;
+			VkBool32        shaderStorageTexelBufferArrayDynamicIndexing;
+			VkBool32        shaderUniformBufferArrayNonUniformIndexing;
+			VkBool32        shaderSampledImageArrayNonUniformIndexing;
+			VkBool32        shaderStorageBufferArrayNonUniformIndexing;
+			VkBool32        shaderStorageImageArrayNonUniformIndexing;
+			VkBool32        shaderInputAttachmentArrayNonUniformIndexing;
+			VkBool32        shaderUniformTexelBufferArrayNonUniformIndexing;
+			VkBool32        shaderStorageTexelBufferArrayNonUniformIndexing;
+			VkBool32        descriptorBindingUniformBufferUpdateAfterBind;
+			VkBool32        descriptorBindingSampledImageUpdateAfterBind;
+			VkBool32        descriptorBindingStorageImageUpdateAfterBind;
+			VkBool32        descriptorBindingStorageBufferUpdateAfterBind;
+			VkBool32        descriptorBindingUniformTexelBufferUpdateAfterBind;
+			VkBool32        descriptorBindingStorageTexelBufferUpdateAfterBind;
+			VkBool32        descriptorBindingUpdateUnusedWhilePending;
+			VkBool32        descriptorBindingPartiallyBound;
+			VkBool32        descriptorBindingVariableDescriptorCount;
+			VkBool32        runtimeDescriptorArray;
+		} VkPhysicalDeviceDescriptorIndexingFeaturesEXT;
+		#endif
+
 		struct RenderSystem
 		{
 			static std::vector<VkCommandBuffer> vkPrimalCommandBuffers;
@@ -32,6 +97,12 @@ namespace Renderer
 
 			static VkPhysicalDevice             vkPhysicalDevice;
 			static VkPhysicalDeviceMemoryProperties vkPhysicalDeviceMemoryProperties;
+			static VkPhysicalDeviceFeatures     vkPhysicalDeviceFeatures;
+			static bool                         supportsDrawIndirectCount;
+			static bool                         supportsDrawIndirectFirstInstance;
+			static PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCount;
+			static bool                         supportsPhysicalDeviceProperties2;
+			static bool                         supportsDescriptorIndexing;
 
 			static VkQueue                       vkQueue;
 			static uint32_t                      vkGraphicsQueueFamilyIndex;
@@ -48,6 +119,10 @@ namespace Renderer
 			static uint32_t                      activeBackbufferMask;
 			static uint32_t						 allocatedSecondaryCmdBufferCount;
 			static glm::uvec2                    backBufferDimensions;
+			static bool                          vsyncEnabled;
+
+			//Set when acquire or present reported the swapchain out of date or suboptimal, ResizeSwapchain recreates it
+			static bool                          swapchainOutOfDate;
 
 			static VkPipelineCache               vkPipelineCache;
 
@@ -98,10 +173,18 @@ namespace Renderer
 			static void InitPlatformDependentFormats();
 			static void InitVulkanSynchronization();
 
-			static void ResizeSwapchain();
+			//Returns false if the surface extent did not change and the swapchain is not out of date
+			static bool ResizeSwapchain();
+			static void RecreateResolutionDependentResources();
+
+			//Draw calls get new descriptor sets for the new views of these images, frames in flight keep the old ones
+			static void UpdateImageDescriptors(const std::unordered_set<uint32_t>& imageIds);
+
+			//False if no back buffer could be acquired, the frame has to be skipped and the swapchain resized
+			static bool StartFrame();
 
-			static void StartFrame();
-			static void EndFrame();
+			//False if the swapchain has to be resized before the next frame
+			static bool EndFrame();
 
 			static bool WaitForFrame(const uint32_t index);
 
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		//Runs the installed glslangValidator, shaders are otherwise compiled offline by generate-spirv.bat
+		struct ShaderCompiler
+		{
+			/*
+				Written to a temporary file first, a failed compile leaves an existing output alone.
+				@param arguments passed besides -V, e.g. defines
+				@return false if the compile failed or no compiler is installed
+			*/
+			static bool Compile(const std::string& source, const std::string& output, const std::vector<std::string>& arguments);
+
+		private:
+			static std::string GetCompiler();
+		};
+	}
+}
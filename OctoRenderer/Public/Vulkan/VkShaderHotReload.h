@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+#if defined(NDEBUG)
+		const bool SHADER_HOT_RELOAD_ENABLED = false;
+#else
+		const bool SHADER_HOT_RELOAD_ENABLED = true;
+#endif
+
+		//How long the watcher sleeps between checks when no change notification arrives
+		const uint32_t SHADER_WATCH_INTERVAL_MS = 250u;
+
+		//One line of generate-spirv.bat
+		struct ShaderCompileJob
+		{
+			std::string source;
+			std::string output;
+
+			//Everything besides -V, the source and the output, e.g. defines of permutations
+			std::vector<std::string> arguments;
+		};
+
+		/*
+			Recompiles shaders whose GLSL changed while running.
+			A background thread watches the shader directory, compiles changed sources with glslangValidator
+			the way generate-spirv.bat does and queues the written SPIR-V.
+			ApplyChanges() swaps the modules and rebuilds the pipelines using them, it has to run between frames.
+			Variants of GpuProgramManager::GetVariant() are recompiled there when their source or one of their includes changed.
+			Changes of the shader interface still need a restart, the pipeline layouts are kept.
+		*/
+		struct ShaderHotReload
+		{
+			//@param shaderDirectory with trailing slash, generate-spirv.bat is read from there
+			static void Init(const std::string& shaderDirectory);
+			static void Shutdown();
+
+			static void ApplyChanges();
+
+		private:
+			static void ParseCompileJobs();
+			static void Watch();
+			static void CompileChanged();
+			static bool Compile(const ShaderCompileJob& job);
+
+			static std::string directory;
+			static std::vector<ShaderCompileJob> jobs;
+
+			//Last write time per source and include, seen by the watcher thread only
+			static std::unordered_map<std::string, int64_t> writeTimes;
+
+			static std::thread watcher;
+			static std::atomic<bool> running;
+
+			//SPIR-V written and sources changed since the last ApplyChanges()
+			static std::mutex readyMutex;
+			static std::vector<std::string> readyOutputs;
+			static std::vector<std::string> changedSources;
+		};
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "ThirdParty/vulkan/vulkan.h"
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		struct ShaderBinding
+		{
+			uint32_t set;
+			uint32_t binding;
+			VkDescriptorType descriptorType;
+
+			//0 for runtime sized arrays
+			uint32_t descriptorCount;
+		};
+
+		//32 bit format of the shader type, packed streams may use any format converting to it
+		struct ShaderVertexInput
+		{
+			uint32_t location;
+			VkFormat format;
+		};
+
+		struct ShaderSpecializationConstant
+		{
+			uint32_t constantId;
+			uint32_t size;
+			uint32_t defaultValue;
+		};
+
+		struct ShaderReflection
+		{
+			//Sorted by set and binding
+			std::vector<ShaderBinding> bindings;
+
+			//Bytes of the push_constant block actually declared, 0 without one
+			uint32_t pushConstantOffset = 0u;
+			uint32_t pushConstantSize = 0u;
+
+			//Vertex shaders only, built-ins are skipped
+			std::vector<ShaderVertexInput> vertexInputs;
+
+			std::vector<ShaderSpecializationConstant> specializationConstants;
+		};
+
+		/*
+			Minimal SPIR-V parser, walks the module once and only looks at decorations, types and global variables.
+			Covers what glslang emits for GLSL 450, unknown instructions are skipped, malformed known ones fail the reflection.
+		*/
+		struct ShaderReflector
+		{
+			//@return false if the code is no valid SPIR-V module
+			static bool Reflect(const uint32_t* code, size_t wordCount, ShaderReflection& reflection);
+		};
+	}
+}
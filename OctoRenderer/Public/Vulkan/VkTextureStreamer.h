@@ -0,0 +1,140 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "ThirdParty/vulkan/vulkan.h"
+#include "OctoCore/Public/DOD.h"
+#include "VkEnums.h"
+#include "VkImageManager.h"
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		//Device local memory all streamed textures share, the mip tails are kept even above it
+		const uint64_t TEXTURE_STREAMING_DEFAULT_BUDGET_IN_BYTES = 512ull * 1024ull * 1024ull;
+
+		//Mips up to this extent are loaded with the texture and never evicted, fewer if they do not fit into the staging memory
+		const uint32_t TEXTURE_STREAMING_TAIL_EXTENT = 64u;
+
+		//Staging memory per back buffer, bounds what gets uploaded in one frame
+		const uint32_t TEXTURE_STREAMING_STAGING_SIZE_IN_BYTES = 16u * 1024u * 1024u;
+
+		//Textures not requested for this many frames drop back to their tail
+		const uint32_t TEXTURE_STREAMING_UNUSED_FRAMES = 120u;
+
+		//Swapping images replaces the descriptor sets sampling them, so swaps are gathered for this many frames
+		const uint32_t TEXTURE_STREAMING_SWAP_INTERVAL_FRAMES = 8u;
+
+		//Mips [firstMip, lastMip) of a texture file, read by the loader thread
+		struct TextureStreamingLoad
+		{
+			DOD::Ref imageRef;
+			std::string fileName;
+			uint32_t firstMip;
+			uint32_t lastMip;
+
+			std::vector<uint8_t> data;
+			std::vector<size_t> mipOffsets;
+			bool failed;
+		};
+
+		//Kept until the frame copying out of it is done
+		struct RetiredStreamedImage
+		{
+			VkImage image;
+			VkImageView imageView;
+			ImageViewArray subresourceImageViews;
+			MemoryPoolTypes::GpuMemoryAllocationInfo memoryAllocationInfo;
+		};
+
+		struct StreamingStagingBuffer
+		{
+			VkBuffer buffer;
+			MemoryPoolTypes::GpuMemoryAllocationInfo memoryAllocationInfo;
+		};
+
+		/*
+			Streams the mips of ImageType::kTextureFromFile images.
+			Creating a texture only loads its mip tail, finer mips follow once RequestMip() asks for them,
+			which DrawCallManager::RequestTextureMips() does for the textures bound by draw calls.
+			A loader thread reads the mips from the file, Update() uploads them through per back buffer staging memory
+			and copies the resident mips over into a new image holding the finer chain.
+			Under the budget the least recently used textures give up their finest mips first.
+			Only 2D textures with a single layer are streamed, they are sampled through per draw sets and never registered in the DescriptorHeap.
+		*/
+		struct TextureStreamer
+		{
+			static void Init();
+			static void Shutdown();
+
+			/*
+				Reads size and format from the file and uploads the mip tail right away.
+				@return false if the file can not be loaded or its coarsest mip does not fit into the staging memory, no image is created then
+			*/
+			static bool CreateTexture(const DOD::Ref& ref);
+
+			//@param screenExtentInPixels largest extent the texture covers on screen this frame
+			static void RequestMip(const DOD::Ref& ref, float screenExtentInPixels);
+			static void RequestMip(const DOD::Ref& ref, uint32_t mip);
+
+			static void SetBudget(uint64_t budgetInBytes)
+			{
+				budget = budgetInBytes;
+			}
+
+			static uint64_t GetResidentSize();
+
+			//Memory of replaced images frames in flight may still sample
+			static uint64_t GetRetiredSize();
+
+			//Records into the primary command buffer, the fence of the back buffer has to be waited on
+			static void Update(VkCommandBuffer commandBuffer, uint32_t backBufferIndex);
+
+		private:
+			static uint32_t GetTailMip(const DOD::Ref& ref);
+
+			//Finer mips do not fit into the staging memory on their own and are never streamed in
+			static uint32_t GetFirstStreamableMip(const DOD::Ref& ref);
+			static uint64_t GetMipChainSize(const DOD::Ref& ref, uint32_t firstMip);
+			static std::vector<uint32_t> AssignBudget(const std::vector<DOD::Ref>& refs);
+
+			static void LoadThread();
+			static bool ReadMips(TextureStreamingLoad& load);
+
+			/*
+				Replaces the image by one holding the mips from residentMip on, a load has to end at the current resident mip.
+				@return false if the staging memory is used up, the image is kept then
+			*/
+			static bool Restream(VkCommandBuffer commandBuffer, uint32_t stagingIdx, const DOD::Ref& ref, uint32_t residentMip,
+				const TextureStreamingLoad* load, RetiredStreamedImage& retired);
+			static bool StageMips(uint32_t stagingIdx, const TextureStreamingLoad& load, uint32_t residentMip, std::vector<VkBufferImageCopy>& regions);
+			static void ReleaseRetired(std::vector<RetiredStreamedImage>& retired);
+
+			static uint64_t budget;
+			static uint32_t frame;
+			static uint32_t lastSwapFrame;
+
+			//One per back buffer and one more for CreateTexture(), which may run while a frame is recorded
+			static std::vector<StreamingStagingBuffer> stagingBuffers;
+			static std::vector<size_t> stagingOffsets;
+			static std::vector<std::vector<RetiredStreamedImage>> retiredImages;
+
+			//Images with a load queued or in flight, main thread only
+			static std::unordered_set<uint32_t> pendingLoads;
+
+			static std::thread loader;
+			static bool running;
+			static std::mutex loadMutex;
+			static std::condition_variable loadCondition;
+			static std::deque<TextureStreamingLoad> queuedLoads;
+			static std::vector<TextureStreamingLoad> finishedLoads;
+		};
+	}
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "ThirdParty/vulkan/vulkan.h"
+#include "OctoCore/Public/DOD.h"
+#include "OctoCore/Public/VirtualTextureFile.h"
+#include "VkEnums.h"
+
+//ThirdParty
+#include <ThirdParty/glm/glm/glm.hpp>
+
+namespace Renderer
+{
+	namespace Resource
+	{
+		//Texture ids take 4 bits of a feedback texel, the id with all bits set is left to VIRTUAL_TEXTURE_NO_FEEDBACK
+		const uint32_t VIRTUAL_TEXTURE_MAX_COUNT = 15u;
+
+		//Cleared feedback texels, nothing was drawn there
+		const uint32_t VIRTUAL_TEXTURE_NO_FEEDBACK = ~0u;
+
+		//Physical tiles per side of the atlas all virtual textures share, matches virtual_texture.glsl
+		const uint32_t VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE = 24u;
+
+		//Bounds the tiles and page table texels uploaded in one frame
+		const uint32_t VIRTUAL_TEXTURE_STAGING_SIZE_IN_BYTES = 4u * 1024u * 1024u;
+		const uint32_t VIRTUAL_TEXTURE_MAX_UPLOADS_PER_FRAME = 32u;
+
+		//Tile loads queued or in flight at once, further requests are dropped and come back with the next feedback
+		const uint32_t VIRTUAL_TEXTURE_MAX_PENDING_LOADS = 256u;
+
+		/*
+			Feedback texel and tile key, see virtual_texture.glsl
+			textureId:4 | mip:4 | pageY:12 | pageX:12
+		*/
+		inline uint32_t EncodeVirtualTextureTile(uint32_t textureId, uint32_t mip, uint32_t pageX, uint32_t pageY)
+		{
+			return (textureId << 28u) | (mip << 24u) | (pageY << 12u) | pageX;
+		}
+
+		//Tiles of one virtual texture in the file, read by the loader thread
+		struct VirtualTextureTileLoad
+		{
+			uint32_t tileKey;
+			uint32_t generation;
+			std::shared_ptr<const Core::Texture::VirtualTextureFile> file;
+
+			std::vector<uint8_t> data;
+		};
+
+		//Physical tile of the atlas
+		struct VirtualTextureSlot
+		{
+			//VIRTUAL_TEXTURE_NO_FEEDBACK if free
+			uint32_t tileKey;
+			uint32_t lastUsedFrame;
+
+			//Coarsest mip of every texture, the fallback of all its pages
+			bool pinned;
+		};
+
+		struct VirtualTexture
+		{
+			//Shared with the loads in flight, the file stays mapped until the last one is done
+			std::shared_ptr<const Core::Texture::VirtualTextureFile> file;
+
+			//Bumped on every creation, loads of a destroyed texture in the same place are dropped
+			uint32_t generation;
+
+			//RGBA8 per page and mip: atlas x, atlas y, mip of the mapped tile, 255 once valid
+			DOD::Ref pageTableRef;
+			uint32_t pageTableHeapIndex;
+
+			//CPU copy of the page table and the atlas slot mapped for each page, per mip
+			std::vector<std::vector<uint32_t>> pageTable;
+			std::vector<std::vector<uint32_t>> slots;
+
+			//Page rects per mip to rebuild and upload, min and max exclusive
+			std::vector<glm::uvec4> dirtyRects;
+			std::vector<uint32_t> dirtyRectMips;
+		};
+
+		/*
+			Virtual textures share one atlas of physical tiles, their pages are mapped into it on demand.
+			Each texture has a page table holding the atlas tile of every page, pages without a tile
+			point at the tile of the closest coarser mip that has one, the coarsest mip is always resident.
+			The feedback pass writes the tiles the screen wants, AddFeedback() turns them into tile loads
+			read from the tiled file by a loader thread, Update() maps finished tiles in place of the least recently used ones.
+			Memory is a fixed atlas and page tables, independent of the size of the textures.
+		*/
+		struct VirtualTextureSystem
+		{
+			static void Init();
+			static void Shutdown();
+
+			/*
+				@param fileName of a file cooked by Core::Texture::VirtualTextureFile::Cook()
+				@return id of the texture, VIRTUAL_TEXTURE_NO_FEEDBACK if the file could not be loaded or all ids are taken
+			*/
+			static uint32_t CreateVirtualTexture(const std::string& fileName);
+
+			//Waits for the device, the page table may still be read by frames in flight
+			static void DestroyVirtualTexture(uint32_t textureId);
+
+			//Feedback texels of one frame, requested tiles are loaded and kept from being evicted
+			static void AddFeedback(const uint32_t* texels, size_t texelCount);
+
+			//Records into the primary command buffer, the fence of the back buffer has to be waited on
+			static void Update(VkCommandBuffer commandBuffer, uint32_t backBufferIndex);
+
+			static bool IsValid(uint32_t textureId)
+			{
+				return textureId < VIRTUAL_TEXTURE_MAX_COUNT && textures[textureId].file != nullptr;
+			}
+
+			static uint32_t GetPageCount(uint32_t textureId)
+			{
+				return textures[textureId].file->GetPageCount(0u);
+			}
+
+			static uint32_t GetMipCount(uint32_t textureId)
+			{
+				return textures[textureId].file->GetHeader().mipCount;
+			}
+
+			//Sampled with VIRTUAL_TEXTURE_SAMPLE() or bound per draw without the descriptor heap
+			static const DOD::Ref& GetPageTableImageRef(uint32_t textureId)
+			{
+				return textures[textureId].pageTableRef;
+			}
+
+			static uint32_t GetPageTableHeapIndex(uint32_t textureId)
+			{
+				return textures[textureId].pageTableHeapIndex;
+			}
+
+			static const DOD::Ref& GetAtlasImageRef()
+			{
+				return atlasRef;
+			}
+
+			static uint32_t GetAtlasHeapIndex()
+			{
+				return atlasHeapIndex;
+			}
+
+			static VkSampler GetPageTableSampler()
+			{
+				return pageTableSampler;
+			}
+
+			static VkSampler GetAtlasSampler()
+			{
+				return atlasSampler;
+			}
+
+		private:
+			static void CreateSamplers();
+			static void CreateAtlas();
+			static void CreateStagingBuffer(MemoryPoolTypes::GpuMemoryAllocationInfo& memoryAllocationInfo, VkBuffer& buffer);
+
+			//One shot command buffers, the queue is waited on, only used while creating resources
+			static VkCommandBuffer BeginOneShot();
+			static void SubmitAndWait(VkCommandBuffer commandBuffer);
+
+			static void LoadThread();
+
+			//@return atlas slot for a new tile, ~0u if every slot is pinned or used this frame
+			static uint32_t AcquireSlot();
+			static void MapTile(uint32_t tileKey, uint32_t slotIdx);
+			static void UnmapTile(uint32_t tileKey);
+
+			//Marks the page and everything it is the fallback for
+			static void MarkDirty(VirtualTexture& texture, uint32_t mip, uint32_t pageX, uint32_t pageY);
+			static uint64_t GetDirtySize(const VirtualTexture& texture, uint32_t mip);
+
+			//@return false if the staging memory is used up, the texture stays dirty then
+			static bool UploadPageTable(VkCommandBuffer commandBuffer, uint32_t stagingIdx, VirtualTexture& texture);
+			static bool StageTile(uint32_t stagingIdx, const VirtualTextureTileLoad& load, uint32_t slotIdx, VkBufferImageCopy& region);
+
+			static VirtualTexture textures[VIRTUAL_TEXTURE_MAX_COUNT];
+			static uint32_t frame;
+
+			static DOD::Ref atlasRef;
+			static uint32_t atlasHeapIndex;
+			static VkSampler pageTableSampler;
+			static VkSampler atlasSampler;
+			static std::vector<VirtualTextureSlot> atlasSlots;
+
+			//One per back buffer and one more for CreateVirtualTexture()
+			static std::vector<VkBuffer> stagingBuffers;
+			static std::vector<MemoryPoolTypes::GpuMemoryAllocationInfo> stagingMemory;
+			static std::vector<size_t> stagingOffsets;
+
+			//Tiles asked for by the feedback since the last Update(), main thread only
+			static std::unordered_set<uint32_t> requestedTiles;
+			static std::unordered_set<uint32_t> pendingLoads;
+
+			static std::thread loader;
+			static bool running;
+			static std::mutex loadMutex;
+			static std::condition_variable loadCondition;
+			static std::deque<VirtualTextureTileLoad> queuedLoads;
+			static std::vector<VirtualTextureTileLoad> finishedLoads;
+		};
+	}
+}
@@ -54,7 +54,7 @@ namespace VkTools
 		// Load a 2D texture
 		bool LoadTexture(const std::string& filename, VkFormat format, VulkanTexture *texture, bool forceLinear, VkImageUsageFlags imageUsageFlags);
 
-		//Generates texture from given data
+		//Generates texture from given data, mips below the first are blitted on the GPU, 0 miplevels for the full chain
 		bool GenerateTexture(void * pImageData, VulkanTexture *texture,  VkFormat format, uint32_t size, uint32_t width, uint32_t height, uint32_t miplevels, bool bForceLinear, VkImageUsageFlags imageUsageFlags);
 
 
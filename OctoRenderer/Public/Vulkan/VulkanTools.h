@@ -125,6 +125,53 @@ namespace VkTools
 			VkImageLayout newImageLayout, VkImageSubresourceRange subresourceRange, 
 			VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
 
+	 /*
+		@param: VkCommandBuffer cmdbuffer,
+		@param: VkAccessFlags srcAccessMask,
+		@param: VkAccessFlags dstAccessMask,
+		@param: VkPipelineStageFlags srcStageMask,
+		@param: VkPipelineStageFlags dstStageMask
+	*/
+	 void InsertMemoryBarrier(VkCommandBuffer cmdbuffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+			VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+
+	 /*
+		Full mip chain of the extent, down to 1x1
+
+		@param: uint32_t width
+		@param: uint32_t height
+
+		@return: uint32_t
+	*/
+	 uint32_t GetFullMipLevelCount(uint32_t width, uint32_t height);
+
+	 /*
+		True if the optimal tiled format can be linearly blitted into itself, see GenerateMipmaps
+
+		@param: VkPhysicalDevice physicalDevice
+		@param: VkFormat format
+
+		@return: VkBool32
+	*/
+	 VkBool32 SupportsMipmapGeneration(VkPhysicalDevice physicalDevice, VkFormat format);
+
+	 /*
+		Fills mips 1 to mipLevels - 1 by linearly blitting each mip into the next one.
+		Records into the command stream of the upload, every mip has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+		with mip 0 written, all of them are in newImageLayout afterwards.
+		The image needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT as well.
+
+		@param: VkCommandBuffer cmdbuffer
+		@param: VkImage image
+		@param: uint32_t width
+		@param: uint32_t height
+		@param: uint32_t mipLevels
+		@param: VkImageLayout newImageLayout
+		@param: VkPipelineStageFlags dstStageMask
+	*/
+	 void GenerateMipmaps(VkCommandBuffer cmdbuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels,
+			VkImageLayout newImageLayout, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
 	/*
 		@param: uint32_t typeBit
 		@param: VkFlags properties
@@ -175,6 +222,15 @@ namespace VkTools
 	*/
 	 VkBool32 GetSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat& depthFormat);
 
+	/*
+		Size of one element, covers the vertex attribute formats
+
+		@param: VkFormat format
+
+		@return uint32_t
+	*/
+	 uint32_t GetFormatSize(VkFormat format);
+
 	/*
 		Destroys uniform data that was allocated
 
@@ -208,6 +264,15 @@ namespace VkTools
 	 VkShaderModule LoadShader(const std::string& fileName, VkDevice device, VkShaderStageFlagBits stage);
 #endif
 
+	/*
+		@param: const uint32_t* code, SPIR-V words
+		@param: size_t codeSize, in bytes
+		@param: VkDevice device
+
+		@return VkShaderModule
+	*/
+	 VkShaderModule CreateShaderModule(const uint32_t* code, size_t codeSize, VkDevice device);
+
 	namespace Initializer
 	{
 		/*
@@ -0,0 +1,186 @@
+#include "OctoTest.h"
+#include "AnimationSampler.h"
+
+//Other
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const uint32_t JOINT_COUNT = 5u;
+	const uint32_t FRAME_COUNT = 60u;
+	const float FRAME_RATE = 30.0f;
+
+	//Chord of the shorter arc, same measure the clip builder uses
+	float AngleBetween(const glm::quat& a, const glm::quat& b)
+	{
+		const glm::quat closest = glm::dot(a, b) < 0.0f ? -b : b;
+		const glm::vec4 chord = glm::vec4(a.x - closest.x, a.y - closest.y, a.z - closest.z, a.w - closest.w);
+		return 4.0f * std::asin(std::min(glm::length(chord) * 0.5f, 1.0f));
+	}
+
+	/*
+		Joint 0 is constant, joint 1 turns around z and moves in a straight line,
+		the others swing on curves so most of their keys stay.
+	*/
+	std::vector<JointQuat> MakeFrames()
+	{
+		std::vector<JointQuat> frames(FRAME_COUNT * JOINT_COUNT);
+		for (uint32_t frame = 0u; frame < FRAME_COUNT; frame++)
+		{
+			const float time = frame / FRAME_RATE;
+			for (uint32_t jointIdx = 0u; jointIdx < JOINT_COUNT; jointIdx++)
+			{
+				JointQuat& joint = frames[frame * JOINT_COUNT + jointIdx];
+				if (jointIdx == 0u)
+				{
+					joint.q = glm::angleAxis(0.3f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+					joint.t = glm::vec3(0.0f, 1.0f, 0.0f);
+				}
+				else if (jointIdx == 1u)
+				{
+					joint.q = glm::angleAxis(time * 2.0f, glm::vec3(0.0f, 0.0f, 1.0f));
+					joint.t = glm::vec3(time, 0.5f, -2.0f * time);
+				}
+				else
+				{
+					const float phase = jointIdx * 0.7f;
+					joint.q = glm::angleAxis(std::sin(time * 3.0f + phase), glm::normalize(glm::vec3(std::cos(phase), 1.0f, std::sin(time))));
+					joint.t = glm::vec3(std::sin(time * 4.0f + phase), std::cos(time * 2.0f), 0.1f * jointIdx);
+				}
+			}
+		}
+		return frames;
+	}
+
+	void TestPackQuat()
+	{
+		std::mt19937 random(13u);
+		std::normal_distribution<float> gaussian(0.0f, 1.0f);
+
+		//Three 15 bit components keep the rotation within a few ten thousandths of a radian
+		for (uint32_t i = 0u; i < 10000u; i++)
+		{
+			const glm::quat q = glm::normalize(glm::quat(gaussian(random), gaussian(random), gaussian(random), gaussian(random)));
+			const glm::quat unpacked = AnimationClip::UnpackQuat(AnimationClip::PackQuat(q));
+			OCTO_CHECK(AngleBetween(q, unpacked) < 2e-4f);
+			OCTO_CHECK(std::abs(glm::length(unpacked) - 1.0f) < 1e-5f);
+		}
+
+		//Identity and its negation are the same rotation
+		OCTO_CHECK(AngleBetween(AnimationClip::UnpackQuat(AnimationClip::PackQuat(glm::quat(-1.0f, 0.0f, 0.0f, 0.0f))), glm::quat(1.0f, 0.0f, 0.0f, 0.0f)) < 2e-4f);
+	}
+
+	void TestBuild()
+	{
+		AnimationClip clip;
+		OCTO_CHECK(!AnimationClipBuilder::Build(std::vector<JointQuat>(), JOINT_COUNT, FRAME_RATE, AnimationCompressionSettings(), clip));
+
+		const std::vector<JointQuat> frames = MakeFrames();
+		OCTO_CHECK(AnimationClipBuilder::Build(frames, JOINT_COUNT, FRAME_RATE, AnimationCompressionSettings(), clip));
+		OCTO_CHECK(clip.GetJointCount() == JOINT_COUNT && clip.frameCount == FRAME_COUNT);
+		OCTO_CHECK(std::abs(clip.GetDuration() - (FRAME_COUNT - 1u) / FRAME_RATE) < 1e-6f);
+		OCTO_CHECK(clip.GetKeyCount() < FRAME_COUNT * JOINT_COUNT * 2u);
+
+		//Constant tracks keep frame 0 only, straight lines only their ends
+		const AnimationTrack& constant = clip.tracks[0];
+		OCTO_CHECK(constant.rotationKeyCount == 1u && constant.translationKeyCount == 1u);
+		OCTO_CHECK(clip.rotationFrames[constant.firstRotationKey] == 0u && clip.translationFrames[constant.firstTranslationKey] == 0u);
+
+		const AnimationTrack& linear = clip.tracks[1];
+		OCTO_CHECK(linear.translationKeyCount == 2u);
+		OCTO_CHECK(linear.rotationKeyCount > 2u && linear.rotationKeyCount < FRAME_COUNT);
+
+		for (const AnimationTrack& track : clip.tracks)
+		{
+			for (uint32_t key = 1u; key < track.rotationKeyCount; key++)
+			{
+				OCTO_CHECK(clip.rotationFrames[track.firstRotationKey + key] > clip.rotationFrames[track.firstRotationKey + key - 1u]);
+			}
+
+			OCTO_CHECK(track.rotationKeyCount == 1u || clip.rotationFrames[track.firstRotationKey + track.rotationKeyCount - 1u] == FRAME_COUNT - 1u);
+		}
+	}
+
+	void TestSample()
+	{
+		const std::vector<JointQuat> frames = MakeFrames();
+		const AnimationCompressionSettings settings;
+		AnimationClip clip;
+		OCTO_CHECK(AnimationClipBuilder::Build(frames, JOINT_COUNT, FRAME_RATE, settings, clip));
+
+		AnimationCursor cursor;
+		cursor.Reset(clip);
+		SkeletonPose pose;
+
+		//Playing forward hits every source frame within the compression error
+		for (uint32_t frame = 0u; frame < FRAME_COUNT; frame++)
+		{
+			AnimationSampler::Sample(cursor, frame / FRAME_RATE, pose);
+			OCTO_CHECK(pose.GetJointCount() == JOINT_COUNT);
+			for (uint32_t jointIdx = 0u; jointIdx < JOINT_COUNT; jointIdx++)
+			{
+				const JointQuat& source = frames[frame * JOINT_COUNT + jointIdx];
+				const JointQuat sampled = pose.GetJoint(jointIdx);
+				OCTO_CHECK(AngleBetween(sampled.q, source.q) <= settings.rotationError * 1.01f + 1e-5f);
+				OCTO_CHECK(glm::distance(sampled.t, source.t) <= settings.translationError + 1e-5f);
+			}
+		}
+
+		//Seeking back gives the same pose as a fresh cursor, times past the end hold the last frame
+		const float times[] = { 0.9f, 0.25f, 100.0f };
+		for (const float time : times)
+		{
+			AnimationCursor freshCursor;
+			freshCursor.Reset(clip);
+			SkeletonPose freshPose;
+			AnimationSampler::Sample(cursor, time, pose);
+			AnimationSampler::Sample(freshCursor, time, freshPose);
+			for (uint32_t jointIdx = 0u; jointIdx < JOINT_COUNT; jointIdx++)
+			{
+				OCTO_CHECK(AngleBetween(pose.GetJoint(jointIdx).q, freshPose.GetJoint(jointIdx).q) < 1e-6f);
+				OCTO_CHECK(glm::distance(pose.GetJoint(jointIdx).t, freshPose.GetJoint(jointIdx).t) < 1e-6f);
+			}
+		}
+
+		for (uint32_t jointIdx = 0u; jointIdx < JOINT_COUNT; jointIdx++)
+		{
+			const JointQuat& last = frames[(FRAME_COUNT - 1u) * JOINT_COUNT + jointIdx];
+			OCTO_CHECK(AngleBetween(pose.GetJoint(jointIdx).q, last.q) <= settings.rotationError * 1.01f + 1e-5f);
+			OCTO_CHECK(glm::distance(pose.GetJoint(jointIdx).t, last.t) <= settings.translationError + 1e-5f);
+		}
+	}
+
+	void TestBlend()
+	{
+		SkeletonPose a;
+		SkeletonPose b;
+		a.Resize(JOINT_COUNT);
+		b.Resize(JOINT_COUNT);
+		for (uint32_t jointIdx = 0u; jointIdx < JOINT_COUNT; jointIdx++)
+		{
+			a.SetJoint(jointIdx, { glm::angleAxis(0.0f, glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(0.0f) });
+			b.SetJoint(jointIdx, { glm::angleAxis(1.0f, glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(2.0f, 0.0f, -4.0f) });
+		}
+
+		//Halfway between two rotations around one axis is the half angle
+		SkeletonPose result;
+		AnimationSampler::Blend(a, b, 0.5f, nullptr, result);
+		for (uint32_t jointIdx = 0u; jointIdx < JOINT_COUNT; jointIdx++)
+		{
+			OCTO_CHECK(AngleBetween(result.GetJoint(jointIdx).q, glm::angleAxis(0.5f, glm::vec3(0.0f, 0.0f, 1.0f))) < 1e-5f);
+			OCTO_CHECK(glm::distance(result.GetJoint(jointIdx).t, glm::vec3(1.0f, 0.0f, -2.0f)) < 1e-5f);
+		}
+	}
+}
+
+int main()
+{
+	TestPackQuat();
+	TestBuild();
+	TestSample();
+	TestBlend();
+
+	return OctoTest::GetFailureCount();
+}
@@ -0,0 +1,237 @@
+#include "OctoTest.h"
+#include "AssimpLoader.h"
+#include "MeshFile.h"
+
+//Other
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Core::Mesh;
+
+namespace
+{
+	const char* SOURCE_PATH = "MeshFileTest.obj";
+	const char* COOKED_PATH = "MeshFileTest.omesh";
+	const char* CORRUPT_PATH = "MeshFileTest_Corrupt.omesh";
+
+	//Quads per side of the grid, spanning -1 to 1 in x and y
+	const uint32_t GRID_SIZE = 16u;
+
+	bool WriteGrid(const char* path)
+	{
+		FILE* fp = fopen(path, "w");
+		if (fp == nullptr)
+		{
+			return false;
+		}
+
+		const float step = 2.0f / GRID_SIZE;
+		for (uint32_t y = 0u; y <= GRID_SIZE; y++)
+		{
+			for (uint32_t x = 0u; x <= GRID_SIZE; x++)
+			{
+				fprintf(fp, "v %f %f 0.0\n", -1.0f + x * step, -1.0f + y * step);
+				fprintf(fp, "vt %f %f\n", static_cast<float>(x) / GRID_SIZE, static_cast<float>(y) / GRID_SIZE);
+			}
+		}
+		fprintf(fp, "vn 0.0 0.0 1.0\n");
+
+		//Counter clockwise seen from +z, OBJ indices start at 1
+		for (uint32_t y = 0u; y < GRID_SIZE; y++)
+		{
+			for (uint32_t x = 0u; x < GRID_SIZE; x++)
+			{
+				const uint32_t i0 = y * (GRID_SIZE + 1u) + x + 1u;
+				const uint32_t i1 = i0 + 1u;
+				const uint32_t i2 = i0 + GRID_SIZE + 1u;
+				const uint32_t i3 = i2 + 1u;
+				fprintf(fp, "f %u/%u/1 %u/%u/1 %u/%u/1\n", i0, i0, i1, i1, i3, i3);
+				fprintf(fp, "f %u/%u/1 %u/%u/1 %u/%u/1\n", i0, i0, i3, i3, i2, i2);
+			}
+		}
+
+		fclose(fp);
+		return true;
+	}
+
+	std::vector<uint8_t> ReadFile(const char* path)
+	{
+		std::vector<uint8_t> bytes;
+		FILE* fp = fopen(path, "rb");
+		if (fp == nullptr)
+		{
+			return bytes;
+		}
+
+		fseek(fp, 0, SEEK_END);
+		bytes.resize(static_cast<size_t>(ftell(fp)));
+		fseek(fp, 0, SEEK_SET);
+		bytes.resize(fread(bytes.data(), 1u, bytes.size(), fp));
+		fclose(fp);
+		return bytes;
+	}
+
+	//Writes the bytes as a cooked file and loads it, the mapping is released so the next copy can replace the file
+	bool LoadBytes(const std::vector<uint8_t>& bytes)
+	{
+		FILE* fp = fopen(CORRUPT_PATH, "wb");
+		if (fp == nullptr)
+		{
+			return false;
+		}
+
+		fwrite(bytes.data(), 1u, bytes.size(), fp);
+		fclose(fp);
+
+		MeshFile meshFile;
+		const bool loaded = meshFile.Load(CORRUPT_PATH);
+		meshFile.Release();
+		return loaded;
+	}
+
+	uint32_t GetIndex(const MeshFile& meshFile, uint32_t index)
+	{
+		return meshFile.GetHeader().indexSize == sizeof(uint16_t)
+			? static_cast<const uint16_t*>(meshFile.GetIndexData())[index]
+			: static_cast<const uint32_t*>(meshFile.GetIndexData())[index];
+	}
+
+	glm::vec3 DecodePosition(const MeshFile& meshFile, const MeshFileSubmesh& submesh, uint32_t vertexIdx)
+	{
+		const PositionQuantization quantization = GetPositionQuantization(submesh.bounds.min, submesh.bounds.max);
+		const PackedPosition* positions = static_cast<const PackedPosition*>(meshFile.GetVertexData());
+		return quantization.offset + glm::vec3(glm::unpackSnorm4x16(positions[submesh.vertexOffset + vertexIdx].position)) * quantization.scale;
+	}
+
+	void TestRoundTrip()
+	{
+		OCTO_CHECK(WriteGrid(SOURCE_PATH));
+		OCTO_CHECK(AssimpLoader::CookMesh(SOURCE_PATH, COOKED_PATH));
+		OCTO_CHECK(!AssimpLoader::IsCookedMeshStale(SOURCE_PATH, COOKED_PATH));
+
+		MeshFile meshFile;
+		OCTO_CHECK(meshFile.Load(COOKED_PATH));
+		if (!meshFile.IsLoaded())
+		{
+			return;
+		}
+
+		const MeshFileHeader& header = meshFile.GetHeader();
+		OCTO_CHECK(header.submeshCount == 1u);
+		OCTO_CHECK(header.vertexCount == (GRID_SIZE + 1u) * (GRID_SIZE + 1u));
+		OCTO_CHECK(!meshFile.IsSkinned());
+
+		const MeshFileSubmesh& submesh = meshFile.GetSubmeshes()[0];
+		OCTO_CHECK(submesh.indexCount == GRID_SIZE * GRID_SIZE * 6u);
+		OCTO_CHECK(submesh.vertexCount == header.vertexCount);
+		OCTO_CHECK(glm::all(glm::lessThan(glm::abs(submesh.bounds.min - glm::vec3(-1.0f, -1.0f, 0.0f)), glm::vec3(1e-5f))));
+		OCTO_CHECK(glm::all(glm::lessThan(glm::abs(submesh.bounds.max - glm::vec3(1.0f, 1.0f, 0.0f)), glm::vec3(1e-5f))));
+
+		//Decoded positions stay on the grid within the quantization error, normals keep pointing up
+		const float quantizationError = GetPositionQuantizationError(GetPositionQuantization(submesh.bounds.min, submesh.bounds.max));
+		const PackedAttributes* attributes = reinterpret_cast<const PackedAttributes*>(
+			static_cast<const uint8_t*>(meshFile.GetVertexData()) + (header.attributeOffset - header.positionOffset));
+		for (uint32_t vertexIdx = 0u; vertexIdx < submesh.vertexCount; vertexIdx++)
+		{
+			const glm::vec3 position = DecodePosition(meshFile, submesh, vertexIdx);
+			const glm::vec2 gridPosition = (glm::vec2(position) + 1.0f) * (GRID_SIZE * 0.5f);
+			OCTO_CHECK(glm::length(gridPosition - glm::round(gridPosition)) / (GRID_SIZE * 0.5f) <= quantizationError);
+			OCTO_CHECK(std::abs(position.z) <= quantizationError);
+
+			const glm::vec3 normal = OctahedralDecode(glm::unpackSnorm2x16(attributes[submesh.vertexOffset + vertexIdx].normal));
+			OCTO_CHECK(glm::dot(normal, glm::vec3(0.0f, 0.0f, 1.0f)) > 0.9999f);
+		}
+
+		//LOD 0 is the source surface with its winding
+		float area = 0.0f;
+		for (uint32_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount; i += 3u)
+		{
+			const glm::vec3 p0 = DecodePosition(meshFile, submesh, GetIndex(meshFile, i + 0u));
+			const glm::vec3 p1 = DecodePosition(meshFile, submesh, GetIndex(meshFile, i + 1u));
+			const glm::vec3 p2 = DecodePosition(meshFile, submesh, GetIndex(meshFile, i + 2u));
+			const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			OCTO_CHECK(normal.z > 0.0f);
+			area += glm::length(normal) * 0.5f;
+		}
+		OCTO_CHECK(std::abs(area - 4.0f) < 1e-3f);
+
+		const MeshFileLod* lods = meshFile.GetLods() + submesh.firstLod;
+		OCTO_CHECK(submesh.lodCount >= 1u && submesh.lodCount <= MAX_MESH_LODS);
+		OCTO_CHECK(lods[0].firstIndex == submesh.firstIndex && lods[0].indexCount == submesh.indexCount && lods[0].error == 0.0f);
+		for (uint32_t lodIdx = 0u; lodIdx < submesh.lodCount; lodIdx++)
+		{
+			OCTO_CHECK(lods[lodIdx].indexCount % 3u == 0u);
+			OCTO_CHECK(lodIdx == 0u || (lods[lodIdx].indexCount < lods[lodIdx - 1u].indexCount && lods[lodIdx].error >= lods[lodIdx - 1u].error));
+			for (uint32_t i = lods[lodIdx].firstIndex; i < lods[lodIdx].firstIndex + lods[lodIdx].indexCount; i++)
+			{
+				OCTO_CHECK(GetIndex(meshFile, i) < submesh.vertexCount);
+			}
+		}
+
+		//Clusters split LOD 0 into contiguous ranges
+		const MeshFileCluster* clusters = meshFile.GetClusters() + submesh.firstCluster;
+		OCTO_CHECK(submesh.clusterCount > 1u);
+		uint32_t nextIndex = submesh.firstIndex;
+		for (uint32_t clusterIdx = 0u; clusterIdx < submesh.clusterCount; clusterIdx++)
+		{
+			OCTO_CHECK(clusters[clusterIdx].firstIndex == nextIndex);
+			OCTO_CHECK(clusters[clusterIdx].indexCount > 0u && clusters[clusterIdx].indexCount % 3u == 0u);
+			nextIndex = clusters[clusterIdx].firstIndex + clusters[clusterIdx].indexCount;
+		}
+		OCTO_CHECK(nextIndex == submesh.firstIndex + submesh.indexCount);
+
+		meshFile.Release();
+	}
+
+	void TestCorruptFiles()
+	{
+		const std::vector<uint8_t> bytes = ReadFile(COOKED_PATH);
+		OCTO_CHECK(bytes.size() > sizeof(MeshFileHeader));
+		if (bytes.size() <= sizeof(MeshFileHeader))
+		{
+			return;
+		}
+
+		OCTO_CHECK(LoadBytes(bytes));
+
+		MeshFileHeader header;
+		memcpy(&header, bytes.data(), sizeof(MeshFileHeader));
+
+		std::vector<uint8_t> truncated(bytes.begin(), bytes.begin() + bytes.size() / 2u);
+		OCTO_CHECK(!LoadBytes(truncated));
+
+		std::vector<uint8_t> otherVersion = bytes;
+		reinterpret_cast<MeshFileHeader*>(otherVersion.data())->version = MESH_FILE_VERSION + 1u;
+		OCTO_CHECK(!LoadBytes(otherVersion));
+
+		std::vector<uint8_t> offsetPastFile = bytes;
+		reinterpret_cast<MeshFileHeader*>(offsetPastFile.data())->indexOffset = ~0ull - 8u;
+		OCTO_CHECK(!LoadBytes(offsetPastFile));
+
+		std::vector<uint8_t> indexRange = bytes;
+		reinterpret_cast<MeshFileSubmesh*>(indexRange.data() + header.submeshOffset)->indexCount = header.indexCount + 3u;
+		OCTO_CHECK(!LoadBytes(indexRange));
+
+		std::vector<uint8_t> noLods = bytes;
+		reinterpret_cast<MeshFileSubmesh*>(noLods.data() + header.submeshOffset)->lodCount = 0u;
+		OCTO_CHECK(!LoadBytes(noLods));
+
+		std::vector<uint8_t> lodRange = bytes;
+		reinterpret_cast<MeshFileLod*>(lodRange.data() + header.lodOffset)->indexCount = header.indexCount + 3u;
+		OCTO_CHECK(!LoadBytes(lodRange));
+
+		std::vector<uint8_t> clusterRange = bytes;
+		reinterpret_cast<MeshFileCluster*>(clusterRange.data() + header.clusterOffset)->firstIndex = header.indexCount;
+		OCTO_CHECK(!LoadBytes(clusterRange));
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestCorruptFiles();
+
+	return OctoTest::GetFailureCount();
+}
@@ -0,0 +1,143 @@
+#include "OctoTest.h"
+#include "TestMeshes.h"
+#include "MeshOptimizer.h"
+
+//Other
+#include <algorithm>
+#include <array>
+#include <random>
+
+using namespace Core::Mesh;
+
+namespace
+{
+	typedef std::array<float, 9> TrianglePositions;
+
+	//Triangles by position, rotated to start at their smallest corner so the winding is kept
+	std::vector<TrianglePositions> GetTriangles(const std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		std::vector<TrianglePositions> triangles;
+		for (size_t i = 0u; i < indices.size(); i += 3u)
+		{
+			std::array<glm::vec3, 3> corners = { vertices[indices[i]].position, vertices[indices[i + 1u]].position, vertices[indices[i + 2u]].position };
+			auto less = [](const glm::vec3& lhs, const glm::vec3& rhs)
+			{
+				return lhs.x != rhs.x ? lhs.x < rhs.x : (lhs.y != rhs.y ? lhs.y < rhs.y : lhs.z < rhs.z);
+			};
+			std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+
+			TrianglePositions triangle;
+			for (uint32_t corner = 0u; corner < 3u; corner++)
+			{
+				triangle[corner * 3u + 0u] = corners[corner].x;
+				triangle[corner * 3u + 1u] = corners[corner].y;
+				triangle[corner * 3u + 2u] = corners[corner].z;
+			}
+			triangles.push_back(triangle);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	//Every triangle gets its own three vertices in random order, like an unindexed import
+	void Unweld(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices, std::mt19937& random)
+	{
+		std::vector<uint32_t> triangles(indices.size() / 3u);
+		for (uint32_t i = 0u; i < triangles.size(); i++)
+		{
+			triangles[i] = i;
+		}
+		std::shuffle(triangles.begin(), triangles.end(), random);
+
+		std::vector<CookedVertex> unweldedVertices;
+		std::vector<uint32_t> unweldedIndices;
+		for (const uint32_t triangle : triangles)
+		{
+			for (uint32_t corner = 0u; corner < 3u; corner++)
+			{
+				unweldedIndices.push_back(static_cast<uint32_t>(unweldedVertices.size()));
+				unweldedVertices.push_back(vertices[indices[triangle * 3u + corner]]);
+			}
+		}
+
+		vertices.swap(unweldedVertices);
+		indices.swap(unweldedIndices);
+	}
+
+	void TestOptimize()
+	{
+		std::mt19937 random(3u);
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32_t> indices;
+		OctoTest::MakeGrid(32u, vertices, indices);
+		const size_t weldedVertexCount = vertices.size();
+		const std::vector<TrianglePositions> sourceTriangles = GetTriangles(vertices, indices);
+
+		Unweld(vertices, indices, random);
+		MeshOptimizer::DeduplicateVertices(vertices, indices);
+		OCTO_CHECK(vertices.size() == weldedVertexCount);
+		const float shuffledACMR = MeshOptimizer::CalculateACMR(indices, static_cast<uint32_t>(vertices.size()));
+
+		MeshOptimizer::Optimize(vertices, indices);
+		OCTO_CHECK(vertices.size() == weldedVertexCount);
+		OCTO_CHECK(GetTriangles(vertices, indices) == sourceTriangles);
+
+		//Tipsify gets a regular grid close to the optimum of 0.5
+		const float optimizedACMR = MeshOptimizer::CalculateACMR(indices, static_cast<uint32_t>(vertices.size()));
+		OCTO_CHECK(optimizedACMR < shuffledACMR);
+		OCTO_CHECK(optimizedACMR < 0.8f);
+
+		//Vertices are stored in the order the indices reference them first
+		uint32_t nextVertex = 0u;
+		for (const uint32_t index : indices)
+		{
+			OCTO_CHECK(index <= nextVertex);
+			nextVertex = std::max(nextVertex, index + 1u);
+		}
+		OCTO_CHECK(nextVertex == vertices.size());
+	}
+
+	void TestVertexCache()
+	{
+		std::mt19937 random(5u);
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32_t> indices;
+		OctoTest::MakeGrid(32u, vertices, indices);
+		Unweld(vertices, indices, random);
+		MeshOptimizer::DeduplicateVertices(vertices, indices);
+		const std::vector<TrianglePositions> sourceTriangles = GetTriangles(vertices, indices);
+		const float shuffledACMR = MeshOptimizer::CalculateACMR(indices, static_cast<uint32_t>(vertices.size()));
+
+		std::vector<uint32_t> clusterStarts;
+		MeshOptimizer::OptimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()), clusterStarts);
+		OCTO_CHECK(GetTriangles(vertices, indices) == sourceTriangles);
+		OCTO_CHECK(MeshOptimizer::CalculateACMR(indices, static_cast<uint32_t>(vertices.size())) < shuffledACMR);
+
+		OCTO_CHECK(!clusterStarts.empty() && clusterStarts[0] == 0u);
+		for (size_t i = 1u; i < clusterStarts.size(); i++)
+		{
+			OCTO_CHECK(clusterStarts[i] > clusterStarts[i - 1u] && clusterStarts[i] < indices.size() / 3u);
+		}
+	}
+
+	void TestACMR()
+	{
+		//Separate triangles miss on every vertex, the worst case
+		const std::vector<uint32_t> separate = { 0u, 1u, 2u, 3u, 4u, 5u };
+		OCTO_CHECK(MeshOptimizer::CalculateACMR(separate, 6u) == 3.0f);
+
+		//A quad shares two vertices
+		const std::vector<uint32_t> quad = { 0u, 1u, 2u, 0u, 2u, 3u };
+		OCTO_CHECK(MeshOptimizer::CalculateACMR(quad, 4u) == 2.0f);
+	}
+}
+
+int main()
+{
+	TestOptimize();
+	TestVertexCache();
+	TestACMR();
+
+	return OctoTest::GetFailureCount();
+}
@@ -0,0 +1,137 @@
+#include "OctoTest.h"
+#include "TestMeshes.h"
+#include "MeshSimplifier.h"
+
+//Other
+#include <algorithm>
+#include <cmath>
+
+using namespace Core::Mesh;
+
+namespace
+{
+	//Valid indices, no degenerate triangles and nothing flipped against +z
+	void CheckTriangles(const std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		OCTO_CHECK(indices.size() % 3u == 0u);
+		for (size_t i = 0u; i < indices.size(); i += 3u)
+		{
+			const uint32_t a = indices[i + 0u];
+			const uint32_t b = indices[i + 1u];
+			const uint32_t c = indices[i + 2u];
+			OCTO_CHECK(a < vertices.size() && b < vertices.size() && c < vertices.size());
+			OCTO_CHECK(a != b && b != c && c != a);
+
+			const glm::vec3 normal = glm::cross(vertices[b].position - vertices[a].position, vertices[c].position - vertices[a].position);
+			OCTO_CHECK(normal.z > 0.0f);
+		}
+	}
+
+	float GetArea(const std::vector<CookedVertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		float area = 0.0f;
+		for (size_t i = 0u; i < indices.size(); i += 3u)
+		{
+			const glm::vec3& p0 = vertices[indices[i + 0u]].position;
+			area += glm::length(glm::cross(vertices[indices[i + 1u]].position - p0, vertices[indices[i + 2u]].position - p0)) * 0.5f;
+		}
+		return area;
+	}
+
+	void TestFlatGrid()
+	{
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32_t> indices;
+		OctoTest::MakeGrid(32u, vertices, indices);
+
+		//Collapses inside a plane and along its straight borders cost nothing
+		float error = -1.0f;
+		const std::vector<uint32_t> simplified = MeshSimplifier::Simplify(vertices, indices, static_cast<uint32_t>(indices.size() / 8u), error);
+		OCTO_CHECK(simplified.size() <= indices.size() / 8u);
+		OCTO_CHECK(error >= 0.0f && error < 1e-4f);
+		OCTO_CHECK(std::abs(GetArea(vertices, simplified) - 4.0f) < 1e-3f);
+		CheckTriangles(vertices, simplified);
+
+		//Nothing to do above the target
+		const std::vector<uint32_t> unchanged = MeshSimplifier::Simplify(vertices, indices, static_cast<uint32_t>(indices.size()), error);
+		OCTO_CHECK(unchanged == indices && error == 0.0f);
+	}
+
+	void TestHeightField()
+	{
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32_t> indices;
+		OctoTest::MakeGrid(32u, vertices, indices);
+		for (CookedVertex& vertex : vertices)
+		{
+			vertex.position.z = 0.1f * std::sin(vertex.position.x * 3.0f) * std::cos(vertex.position.y * 2.0f);
+		}
+
+		float coarseError = 0.0f;
+		float fineError = 0.0f;
+		const std::vector<uint32_t> fine = MeshSimplifier::Simplify(vertices, indices, static_cast<uint32_t>(indices.size() / 2u), fineError);
+		const std::vector<uint32_t> coarse = MeshSimplifier::Simplify(vertices, indices, static_cast<uint32_t>(indices.size() / 16u), coarseError);
+		OCTO_CHECK(fine.size() <= indices.size() / 2u);
+		OCTO_CHECK(coarse.size() < fine.size());
+		CheckTriangles(vertices, fine);
+		CheckTriangles(vertices, coarse);
+
+		//Curvature costs something, more collapses never cost less, and the surface stays within its amplitude
+		OCTO_CHECK(coarseError > 0.0f);
+		OCTO_CHECK(coarseError >= fineError);
+		OCTO_CHECK(coarseError < 0.2f);
+	}
+
+	void TestSeams()
+	{
+		//The right half gets its own vertices along x = 0 with other uvs, like a texture seam
+		const uint32_t gridSize = 16u;
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32_t> indices;
+		OctoTest::MakeGrid(gridSize, vertices, indices);
+
+		std::vector<uint32_t> seamVertices;
+		const uint32_t seamColumn = gridSize / 2u;
+		for (uint32_t y = 0u; y <= gridSize; y++)
+		{
+			const uint32_t vertexIdx = y * (gridSize + 1u) + seamColumn;
+			CookedVertex split = vertices[vertexIdx];
+			split.uv.x += 0.5f;
+
+			const uint32_t splitIdx = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(split);
+			seamVertices.push_back(vertexIdx);
+			seamVertices.push_back(splitIdx);
+
+			//Quads right of the seam use the split vertex
+			for (size_t i = 0u; i < indices.size(); i += 3u)
+			{
+				const bool rightOfSeam = vertices[indices[i + 0u]].position.x + vertices[indices[i + 1u]].position.x + vertices[indices[i + 2u]].position.x > 0.0f;
+				for (uint32_t corner = 0u; rightOfSeam && corner < 3u; corner++)
+				{
+					indices[i + corner] = indices[i + corner] == vertexIdx ? splitIdx : indices[i + corner];
+				}
+			}
+		}
+
+		float error = 0.0f;
+		const std::vector<uint32_t> simplified = MeshSimplifier::Simplify(vertices, indices, static_cast<uint32_t>(indices.size() / 8u), error);
+		OCTO_CHECK(simplified.size() < indices.size());
+		CheckTriangles(vertices, simplified);
+
+		//Seam vertices never collapse, so both sides still meet along the whole seam
+		for (const uint32_t vertexIdx : seamVertices)
+		{
+			OCTO_CHECK(std::find(simplified.begin(), simplified.end(), vertexIdx) != simplified.end());
+		}
+	}
+}
+
+int main()
+{
+	TestFlatGrid();
+	TestHeightField();
+	TestSeams();
+
+	return OctoTest::GetFailureCount();
+}
@@ -0,0 +1,75 @@
+#include "OctoTest.h"
+#include "TestMeshes.h"
+#include "MeshletBuilder.h"
+
+//Other
+#include <cmath>
+#include <unordered_set>
+
+using namespace Core::Mesh;
+
+namespace
+{
+	//Offset of the mesh in a shared index section
+	const uint32_t FIRST_INDEX = 96u;
+
+	void TestClusterLimits()
+	{
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32_t> indices;
+		OctoTest::MakeGrid(32u, vertices, indices);
+
+		std::vector<MeshFileCluster> clusters;
+		MeshletBuilder::Build(vertices, indices.data(), static_cast<uint32_t>(indices.size()), FIRST_INDEX, clusters);
+		OCTO_CHECK(clusters.size() > 1u);
+
+		//Clusters are contiguous ranges covering every index, each within the limits
+		uint32_t nextIndex = FIRST_INDEX;
+		for (const MeshFileCluster& cluster : clusters)
+		{
+			OCTO_CHECK(cluster.firstIndex == nextIndex);
+			OCTO_CHECK(cluster.indexCount > 0u && cluster.indexCount % 3u == 0u);
+			OCTO_CHECK(cluster.indexCount / 3u <= MAX_CLUSTER_TRIANGLES);
+			nextIndex = cluster.firstIndex + cluster.indexCount;
+
+			std::unordered_set<uint32_t> clusterVertices;
+			for (uint32_t i = cluster.firstIndex - FIRST_INDEX; i < cluster.firstIndex - FIRST_INDEX + cluster.indexCount; i++)
+			{
+				clusterVertices.insert(indices[i]);
+
+				//Bounding sphere holds every vertex of the cluster
+				const glm::vec3 center = glm::vec3(cluster.boundingSphere);
+				OCTO_CHECK(glm::distance(vertices[indices[i]].position, center) <= cluster.boundingSphere.w * 1.0001f);
+			}
+			OCTO_CHECK(clusterVertices.size() <= MAX_CLUSTER_VERTICES);
+
+			//All triangles face +z, so the cone is the axis itself
+			OCTO_CHECK(glm::dot(glm::vec3(cluster.cone), glm::vec3(0.0f, 0.0f, 1.0f)) > 0.9999f);
+			OCTO_CHECK(cluster.cone.w < 1e-3f);
+		}
+		OCTO_CHECK(nextIndex == FIRST_INDEX + indices.size());
+	}
+
+	void TestOpposingNormals()
+	{
+		//Two triangles facing away from each other can never be culled as a whole
+		std::vector<CookedVertex> vertices(4u);
+		vertices[0].position = glm::vec3(0.0f, 0.0f, 0.0f);
+		vertices[1].position = glm::vec3(1.0f, 0.0f, 0.0f);
+		vertices[2].position = glm::vec3(0.0f, 1.0f, 0.0f);
+		vertices[3].position = glm::vec3(0.0f, 0.0f, 1.0f);
+		const std::vector<uint32_t> indices = { 0u, 1u, 2u, 0u, 3u, 1u, 0u, 2u, 1u };
+
+		std::vector<MeshFileCluster> clusters;
+		MeshletBuilder::Build(vertices, indices.data(), static_cast<uint32_t>(indices.size()), 0u, clusters);
+		OCTO_CHECK(clusters.size() == 1u && clusters[0].cone.w == 1.0f);
+	}
+}
+
+int main()
+{
+	TestClusterLimits();
+	TestOpposingNormals();
+
+	return OctoTest::GetFailureCount();
+}
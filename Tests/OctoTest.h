@@ -0,0 +1,27 @@
+#pragma once
+
+//Other
+#include <cstdio>
+
+/*
+	Minimal checks for the tests, every test is its own executable.
+	Failed checks are printed and counted, main returns the count so a non zero exit code fails the test.
+*/
+namespace OctoTest
+{
+	inline int& GetFailureCount()
+	{
+		static int failureCount = 0;
+		return failureCount;
+	}
+}
+
+#define OCTO_CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("FAILED: %s:%d: %s \n", __FILE__, __LINE__, #condition); \
+			OctoTest::GetFailureCount()++; \
+		} \
+	} while (false)
@@ -0,0 +1,243 @@
+#include "OctoTest.h"
+#include "Vulkan/VkShaderReflection.h"
+
+//Other
+#include <initializer_list>
+
+using namespace Renderer::Resource;
+
+namespace
+{
+	const uint32_t SPIRV_MAGIC = 0x07230203u;
+
+	//Opcodes, decorations and storage classes the module below uses
+	const uint32_t OP_ENTRY_POINT = 15u;
+	const uint32_t OP_TYPE_INT = 21u;
+	const uint32_t OP_TYPE_FLOAT = 22u;
+	const uint32_t OP_TYPE_VECTOR = 23u;
+	const uint32_t OP_TYPE_IMAGE = 25u;
+	const uint32_t OP_TYPE_SAMPLED_IMAGE = 27u;
+	const uint32_t OP_TYPE_ARRAY = 28u;
+	const uint32_t OP_TYPE_RUNTIME_ARRAY = 29u;
+	const uint32_t OP_TYPE_STRUCT = 30u;
+	const uint32_t OP_TYPE_POINTER = 32u;
+	const uint32_t OP_CONSTANT = 43u;
+	const uint32_t OP_SPEC_CONSTANT = 50u;
+	const uint32_t OP_VARIABLE = 59u;
+	const uint32_t OP_DECORATE = 71u;
+	const uint32_t OP_MEMBER_DECORATE = 72u;
+
+	const uint32_t DECORATION_SPEC_ID = 1u;
+	const uint32_t DECORATION_BLOCK = 2u;
+	const uint32_t DECORATION_ARRAY_STRIDE = 6u;
+	const uint32_t DECORATION_BUILT_IN = 11u;
+	const uint32_t DECORATION_LOCATION = 30u;
+	const uint32_t DECORATION_BINDING = 33u;
+	const uint32_t DECORATION_DESCRIPTOR_SET = 34u;
+	const uint32_t DECORATION_OFFSET = 35u;
+
+	const uint32_t STORAGE_UNIFORM_CONSTANT = 0u;
+	const uint32_t STORAGE_INPUT = 1u;
+	const uint32_t STORAGE_UNIFORM = 2u;
+	const uint32_t STORAGE_PUSH_CONSTANT = 9u;
+	const uint32_t STORAGE_STORAGE_BUFFER = 12u;
+
+	const uint32_t EXECUTION_MODEL_VERTEX = 0u;
+	const uint32_t EXECUTION_MODEL_FRAGMENT = 4u;
+
+	//Hand assembled module, ids are numbered by hand so the expectations can name them
+	struct SpirvModule
+	{
+		SpirvModule(uint32_t idBound)
+		{
+			code = { SPIRV_MAGIC, 0x00010000u, 0u, idBound, 0u };
+		}
+
+		void Add(uint32_t op, std::initializer_list<uint32_t> operands)
+		{
+			code.push_back((static_cast<uint32_t>(operands.size() + 1u) << 16u) | op);
+			code.insert(code.end(), operands);
+		}
+
+		bool Reflect(ShaderReflection& reflection) const
+		{
+			return ShaderReflector::Reflect(code.data(), code.size(), reflection);
+		}
+
+		std::vector<uint32_t> code;
+	};
+
+	/*
+		What glslang emits for a vertex shader with
+			layout(set = 0, binding = 3) uniform Camera { vec4 position; };
+			layout(set = 1, binding = 0) buffer Lights { vec4 lights[]; };
+			layout(set = 0, binding = 1) uniform sampler2D textures[4];
+			layout(push_constant) uniform Push { layout(offset = 16) vec4 color; uvec2 ids; };
+			layout(constant_id = 5) const uint COUNT = 7;
+			layout(location = 2) in vec4 inColor;
+			layout(location = 0) in uvec2 inIds;
+		and gl_VertexIndex.
+	*/
+	SpirvModule MakeVertexShader(uint32_t executionModel)
+	{
+		SpirvModule module(28u);
+		module.Add(OP_ENTRY_POINT, { executionModel, 1u, 0x6E69616Du, 0u });
+
+		module.Add(OP_DECORATE, { 6u, DECORATION_BLOCK });
+		module.Add(OP_MEMBER_DECORATE, { 6u, 0u, DECORATION_OFFSET, 0u });
+		module.Add(OP_DECORATE, { 8u, DECORATION_DESCRIPTOR_SET, 0u });
+		module.Add(OP_DECORATE, { 8u, DECORATION_BINDING, 3u });
+		module.Add(OP_DECORATE, { 10u, DECORATION_ARRAY_STRIDE, 16u });
+		module.Add(OP_DECORATE, { 9u, DECORATION_BLOCK });
+		module.Add(OP_MEMBER_DECORATE, { 9u, 0u, DECORATION_OFFSET, 0u });
+		module.Add(OP_DECORATE, { 12u, DECORATION_DESCRIPTOR_SET, 1u });
+		module.Add(OP_DECORATE, { 12u, DECORATION_BINDING, 0u });
+		module.Add(OP_DECORATE, { 18u, DECORATION_DESCRIPTOR_SET, 0u });
+		module.Add(OP_DECORATE, { 18u, DECORATION_BINDING, 1u });
+		module.Add(OP_DECORATE, { 19u, DECORATION_BLOCK });
+		module.Add(OP_MEMBER_DECORATE, { 19u, 0u, DECORATION_OFFSET, 16u });
+		module.Add(OP_MEMBER_DECORATE, { 19u, 1u, DECORATION_OFFSET, 32u });
+		module.Add(OP_DECORATE, { 22u, DECORATION_SPEC_ID, 5u });
+		module.Add(OP_DECORATE, { 24u, DECORATION_LOCATION, 2u });
+		module.Add(OP_DECORATE, { 26u, DECORATION_LOCATION, 0u });
+		module.Add(OP_DECORATE, { 27u, DECORATION_BUILT_IN, 42u });
+
+		module.Add(OP_TYPE_FLOAT, { 2u, 32u });
+		module.Add(OP_TYPE_VECTOR, { 3u, 2u, 4u });
+		module.Add(OP_TYPE_INT, { 4u, 32u, 0u });
+		module.Add(OP_TYPE_VECTOR, { 5u, 4u, 2u });
+
+		module.Add(OP_TYPE_STRUCT, { 6u, 3u });
+		module.Add(OP_TYPE_POINTER, { 7u, STORAGE_UNIFORM, 6u });
+		module.Add(OP_VARIABLE, { 7u, 8u, STORAGE_UNIFORM });
+
+		module.Add(OP_TYPE_RUNTIME_ARRAY, { 10u, 3u });
+		module.Add(OP_TYPE_STRUCT, { 9u, 10u });
+		module.Add(OP_TYPE_POINTER, { 11u, STORAGE_STORAGE_BUFFER, 9u });
+		module.Add(OP_VARIABLE, { 11u, 12u, STORAGE_STORAGE_BUFFER });
+
+		module.Add(OP_TYPE_IMAGE, { 13u, 2u, 1u, 0u, 0u, 0u, 1u, 0u });
+		module.Add(OP_TYPE_SAMPLED_IMAGE, { 14u, 13u });
+		module.Add(OP_CONSTANT, { 4u, 15u, 4u });
+		module.Add(OP_TYPE_ARRAY, { 16u, 14u, 15u });
+		module.Add(OP_TYPE_POINTER, { 17u, STORAGE_UNIFORM_CONSTANT, 16u });
+		module.Add(OP_VARIABLE, { 17u, 18u, STORAGE_UNIFORM_CONSTANT });
+
+		module.Add(OP_TYPE_STRUCT, { 19u, 3u, 5u });
+		module.Add(OP_TYPE_POINTER, { 20u, STORAGE_PUSH_CONSTANT, 19u });
+		module.Add(OP_VARIABLE, { 20u, 21u, STORAGE_PUSH_CONSTANT });
+
+		module.Add(OP_SPEC_CONSTANT, { 4u, 22u, 7u });
+
+		module.Add(OP_TYPE_POINTER, { 23u, STORAGE_INPUT, 3u });
+		module.Add(OP_VARIABLE, { 23u, 24u, STORAGE_INPUT });
+		module.Add(OP_TYPE_POINTER, { 25u, STORAGE_INPUT, 5u });
+		module.Add(OP_VARIABLE, { 25u, 26u, STORAGE_INPUT });
+		module.Add(OP_VARIABLE, { 23u, 27u, STORAGE_INPUT });
+		return module;
+	}
+
+	void TestReflect()
+	{
+		ShaderReflection reflection;
+		OCTO_CHECK(MakeVertexShader(EXECUTION_MODEL_VERTEX).Reflect(reflection));
+
+		//Sorted by set and binding
+		OCTO_CHECK(reflection.bindings.size() == 3u);
+		if (reflection.bindings.size() == 3u)
+		{
+			const ShaderBinding& textures = reflection.bindings[0];
+			OCTO_CHECK(textures.set == 0u && textures.binding == 1u);
+			OCTO_CHECK(textures.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && textures.descriptorCount == 4u);
+
+			const ShaderBinding& camera = reflection.bindings[1];
+			OCTO_CHECK(camera.set == 0u && camera.binding == 3u);
+			OCTO_CHECK(camera.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && camera.descriptorCount == 1u);
+
+			const ShaderBinding& lights = reflection.bindings[2];
+			OCTO_CHECK(lights.set == 1u && lights.binding == 0u);
+			OCTO_CHECK(lights.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && lights.descriptorCount == 1u);
+		}
+
+		//The block starts at 16 and ends after the uvec2 at 32
+		OCTO_CHECK(reflection.pushConstantOffset == 16u && reflection.pushConstantSize == 24u);
+
+		OCTO_CHECK(reflection.specializationConstants.size() == 1u);
+		if (reflection.specializationConstants.size() == 1u)
+		{
+			const ShaderSpecializationConstant& count = reflection.specializationConstants[0];
+			OCTO_CHECK(count.constantId == 5u && count.size == 4u && count.defaultValue == 7u);
+		}
+
+		//Sorted by location, gl_VertexIndex is skipped
+		OCTO_CHECK(reflection.vertexInputs.size() == 2u);
+		if (reflection.vertexInputs.size() == 2u)
+		{
+			OCTO_CHECK(reflection.vertexInputs[0].location == 0u && reflection.vertexInputs[0].format == VK_FORMAT_R32G32_UINT);
+			OCTO_CHECK(reflection.vertexInputs[1].location == 2u && reflection.vertexInputs[1].format == VK_FORMAT_R32G32B32A32_SFLOAT);
+		}
+
+		//Inputs of other stages are no vertex attributes
+		OCTO_CHECK(MakeVertexShader(EXECUTION_MODEL_FRAGMENT).Reflect(reflection));
+		OCTO_CHECK(reflection.vertexInputs.empty() && reflection.bindings.size() == 3u);
+	}
+
+	void TestMalformed()
+	{
+		ShaderReflection reflection;
+		const SpirvModule valid = MakeVertexShader(EXECUTION_MODEL_VERTEX);
+
+		OCTO_CHECK(!ShaderReflector::Reflect(nullptr, 0u, reflection));
+		OCTO_CHECK(!ShaderReflector::Reflect(valid.code.data(), 4u, reflection));
+
+		SpirvModule badMagic = valid;
+		badMagic.code[0] = 0x03022307u;
+		OCTO_CHECK(!badMagic.Reflect(reflection));
+
+		SpirvModule hugeBound = valid;
+		hugeBound.code[3] = ~0u;
+		OCTO_CHECK(!hugeBound.Reflect(reflection));
+
+		//Last instruction claims more words than the module has
+		SpirvModule truncated = valid;
+		truncated.code.pop_back();
+		OCTO_CHECK(!truncated.Reflect(reflection));
+
+		SpirvModule shortVector(8u);
+		shortVector.Add(OP_TYPE_FLOAT, { 2u, 32u });
+		shortVector.Add(OP_TYPE_VECTOR, { 3u, 2u });
+		OCTO_CHECK(!shortVector.Reflect(reflection));
+
+		SpirvModule undeclaredMember(8u);
+		undeclaredMember.Add(OP_TYPE_STRUCT, { 5u, 3u });
+		OCTO_CHECK(!undeclaredMember.Reflect(reflection));
+
+		SpirvModule hugeMember(8u);
+		hugeMember.Add(OP_MEMBER_DECORATE, { 5u, 0x7FFFFFFFu, DECORATION_OFFSET, 0u });
+		OCTO_CHECK(!hugeMember.Reflect(reflection));
+
+		SpirvModule missingLiteral(8u);
+		missingLiteral.Add(OP_DECORATE, { 5u, DECORATION_BINDING });
+		OCTO_CHECK(!missingLiteral.Reflect(reflection));
+
+		SpirvModule idOutOfBound(8u);
+		idOutOfBound.Add(OP_TYPE_FLOAT, { 8u, 32u });
+		OCTO_CHECK(!idOutOfBound.Reflect(reflection));
+
+		//A struct containing itself would send the size calculation into a loop
+		SpirvModule redefined(8u);
+		redefined.Add(OP_TYPE_FLOAT, { 2u, 32u });
+		redefined.Add(OP_TYPE_STRUCT, { 3u, 2u });
+		redefined.Add(OP_TYPE_STRUCT, { 3u, 3u });
+		OCTO_CHECK(!redefined.Reflect(reflection));
+		OCTO_CHECK(reflection.bindings.empty() && reflection.pushConstantSize == 0u);
+	}
+}
+
+int main()
+{
+	TestReflect();
+	TestMalformed();
+
+	return OctoTest::GetFailureCount();
+}
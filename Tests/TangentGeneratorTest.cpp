@@ -0,0 +1,102 @@
+#include "OctoTest.h"
+#include "TestMeshes.h"
+#include "TangentGenerator.h"
+
+//Other
+#include <cmath>
+
+using namespace Core::Mesh;
+
+namespace
+{
+	//5x5 quads are 50 triangles and 36 vertices, 7x7 are 98 and 64, so the batches of four get a tail on either side
+	const uint32_t GRID_SIZES[] = { 5u, 7u };
+
+	void TestFlatGrid()
+	{
+		for (const uint32_t gridSize : GRID_SIZES)
+		{
+			std::vector<CookedVertex> vertices;
+			std::vector<uint32_t> indices;
+			OctoTest::MakeGrid(gridSize, vertices, indices);
+
+			//u follows x and v follows y, the frame is the xy axes
+			TangentGenerator::Generate(vertices, indices);
+			for (const CookedVertex& vertex : vertices)
+			{
+				OCTO_CHECK(glm::distance(vertex.tangent, glm::vec3(1.0f, 0.0f, 0.0f)) < 1e-4f);
+				OCTO_CHECK(glm::distance(vertex.bitangent, glm::vec3(0.0f, 1.0f, 0.0f)) < 1e-4f);
+			}
+
+			//Mirrored uvs flip the tangent and keep the bitangent through the handedness
+			for (CookedVertex& vertex : vertices)
+			{
+				vertex.uv.x = 1.0f - vertex.uv.x;
+			}
+
+			TangentGenerator::Generate(vertices, indices);
+			for (const CookedVertex& vertex : vertices)
+			{
+				OCTO_CHECK(glm::distance(vertex.tangent, glm::vec3(-1.0f, 0.0f, 0.0f)) < 1e-4f);
+				OCTO_CHECK(glm::distance(vertex.bitangent, glm::vec3(0.0f, 1.0f, 0.0f)) < 1e-4f);
+			}
+		}
+	}
+
+	void TestCurvedSurface()
+	{
+		for (const uint32_t gridSize : GRID_SIZES)
+		{
+			std::vector<CookedVertex> vertices;
+			std::vector<uint32_t> indices;
+			OctoTest::MakeGrid(gridSize, vertices, indices);
+
+			//z = 0.3 sin(2x) cos(y) with its analytic normals
+			for (CookedVertex& vertex : vertices)
+			{
+				const float x = vertex.position.x;
+				const float y = vertex.position.y;
+				vertex.position.z = 0.3f * std::sin(2.0f * x) * std::cos(y);
+				vertex.normal = glm::normalize(glm::vec3(-0.6f * std::cos(2.0f * x) * std::cos(y), 0.3f * std::sin(2.0f * x) * std::sin(y), 1.0f));
+			}
+
+			//Frames are orthonormal and still follow the uv directions
+			TangentGenerator::Generate(vertices, indices);
+			for (const CookedVertex& vertex : vertices)
+			{
+				OCTO_CHECK(std::abs(glm::length(vertex.tangent) - 1.0f) < 1e-4f);
+				OCTO_CHECK(std::abs(glm::dot(vertex.tangent, vertex.normal)) < 1e-4f);
+				OCTO_CHECK(glm::distance(vertex.bitangent, glm::cross(vertex.normal, vertex.tangent)) < 1e-4f);
+				OCTO_CHECK(vertex.tangent.x > 0.5f && vertex.bitangent.y > 0.5f);
+			}
+		}
+	}
+
+	void TestDegenerateUvs()
+	{
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32_t> indices;
+		OctoTest::MakeGrid(5u, vertices, indices);
+		for (CookedVertex& vertex : vertices)
+		{
+			vertex.uv = glm::vec2(0.5f);
+		}
+
+		//Without uv derivatives any tangent perpendicular to the normal will do
+		TangentGenerator::Generate(vertices, indices);
+		for (const CookedVertex& vertex : vertices)
+		{
+			OCTO_CHECK(std::abs(glm::length(vertex.tangent) - 1.0f) < 1e-4f);
+			OCTO_CHECK(std::abs(glm::dot(vertex.tangent, vertex.normal)) < 1e-4f);
+		}
+	}
+}
+
+int main()
+{
+	TestFlatGrid();
+	TestCurvedSurface();
+	TestDegenerateUvs();
+
+	return OctoTest::GetFailureCount();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "MeshFile.h"
+
+//Other
+#include <vector>
+
+namespace OctoTest
+{
+	/*
+		Flat grid of quads in the xy plane spanning -1 to 1, counter clockwise seen from +z.
+		Normals point up, uvs follow xy from 0 to 1, tangent frames are left zero.
+	*/
+	inline void MakeGrid(uint32_t gridSize, std::vector<Core::Mesh::CookedVertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		vertices.clear();
+		indices.clear();
+
+		const float step = 2.0f / gridSize;
+		for (uint32_t y = 0u; y <= gridSize; y++)
+		{
+			for (uint32_t x = 0u; x <= gridSize; x++)
+			{
+				Core::Mesh::CookedVertex vertex = {};
+				vertex.position = glm::vec3(-1.0f + x * step, -1.0f + y * step, 0.0f);
+				vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+				vertex.color = glm::vec3(1.0f);
+				vertex.uv = glm::vec2(static_cast<float>(x) / gridSize, static_cast<float>(y) / gridSize);
+				vertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t y = 0u; y < gridSize; y++)
+		{
+			for (uint32_t x = 0u; x < gridSize; x++)
+			{
+				const uint32_t i0 = y * (gridSize + 1u) + x;
+				const uint32_t i1 = i0 + 1u;
+				const uint32_t i2 = i0 + gridSize + 1u;
+				const uint32_t i3 = i2 + 1u;
+				indices.insert(indices.end(), { i0, i1, i3, i0, i3, i2 });
+			}
+		}
+	}
+}
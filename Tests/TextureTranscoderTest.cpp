@@ -0,0 +1,262 @@
+#include "OctoTest.h"
+#include "TextureTranscoder.h"
+
+//Other
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace Core::Texture;
+
+namespace
+{
+	const uint32_t BLOCK_TEXELS = 16u;
+
+	/*
+		Reference decoders as written in the BC specification, independent of the encoder.
+		Every decoder writes RGBA8 texels, channels a format does not store are left untouched.
+	*/
+	void DecodeRgb565(uint16_t color, uint8_t* rgb)
+	{
+		const uint32_t r = (color >> 11u) & 31u;
+		const uint32_t g = (color >> 5u) & 63u;
+		const uint32_t b = color & 31u;
+		rgb[0] = static_cast<uint8_t>((r << 3u) | (r >> 2u));
+		rgb[1] = static_cast<uint8_t>((g << 2u) | (g >> 4u));
+		rgb[2] = static_cast<uint8_t>((b << 3u) | (b >> 2u));
+	}
+
+	void DecodeBC1(const uint8_t* block, uint8_t texels[64])
+	{
+		uint16_t color0;
+		uint16_t color1;
+		uint32_t indices;
+		memcpy(&color0, block, sizeof(uint16_t));
+		memcpy(&color1, block + 2, sizeof(uint16_t));
+		memcpy(&indices, block + 4, sizeof(uint32_t));
+
+		uint8_t palette[4][3];
+		DecodeRgb565(color0, palette[0]);
+		DecodeRgb565(color1, palette[1]);
+		for (uint32_t channel = 0; channel < 3u; ++channel)
+		{
+			if (color0 > color1)
+			{
+				palette[2][channel] = static_cast<uint8_t>((2u * palette[0][channel] + palette[1][channel]) / 3u);
+				palette[3][channel] = static_cast<uint8_t>((palette[0][channel] + 2u * palette[1][channel]) / 3u);
+			}
+			else
+			{
+				palette[2][channel] = static_cast<uint8_t>((palette[0][channel] + palette[1][channel]) / 2u);
+				palette[3][channel] = 0u;
+			}
+		}
+
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			memcpy(&texels[i * 4u], palette[(indices >> (i * 2u)) & 3u], 3u);
+		}
+	}
+
+	void DecodeBC4(const uint8_t* block, uint32_t channel, uint8_t texels[64])
+	{
+		uint32_t palette[8];
+		palette[0] = block[0];
+		palette[1] = block[1];
+		for (uint32_t p = 2; p < 8u; ++p)
+		{
+			palette[p] = block[0] > block[1]
+				? ((8u - p) * palette[0] + (p - 1u) * palette[1]) / 7u
+				: (p < 6u ? ((6u - p) * palette[0] + (p - 1u) * palette[1]) / 5u : (p == 6u ? 0u : 255u));
+		}
+
+		uint64_t indices = 0;
+		for (uint32_t i = 0; i < 6u; ++i)
+		{
+			indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8u);
+		}
+
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			texels[i * 4u + channel] = static_cast<uint8_t>(palette[(indices >> (i * 3u)) & 7u]);
+		}
+	}
+
+	uint32_t ReadBits(const uint8_t* block, uint32_t& bitOffset, uint32_t bitCount)
+	{
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < bitCount; ++i, ++bitOffset)
+		{
+			value |= ((block[bitOffset / 8u] >> (bitOffset % 8u)) & 1u) << i;
+		}
+		return value;
+	}
+
+	//Mode 6 only, @return false for any other mode
+	bool DecodeBC7(const uint8_t* block, uint8_t texels[64])
+	{
+		static const uint32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		uint32_t bitOffset = 0;
+		if (ReadBits(block, bitOffset, 7u) != (1u << 6u))
+		{
+			return false;
+		}
+
+		uint32_t endpoints[2][4];
+		for (uint32_t channel = 0; channel < 4u; ++channel)
+		{
+			endpoints[0][channel] = ReadBits(block, bitOffset, 7u) << 1u;
+			endpoints[1][channel] = ReadBits(block, bitOffset, 7u) << 1u;
+		}
+
+		const uint32_t pBit0 = ReadBits(block, bitOffset, 1u);
+		const uint32_t pBit1 = ReadBits(block, bitOffset, 1u);
+		for (uint32_t channel = 0; channel < 4u; ++channel)
+		{
+			endpoints[0][channel] |= pBit0;
+			endpoints[1][channel] |= pBit1;
+		}
+
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			const uint32_t weight = weights[ReadBits(block, bitOffset, i == 0u ? 3u : 4u)];
+			for (uint32_t channel = 0; channel < 4u; ++channel)
+			{
+				texels[i * 4u + channel] = static_cast<uint8_t>(((64u - weight) * endpoints[0][channel] + weight * endpoints[1][channel] + 32u) >> 6u);
+			}
+		}
+		return true;
+	}
+
+	void Decode(const uint8_t* block, TranscodeFormat::Enum format, uint8_t texels[64])
+	{
+		memset(texels, 0, 64u);
+		switch (format)
+		{
+		case TranscodeFormat::kBC1:
+			DecodeBC1(block, texels);
+			break;
+		case TranscodeFormat::kBC3:
+			DecodeBC4(block, 3u, texels);
+			DecodeBC1(block + 8, texels);
+			break;
+		case TranscodeFormat::kBC5:
+			DecodeBC4(block, 0u, texels);
+			DecodeBC4(block + 8, 1u, texels);
+			break;
+		case TranscodeFormat::kBC7:
+			OCTO_CHECK(DecodeBC7(block, texels));
+			break;
+		}
+	}
+
+	//Largest difference over the channels the format stores
+	int32_t GetMaxError(const uint8_t source[64], const uint8_t decoded[64], TranscodeFormat::Enum format)
+	{
+		const uint32_t channelMask = format == TranscodeFormat::kBC1 ? 0x7u : (format == TranscodeFormat::kBC5 ? 0x3u : 0xFu);
+
+		int32_t maxError = 0;
+		for (uint32_t i = 0; i < 64u; ++i)
+		{
+			maxError = (channelMask >> (i % 4u)) & 1u ? std::max(maxError, std::abs(source[i] - decoded[i])) : maxError;
+		}
+		return maxError;
+	}
+
+	int32_t EncodeDecode(const uint8_t texels[64], TranscodeFormat::Enum format)
+	{
+		uint8_t block[16] = {};
+		uint8_t decoded[64];
+		TextureTranscoder::EncodeBlock(texels, format, block);
+		Decode(block, format, decoded);
+		return GetMaxError(texels, decoded, format);
+	}
+
+	void TestSolidBlocks()
+	{
+		std::mt19937 random(17u);
+		std::uniform_int_distribution<uint32_t> byte(0u, 255u);
+
+		for (uint32_t test = 0; test < 256u; ++test)
+		{
+			uint8_t color[4] = { static_cast<uint8_t>(byte(random)), static_cast<uint8_t>(byte(random)), static_cast<uint8_t>(byte(random)), static_cast<uint8_t>(byte(random)) };
+			uint8_t texels[64];
+			for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+			{
+				memcpy(&texels[i * 4u], color, 4u);
+			}
+
+			//565 rounding in BC1 and BC3 color, exact single channel blocks, 7 bit endpoints with a p-bit in BC7
+			OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC1) <= 4);
+			OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC3) <= 4);
+			OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC5) == 0);
+			OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC7) <= 1);
+		}
+	}
+
+	void TestGradientBlocks()
+	{
+		//16 levels on one line through RGBA, every channel covers most of its range
+		uint8_t texels[64];
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			texels[i * 4u + 0u] = static_cast<uint8_t>(i * 17u);
+			texels[i * 4u + 1u] = static_cast<uint8_t>(255u - i * 17u);
+			texels[i * 4u + 2u] = static_cast<uint8_t>(40u + i * 12u);
+			texels[i * 4u + 3u] = static_cast<uint8_t>(255u - i * 15u);
+		}
+
+		//Half a palette step plus endpoint rounding: 255 / 3 / 2 for four colors, 255 / 7 / 2 for eight values, BC7 has a weight per level
+		OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC1) <= 47);
+		OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC3) <= 47);
+		OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC5) <= 19);
+		OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC7) <= 3);
+
+		//Four levels fall on the BC1 palette itself
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			const uint32_t level = i % 4u;
+			texels[i * 4u + 0u] = static_cast<uint8_t>(level * 85u);
+			texels[i * 4u + 1u] = static_cast<uint8_t>(255u - level * 85u);
+			texels[i * 4u + 2u] = static_cast<uint8_t>(level * 85u);
+			texels[i * 4u + 3u] = 255u;
+		}
+
+		OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC1) <= 4);
+		OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC7) <= 3);
+	}
+
+	void TestNoiseBlocks()
+	{
+		std::mt19937 random(23u);
+		std::uniform_int_distribution<uint32_t> byte(0u, 255u);
+
+		//Uncorrelated channels are the worst case, BC5 still fits each channel on its own and BC7 stays in mode 6
+		for (uint32_t test = 0; test < 64u; ++test)
+		{
+			uint8_t texels[64];
+			for (uint32_t i = 0; i < 64u; ++i)
+			{
+				texels[i] = static_cast<uint8_t>(byte(random));
+			}
+
+			OCTO_CHECK(EncodeDecode(texels, TranscodeFormat::kBC5) <= 19);
+
+			uint8_t block[16] = {};
+			uint8_t decoded[64];
+			TextureTranscoder::EncodeBlock(texels, TranscodeFormat::kBC7, block);
+			OCTO_CHECK(DecodeBC7(block, decoded));
+		}
+	}
+}
+
+int main()
+{
+	TestSolidBlocks();
+	TestGradientBlocks();
+	TestNoiseBlocks();
+
+	return OctoTest::GetFailureCount();
+}
@@ -0,0 +1,113 @@
+#include "OctoTest.h"
+#include "VertexPacking.h"
+
+//Other
+#include <cmath>
+#include <random>
+
+using namespace Core::Mesh;
+
+namespace
+{
+	glm::vec3 UnpackPosition(const PackedPosition& packed, const PositionQuantization& quantization)
+	{
+		return quantization.offset + glm::vec3(glm::unpackSnorm4x16(packed.position)) * quantization.scale;
+	}
+
+	void TestPositions()
+	{
+		std::mt19937 random(7u);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		//Far from the origin, where half floats would have lost the detail
+		const glm::vec3 boundsMin = glm::vec3(1000.0f, -20.0f, 5000.0f);
+		const glm::vec3 boundsMax = glm::vec3(1010.0f, 20.0f, 5000.5f);
+		const PositionQuantization quantization = GetPositionQuantization(boundsMin, boundsMax);
+		const float error = GetPositionQuantizationError(quantization);
+
+		for (uint32_t i = 0u; i < 10000u; i++)
+		{
+			const glm::vec3 position = glm::mix(boundsMin, boundsMax, glm::vec3(unit(random), unit(random), unit(random)));
+			const PackedPosition packed = PackPosition(position, quantization);
+			OCTO_CHECK(glm::distance(UnpackPosition(packed, quantization), position) <= error);
+			OCTO_CHECK((packed.position >> 48u) == 0x7FFFu);
+		}
+
+		//Corners are exact up to float error, positions outside are clamped to the box
+		OCTO_CHECK(glm::distance(UnpackPosition(PackPosition(boundsMin, quantization), quantization), boundsMin) <= error);
+		OCTO_CHECK(glm::distance(UnpackPosition(PackPosition(boundsMax, quantization), quantization), boundsMax) <= error);
+		OCTO_CHECK(glm::distance(UnpackPosition(PackPosition(boundsMax + 100.0f, quantization), quantization), boundsMax) <= error);
+
+		//Flat boxes keep working on their flat axis
+		const PositionQuantization flat = GetPositionQuantization(glm::vec3(-1.0f, 2.0f, -1.0f), glm::vec3(1.0f, 2.0f, 1.0f));
+		OCTO_CHECK(std::abs(UnpackPosition(PackPosition(glm::vec3(0.5f, 2.0f, 0.5f), flat), flat).y - 2.0f) <= GetPositionQuantizationError(flat));
+	}
+
+	void TestNormals()
+	{
+		std::mt19937 random(11u);
+		std::normal_distribution<float> gaussian(0.0f, 1.0f);
+
+		//Octahedral snorm16 keeps normals within a few thousandths of a degree
+		for (uint32_t i = 0u; i < 10000u; i++)
+		{
+			const glm::vec3 normal = glm::normalize(glm::vec3(gaussian(random), gaussian(random), gaussian(random)));
+			const glm::vec3 decoded = OctahedralDecode(glm::unpackSnorm2x16(glm::packSnorm2x16(OctahedralEncode(normal))));
+			OCTO_CHECK(glm::dot(normal, decoded) > 0.99999f);
+		}
+
+		const glm::vec3 axes[] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+		for (const glm::vec3& axis : axes)
+		{
+			OCTO_CHECK(glm::dot(OctahedralDecode(OctahedralEncode(axis)), axis) > 0.99999f);
+		}
+	}
+
+	void TestAttributes()
+	{
+		const glm::vec3 normal = glm::vec3(0.0f, 0.0f, 1.0f);
+
+		//Tangent is orthogonalized against the normal, the bitangent only keeps its handedness
+		const PackedAttributes rightHanded = PackAttributes(normal, glm::vec3(1.0f, 0.0f, 0.5f), glm::vec3(0.0f, 2.0f, 0.0f), glm::vec2(0.25f, -3.5f), glm::vec3(1.0f, 0.5f, 2.0f));
+		const glm::vec4 tangent = glm::unpackUnorm3x10_1x2(rightHanded.tangent);
+		OCTO_CHECK(glm::distance(glm::vec3(tangent) * 2.0f - 1.0f, glm::vec3(1.0f, 0.0f, 0.0f)) < 2.0f / 1023.0f);
+		OCTO_CHECK(tangent.w == 1.0f);
+		OCTO_CHECK(glm::unpackHalf2x16(rightHanded.uv) == glm::vec2(0.25f, -3.5f));
+		OCTO_CHECK(glm::distance(glm::unpackUnorm4x8(rightHanded.color), glm::vec4(1.0f, 0.5f, 1.0f, 1.0f)) < 1.0f / 255.0f);
+
+		const PackedAttributes leftHanded = PackAttributes(normal, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(0.0f), glm::vec3(0.0f));
+		OCTO_CHECK(glm::unpackUnorm3x10_1x2(leftHanded.tangent).w == 0.0f);
+
+		//Tangents parallel to the normal still get a frame
+		const PackedAttributes degenerate = PackAttributes(normal, normal, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f), glm::vec3(0.0f));
+		const glm::vec3 fallback = glm::vec3(glm::unpackUnorm3x10_1x2(degenerate.tangent)) * 2.0f - 1.0f;
+		OCTO_CHECK(std::abs(glm::length(fallback) - 1.0f) < 0.01f && std::abs(glm::dot(fallback, normal)) < 0.01f);
+	}
+
+	void TestSkin()
+	{
+		const PackedSkin skin = PackSkin(glm::uvec4(3u, 255u, 17u, 0u), glm::vec4(0.5f, 0.3f, 0.2f, 0.0f));
+		OCTO_CHECK(skin.joints == (3u | (255u << 8u) | (17u << 16u)));
+
+		//Quantized weights sum up to exactly 255
+		const glm::uvec4 weights = glm::uvec4(skin.weights & 0xFFu, (skin.weights >> 8u) & 0xFFu, (skin.weights >> 16u) & 0xFFu, skin.weights >> 24u);
+		OCTO_CHECK(weights.x + weights.y + weights.z + weights.w == 255u);
+		OCTO_CHECK(weights.w == 0u);
+
+		const PackedSkin thirds = PackSkin(glm::uvec4(0u, 1u, 2u, 0u), glm::vec4(1.0f, 1.0f, 1.0f, 0.0f));
+		OCTO_CHECK(((thirds.weights & 0xFFu) + ((thirds.weights >> 8u) & 0xFFu) + ((thirds.weights >> 16u) & 0xFFu) + (thirds.weights >> 24u)) == 255u);
+
+		//Vertices without influences follow the first joint
+		OCTO_CHECK(PackSkin(glm::uvec4(9u, 0u, 0u, 0u), glm::vec4(0.0f)).weights == 255u);
+	}
+}
+
+int main()
+{
+	TestPositions();
+	TestNormals();
+	TestAttributes();
+	TestSkin();
+
+	return OctoTest::GetFailureCount();
+}